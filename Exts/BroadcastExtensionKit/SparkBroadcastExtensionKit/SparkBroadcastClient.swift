@@ -28,6 +28,9 @@ class SparkBroadcastClient : BroadcastConnectionClientDelegate{
     private var applicationGroupIdentifier: String?
     private var suspendCount: Int = 0
     private var connectionClient: BroadcastConnectionClient?
+    private var frameRing: BroadcastFrameRing?
+    private let frameEncoder = BroadcastFrameDelta.Encoder()
+    private var keyframeRequestsServed: UInt64 = 0
     
     var onError: ((SparkError) -> Void)?
     var onStateChange: ((BroadcastExtensionState) -> Void)?
@@ -106,6 +109,11 @@ class SparkBroadcastClient : BroadcastConnectionClientDelegate{
                 completionHandler(SparkError.illegalStatus(reason: "Screen share failure due to no call is active."))
                 self.broadcastState = .Stopped
             } else {
+                // Apps on an older SDK don't create the ring; frames then go over the socket.
+                if let identifier = self.applicationGroupIdentifier, let container = FileManager.default.containerURL(forSecurityApplicationGroupIdentifier: identifier) {
+                    self.frameRing = BroadcastFrameRing(openingAt: container.appendingPathComponent(BroadcastFrameRing.fileName).path)
+                    self.keyframeRequestsServed = self.frameRing?.keyframeRequests ?? 0
+                }
                 completionHandler(nil)
                 self.broadcastState = .Broadcasting
             }
@@ -114,10 +122,78 @@ class SparkBroadcastClient : BroadcastConnectionClientDelegate{
     
     func pushVideoSampleBuffer(sampleBuffer:CMSampleBuffer) {
         if self.broadcastState == .Broadcasting {
+            if let ring = self.frameRing, self.push(sampleBuffer, to: ring) {
+                return
+            }
             self.connectionClient?.push(sampleBuffer)
         }
     }
     
+    // ReplayKit hands out bi-planar 4:2:0 frames, or BGRA ones.
+    private func planes(of pixelBuffer: CVPixelBuffer) -> [BroadcastFrameDelta.Plane] {
+        if CVPixelBufferIsPlanar(pixelBuffer) {
+            return (0..<CVPixelBufferGetPlaneCount(pixelBuffer)).compactMap { index in
+                guard let base = CVPixelBufferGetBaseAddressOfPlane(pixelBuffer, index) else {
+                    return nil
+                }
+                let bytesPerRow = CVPixelBufferGetBytesPerRowOfPlane(pixelBuffer, index)
+                let rowBytes = CVPixelBufferGetWidthOfPlane(pixelBuffer, index) * (index == 0 ? 1 : 2)
+                return BroadcastFrameDelta.Plane(base: base, bytesPerRow: bytesPerRow, rowBytes: min(rowBytes, bytesPerRow), rows: CVPixelBufferGetHeightOfPlane(pixelBuffer, index))
+            }
+        }
+        guard let base = CVPixelBufferGetBaseAddress(pixelBuffer) else {
+            return []
+        }
+        let bytesPerRow = CVPixelBufferGetBytesPerRow(pixelBuffer)
+        return [BroadcastFrameDelta.Plane(base: base, bytesPerRow: bytesPerRow, rowBytes: min(CVPixelBufferGetWidth(pixelBuffer) * 4, bytesPerRow), rows: CVPixelBufferGetHeight(pixelBuffer))]
+    }
+    
+    /// Writes the tiles of the frame that changed since the last one into the shared ring and sends
+    /// its descriptor in place of the frame. Returns false if the frame has to go over the socket.
+    private func push(_ sampleBuffer: CMSampleBuffer, to ring: BroadcastFrameRing) -> Bool {
+        guard let pixelBuffer = CMSampleBufferGetImageBuffer(sampleBuffer) else {
+            return false
+        }
+        CVPixelBufferLockBaseAddress(pixelBuffer, .readOnly)
+        defer {
+            CVPixelBufferUnlockBaseAddress(pixelBuffer, .readOnly)
+        }
+        let planes = self.planes(of: pixelBuffer)
+        let requests = ring.keyframeRequests
+        let delta = self.frameEncoder.prepare(planes, keyframe: requests != self.keyframeRequestsServed)
+        guard !planes.isEmpty, delta.length <= ring.slotCapacity else {
+            return false
+        }
+        let width = Int32(CVPixelBufferGetWidth(pixelBuffer))
+        let height = Int32(CVPixelBufferGetHeight(pixelBuffer))
+        guard let frame = ring.write(width: width, height: height, length: delta.length, fill: { self.frameEncoder.write(delta, to: $0) }) else {
+            // No credit: the app hasn't let go of the frames in flight yet.
+            self.didFail(toSendFrame: .frameProcessingSuspended)
+            return true
+        }
+        self.frameEncoder.commit(delta)
+        if delta.keyframe {
+            self.keyframeRequestsServed = requests
+        }
+        self.didFail(toSendFrame: .none)
+        let seconds = CMTimeGetSeconds(CMSampleBufferGetPresentationTimeStamp(sampleBuffer))
+        var message = FrameMessage()
+        message.error = .none
+        message.timestamp = seconds.isFinite ? UInt32(truncatingIfNeeded: Int64(seconds * 1000)) : 0
+        message.width = width
+        message.height = height
+        message.length = UInt32(BroadcastFrameRing.Descriptor.size)
+        var data = Data(bytes: &message, count: MemoryLayout<FrameMessage>.size)
+        data.append(frame.data)
+        self.connectionClient?.sendMessage(data) {
+            error in
+            if error != nil {
+                self.didFail(toSendFrame: .fatal)
+            }
+        }
+        return true
+    }
+    
     func finishClient() {
         if self.broadcastState == .Broadcasting || self.broadcastState == .Suspended {
             var message = FrameMessage()
@@ -136,6 +212,7 @@ class SparkBroadcastClient : BroadcastConnectionClientDelegate{
     func invalidateClient() {
         if self.broadcastState == .Broadcasting || self.broadcastState == .Suspended {
             self.connectionClient?.invalidate()
+            self.frameRing = nil
             self.broadcastState = .Stopped
         }
     }
@@ -45,19 +45,13 @@ public class JWTAuthenticator : Authenticator {
     
     private let client: JWTAuthClient
     private let storage: JWTAuthStorage
-    private var tokenCompletionHandlers: [(String?) -> Void] = []
+    private var broker: TokenBroker!
     
-    private var unexpiredAccessToken: String? {
-        guard authorized else {
+    private var storedToken: TokenBroker.Token? {
+        guard authorized, let authenticationInfo = storage.authenticationInfo else {
             return nil
         }
-        
-        let buffer: TimeInterval = 15 * 60
-        if let authenticationInfo = storage.authenticationInfo,
-            authenticationInfo.accessTokenExpirationDate > Date(timeIntervalSinceNow: buffer) {
-            return authenticationInfo.accessToken
-        }
-        return nil
+        return TokenBroker.Token(value: authenticationInfo.accessToken, expiration: authenticationInfo.accessTokenExpirationDate)
     }
     
     private var unexpiredJwt: String? {
@@ -113,6 +107,26 @@ public class JWTAuthenticator : Authenticator {
     init(storage: JWTAuthStorage, client: JWTAuthClient) {
         self.client = client
         self.storage = storage
+        self.broker = TokenBroker(clock: Clock(), current: { [unowned self] in
+            return self.storedToken
+        }, fetch: { [unowned self] completionHandler in
+            guard let jwt = self.unexpiredJwt else {
+                completionHandler(nil)
+                return
+            }
+            self.client.fetchTokenFromJWT(jwt) { response in
+                switch response.result {
+                case .success(let jwtAccessTokenCreationResult):
+                    if let authInfo = JWTAuthenticator.authenticationInfoFrom(jwtAccessTokenCreationResult: jwtAccessTokenCreationResult) {
+                        self.storage.authenticationInfo = authInfo
+                    }
+                case .failure(let error):
+                    self.deauthorize()
+                    SDKLogger.shared.error("Failed to fetch token", error: error)
+                }
+                completionHandler(self.storedToken)
+            }
+        })
     }
     
     /// Sets the JWT access token on the authorization strategy, overriting any existing access token.
@@ -122,6 +136,7 @@ public class JWTAuthenticator : Authenticator {
     public func authorizedWith(jwt: String) {
         storage.jwt = jwt
         storage.authenticationInfo = nil
+        broker.invalidate()
     }
     
     /// - see: See Authenticator.deauthorize()
@@ -129,49 +144,22 @@ public class JWTAuthenticator : Authenticator {
     public func deauthorize() {
         storage.jwt = nil
         storage.authenticationInfo = nil
+        broker.invalidate()
+        KeyMaterialCache.shared.removeAll()
+        MessageStore.shared.removeAll()
+        ServiceSession.shared.removeAllCachedResponses()
     }
     
     /// - see: See Authenticator.accessToken(completionHandler:)
     /// - since: 1.2.0
     public func accessToken(completionHandler: @escaping (String?) -> Void) {
-        self.fetchToken(force: false, completionHandler: completionHandler)
+        broker.token(completionHandler: completionHandler)
     }
     
     /// - see: See Authenticator.refreshToken(completionHandler:)
     /// - since: 1.4.0
     public func refreshToken(completionHandler: @escaping (String?) -> Void) {
-        self.fetchToken(force: true, completionHandler: completionHandler)
-    }
-    
-    private func fetchToken(force: Bool, completionHandler: @escaping (String?) -> Void) {
-        tokenCompletionHandlers.append(completionHandler)
-        if let jwt = unexpiredJwt, force || unexpiredAccessToken == nil {
-            if tokenCompletionHandlers.count == 1 {
-                client.fetchTokenFromJWT(jwt) { response in
-                    switch response.result {
-                    case .success(let jwtAccessTokenCreationResult):
-                        if let authInfo = JWTAuthenticator.authenticationInfoFrom(jwtAccessTokenCreationResult: jwtAccessTokenCreationResult) {
-                            self.storage.authenticationInfo = authInfo
-                        }
-                    case .failure(let error):
-                        self.deauthorize()
-                        SDKLogger.shared.error("Failed to fetch token", error: error)
-                    }
-                    self.fireCompletionHandlers()
-                }
-            }
-        } else {
-            self.fireCompletionHandlers()
-        }
-    }
-    
-    private func fireCompletionHandlers() {
-        let accessToken = unexpiredAccessToken
-        let handlers = tokenCompletionHandlers
-        tokenCompletionHandlers = []
-        for handler in handlers {
-            handler(accessToken)
-        }
+        broker.refresh(completionHandler: completionHandler)
     }
     
     private static func authenticationInfoFrom(jwtAccessTokenCreationResult: JWTTokenModel) -> JWTAuthenticationInfo? {
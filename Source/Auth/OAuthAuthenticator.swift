@@ -73,8 +73,7 @@ public class OAuthAuthenticator : Authenticator {
     private let oauthClient: OAuthClient
     private let oauthLauncher: OAuthLauncher
     private let clock: Clock
-    private var accessTokenCompletionHandlers: [(_ accessToken: String?) -> Void] = []
-    private var fetchingAccessTokenInProcess = false
+    private var broker: TokenBroker!
     
     /// The delegate, which gets callbacks for refresh access token failure
     public weak var delegate: OAuthAuthenticatorDelegate?
@@ -85,7 +84,7 @@ public class OAuthAuthenticator : Authenticator {
         if let refreshTokenExpirationDate = storage.tokens?.refreshTokenExpirationDate {
             return refreshTokenExpirationDate > clock.currentTime
         } else {
-            return fetchingAccessTokenInProcess
+            return broker.refreshing
         }
     }
     
@@ -114,6 +113,24 @@ public class OAuthAuthenticator : Authenticator {
         self.oauthClient = oauthClient
         self.oauthLauncher = oauthLauncher
         self.clock = clock
+        self.broker = TokenBroker(clock: clock, current: { [unowned self] in
+            guard self.authorized else {
+                return nil
+            }
+            return self.storage.tokens.map { TokenBroker.Token(value: $0.accessToken, expiration: $0.accessTokenExpirationDate) }
+        }, fetch: { [unowned self] completionHandler in
+            guard self.authorized, let refreshToken = self.storage.tokens?.refreshToken else {
+                completionHandler(nil)
+                return
+            }
+            self.oauthClient.refreshAccessTokenFrom(refreshToken: refreshToken, clientId: self.clientId, clientSecret: self.clientSecret) { response in
+                completionHandler(self.storeTokens(from: response) { error in
+                    SDKLogger.shared.error("Failed to refresh token", error: error)
+                    self.deauthorize()
+                    self.delegate?.refreshAccessTokenFailed()
+                })
+            }
+        })
     }
     
     /// Brings up a web-based authorization view controller and directs the user through the OAuth process.
@@ -125,10 +142,11 @@ public class OAuthAuthenticator : Authenticator {
         if let authorizationUrl = self.authorizationUrl() {
             oauthLauncher.launchOAuthViewController(parentViewController: parentViewController, authorizationUrl: authorizationUrl, redirectUri: redirectUri) { oauthCode in
                 if let oauthCode = oauthCode {
-                    self.fetchingAccessTokenInProcess = true
-                    self.oauthClient.fetchAccessTokenFrom(oauthCode: oauthCode, clientId: self.clientId, clientSecret: self.clientSecret, redirectUri: self.redirectUri, completionHandler: { response in
-                        self.createAccessTokenHandler(errorHandler: { error in SDKLogger.shared.error("Failure retrieving the access token from the oauth code", error: error)})(response)
-                        completionHandler?(true)
+                    self.broker.refresh(using: { tokenHandler in
+                        self.oauthClient.fetchAccessTokenFrom(oauthCode: oauthCode, clientId: self.clientId, clientSecret: self.clientSecret, redirectUri: self.redirectUri, completionHandler: { response in
+                            tokenHandler(self.storeTokens(from: response) { error in SDKLogger.shared.error("Failure retrieving the access token from the oauth code", error: error)})
+                            completionHandler?(true)
+                        })
                     })
                 } else {
                     completionHandler?(false)
@@ -157,50 +175,23 @@ public class OAuthAuthenticator : Authenticator {
     /// - see: See Authenticator.accessToken(completionHandler:)
     /// - since: 1.2.0
     public func accessToken(completionHandler: @escaping (String?) -> Void) {
-        guard authorized else {
-            completionHandler(nil)
-            return
-        }
-        let buffer: TimeInterval = 15 * 60
-        if let tokens = storage.tokens, tokens.accessTokenExpirationDate > Date(timeInterval: buffer, since: clock.currentTime) {
-            completionHandler(tokens.accessToken)
-        } else {
-            self.refreshToken(completionHandler: completionHandler)
-        }
+        broker.token(completionHandler: completionHandler)
     }
     
     /// - see: See Authenticator.refreshToken(completionHandler:)
     /// - since: 1.4.0
     public func refreshToken(completionHandler: @escaping (String?) -> Void) {
-        accessTokenCompletionHandlers.append(completionHandler)
-        if !fetchingAccessTokenInProcess, let refreshToken = storage.tokens?.refreshToken {
-            fetchingAccessTokenInProcess = true
-            oauthClient.refreshAccessTokenFrom(refreshToken: refreshToken, clientId: clientId, clientSecret: clientSecret, completionHandler: self.createAccessTokenHandler(errorHandler: { error in
-                SDKLogger.shared.error("Failed to refresh token", error: error)
-                self.deauthorize()
-                self.delegate?.refreshAccessTokenFailed()
-            }))
-        }
+        broker.refresh(completionHandler: completionHandler)
     }
     
-    private func createAccessTokenHandler(errorHandler: @escaping (Error)->Void) -> (ServiceResponse<OAuthTokenModel>) -> Void {
-        return { response in
-            self.fetchingAccessTokenInProcess = false
-            
-            switch response.result {
-            case .success(let accessTokenObject):
-                self.storage.tokens = OAuthAuthenticator.authenticationInfoFrom(accessTokenObject: accessTokenObject)
-            case .failure(let error):
-                errorHandler(error)
-            }
-            
-            let handlers = self.accessTokenCompletionHandlers
-            self.accessTokenCompletionHandlers = []
-            for handler in handlers {
-                handler(self.storage.tokens?.accessToken)
-            }
-            
+    private func storeTokens(from response: ServiceResponse<OAuthTokenModel>, errorHandler: (Error) -> Void) -> TokenBroker.Token? {
+        switch response.result {
+        case .success(let accessTokenObject):
+            self.storage.tokens = OAuthAuthenticator.authenticationInfoFrom(accessTokenObject: accessTokenObject)
+        case .failure(let error):
+            errorHandler(error)
         }
+        return self.storage.tokens.map { TokenBroker.Token(value: $0.accessToken, expiration: $0.accessTokenExpirationDate) }
     }
     
     private static func authenticationInfoFrom(accessTokenObject: OAuthTokenModel) -> OAuthTokens? {
@@ -222,5 +213,9 @@ public class OAuthAuthenticator : Authenticator {
     /// - since: 1.2.0
     public func deauthorize() {
         storage.tokens = nil
+        broker.invalidate()
+        KeyMaterialCache.shared.removeAll()
+        MessageStore.shared.removeAll()
+        ServiceSession.shared.removeAllCachedResponses()
     }
 }
@@ -0,0 +1,228 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// Hands out the access token of an authenticator to all its callers.
+///
+/// A token that is fresh is read without taking a lock, from a copy published behind a sequence
+/// number. Once the token is within `refreshWindow` of expiring it is still handed out, while it is
+/// refreshed in the background; once it is within `expiryMargin`, callers wait for the refresh.
+/// However many callers arrive, there is at most one refresh in flight and all of them get its result.
+///
+/// - note: for internal use only.
+class TokenBroker {
+    
+    struct Token {
+        let value: String
+        let expiration: Date
+    }
+    
+    /// Fetches a new token and calls back with it, or with nil if there is none to be had.
+    typealias Fetch = (@escaping (Token?) -> Void) -> Void
+    
+    /// Tokens this close to expiring are refreshed ahead of time.
+    static let refreshWindow: TimeInterval = 15 * 60
+    
+    /// Tokens this close to expiring are not handed out any more.
+    static let expiryMargin: TimeInterval = 60
+    
+    // The published token takes the words after the sequence, expiration and length.
+    private static let capacity = 512
+    
+    private let clock: Clock
+    private let current: () -> Token?
+    private let fetch: Fetch
+    private let lock = NSLock()
+    private var waiters = [(String?) -> Void]()
+    private var flight = 0
+    private var epoch = 0
+    // [sequence, expiration, length, utf8...], odd sequence while being written.
+    private let published: UnsafeMutablePointer<Int64>
+    // Set while a fetch is in flight, so the read path can tell without the lock.
+    private let fetching: UnsafeMutablePointer<Int64>
+    
+    /// - parameter current: the token as stored by the authenticator, if any; read only when there is no fresh published token.
+    /// - parameter fetch: how to get a new token.
+    init(clock: Clock, current: @escaping () -> Token?, fetch: @escaping Fetch) {
+        self.clock = clock
+        self.current = current
+        self.fetch = fetch
+        self.published = UnsafeMutablePointer<Int64>.allocate(capacity: 3 + TokenBroker.capacity)
+        self.published.initialize(repeating: 0, count: 3 + TokenBroker.capacity)
+        self.fetching = UnsafeMutablePointer<Int64>.allocate(capacity: 1)
+        self.fetching.initialize(to: 0)
+    }
+    
+    deinit {
+        self.published.deallocate()
+        self.fetching.deallocate()
+    }
+    
+    /// Whether a fetch is in flight.
+    var refreshing: Bool {
+        return spark_atomic_load(self.fetching) != 0
+    }
+    
+    /// Calls back with a token that is not about to expire, or nil if none could be fetched.
+    func token(completionHandler: @escaping (String?) -> Void) {
+        let now = self.clock.currentTime
+        if let token = self.load(), token.expiration > now.addingTimeInterval(TokenBroker.expiryMargin) {
+            if token.expiration <= now.addingTimeInterval(TokenBroker.refreshWindow) {
+                self.refreshAhead()
+            }
+            completionHandler(token.value)
+            return
+        }
+        self.lock.lock()
+        if let token = self.current(), token.expiration > now.addingTimeInterval(TokenBroker.expiryMargin) {
+            self.publish(token)
+            self.lock.unlock()
+            if token.expiration <= now.addingTimeInterval(TokenBroker.refreshWindow) {
+                self.refreshAhead()
+            }
+            completionHandler(token.value)
+            return
+        }
+        self.waiters.append(completionHandler)
+        self.startIfIdle()
+    }
+    
+    /// Drops the current token and calls back with a new one, sharing the fetch in flight if there is one.
+    func refresh(completionHandler: @escaping (String?) -> Void) {
+        self.lock.lock()
+        self.publish(nil)
+        self.waiters.append(completionHandler)
+        self.startIfIdle()
+    }
+    
+    /// Gets the token from `fetch` instead, e.g. when authorizing. Callers waiting for a fetch in
+    /// flight get this one's result instead.
+    func refresh(using fetch: @escaping Fetch) {
+        self.lock.lock()
+        self.start(fetch)
+    }
+    
+    /// Forgets the token; a fetch in flight still calls back its waiters but doesn't publish.
+    func invalidate() {
+        self.lock.lock()
+        self.epoch += 1
+        self.publish(nil)
+        self.lock.unlock()
+    }
+    
+    private func refreshAhead() {
+        guard !self.refreshing else {
+            return
+        }
+        self.lock.lock()
+        self.startIfIdle()
+    }
+    
+    // The following expect the lock to be held, and release it.
+    
+    private func startIfIdle() {
+        if self.refreshing {
+            self.lock.unlock()
+        }
+        else {
+            self.start(self.fetch)
+        }
+    }
+    
+    private func start(_ fetch: Fetch) {
+        self.flight += 1
+        let flight = self.flight
+        let epoch = self.epoch
+        spark_atomic_store(self.fetching, 1)
+        self.lock.unlock()
+        fetch { token in
+            self.complete(token, flight: flight, epoch: epoch)
+        }
+    }
+    
+    private func complete(_ token: Token?, flight: Int, epoch: Int) {
+        self.lock.lock()
+        guard flight == self.flight else {
+            // Superseded; its waiters are the newer fetch's now.
+            self.lock.unlock()
+            return
+        }
+        spark_atomic_store(self.fetching, 0)
+        if epoch == self.epoch {
+            self.publish(token)
+        }
+        let waiters = self.waiters
+        self.waiters = []
+        self.lock.unlock()
+        for waiter in waiters {
+            waiter(token?.value)
+        }
+    }
+    
+    // MARK: Published token
+    
+    /// Must be called with the lock held.
+    private func publish(_ token: Token?) {
+        spark_atomic_fetch_add(self.published, 1)
+        let bytes = token.map { Array($0.value.utf8) } ?? []
+        if let token = token, !bytes.isEmpty, bytes.count <= TokenBroker.capacity * 8 {
+            spark_atomic_store(self.published + 1, Int64(bitPattern: token.expiration.timeIntervalSinceReferenceDate.bitPattern))
+            spark_atomic_store(self.published + 2, Int64(bytes.count))
+            for index in 0..<(bytes.count + 7) / 8 {
+                var word: Int64 = 0
+                for offset in 0..<min(8, bytes.count - index * 8) {
+                    word |= Int64(bytes[index * 8 + offset]) << Int64(offset * 8)
+                }
+                spark_atomic_store(self.published + 3 + index, word)
+            }
+        }
+        else {
+            // Too long to publish is fine, it is then read under the lock.
+            spark_atomic_store(self.published + 2, 0)
+        }
+        spark_atomic_fetch_add(self.published, 1)
+    }
+    
+    /// The published token, or nil if there is none or it was being replaced.
+    private func load() -> Token? {
+        let sequence = spark_atomic_load(self.published)
+        guard sequence & 1 == 0 else {
+            return nil
+        }
+        let expiration = Date(timeIntervalSinceReferenceDate: Double(bitPattern: UInt64(bitPattern: spark_atomic_load(self.published + 1))))
+        let length = Int(spark_atomic_load(self.published + 2))
+        guard length > 0 && length <= TokenBroker.capacity * 8 else {
+            return nil
+        }
+        var bytes = [UInt8](repeating: 0, count: length)
+        for index in 0..<(length + 7) / 8 {
+            let word = spark_atomic_load(self.published + 3 + index)
+            for offset in 0..<min(8, length - index * 8) {
+                bytes[index * 8 + offset] = UInt8(truncatingIfNeeded: word >> Int64(offset * 8))
+            }
+        }
+        guard spark_atomic_load(self.published) == sequence else {
+            return nil
+        }
+        return Token(value: String(decoding: bytes, as: UTF8.self), expiration: expiration)
+    }
+}
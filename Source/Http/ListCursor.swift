@@ -0,0 +1,202 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import ObjectMapper
+
+/// A cursor over every item of a list, across as many pages as the service returns.
+///
+/// Pages are fetched by following the `Link: <...>; rel="next"` header of each response. The next
+/// page is requested as soon as the current one arrives, so it is usually there by the time the
+/// current one has been consumed. Items are kept as JSON and mapped only when handed out, and no
+/// more than the current and the next page are held at once.
+///
+/// - since: 1.4.2
+public class ListCursor<T: BaseMappable> {
+    
+    private let authenticator: Authenticator
+    private let queue: DispatchQueue
+    private let state = DispatchQueue(label: "com.ciscospark.sdk.ListCursor")
+    private var first: ServiceRequest.Builder?
+    private var items = ArraySlice<[String: Any]>()
+    private var prefetched: [[String: Any]]?
+    private var nextUrl: URL?
+    private var loading = false
+    private var cancelled = false
+    private var error: Error?
+    private var waiting = [(Result<T?>) -> Void]()
+    
+    init(authenticator: Authenticator, request: ServiceRequest.Builder, queue: DispatchQueue?) {
+        self.authenticator = authenticator
+        self.first = request
+        self.queue = queue ?? DispatchQueue.main
+    }
+    
+    /// Hands out the next item, or nil once all items have been handed out or the cursor was cancelled.
+    ///
+    /// - parameter completionHandler: A closure to be executed with the item, on the queue the cursor was created with.
+    /// - returns: Void
+    /// - since: 1.4.2
+    public func next(completionHandler: @escaping (Result<T?>) -> Void) {
+        self.state.async {
+            self.waiting.append(completionHandler)
+            self.serve()
+        }
+    }
+    
+    /// Hands out the items one by one until `body` returns false, all items have been handed out, or
+    /// a page fails to load. Stopping early cancels the cursor.
+    ///
+    /// - parameter body: A closure to be executed with each item; returns whether to continue.
+    /// - parameter completionHandler: A closure to be executed at the end, with the error if a page failed to load.
+    /// - returns: Void
+    /// - since: 1.4.2
+    public func forEach(_ body: @escaping (T) -> Bool, completionHandler: @escaping (Error?) -> Void) {
+        self.next { result in
+            switch result {
+            case .success(let item?):
+                if body(item) {
+                    self.forEach(body, completionHandler: completionHandler)
+                }
+                else {
+                    self.cancel()
+                    completionHandler(nil)
+                }
+            case .success(nil):
+                completionHandler(nil)
+            case .failure(let error):
+                completionHandler(error)
+            }
+        }
+    }
+    
+    /// Stops the cursor. Pages still in flight are dropped, and `next` hands out nil from now on.
+    ///
+    /// - returns: Void
+    /// - since: 1.4.2
+    public func cancel() {
+        self.state.async {
+            self.cancelled = true
+            self.items = []
+            self.prefetched = nil
+            self.serve()
+        }
+    }
+    
+    // Must run on the state queue.
+    private func serve() {
+        while !self.waiting.isEmpty {
+            var result: Result<T?>
+            if self.cancelled {
+                result = .success(nil)
+            }
+            else if let json = self.items.popFirst() {
+                // Items the model can't be mapped from are skipped rather than ending the list.
+                guard let item = Mapper<T>().map(JSON: json) else {
+                    continue
+                }
+                result = .success(item)
+            }
+            else if let page = self.prefetched {
+                self.prefetched = nil
+                self.items = ArraySlice(page)
+                self.load()
+                continue
+            }
+            else if let error = self.error {
+                result = .failure(error)
+            }
+            else if self.loading || self.first != nil {
+                self.load()
+                return
+            }
+            else {
+                result = .success(nil)
+            }
+            let handler = self.waiting.removeFirst()
+            self.queue.async {
+                handler(result)
+            }
+        }
+    }
+    
+    // Must run on the state queue. Loads the first page, or the one after the last page loaded,
+    // unless a page is already loading or waiting to be consumed.
+    private func load() {
+        guard !self.loading, !self.cancelled, self.prefetched == nil, self.error == nil else {
+            return
+        }
+        var builder: ServiceRequest.Builder
+        if let first = self.first {
+            builder = first
+            self.first = nil
+        }
+        else if let url = self.nextUrl {
+            builder = ServiceRequest.Builder(self.authenticator).baseUrl(url).method(.get)
+            self.nextUrl = nil
+        }
+        else {
+            return
+        }
+        self.loading = true
+        builder.queue(self.state).build().responseJSON { (response: ServiceResponse<Any>) in
+            self.loading = false
+            if self.cancelled {
+                self.serve()
+                return
+            }
+            switch response.result {
+            case .success(let json):
+                self.nextUrl = response.response?.nextPageUrl
+                let page = (json as? [String: Any])?["items"] as? [[String: Any]] ?? []
+                if self.items.isEmpty {
+                    self.items = ArraySlice(page)
+                }
+                else {
+                    self.prefetched = page
+                }
+            case .failure(let error):
+                self.error = error
+            }
+            self.load()
+            self.serve()
+        }
+    }
+}
+
+extension HTTPURLResponse {
+    
+    /// The target of the `rel="next"` link, if the response is a page of a longer list.
+    var nextPageUrl: URL? {
+        guard let header = (self.allHeaderFields["Link"] ?? self.allHeaderFields["link"]) as? String else {
+            return nil
+        }
+        for link in header.components(separatedBy: ",") {
+            let parts = link.components(separatedBy: ";").map { $0.trimmingCharacters(in: .whitespaces) }
+            guard let target = parts.first, target.hasPrefix("<"), target.hasSuffix(">"),
+                parts.dropFirst().contains(where: { $0.replacingOccurrences(of: "\"", with: "") == "rel=next" }) else {
+                continue
+            }
+            return URL(string: String(target.dropFirst().dropLast()))
+        }
+        return nil
+    }
+}
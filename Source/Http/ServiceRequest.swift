@@ -24,7 +24,7 @@ import AlamofireObjectMapper
 import ObjectMapper
 import SwiftyJSON
 
-class ServiceRequest : RequestRetrier, RequestAdapter {
+class ServiceRequest {
     
     #if INTEGRATIONTEST
     static let HYDRA_SERVER_ADDRESS:String = ProcessInfo().environment["HYDRA_SERVER_ADDRESS"] == nil ? "https://api.ciscospark.com/v1":ProcessInfo().environment["HYDRA_SERVER_ADDRESS"]!
@@ -35,7 +35,6 @@ class ServiceRequest : RequestRetrier, RequestAdapter {
     static let KMS_SERVER_ADDRESS: String = "https://encryption-a.wbx2.com/encryption/api/v1"
     static let LOCUS_RESPONSE_ONLY_SDP: Bool = true
     
-    private var pendingTimeCount : Int = 0
     private let url: URL
     private let headers: [String: String]
     private let method: Alamofire.HTTPMethod
@@ -43,17 +42,14 @@ class ServiceRequest : RequestRetrier, RequestAdapter {
     private let query: RequestParameter?
     private let keyPath: String?
     private let queue: DispatchQueue?
+    private let compressBody: Bool
+    private let coalesce: Bool
+    private let ttl: TimeInterval?
+    private let invalidates: [URL]
     private let authenticator: Authenticator
-    private var newAccessToken: String? = nil
-    private var refreshTokenCount = 0
-    private let sessionManager: SessionManager = {
-        let configuration = URLSessionConfiguration.default
-        configuration.httpAdditionalHeaders = SessionManager.defaultHTTPHeaders
-        return SessionManager(configuration: configuration)
-    }()
+    private let session: ServiceSession
     
-    
-    private init(authenticator: Authenticator, url: URL, headers: [String: String], method: Alamofire.HTTPMethod, body: RequestParameter?, query: RequestParameter?, keyPath: String?, queue: DispatchQueue?) {
+    private init(authenticator: Authenticator, url: URL, headers: [String: String], method: Alamofire.HTTPMethod, body: RequestParameter?, query: RequestParameter?, keyPath: String?, queue: DispatchQueue?, compressBody: Bool, coalesce: Bool, ttl: TimeInterval?, invalidates: [URL], session: ServiceSession) {
         self.authenticator = authenticator
         self.url = url
         self.headers = headers
@@ -62,6 +58,11 @@ class ServiceRequest : RequestRetrier, RequestAdapter {
         self.query = query
         self.keyPath = keyPath
         self.queue = queue
+        self.compressBody = compressBody
+        self.coalesce = coalesce
+        self.ttl = ttl
+        self.invalidates = invalidates
+        self.session = session
     }
     
     class Builder {
@@ -76,6 +77,11 @@ class ServiceRequest : RequestRetrier, RequestAdapter {
         private var query: RequestParameter?
         private var keyPath: String?
         private var queue: DispatchQueue?
+        private var compressBody = false
+        private var coalesce: Bool?
+        private var ttl: TimeInterval?
+        private var invalidates = [String]()
+        private var session = ServiceSession.shared
         
         init(_ authenticator: Authenticator) {
             self.authenticator = authenticator
@@ -88,7 +94,10 @@ class ServiceRequest : RequestRetrier, RequestAdapter {
         }
         
         func build() -> ServiceRequest {
-            return ServiceRequest(authenticator: authenticator, url: baseUrl.appendingPathComponent(path), headers: headers, method: method, body: body, query: query, keyPath: keyPath, queue: queue)
+            // Without a path, the base URL is taken as is, query included; pages of a list link to their next page that way.
+            return ServiceRequest(authenticator: authenticator, url: path.isEmpty ? baseUrl : baseUrl.appendingPathComponent(path), headers: headers, method: method, body: body, query: query, keyPath: keyPath, queue: queue, compressBody: compressBody,
+                                  coalesce: coalesce ?? (method == .get), ttl: method == .get ? ttl : nil,
+                                  invalidates: invalidates.map { baseUrl.appendingPathComponent($0) }, session: session)
         }
         
         func method(_ method: Alamofire.HTTPMethod) -> Builder {
@@ -135,58 +144,65 @@ class ServiceRequest : RequestRetrier, RequestAdapter {
             self.queue = queue
             return self
         }
+        
+        /// Sends the body gzip encoded. Only for services known to accept `Content-Encoding: gzip`.
+        func compressBody(_ compressBody: Bool) -> Builder {
+            self.compressBody = compressBody
+            return self
+        }
+        
+        /// Whether identical requests in flight share one network call. On by default for GETs;
+        /// set it for other requests only if they are idempotent.
+        func coalesce(_ coalesce: Bool) -> Builder {
+            self.coalesce = coalesce
+            return self
+        }
+        
+        /// Caches the response of a GET for `ttl` seconds, and revalidates it with its ETag after.
+        func cache(ttl: TimeInterval) -> Builder {
+            self.ttl = ttl
+            return self
+        }
+        
+        /// Drops the cached response of another resource, `path` under the base URL, once this write
+        /// succeeds. For writes that change what a different path answers, such as `people/me`.
+        func invalidates(_ path: String) -> Builder {
+            self.invalidates.append(path)
+            return self
+        }
+        
+        func session(_ session: ServiceSession) -> Builder {
+            self.session = session
+            return self
+        }
     }
     
     func responseObject<T: BaseMappable>(_ completionHandler: @escaping (ServiceResponse<T>) -> Void) {
-        let queue = self.queue
-        let keyPath = self.keyPath
-        createAlamofireRequest() { request in
-            request.responseObject(queue: queue, keyPath: keyPath) { (response: DataResponse<T>) in
-                var result: Result<T>
-                switch response.result {
-                case .success(let value):
-                    result = .success(value)
-                case .failure(var error):
-                    if response.response != nil {
-                        if let data = response.data {
-                            error = SparkError.requestErrorWith(data: data)
-                        }
-                    }
-                    result = .failure(error)
-                }
-                completionHandler(ServiceResponse(response.response, result))
-            }
-        }
+        self.response(serializer: DataRequest.ObjectMapperSerializer(self.keyPath), completionHandler)
     }
     
     func responseArray<T: BaseMappable>(_ completionHandler: @escaping (ServiceResponse<[T]>) -> Void) {
-        let queue = self.queue
-        let keyPath = self.keyPath
-        createAlamofireRequest() { request in
-            request.responseArray(queue: queue, keyPath: keyPath) { (response: DataResponse<[T]>) in
-                var result: Result<[T]>
-                switch response.result {
-                case .success(let value):
-                    result = .success(value)
-                case .failure(var error):
-                    if response.response != nil {
-                        if let data = response.data {
-                            error = SparkError.requestErrorWith(data: data)
-                        }
-                    }
-                    result = .failure(error)
-                }
-                completionHandler(ServiceResponse(response.response, result))
-            }
-        }
+        self.response(serializer: DataRequest.ObjectMapperArraySerializer(self.keyPath), completionHandler)
     }
     
     func responseJSON(_ completionHandler: @escaping (ServiceResponse<Any>) -> Void) {
-        let queue = self.queue
-        createAlamofireRequest() { request in
-            request.responseJSON(queue: queue) { (response: DataResponse<Any>) in
-                var result: Result<Any>
-                switch response.result {
+        self.response(serializer: DataRequest.jsonResponseSerializer(), completionHandler)
+    }
+    
+    // Responses are shared between coalesced requests, so each request serializes its own copy,
+    // off the completion queue.
+    private func response<T>(serializer: DataResponseSerializer<T>, _ completionHandler: @escaping (ServiceResponse<T>) -> Void) {
+        let queue = self.queue ?? DispatchQueue.main
+        createURLRequest() { urlRequest in
+            guard let urlRequest = urlRequest.data else {
+                queue.async {
+                    completionHandler(ServiceResponse(nil, .failure(urlRequest.error ?? SparkError.illegalOperation(reason: "Invalid request"))))
+                }
+                return
+            }
+            self.session.send(urlRequest, authenticator: self.authenticator, coalesce: self.coalesce, ttl: self.ttl, invalidates: self.invalidates) { response in
+                var result: Result<T>
+                switch serializer.serializeResponse(response.request, response.response, response.data, response.error) {
                 case .success(let value):
                     result = .success(value)
                 case .failure(var error):
@@ -197,97 +213,37 @@ class ServiceRequest : RequestRetrier, RequestAdapter {
                     }
                     result = .failure(error)
                 }
-                completionHandler(ServiceResponse(response.response, result))
+                queue.async {
+                    completionHandler(ServiceResponse(response.response, result))
+                }
             }
         }
     }
     
-    private func createAlamofireRequest(completionHandler: @escaping (Alamofire.DataRequest) -> Void) {
-        let accessTokenCallback: (String?) -> Void = { accessToken in
+    private func createURLRequest(completionHandler: @escaping (Result<URLRequest>) -> Void) {
+        authenticator.accessToken { accessToken in
             var headers = self.headers
             if let accessToken = accessToken {
                 headers["Authorization"] = "Bearer " + accessToken
             }
-            
-            let urlRequestConvertible: URLRequestConvertible
             do {
                 var urlRequest = try URLRequest(url: self.url, method: self.method, headers: headers)
                 //disable http local cache data.
                 urlRequest.cachePolicy = .reloadIgnoringLocalCacheData
                 if let body = self.body {
                     urlRequest = try JSONEncoding.default.encode(urlRequest, with: body.value())
+                    if self.compressBody, let data = urlRequest.httpBody, let gzipped = data.gzipped() {
+                        urlRequest.httpBody = gzipped
+                        urlRequest.setValue("gzip", forHTTPHeaderField: "Content-Encoding")
+                    }
                 }
                 if let query = self.query {
                     urlRequest = try URLEncoding.default.encode(urlRequest, with: query.value())
                 }
-                urlRequestConvertible = urlRequest
-            } catch {
-                class ErrorRequestConvertible : URLRequestConvertible {
-                    private let error: Error
-                    
-                    init(_ error: Error) {
-                        self.error = error
-                    }
-                    
-                    func asURLRequest() throws -> URLRequest {
-                        throw self.error
-                    }
-                }
-                urlRequestConvertible = ErrorRequestConvertible(error)
+                completionHandler(.success(urlRequest))
+            } catch let error {
+                completionHandler(.failure(error))
             }
-            self.sessionManager.retrier = self
-            self.sessionManager.adapter = self
-            self.sessionManager.delegate.taskWillPerformHTTPRedirection = { session, task, response, request in
-                var finalRequest = request
-                if let accessToken = accessToken {
-                    finalRequest.setValue("Bearer " + accessToken, forHTTPHeaderField: "Authorization")
-                }
-                return finalRequest
-            }
-            completionHandler(self.sessionManager.request(urlRequestConvertible).validate())
-        }
-        
-        authenticator.accessToken { accessToken in
-            accessTokenCallback(accessToken)
-        }
-    }
-    
-    func adapt(_ urlRequest: URLRequest) throws -> URLRequest {
-        var urlRequest = urlRequest
-        if let newToken = self.newAccessToken, let _ =  urlRequest.value(forHTTPHeaderField: "Authorization") {
-            urlRequest.setValue("Bearer " + newToken, forHTTPHeaderField: "Authorization")
-            self.refreshTokenCount += 1
-        }
-        return urlRequest
-    }
-    
-    func should(_ manager: SessionManager, retry request: Request, with error: Error, completion: @escaping RequestRetryCompletion) {
-        if let response = request.task?.response as? HTTPURLResponse, response.statusCode == 429 {
-            if var retryAfter = response.allHeaderFields["Retry-After"] as? Int {
-                if retryAfter > 3600 {
-                    retryAfter = 3600
-                } else if retryAfter == 0 {
-                    retryAfter = 60
-                }
-                self.pendingTimeCount += retryAfter
-                completion(true, TimeInterval(retryAfter))
-            }
-        } else if let response = request.task?.response as? HTTPURLResponse, response.statusCode == 401 {
-            self.authenticator.refreshToken(completionHandler: { accessToken in
-                if accessToken == nil {
-                    self.newAccessToken = accessToken
-                    completion(false, 0.0)
-                } else {
-                    if self.refreshTokenCount >= 2{// After Refreshed token twice, if still get 401 from server, returns error.
-                        completion(false, 0.0)
-                    } else {
-                        self.newAccessToken = accessToken
-                        completion(true, 0.0)
-                    }
-                }
-            })
-        } else {
-            completion(false,0.0)
         }
     }
 }
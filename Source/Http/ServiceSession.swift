@@ -0,0 +1,288 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import Alamofire
+
+/// The one URL session every `ServiceRequest` goes through.
+///
+/// Connections to a service are reused across requests, identical requests in flight share one
+/// network call, and responses of requests built with a TTL are cached and revalidated with their
+/// ETag. Token refresh on 401 and back-off on 429 are handled here for all requests.
+///
+/// - note: for internal use only.
+class ServiceSession: RequestRetrier, RequestAdapter {
+    
+    /// The session requests are sent through unless their builder names another.
+    /// Tests replace it to point the whole SDK at a stand-in server.
+    static var shared = ServiceSession()
+    
+    struct Response {
+        let request: URLRequest?
+        let response: HTTPURLResponse?
+        let data: Data?
+        let error: Error?
+    }
+    
+    struct Statistics {
+        /// Requests asked for, however they were answered.
+        var requests = 0
+        /// Requests that went to the network.
+        var network = 0
+        /// Requests answered by a call already in flight.
+        var coalesced = 0
+        /// Requests answered from the cache without a network call.
+        var cacheHits = 0
+        /// Conditional requests answered with 304 Not Modified.
+        var revalidated = 0
+        var failures = 0
+        
+        var hitRate: Double {
+            return self.requests > 0 ? Double(self.coalesced + self.cacheHits + self.revalidated) / Double(self.requests) : 0
+        }
+    }
+    
+    private struct CacheEntry {
+        let response: HTTPURLResponse
+        let data: Data
+        let etag: String?
+        var expires: Date
+        var lastUsed: Date
+    }
+    
+    static let defaultMaximumConnectionsPerHost = 4
+    
+    static let cacheCapacity = 64
+    
+    /// Token refreshes remembered for requests still carrying an older token. Only the latest
+    /// few matter: a request waits on at most a couple of refreshes.
+    static let refreshedTokenCapacity = 8
+    
+    var statistics: Statistics {
+        var statistics = Statistics()
+        synchronized(lock: self) {
+            statistics = self._statistics
+        }
+        return statistics
+    }
+    
+    private let manager: SessionManager
+    private var _statistics = Statistics()
+    private var inFlight = [String: [(Response) -> Void]]()
+    private var cache = [String: CacheEntry]()
+    private var authenticators = [ObjectIdentifier: Authenticator]()
+    // Tokens replaced on a 401, oldest first, so retries of requests still carrying the old one get the new one.
+    private var refreshedTokens = [(old: String, new: String)]()
+    
+    init(configuration: URLSessionConfiguration = URLSessionConfiguration.default, maximumConnectionsPerHost: Int = ServiceSession.defaultMaximumConnectionsPerHost) {
+        configuration.httpAdditionalHeaders = SessionManager.defaultHTTPHeaders
+        configuration.httpMaximumConnectionsPerHost = maximumConnectionsPerHost
+        // Responses worth caching are cached below, keyed by user; URLCache would only get in the way.
+        configuration.urlCache = nil
+        configuration.requestCachePolicy = .reloadIgnoringLocalCacheData
+        self.manager = SessionManager(configuration: configuration)
+        // Requests are resumed once their authenticator is registered, so even a fast 401 finds it.
+        self.manager.startRequestsImmediately = false
+        self.manager.retrier = self
+        self.manager.adapter = self
+        self.manager.delegate.taskWillPerformHTTPRedirection = { session, task, response, request in
+            var redirected = request
+            if let authorization = task.originalRequest?.value(forHTTPHeaderField: "Authorization") {
+                redirected.setValue(authorization, forHTTPHeaderField: "Authorization")
+            }
+            return redirected
+        }
+    }
+    
+    /// Sends `request`, or joins an identical one already in flight if `coalesce` is set.
+    /// With a `ttl`, a cached response younger than that is returned without a network call.
+    /// Cached responses of `invalidates` are dropped once the request succeeds.
+    func send(_ request: URLRequest, authenticator: Authenticator, coalesce: Bool, ttl: TimeInterval?, invalidates: [URL] = [], completionHandler: @escaping (Response) -> Void) {
+        let key = coalesce || ttl != nil ? ServiceSession.key(of: request) : ""
+        var cached: CacheEntry?
+        var joined = false
+        var request = request
+        synchronized(lock: self) {
+            self._statistics.requests += 1
+            if request.httpMethod != HTTPMethod.get.rawValue {
+                // Writes make whatever was cached for the resource stale.
+                self.cache = self.cache.filter { $0.value.response.url?.path != request.url?.path }
+            }
+            if ttl != nil, var entry = self.cache[key] {
+                if entry.expires > Date() {
+                    entry.lastUsed = Date()
+                    self.cache[key] = entry
+                    self._statistics.cacheHits += 1
+                    cached = entry
+                    return
+                }
+                if let etag = entry.etag {
+                    request.setValue(etag, forHTTPHeaderField: "If-None-Match")
+                }
+            }
+            if coalesce {
+                if self.inFlight[key] != nil {
+                    self.inFlight[key]?.append(completionHandler)
+                    self._statistics.coalesced += 1
+                    joined = true
+                    return
+                }
+                self.inFlight[key] = [completionHandler]
+            }
+            self._statistics.network += 1
+        }
+        if let entry = cached {
+            completionHandler(Response(request: request, response: entry.response, data: entry.data, error: nil))
+            return
+        }
+        if joined {
+            return
+        }
+        let conditional = request.value(forHTTPHeaderField: "If-None-Match") != nil
+        let dataRequest = self.manager.request(request).validate { _, response, _ in
+            if (200..<300).contains(response.statusCode) || (conditional && response.statusCode == 304) {
+                return .success
+            }
+            return .failure(AFError.responseValidationFailed(reason: .unacceptableStatusCode(code: response.statusCode)))
+        }
+        synchronized(lock: self) {
+            self.authenticators[ObjectIdentifier(dataRequest)] = authenticator
+        }
+        dataRequest.resume()
+        dataRequest.response(queue: DispatchQueue.global(qos: .userInitiated)) { response in
+            var result = Response(request: response.request, response: response.response, data: response.data, error: response.error)
+            var waiters = [completionHandler]
+            synchronized(lock: self) {
+                self.authenticators[ObjectIdentifier(dataRequest)] = nil
+                if coalesce {
+                    waiters = self.inFlight.removeValue(forKey: key) ?? []
+                }
+                if let http = response.response, http.statusCode == 304, let entry = self.cache[key] {
+                    self._statistics.revalidated += 1
+                    self.cache[key]?.expires = Date().addingTimeInterval(ttl ?? 0)
+                    self.cache[key]?.lastUsed = Date()
+                    result = Response(request: response.request, response: entry.response, data: entry.data, error: nil)
+                }
+                else if let ttl = ttl, response.error == nil, let http = response.response, let data = response.data {
+                    self.store(CacheEntry(response: http, data: data, etag: http.allHeaderFields["Etag"] as? String ?? http.allHeaderFields["ETag"] as? String, expires: Date().addingTimeInterval(ttl), lastUsed: Date()), for: key)
+                }
+                if result.error != nil {
+                    self._statistics.failures += 1
+                }
+                else if !invalidates.isEmpty {
+                    // Dropped on success rather than on send, so a read of them that raced the write isn't cached past it.
+                    let paths = Set(invalidates.map { $0.path })
+                    self.cache = self.cache.filter { !paths.contains($0.value.response.url?.path ?? "") }
+                }
+            }
+            waiters.forEach { $0(result) }
+        }
+    }
+    
+    /// Drops cached responses and remembered token refreshes, used when the user changes.
+    func removeAllCachedResponses() {
+        synchronized(lock: self) {
+            self.cache.removeAll()
+            self.refreshedTokens.removeAll()
+        }
+    }
+    
+    // Must hold the lock.
+    private func store(_ entry: CacheEntry, for key: String) {
+        self.cache[key] = entry
+        if self.cache.count > ServiceSession.cacheCapacity, let oldest = self.cache.min(by: { $0.value.lastUsed < $1.value.lastUsed }) {
+            self.cache[oldest.key] = nil
+        }
+    }
+    
+    /// Requests are the same if they'd be the same on the wire for the same user.
+    private static func key(of request: URLRequest) -> String {
+        return [request.httpMethod ?? "", request.url?.absoluteString ?? "", request.value(forHTTPHeaderField: "Authorization") ?? "",
+                request.httpBody.map { $0.base64EncodedString() } ?? ""].joined(separator: " ")
+    }
+    
+    // MARK: RequestAdapter
+    
+    func adapt(_ urlRequest: URLRequest) throws -> URLRequest {
+        guard let authorization = urlRequest.value(forHTTPHeaderField: "Authorization"), authorization.hasPrefix("Bearer ") else {
+            return urlRequest
+        }
+        var token = String(authorization.dropFirst("Bearer ".count))
+        synchronized(lock: self) {
+            // A token can have been refreshed more than once while the request waited.
+            for _ in 0..<4 {
+                guard let refreshed = self.refreshedTokens.reversed().first(where: { $0.old == token }) else {
+                    break
+                }
+                token = refreshed.new
+            }
+        }
+        var urlRequest = urlRequest
+        urlRequest.setValue("Bearer " + token, forHTTPHeaderField: "Authorization")
+        return urlRequest
+    }
+    
+    // MARK: RequestRetrier
+    
+    func should(_ manager: SessionManager, retry request: Request, with error: Error, completion: @escaping RequestRetryCompletion) {
+        if let response = request.task?.response as? HTTPURLResponse, response.statusCode == 429 {
+            if var retryAfter = response.allHeaderFields["Retry-After"] as? Int {
+                if retryAfter > 3600 {
+                    retryAfter = 3600
+                } else if retryAfter == 0 {
+                    retryAfter = 60
+                }
+                completion(true, TimeInterval(retryAfter))
+            }
+            else {
+                completion(false, 0.0)
+            }
+        } else if let response = request.task?.response as? HTTPURLResponse, response.statusCode == 401 {
+            var authenticator: Authenticator?
+            synchronized(lock: self) {
+                authenticator = self.authenticators[ObjectIdentifier(request)]
+            }
+            // After refreshing the token twice, a 401 from the server is returned as an error.
+            guard let owner = authenticator, request.retryCount < 2 else {
+                completion(false, 0.0)
+                return
+            }
+            let old = request.request?.value(forHTTPHeaderField: "Authorization").map { String($0.dropFirst("Bearer ".count)) }
+            owner.refreshToken(completionHandler: { accessToken in
+                guard let accessToken = accessToken else {
+                    completion(false, 0.0)
+                    return
+                }
+                if let old = old {
+                    synchronized(lock: self) {
+                        self.refreshedTokens.append((old: old, new: accessToken))
+                        if self.refreshedTokens.count > ServiceSession.refreshedTokenCapacity {
+                            self.refreshedTokens.removeFirst(self.refreshedTokens.count - ServiceSession.refreshedTokenCapacity)
+                        }
+                    }
+                }
+                completion(true, 0.0)
+            })
+        } else {
+            completion(false, 0.0)
+        }
+    }
+}
@@ -0,0 +1,191 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// Rolling log file in a compact binary form.
+///
+/// Records are appended unformatted, length-prefixed, into `log.0`; once that file would grow past
+/// half of `maxSize` it becomes `log.1` and a new `log.0` is started, so at most `maxSize` bytes
+/// are kept on disk. Text is only produced by `read()`.
+///
+/// Not thread safe; `SDKLogger` only touches it from its writer queue.
+///
+/// - note: for internal use only.
+class LogFileSink {
+    
+    let directory: URL
+    let maxSize: UInt64
+    
+    private var handle: FileHandle?
+    private var size: UInt64 = 0
+    
+    private var current: URL {
+        return self.directory.appendingPathComponent("log.0")
+    }
+    
+    private var previous: URL {
+        return self.directory.appendingPathComponent("log.1")
+    }
+    
+    init(directory: URL, maxSize: UInt64) {
+        self.directory = directory
+        self.maxSize = maxSize
+    }
+    
+    convenience init?(maxSize: UInt64) {
+        guard let caches = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first else {
+            return nil
+        }
+        self.init(directory: caches.appendingPathComponent("com.ciscospark.sdk").appendingPathComponent("logs"), maxSize: maxSize)
+    }
+    
+    deinit {
+        self.handle?.closeFile()
+    }
+    
+    func write(_ records: [LogRecord]) {
+        guard records.count > 0 else {
+            return
+        }
+        var data = Data()
+        for record in records {
+            LogFileSink.encode(record, into: &data)
+        }
+        if self.handle == nil || self.size + UInt64(data.count) > self.maxSize / 2 {
+            self.roll()
+        }
+        guard let handle = self.handle else {
+            return
+        }
+        handle.write(data)
+        self.size += UInt64(data.count)
+    }
+    
+    /// Every record still on disk, oldest first.
+    func read() -> [LogRecord] {
+        self.handle?.synchronizeFile()
+        var records = [LogRecord]()
+        for url in [self.previous, self.current] {
+            if let data = try? Data(contentsOf: url) {
+                LogFileSink.decode(data, into: &records)
+            }
+        }
+        return records
+    }
+    
+    func removeAll() {
+        self.handle?.closeFile()
+        self.handle = nil
+        self.size = 0
+        try? FileManager.default.removeItem(at: self.current)
+        try? FileManager.default.removeItem(at: self.previous)
+    }
+    
+    private func roll() {
+        let manager = FileManager.default
+        if let handle = self.handle {
+            handle.closeFile()
+            self.handle = nil
+            try? manager.removeItem(at: self.previous)
+            try? manager.moveItem(at: self.current, to: self.previous)
+        }
+        else if let attributes = try? manager.attributesOfItem(atPath: self.current.path), let size = (attributes[.size] as? NSNumber)?.uint64Value, size < self.maxSize / 2 {
+            // Carry on with the file a previous run left behind.
+            self.handle = FileHandle(forWritingAtPath: self.current.path)
+            self.size = self.handle?.seekToEndOfFile() ?? 0
+            if self.handle != nil {
+                return
+            }
+        }
+        // Logging must not log, so failures here only lose the file output.
+        try? manager.createDirectory(at: self.directory, withIntermediateDirectories: true, attributes: nil)
+        if manager.createFile(atPath: self.current.path, contents: nil, attributes: nil) {
+            self.handle = FileHandle(forWritingAtPath: self.current.path)
+        }
+        self.size = 0
+    }
+    
+    // MARK: Encoding
+    
+    // u32 body length, then u8 level, f64 timestamp, u32 line and the thread, file, function and
+    // message as u32 length-prefixed UTF-8, all little endian.
+    static func encode(_ record: LogRecord, into data: inout Data) {
+        var body = Data()
+        body.append(UInt8(truncatingIfNeeded: record.level.rawValue))
+        LogFileSink.append(record.timestamp.timeIntervalSince1970.bitPattern, to: &body)
+        LogFileSink.append(UInt32(truncatingIfNeeded: record.line), to: &body)
+        for string in [record.thread, record.file, record.function, record.message] {
+            let utf8 = Data(string.utf8)
+            LogFileSink.append(UInt32(utf8.count), to: &body)
+            body.append(utf8)
+        }
+        LogFileSink.append(UInt32(body.count), to: &data)
+        data.append(body)
+    }
+    
+    static func decode(_ data: Data, into records: inout [LogRecord]) {
+        let bytes = [UInt8](data)
+        var offset = 0
+        func integer<T: FixedWidthInteger>(_ type: T.Type) -> T? {
+            let size = MemoryLayout<T>.size
+            guard offset + size <= bytes.count else {
+                return nil
+            }
+            var value: T = 0
+            for index in (0..<size).reversed() {
+                value = value << 8 | T(bytes[offset + index])
+            }
+            offset += size
+            return value
+        }
+        func string() -> String? {
+            guard let length = integer(UInt32.self), offset + Int(length) <= bytes.count else {
+                return nil
+            }
+            defer {
+                offset += Int(length)
+            }
+            return String(decoding: bytes[offset..<offset + Int(length)], as: UTF8.self)
+        }
+        while let length = integer(UInt32.self) {
+            let end = offset + Int(length)
+            guard end <= bytes.count,
+                let level = integer(UInt8.self).flatMap({ LogLevel(rawValue: UInt($0)) }),
+                let time = integer(UInt64.self),
+                let line = integer(UInt32.self),
+                let thread = string(),
+                let file = string(),
+                let function = string(),
+                let message = string(),
+                offset == end else {
+                // A record cut short by the process dying ends the file.
+                return
+            }
+            records.append(LogRecord(level: level, timestamp: Date(timeIntervalSince1970: Double(bitPattern: time)), thread: thread, file: file, function: function, line: UInt(line), message: message))
+        }
+    }
+    
+    private static func append<T: FixedWidthInteger>(_ value: T, to data: inout Data) {
+        var little = value.littleEndian
+        withUnsafeBytes(of: &little) { data.append(contentsOf: $0) }
+    }
+}
@@ -0,0 +1,124 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// Single-producer, single-consumer ring of log records owned by one thread.
+///
+/// The owning thread pushes without locks or allocations beyond the record itself; the
+/// `SDKLogger` writer is the only consumer. `push` never blocks: on a full ring it drops the
+/// record and counts it. `SDKLogger` checks `isFull` first and waits for the writer to drain the
+/// ring instead, so the thread that logs blocks rather than losing history.
+///
+/// - note: for internal use only.
+class LogRing {
+    
+    static let defaultCapacity = 1024
+    
+    let capacity: Int
+    
+    private let mask: Int64
+    private let slots: UnsafeMutablePointer<LogRecord>
+    // Head (consumer), tail (producer), dropped count and retired flag, a cache line apart.
+    private let words: UnsafeMutablePointer<Int64>
+    private var head: UnsafeMutablePointer<Int64> {
+        return self.words
+    }
+    private var tail: UnsafeMutablePointer<Int64> {
+        return self.words + 8
+    }
+    private var dropped: UnsafeMutablePointer<Int64> {
+        return self.words + 16
+    }
+    private var retired: UnsafeMutablePointer<Int64> {
+        return self.words + 24
+    }
+    
+    init(capacity: Int = LogRing.defaultCapacity) {
+        var size = 2
+        while size < capacity {
+            size <<= 1
+        }
+        self.capacity = size
+        self.mask = Int64(size - 1)
+        self.slots = UnsafeMutablePointer<LogRecord>.allocate(capacity: size)
+        self.words = UnsafeMutablePointer<Int64>.allocate(capacity: 32)
+        self.words.initialize(repeating: 0, count: 32)
+    }
+    
+    deinit {
+        var records = [LogRecord]()
+        self.drain(into: &records)
+        self.slots.deallocate()
+        self.words.deallocate()
+    }
+    
+    var count: Int {
+        return Int(spark_atomic_load(self.tail) - spark_atomic_load(self.head))
+    }
+    
+    var isFull: Bool {
+        return self.count >= self.capacity
+    }
+    
+    /// Set once the owning thread exited; the writer forgets the ring after draining it.
+    var isRetired: Bool {
+        return spark_atomic_load(self.retired) != 0
+    }
+    
+    /// Producer side. Returns false, and counts the record as dropped, if the ring is full.
+    @discardableResult
+    func push(_ record: LogRecord) -> Bool {
+        let position = spark_atomic_load(self.tail)
+        if position - spark_atomic_load(self.head) >= Int64(self.capacity) {
+            spark_atomic_fetch_add(self.dropped, 1)
+            return false
+        }
+        (self.slots + Int(position & self.mask)).initialize(to: record)
+        spark_atomic_store(self.tail, position + 1)
+        return true
+    }
+    
+    func retire() {
+        spark_atomic_store(self.retired, 1)
+    }
+    
+    /// Consumer side. Moves every published record into `records`, oldest first.
+    func drain(into records: inout [LogRecord]) {
+        let start = spark_atomic_load(self.head)
+        let end = spark_atomic_load(self.tail)
+        var position = start
+        while position < end {
+            records.append((self.slots + Int(position & self.mask)).move())
+            position += 1
+        }
+        spark_atomic_store(self.head, end)
+    }
+    
+    /// Consumer side. The number of records dropped since the last call.
+    func takeDropped() -> Int {
+        let count = spark_atomic_load(self.dropped)
+        if count > 0 {
+            spark_atomic_fetch_add(self.dropped, -count)
+        }
+        return Int(count)
+    }
+}
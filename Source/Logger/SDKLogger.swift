@@ -20,6 +20,43 @@
 
 import Foundation
 
+/// A log call captured as-is; formatting is deferred until the record is printed, read or exported.
+///
+/// - note: for internal use only.
+struct LogRecord {
+    let level: LogLevel
+    let timestamp: Date
+    let thread: String
+    let file: String
+    let function: String
+    let line: UInt
+    let message: String
+    
+    var description: String {
+        var level: String
+        switch (self.level) {
+        case .error:   level = "E"
+        case .warning: level = "W"
+        case .info:    level = "I"
+        case .debug:   level = "D"
+        case .verbose: level = "V"
+        default:       level = "A"
+        }
+        return level + " " + self.timestamp.longString + " " + "[" + self.thread + "]" + " | " + self.function + ": " + self.message
+    }
+    
+    var logMessage: LogMessage {
+        return LogMessage(message: self.message, level: self.level, file: self.file, function: self.function, line: self.line, description: self.description, timestamp: self.timestamp, threadName: self.thread)
+    }
+}
+
+/// Logging pipeline of the SDK.
+///
+/// A call above the console level is discarded before its message is even built, unless a custom
+/// `logger` is set. Otherwise the raw record goes into a ring owned by the calling thread
+/// and a single background writer drains all rings into the console, the in-memory history, the
+/// optional rolling file and the custom logger. Errors are drained before the call returns, and so
+/// is a ring that is full, which makes the logging thread wait for the writer.
 class SDKLogger {
     
     static let shared = SDKLogger()
@@ -30,117 +67,229 @@ class SDKLogger {
     
     var memory: Bool = true
     
+    /// Maximum size in bytes of the rolling log file, or 0 for none.
+    var fileSize: UInt64 = 0 {
+        didSet {
+            let size = self.fileSize
+            self.queue.async {
+                self.file = size > 0 ? LogFileSink(maxSize: size) : nil
+            }
+        }
+    }
+    
     var logs: String? {
-        return memory ? self.storage.read() : nil
+        guard self.memory else {
+            return nil
+        }
+        self.drainNow()
+        return self.storage.read()
     }
     
     private var storage = MemoryLoggerStorage()
+    private var file: LogFileSink?
+    private var rings = [LogRing]()
+    private let queue = DispatchQueue(label: "com.ciscospark.sdk.SDKLogger", qos: .utility)
+    private let queueKey = DispatchSpecificKey<Bool>()
+    // Set while a drain is queued, so a burst of log calls queues only one.
+    private let drainScheduled: UnsafeMutablePointer<Int64> = {
+        let flag = UnsafeMutablePointer<Int64>.allocate(capacity: 1)
+        flag.initialize(to: 0)
+        return flag
+    }()
+    
+    private static let ringKey: pthread_key_t = {
+        var key = pthread_key_t()
+        pthread_key_create(&key) { pointer in
+            Unmanaged<LogRing>.fromOpaque(pointer).takeRetainedValue().retire()
+        }
+        return key
+    }()
+    
+    init() {
+        self.queue.setSpecific(key: self.queueKey, value: true)
+    }
     
     func verbose(_ message: @autoclosure () -> String, error: Error? = nil, file: String = #file, function: String = #function, line: UInt = #line) {
-        log(message(), error:error, level: LogLevel.verbose, file: file, function: function, line: line)
+        log(message, error:error, level: LogLevel.verbose, file: file, function: function, line: line)
     }
     
     func debug(_ message: @autoclosure () -> String, error: Error? = nil, file: String = #file, function: String = #function, line: UInt = #line) {
-        log(message(), error:error, level: LogLevel.debug, file: file, function: function, line: line)
+        log(message, error:error, level: LogLevel.debug, file: file, function: function, line: line)
     }
     
     func info(_ message: @autoclosure () -> String, error: Error? = nil, file: String = #file, function: String = #function, line: UInt = #line) {
-        log(message(), error:error, level: LogLevel.info, file: file, function: function, line: line)
+        log(message, error:error, level: LogLevel.info, file: file, function: function, line: line)
     }
     
     func warn(_ message: @autoclosure () -> String, error: Error? = nil, file: String = #file, function: String = #function, line: UInt = #line) {
-        log(message(), error:error, level: LogLevel.warning, file: file, function: function, line: line)
+        log(message, error:error, level: LogLevel.warning, file: file, function: function, line: line)
     }
     
 	func error(_ message: @autoclosure () -> String, error: Error? = nil, file: String = #file, function: String = #function, line: UInt = #line) {
-        log(message(), error:error, level: LogLevel.error, file: file, function: function, line: line, asynchronous: false)
+        log(message, error:error, level: LogLevel.error, file: file, function: function, line: line, asynchronous: false)
     }
     
-    private func log(_ message: @autoclosure () -> String, error: Error?, level: LogLevel, file: String, function: String, line: UInt, asynchronous: Bool = true) {
+    /// Formatted text of the rolling log file, or of the in-memory history if there is no file.
+    func export() -> String? {
+        self.drainNow()
+        var text: String?
+        self.queue.sync {
+            if let file = self.file {
+                text = file.read().map { $0.description + "\n" }.joined()
+            }
+        }
+        return text ?? self.logs
+    }
+    
+    private func log(_ message: () -> String, error: Error?, level: LogLevel, file: String, function: String, line: UInt, asynchronous: Bool = true) {
+        guard level.rawValue <= self.console.rawValue || self.logger != nil else {
+            return
+        }
         let actualMessage: String
         if let error = error {
             actualMessage = "\(message()): \(String(describing: error.localizedDescription))"
         } else {
             actualMessage = message()
         }
-        let timestamp = Date()
-        let thread = Thread.current.name ?? ""
-        let desc = format(logLevel: level, timestamp: timestamp, thread: thread, message: actualMessage, function: function)
-        let log = LogMessage(message: actualMessage, level: level, file: file, function: function, line: line, description: desc, timestamp: timestamp, threadName: thread)
-        
-        func output() {
-            if let logger = self.logger {
-                logger.log(message: log)
-            }
-            if level.rawValue <= console.rawValue {
-                print(desc)
-                if memory {
-                    self.storage.write(desc)
+        let record = LogRecord(level: level, timestamp: Date(), thread: Thread.current.name ?? "", file: file, function: function, line: line, message: actualMessage)
+        let ring = self.ring()
+        if ring.isFull {
+            // The writer fell behind; wait for it rather than lose history.
+            self.drainNow()
+        }
+        ring.push(record)
+        if !asynchronous {
+            self.drainNow()
+        }
+        else {
+            var idle: Int64 = 0
+            if spark_atomic_compare_exchange(self.drainScheduled, &idle, 1) {
+                self.queue.async {
+                    self.drain()
                 }
             }
         }
-        
-        if asynchronous {
-            DispatchQueue.main.async {
-                output()
-            }
+    }
+    
+    private func ring() -> LogRing {
+        if let pointer = pthread_getspecific(SDKLogger.ringKey) {
+            return Unmanaged<LogRing>.fromOpaque(pointer).takeUnretainedValue()
         }
-        else {
-            output()
+        let ring = LogRing()
+        pthread_setspecific(SDKLogger.ringKey, Unmanaged.passRetained(ring).toOpaque())
+        synchronized(lock: self) {
+            self.rings.append(ring)
         }
+        return ring
     }
     
-    private func format(message: LogMessage) -> String {
-        return self.format(logLevel: message.level, timestamp: message.timestamp, thread: message.threadName, message: message.message, function: message.function)
+    private func drainNow() {
+        if DispatchQueue.getSpecific(key: self.queueKey) == true {
+            self.drain()
+        }
+        else {
+            self.queue.sync {
+                self.drain()
+            }
+        }
     }
     
-    private func format(logLevel: LogLevel, timestamp: Date, thread: String, message: String, function: String) -> String {
-        let timestamp: String = timestamp.longString
-        var level: String
-        switch (logLevel) {
-        case .error:   level = "E"
-        case .warning: level = "W"
-        case .info:    level = "I"
-        case .debug:   level = "D"
-        case .verbose: level = "V"
-        default:       level = "A"
+    // Must be called on `queue`.
+    private func drain() {
+        spark_atomic_store(self.drainScheduled, 0)
+        var rings = [LogRing]()
+        synchronized(lock: self) {
+            rings = self.rings
+        }
+        var records = [LogRecord]()
+        var dropped = 0
+        var retired = [LogRing]()
+        for ring in rings {
+            // Read before draining, so a ring is only forgotten once its last record was taken.
+            let isRetired = ring.isRetired
+            ring.drain(into: &records)
+            dropped += ring.takeDropped()
+            if isRetired {
+                retired.append(ring)
+            }
         }
-        return level + " " + timestamp + " " + "[" + thread + "]" + " | " + function + ": " + message
+        if retired.count > 0 {
+            synchronized(lock: self) {
+                self.rings = self.rings.filter { ring in !retired.contains { $0 === ring } }
+            }
+        }
+        if dropped > 0 {
+            records.append(LogRecord(level: LogLevel.warning, timestamp: Date(), thread: "", file: #file, function: #function, line: #line, message: "Dropped \(dropped) log messages"))
+        }
+        guard records.count > 0 else {
+            return
+        }
+        if rings.count > 1 {
+            // Interleave the threads, keeping each thread's own order.
+            records = records.enumerated().sorted { ($0.element.timestamp, $0.offset) < ($1.element.timestamp, $1.offset) }.map { $0.element }
+        }
+        if let logger = self.logger {
+            let messages = records.map { $0.logMessage }
+            DispatchQueue.main.async {
+                messages.forEach { logger.log(message: $0) }
+            }
+        }
+        let console = self.console
+        let output = records.filter { $0.level.rawValue <= console.rawValue }
+        guard output.count > 0 else {
+            return
+        }
+        for record in output {
+            print(record.description)
+        }
+        if self.memory {
+            self.storage.write(output)
+        }
+        self.file?.write(output)
     }
 }
 
 
 class MemoryLoggerStorage {
     
-    // configs
-    private let BlockSize = 10*1024
-    private let BlockCount = 1
+    // Roughly the bytes of history kept; records are only formatted on read.
+    private let capacity: Int
     
-    // storage
-    private var blocks: [String]
-    private var blockIndex = 0
+    private var records = [LogRecord]()
+    private var first = 0
+    private var size = 0
     
-    init() {
-        blocks = [String](repeating: "", count: BlockCount)
+    init(capacity: Int = 64 * 1024) {
+        self.capacity = capacity
     }
     
-    func write(_ message: String) {
+    func write(_ records: [LogRecord]) {
         synchronized(lock: self) {
-            blocks[blockIndex] += message + "\n"
-            if blocks[blockIndex].count > BlockSize {
-                blockIndex = (blockIndex + 1) % BlockCount
-                blocks[blockIndex] = ""
+            for record in records {
+                self.records.append(record)
+                self.size += MemoryLoggerStorage.size(of: record)
+            }
+            while self.size > self.capacity && self.first < self.records.count {
+                self.size -= MemoryLoggerStorage.size(of: self.records[self.first])
+                self.first += 1
+            }
+            if self.first > self.records.count / 2 {
+                self.records.removeFirst(self.first)
+                self.first = 0
             }
         }
     }
     
     func read() -> String {
-        var output = ""
+        var records = [LogRecord]()
         synchronized(lock: self) {
-            for offset in 1...BlockCount {
-                output += blocks[(blockIndex + offset) % BlockCount]
-            }
+            records = Array(self.records[self.first...])
         }
-        return output
+        return records.map { $0.description + "\n" }.joined()
+    }
+    
+    private static func size(of record: LogRecord) -> Int {
+        // Level, timestamp and separators take about 32 bytes once formatted.
+        return 32 + record.thread.utf8.count + record.function.utf8.count + record.message.utf8.count
     }
 }
@@ -81,6 +81,23 @@ public class MembershipClient {
         list(roomId: roomId, personId: nil, personEmail: personEmail, max: nil, queue: queue, completionHandler: completionHandler)
     }
     
+    /// Lists room memberships, page by page, through a cursor. Without a room or a person, all memberships
+    /// of the authenticated user are listed.
+    ///
+    /// - parameter roomId: If not nil, only list the memberships of this room.
+    /// - parameter personId: If not nil, only list the memberships of the person with this id.
+    /// - parameter personEmail: If not nil, only list the memberships of the person with this email address.
+    /// - parameter pageSize: The number of memberships fetched per request, or the service default if nil.
+    /// - parameter queue: If not nil, the queue on which the cursor hands out memberships. Otherwise, they're handed out on the application's main thread.
+    /// - returns: A cursor over the memberships.
+    /// - since: 1.4.2
+    public func listAll(roomId: String? = nil, personId: String? = nil, personEmail: EmailAddress? = nil, pageSize: Int? = nil, queue: DispatchQueue? = nil) -> ListCursor<Membership> {
+        let request = requestBuilder()
+            .method(.get)
+            .query(RequestParameter(["roomId": roomId, "personId": personId, "personEmail": personEmail?.toString(), "max": pageSize]))
+        return ListCursor(authenticator: self.authenticator, request: request, queue: queue)
+    }
+    
     private func list(roomId: String?, personId: String?, personEmail: EmailAddress?, max: Int?, queue: DispatchQueue?, completionHandler: @escaping (ServiceResponse<[Membership]>) -> Void) {
         
         let query = RequestParameter([
@@ -0,0 +1,109 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+
+/// Decrypts the pages of a message listing while the next pages are still being fetched.
+///
+/// The room key is resolved concurrently with the first page request. Each submitted page is
+/// handed to `ActivityModel.decrypt(_:key:)` on a background queue as soon as the key is known,
+/// so by the time the last page arrives the earlier ones are already in cleartext.
+///
+/// - note: for internal use only.
+class ActivityDecryptionPipeline {
+    
+    let limit: Int
+    
+    private let queue = DispatchQueue(label: "com.ciscospark.sdk.ActivityDecryptionPipeline")
+    private let group = DispatchGroup()
+    private var pages = [[ActivityModel]]()
+    private var waiting = [Int]()
+    private var material: Result<String>?
+    private var count = 0
+    
+    init(limit: Int) {
+        self.limit = limit
+        // Held until the key is resolved.
+        self.group.enter()
+    }
+    
+    /// Provides the room key. Pages submitted so far start decrypting.
+    func resolve(material: Result<String>) {
+        self.queue.async {
+            guard self.material == nil else {
+                return
+            }
+            self.material = material
+            self.waiting.forEach { self.decrypt(page: $0) }
+            self.waiting.removeAll()
+            self.group.leave()
+        }
+    }
+    
+    /// Adds a page of activities, keeping no more than `limit` in total.
+    ///
+    /// - returns: the number of activities accepted so far.
+    func submit(_ activities: [ActivityModel]) -> Int {
+        return self.queue.sync {
+            let page = Array(activities.prefix(self.limit - self.count))
+            self.count += page.count
+            if page.isEmpty {
+                return self.count
+            }
+            self.pages.append(page)
+            self.group.enter()
+            if self.material == nil {
+                self.waiting.append(self.pages.count - 1)
+            }
+            else {
+                self.decrypt(page: self.pages.count - 1)
+            }
+            return self.count
+        }
+    }
+    
+    /// Calls `completionHandler` with all submitted activities, in order, once they are decrypted.
+    func finish(completionHandler: @escaping (Result<[ActivityModel]>) -> Void) {
+        self.group.notify(queue: self.queue) {
+            if let error = self.material?.error {
+                completionHandler(Result.failure(error))
+            }
+            else {
+                completionHandler(Result.success(self.pages.flatMap { $0 }))
+            }
+        }
+    }
+    
+    // Must be called on `queue`.
+    private func decrypt(page index: Int) {
+        guard let key = self.material?.data else {
+            self.group.leave()
+            return
+        }
+        let page = self.pages[index]
+        DispatchQueue.global(qos: .userInitiated).async {
+            let decrypted = ActivityModel.decrypt(page, key: key)
+            self.queue.async {
+                self.pages[index] = decrypted
+                self.group.leave()
+            }
+        }
+    }
+}
@@ -47,6 +47,8 @@ struct ActivityModel {
     private(set) var encryptionKeyUrl: String?
     private(set) var kind: ActivityModel.Kind?
     private(set) var clientTempId: String?
+    /// What the activity acts on; for a delete, the id of the deleted message.
+    private(set) var objectId: String?
 }
 
 extension ActivityModel : ImmutableMappable {
@@ -64,6 +66,7 @@ extension ActivityModel : ImmutableMappable {
         self.roomId = try? map.value("target.id", using: IdentityTransform(for: IdentityType.room))
         self.roomType = try? map.value("target.tags", using: RoomTypeTransform())
         self.clientTempId = try? map.value("clientTempId")
+        self.objectId = try? map.value("object.id", using: IdentityTransform(for: IdentityType.message))
         if let text: String = try? map.value("object.displayName") {
             self.text = text
         }
@@ -108,7 +111,36 @@ extension ActivityModel : ImmutableMappable {
 }
 
 extension ActivityModel {
+    
+    /// The activity in the conversation service's format, so `init(map:)` reads it back unchanged.
+    var serviceJSON: [String: Any] {
+        let dates = CustomDateFormatTransform(formatString: "yyyy-MM-dd'T'HH:mm:ss.SSSZZZZZ")
+        var object = [String: Any]()
+        object["id"] = self.objectId?.locusFormat
+        object["displayName"] = self.text
+        object["mentions"] = self.mentionedPeople.map { ["items": $0.map { ["objectType": "person", "id": $0.locusFormat] }] }
+        object["groupMentions"] = self.mentionedGroup.map { ["items": $0.map { ["objectType": "groupMention", "groupType": $0] }] }
+        object["files"] = self.files.map { ["items": $0.toJSON()] }
+        var target: [String: Any] = ["objectType": "conversation"]
+        target["id"] = self.roomId?.locusFormat
+        target["tags"] = RoomTypeTransform().transformToJSON(self.roomType).map { [$0] }
+        var actor = [String: Any]()
+        actor["entryUUID"] = self.personId?.locusFormat
+        actor["emailAddress"] = self.personEmail
+        var json: [String: Any] = ["object": object, "target": target, "actor": actor]
+        json["id"] = self.id?.locusFormat
+        json["published"] = dates.transformToJSON(self.created)
+        json["encryptionKeyUrl"] = self.encryptionKeyUrl
+        json["verb"] = self.kind?.rawValue
+        json["clientTempId"] = self.clientTempId
+        return json
+    }
+    
     func decrypt(key: String?) -> ActivityModel {
+        return self.decrypt(key: key.map { JWEKey.prepared(jwk: $0) })
+    }
+    
+    func decrypt(key: JWEKey?) -> ActivityModel {
         var activity = self
         activity.text = activity.text?.decrypt(key: key)
         activity.files = activity.files?.map { f in
@@ -118,6 +150,22 @@ extension ActivityModel {
         }
         return activity;
     }
+    
+    /// Decrypts a batch of activities of one room on all cores, keeping their order.
+    static func decrypt(_ activities: [ActivityModel], key: String?) -> [ActivityModel] {
+        let key = key.map { JWEKey.prepared(jwk: $0) }
+        var results = activities
+        if results.count < 2 {
+            return results.map { $0.decrypt(key: key) }
+        }
+        results.withUnsafeMutableBufferPointer { buffer in
+            let output = buffer
+            DispatchQueue.concurrentPerform(iterations: output.count) { index in
+                output[index] = output[index].decrypt(key: key)
+            }
+        }
+        return results
+    }
 }
 
 enum IdentityType : String {
@@ -151,7 +199,11 @@ extension String {
     }
     
     func decrypt(key: String?) -> String {
-        if let key = key, let data = try? CjoseWrapper.content(fromCiphertext: self, key: key), let text = String(data: data, encoding: .utf8) {
+        return self.decrypt(key: key.map { JWEKey.prepared(jwk: $0) })
+    }
+    
+    func decrypt(key: JWEKey?) -> String {
+        if let key = key, let data = key.decrypt(self), let text = String(data: data, encoding: .utf8) {
             return text
         }
         return self
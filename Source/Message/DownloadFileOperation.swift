@@ -18,23 +18,69 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
+
 import UIKit
 import Alamofire
 
-class DownloadFileOperation : NSObject, URLSessionDataDelegate {
+/// Downloads a file as several HTTP byte ranges at once.
+///
+/// Ranges are decrypted and written strictly in order: a range that arrives early waits in a
+/// small reorder buffer, while the range at the write frontier is decrypted as its bytes come in.
+/// After every completed range a checkpoint with the write offset and the cipher state is saved
+/// to the SDK's download directory, so a failed or interrupted download continues where it stopped. Servers
+/// that ignore `Range` fall back to a single stream.
+class DownloadFileOperation : NSObject {
+    
+    static let segmentSize: UInt64 = 2 * 1024 * 1024
+    static let maxConcurrentSegments = 4
+    static let maxBufferedSegments = 8
+    static var maxRetries = 3
+    
+    private class Segment {
+        let offset: UInt64
+        var length: UInt64
+        var buffer = Data()
+        var written: UInt64 = 0
+        var done = false
+        var retries = 0
+        var task: URLSessionDataTask?
+        
+        init(offset: UInt64, length: UInt64) {
+            self.offset = offset
+            self.length = length
+        }
+        
+        var received: UInt64 {
+            return self.written + UInt64(self.buffer.count)
+        }
+    }
+    
+    private struct Checkpoint: Codable {
+        let source: String
+        let target: String
+        let total: UInt64
+        let committed: UInt64
+        let cipher: ParallelCipherA256GCM.State?
+    }
     
     private let authenticator: Authenticator
     private let uuid: String
     private let source: String
     private let secureContentRef: String?
+    private let directory: URL
     private var target: URL
     private let queue: DispatchQueue
     private let progressHandler: ((Double) -> Void)?
     private let completionHandler : ((Result<URL>) -> Void)
-    private var outputStream : OutputStream?
-    private var downloadSeesion: URLSession?
+    private let state = DispatchQueue(label: "com.ciscospark.sdk.DownloadFileOperation")
+    private var token: String?
+    private var cipher: ParallelCipherA256GCM?
+    private var file: FileHandle?
     private var totalSize: UInt64?
-    private var countSize: UInt64 = 0
+    private var committed: UInt64 = 0
+    private var nextOffset: UInt64 = 0
+    private var segments = [UInt64: Segment]()
+    private var finished = false
 
     init(authenticator: Authenticator, uuid: String, source: String, displayName: String?, secureContentRef: String?, thnumnail: Bool, target: URL?, queue: DispatchQueue?, progressHandler: ((Double) -> Void)?, completionHandler: @escaping ((Result<URL>) -> Void)) {
         self.authenticator = authenticator
@@ -45,22 +91,22 @@ class DownloadFileOperation : NSObject, URLSessionDataDelegate {
         self.progressHandler = progressHandler
         self.completionHandler = completionHandler
         if let target = target {
-            self.target = target
+            self.directory = target
         }
         else {
             let path = FileManager.default.temporaryDirectory.appendingPathComponent("com.ciscospark.sdk.downloads", isDirectory: true)
             try? FileManager.default.createDirectory(at: path, withIntermediateDirectories: false, attributes: nil)
-            self.target = path
+            self.directory = path
         }
         var name = UUID().uuidString + "-" + (displayName ?? Date().iso8601String)
         if (thnumnail) {
             name = "thumb-" + name
         }
-        self.target = self.target.appendingPathComponent(name, isDirectory: false)
+        self.target = self.directory.appendingPathComponent(name, isDirectory: false)
     }
     
     func run() {
-        guard let url = URL(string: self.source) else {
+        guard URL(string: self.source) != nil else {
             self.downloadError()
             return
         }
@@ -69,62 +115,305 @@ class DownloadFileOperation : NSObject, URLSessionDataDelegate {
                 self.downloadError()
                 return
             }
-            self.downloadSeesion = URLSession(configuration: URLSessionConfiguration.default, delegate: self, delegateQueue: OperationQueue.main)
-            var request = URLRequest(url: url, cachePolicy: URLRequest.CachePolicy.reloadIgnoringCacheData, timeoutInterval: 0)
-            request.setValue("Bearer " + token, forHTTPHeaderField: "Authorization")
-            request.setValue("ITCLIENT_\(self.uuid)_0", forHTTPHeaderField: "TrackingID")
-            if let dataTask = self.downloadSeesion?.dataTask(with: request){
-                dataTask.resume()
+            self.state.async {
+                self.token = token
+                do {
+                    try self.prepare()
+                    self.schedule()
+                }
+                catch {
+                    SDKLogger.shared.info("DownLoadSession Create Error - \(error)")
+                    self.fail(error)
+                }
             }
         }
     }
     
-    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive response: URLResponse, completionHandler: @escaping (URLSession.ResponseDisposition) -> Swift.Void) {
-        if let resp = response as? HTTPURLResponse, let length = (resp.allHeaderFields["Content-Length"] as? String)?.components(separatedBy: "/").last, let size = UInt64(length) {
-            self.totalSize = size
+    // MARK: Checkpoint
+    
+    private var checkpointUrl: URL {
+        var digest = [UInt8](repeating: 0, count: Int(CC_SHA256_DIGEST_LENGTH))
+        let data = [UInt8]((self.source + "|" + self.directory.path).utf8)
+        CC_SHA256(data, CC_LONG(data.count), &digest)
+        let name = digest.map { String(format: "%02x", $0) }.joined()
+        let path = FileManager.default.temporaryDirectory.appendingPathComponent("com.ciscospark.sdk.downloads", isDirectory: true)
+        try? FileManager.default.createDirectory(at: path, withIntermediateDirectories: false, attributes: nil)
+        return path.appendingPathComponent(name + ".checkpoint", isDirectory: false)
+    }
+    
+    private func prepare() throws {
+        if let ref = self.secureContentRef {
+            self.cipher = try ParallelCipherA256GCM(scr: try SecureContentReference(json: ref))
+        }
+        if let data = try? Data(contentsOf: self.checkpointUrl),
+            let checkpoint = try? JSONDecoder().decode(Checkpoint.self, from: data),
+            checkpoint.source == self.source,
+            (checkpoint.cipher == nil) == (self.cipher == nil),
+            let handle = FileHandle(forWritingAtPath: checkpoint.target),
+            handle.seekToEndOfFile() >= checkpoint.committed {
             do {
-                var outputStream = OutputStream(toFileAtPath: self.target.path, append: true)
-                if let ref = self.secureContentRef {
-                    outputStream = try SecureOutputStream(stream: outputStream, scr: try SecureContentReference(json: ref))
+                if let state = checkpoint.cipher {
+                    try self.cipher?.resume(from: state)
                 }
-                self.outputStream = outputStream
-                self.outputStream?.open()
-                completionHandler(URLSession.ResponseDisposition.allow);
+                handle.truncateFile(atOffset: checkpoint.committed)
+                self.target = URL(fileURLWithPath: checkpoint.target)
+                self.file = handle
+                self.totalSize = checkpoint.total
+                self.committed = checkpoint.committed
+                self.nextOffset = checkpoint.committed
+                SDKLogger.shared.info("Resume download at \(checkpoint.committed) of \(checkpoint.total)")
+                return
             }
             catch {
-                SDKLogger.shared.info("DownLoadSession Create Error - \(error)")
-                completionHandler(URLSession.ResponseDisposition.cancel);
+                handle.closeFile()
+                if let ref = self.secureContentRef {
+                    self.cipher = try ParallelCipherA256GCM(scr: try SecureContentReference(json: ref))
+                }
             }
         }
-        else {
-            SDKLogger.shared.info("Unknown size of the file")
-            completionHandler(URLSession.ResponseDisposition.cancel);
+        guard FileManager.default.createFile(atPath: self.target.path, contents: nil, attributes: nil), let handle = FileHandle(forWritingAtPath: self.target.path) else {
+            throw SparkError.illegalOperation(reason: "Cannot create \(self.target.path)")
         }
+        self.file = handle
     }
     
-    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive data: Data) {
-//        var buffer = [UInt8](repeating: 0, count: data.count)
-//        data.copyBytes(to: &buffer, count: data.count)
-//        self.outputStream?.write(buffer, maxLength: data.count)
-        _ = self.outputStream?.write(data: data)
-        self.queue.async {
-            self.countSize = self.countSize + UInt64(data.count)
-            self.progressHandler?(Double(self.countSize)/Double(self.totalSize!))
+    private func saveCheckpoint() {
+        guard let total = self.totalSize else {
+            return
+        }
+        let checkpoint = Checkpoint(source: self.source, target: self.target.path, total: total, committed: self.committed, cipher: self.cipher?.state)
+        if let data = try? JSONEncoder().encode(checkpoint) {
+            try? data.write(to: self.checkpointUrl, options: .atomic)
         }
     }
     
-    func urlSession(_ session: URLSession, task: URLSessionTask, didCompleteWithError error: Error?) {
-        self.outputStream?.close()
-        if let error = error {
-            self.downloadError(error)
+    // MARK: Segments
+    
+    /// Starts ranges until the concurrency limit or the reorder window is reached. Before the
+    /// size is known only the first range is requested.
+    private func schedule() {
+        guard !self.finished else {
+            return
         }
-        else {
+        guard let total = self.totalSize else {
+            if self.segments.isEmpty {
+                self.start(Segment(offset: self.nextOffset, length: DownloadFileOperation.segmentSize))
+                self.nextOffset += DownloadFileOperation.segmentSize
+            }
+            return
+        }
+        if self.committed >= total {
+            self.complete()
+            return
+        }
+        while self.segments.values.filter({ !$0.done }).count < DownloadFileOperation.maxConcurrentSegments
+            && self.nextOffset < total
+            && self.nextOffset - self.committed < DownloadFileOperation.segmentSize * UInt64(DownloadFileOperation.maxBufferedSegments) {
+            let length = min(DownloadFileOperation.segmentSize, total - self.nextOffset)
+            self.start(Segment(offset: self.nextOffset, length: length))
+            self.nextOffset += length
+        }
+    }
+    
+    private func start(_ segment: Segment) {
+        guard let url = URL(string: self.source), let token = self.token else {
+            return
+        }
+        var request = URLRequest(url: url, cachePolicy: URLRequest.CachePolicy.reloadIgnoringCacheData, timeoutInterval: 60)
+        request.setValue("Bearer " + token, forHTTPHeaderField: "Authorization")
+        request.setValue("ITCLIENT_\(self.uuid)_0", forHTTPHeaderField: "TrackingID")
+        request.setValue("bytes=\(segment.offset + segment.received)-\(segment.offset + segment.length - 1)", forHTTPHeaderField: "Range")
+        self.segments[segment.offset] = segment
+        // The segment a task fills, changed only on `state` when a server ignoring `Range` sends the whole body.
+        var current = segment
+        segment.task = DownloadSessionPool.shared.start(request: request, response: { response in
+            return self.state.sync {
+                guard let taking = self.receive(response: response, for: current) else {
+                    return false
+                }
+                current = taking
+                return true
+            }
+        }, data: { data in
+            self.state.async {
+                self.receive(data: data, for: current)
+            }
+        }, completion: { error in
+            self.state.async {
+                self.complete(segment: current, error: error)
+            }
+        })
+    }
+    
+    /// Returns the segment the body of the response goes to, or nil to cancel the task.
+    private func receive(response: URLResponse, for segment: Segment) -> Segment? {
+        guard !self.finished, self.segments[segment.offset] === segment, let resp = response as? HTTPURLResponse else {
+            return nil
+        }
+        if resp.statusCode == 206 {
+            if self.totalSize == nil, let range = resp.allHeaderFields["Content-Range"] as? String, let length = range.components(separatedBy: "/").last, let size = UInt64(length) {
+                self.totalSize = size
+                segment.length = min(segment.length, size - segment.offset)
+                self.nextOffset = segment.offset + segment.length
+                self.state.async {
+                    self.schedule()
+                }
+            }
+            return self.totalSize != nil ? segment : nil
+        }
+        if resp.statusCode == 200 {
+            // No range support: the whole body follows in this one response.
+            guard let size = UInt64(exactly: resp.expectedContentLength) ?? (resp.allHeaderFields["Content-Length"] as? String).flatMap({ UInt64($0) }) else {
+                SDKLogger.shared.info("Unknown size of the file")
+                return nil
+            }
+            if self.committed != 0 {
+                do {
+                    try self.restart()
+                }
+                catch {
+                    return nil
+                }
+            }
+            self.segments.values.filter({ $0 !== segment }).forEach { $0.task?.cancel() }
+            // The body starts at 0 whatever range this task asked for, so it gets a segment of its own.
+            let whole = Segment(offset: 0, length: size)
+            whole.task = segment.task
+            self.segments = [0: whole]
+            self.totalSize = size
+            self.nextOffset = size
+            return whole
+        }
+        if resp.statusCode == 416, self.totalSize == nil, segment.offset == 0, let range = resp.allHeaderFields["Content-Range"] as? String, range == "bytes */0" {
+            // An empty file has no range to ask for; there is nothing left to download.
+            self.segments = [:]
+            self.totalSize = 0
+            self.nextOffset = 0
+            self.state.async {
+                self.schedule()
+            }
+            return nil
+        }
+        SDKLogger.shared.info("Download failed with status \(resp.statusCode)")
+        return nil
+    }
+    
+    private func receive(data: Data, for segment: Segment) {
+        guard !self.finished, self.segments[segment.offset] === segment else {
+            return
+        }
+        segment.buffer.append(data)
+        self.drain()
+        if let total = self.totalSize, total > 0 {
+            let received = self.segments.values.reduce(self.committed) { $0 + UInt64($1.buffer.count) }
             self.queue.async {
-                self.completionHandler(Result.success(self.target))
+                self.progressHandler?(Double(received)/Double(total))
             }
         }
     }
     
+    private func complete(segment: Segment, error: Error?) {
+        guard !self.finished, self.segments[segment.offset] === segment else {
+            return
+        }
+        if error == nil && segment.received >= segment.length {
+            segment.done = true
+            self.drain()
+            self.schedule()
+            return
+        }
+        segment.retries += 1
+        if segment.retries > DownloadFileOperation.maxRetries {
+            // The checkpoint stays on disk, the next attempt on the same file resumes from it.
+            self.fail(error)
+            return
+        }
+        SDKLogger.shared.info("Retry range \(segment.offset + segment.received)-\(segment.offset + segment.length - 1): \(String(describing: error))")
+        self.state.asyncAfter(deadline: .now() + Double(segment.retries)) {
+            if !self.finished && self.segments[segment.offset] === segment {
+                self.start(segment)
+            }
+        }
+    }
+    
+    /// Decrypts and writes everything that is contiguous with the write frontier.
+    private func drain() {
+        while let segment = self.segments.values.first(where: { $0.offset <= self.committed && self.committed < $0.offset + $0.length }) {
+            if segment.buffer.count > 0 {
+                var chunk = segment.buffer
+                let count = chunk.count
+                segment.buffer = Data()
+                do {
+                    if let cipher = self.cipher {
+                        _ = try chunk.withUnsafeMutableBytes { (bytes: UnsafeMutablePointer<UInt8>) in
+                            try cipher.decryptBytes(UnsafePointer(bytes), toBuffer: bytes, withLength: count)
+                        }
+                    }
+                    self.file?.write(chunk)
+                }
+                catch {
+                    self.fail(error)
+                    return
+                }
+                segment.written += UInt64(count)
+                self.committed += UInt64(count)
+            }
+            guard segment.done && segment.written >= segment.length else {
+                return
+            }
+            self.segments[segment.offset] = nil
+            self.saveCheckpoint()
+            if let total = self.totalSize, self.committed >= total {
+                self.complete()
+                return
+            }
+        }
+    }
+    
+    /// Drops everything written so far, used when a resumed download gets the whole body again.
+    private func restart() throws {
+        self.file?.truncateFile(atOffset: 0)
+        self.committed = 0
+        if let ref = self.secureContentRef {
+            self.cipher = try ParallelCipherA256GCM(scr: try SecureContentReference(json: ref))
+        }
+        try? FileManager.default.removeItem(at: self.checkpointUrl)
+    }
+    
+    private func complete() {
+        guard !self.finished else {
+            return
+        }
+        self.finished = true
+        self.file?.closeFile()
+        do {
+            // Same GCM tag validation SecureOutputStream performs when it is closed.
+            try self.cipher?.finalize()
+        }
+        catch {
+            SDKLogger.shared.error("Downloaded file failed validation", error: error)
+            try? FileManager.default.removeItem(at: self.target)
+            try? FileManager.default.removeItem(at: self.checkpointUrl)
+            self.downloadError(error)
+            return
+        }
+        try? FileManager.default.removeItem(at: self.checkpointUrl)
+        self.queue.async {
+            self.completionHandler(Result.success(self.target))
+        }
+    }
+    
+    private func fail(_ error: Error?) {
+        guard !self.finished else {
+            return
+        }
+        self.finished = true
+        self.segments.values.forEach { $0.task?.cancel() }
+        self.segments.removeAll()
+        self.file?.closeFile()
+        self.downloadError(error)
+    }
+    
     private func downloadError(_ error: Error? = nil) {
         SDKLogger.shared.info("File download fail...")
         self.queue.async {
@@ -133,9 +422,65 @@ class DownloadFileOperation : NSObject, URLSessionDataDelegate {
     }
 }
 
-extension OutputStream {
-    func write(data: Data) -> Int {
-        return data.withUnsafeBytes { self.write($0, maxLength: data.count) }
+/// One `URLSession` shared by all downloads, so connections to the file service are reused.
+/// Delegate callbacks are routed to the handlers registered for each task.
+class DownloadSessionPool : NSObject, URLSessionDataDelegate {
+    
+    static var shared = DownloadSessionPool()
+    
+    static let maxConnectionsPerHost = 8
+    
+    private struct Handlers {
+        let response: (URLResponse) -> Bool
+        let data: (Data) -> Void
+        let completion: (Error?) -> Void
+    }
+    
+    private let lock = NSLock()
+    
+    private var handlers = [Int: Handlers]()
+    
+    private let configuration: URLSessionConfiguration
+    
+    private lazy var session: URLSession = {
+        self.configuration.httpMaximumConnectionsPerHost = DownloadSessionPool.maxConnectionsPerHost
+        let queue = OperationQueue()
+        queue.maxConcurrentOperationCount = 1
+        return URLSession(configuration: self.configuration, delegate: self, delegateQueue: queue)
+    }()
+    
+    init(configuration: URLSessionConfiguration = URLSessionConfiguration.default) {
+        self.configuration = configuration
+        super.init()
+    }
+    
+    func start(request: URLRequest, response: @escaping (URLResponse) -> Bool, data: @escaping (Data) -> Void, completion: @escaping (Error?) -> Void) -> URLSessionDataTask {
+        self.lock.lock()
+        let task = self.session.dataTask(with: request)
+        self.handlers[task.taskIdentifier] = Handlers(response: response, data: data, completion: completion)
+        self.lock.unlock()
+        task.resume()
+        return task
+    }
+    
+    private func handlers(for task: URLSessionTask, remove: Bool = false) -> Handlers? {
+        self.lock.lock()
+        defer {
+            self.lock.unlock()
+        }
+        return remove ? self.handlers.removeValue(forKey: task.taskIdentifier) : self.handlers[task.taskIdentifier]
+    }
+    
+    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive response: URLResponse, completionHandler: @escaping (URLSession.ResponseDisposition) -> Swift.Void) {
+        let allow = self.handlers(for: dataTask)?.response(response) ?? false
+        completionHandler(allow ? URLSession.ResponseDisposition.allow : URLSession.ResponseDisposition.cancel)
+    }
+    
+    func urlSession(_ session: URLSession, dataTask: URLSessionDataTask, didReceive data: Data) {
+        self.handlers(for: dataTask)?.data(data)
+    }
+    
+    func urlSession(_ session: URLSession, task: URLSessionTask, didCompleteWithError error: Error?) {
+        self.handlers(for: task, remove: true)?.completion(error)
     }
 }
-
@@ -35,6 +35,8 @@ class EncryptionKey {
         if self.encryptionUrl != encryptionUrl {
             self.encryptionUrl = encryptionUrl
             self.material = nil
+            // The room's key was rotated; what's sent next is encrypted with the new one.
+            KeyMaterialCache.shared.bind(roomId: self.roomId, uri: encryptionUrl)
         }
     }
     
@@ -42,6 +44,11 @@ class EncryptionKey {
         if let marterial = self.material {
             completionHandler(Result.success(marterial))
         }
+        else if let cached = self.cachedMaterial() {
+            self.encryptionUrl = cached.0
+            self.material = cached.1
+            completionHandler(Result.success(cached.1))
+        }
         else {
             self.encryptionUrl(client: client) { response in
                 if let error = response.error {
@@ -54,6 +61,7 @@ class EncryptionKey {
                         case .success(let data):
                             self.encryptionUrl = data.0
                             self.material = data.1
+                            KeyMaterialCache.shared.bind(roomId: self.roomId, uri: data.0)
                             completionHandler(Result<String>.success(data.1))
                         case .failure(let error):
                             completionHandler(Result<String>.failure(error))
@@ -68,6 +76,10 @@ class EncryptionKey {
         if let url = self.encryptionUrl {
             completionHandler(Result.success(url))
         }
+        else if let url = KeyMaterialCache.shared.uri(roomId: self.roomId) {
+            self.encryptionUrl = url
+            completionHandler(Result.success(url))
+        }
         else {
             client.requestRoomEncryptionURL(roomId: self.roomId) { result in
                 self.encryptionUrl = result.data as? String
@@ -76,6 +88,17 @@ class EncryptionKey {
         }
     }
     
+    private func cachedMaterial() -> (String, String)? {
+        if let url = self.encryptionUrl {
+            guard let material = KeyMaterialCache.shared.material(uri: url) else {
+                return nil
+            }
+            KeyMaterialCache.shared.bind(roomId: self.roomId, uri: url)
+            return (url, material)
+        }
+        return KeyMaterialCache.shared.material(roomId: self.roomId)
+    }
+    
     func spaceUrl(authenticator: Authenticator, completionHandler: @escaping (Result<String>) -> Void) {
         if let url = self.spaceUrl {
             completionHandler(Result.success(url))
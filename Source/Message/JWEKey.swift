@@ -0,0 +1,276 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import Security
+
+/// A room key in JWK form, parsed once and reused for every JWE it encrypts or decrypts.
+///
+/// Conversation content is JWE compact serialization with direct key agreement and A256GCM
+/// (`{"alg":"dir","enc":"A256GCM"}`). For those, the key is prepared up front (key bytes and
+/// GHASH tables) and each message runs on `ParallelCipherA256GCM`, skipping the JWK parsing and
+/// key setup `CjoseWrapper` repeats on every call. Base64url goes through lookup tables instead
+/// of string rewriting. Any other key type or JWE header falls back to `CjoseWrapper`.
+///
+/// Encrypting with a `JWEKey` is opt-in: it writes only `alg` and `enc` in the protected header,
+/// no `kid`, so outgoing content still goes through `CjoseWrapper`.
+///
+/// - note: for internal use only.
+class JWEKey {
+    
+    /// Batches at least this large are spread over all cores.
+    static let parallelBatchThreshold = 16
+    
+    let jwk: String
+    
+    private let prepared: ParallelCipherA256GCM.PreparedKey?
+    private let lock = NSLock()
+    // Header segments already checked to be dir / A256GCM. Messages of a room share a handful.
+    private var headers = Set<String>()
+    
+    // The header this key writes, and its base64url form that doubles as the AAD.
+    private static let header = JWEKey.base64URLEncode(Data("{\"alg\":\"dir\",\"enc\":\"A256GCM\"}".utf8))
+    private static let headerAAD = Data(JWEKey.header.utf8)
+    
+    private static let cache: NSCache<NSString, JWEKey> = {
+        let cache = NSCache<NSString, JWEKey>()
+        cache.countLimit = 64
+        return cache
+    }()
+    
+    /// Returns the shared prepared key for `jwk`.
+    static func prepared(jwk: String) -> JWEKey {
+        if let key = JWEKey.cache.object(forKey: jwk as NSString) {
+            return key
+        }
+        let key = JWEKey(jwk: jwk)
+        JWEKey.cache.setObject(key, forKey: jwk as NSString)
+        return key
+    }
+    
+    init(jwk: String) {
+        self.jwk = jwk
+        if let data = jwk.data(using: .utf8),
+            let json = (try? JSONSerialization.jsonObject(with: data, options: [])) as? [String: Any],
+            json["kty"] as? String == "oct",
+            let k = json["k"] as? String,
+            let key = JWEKey.base64URLDecode(k) {
+            self.prepared = try? ParallelCipherA256GCM.PreparedKey(key: key)
+        }
+        else {
+            self.prepared = nil
+        }
+    }
+    
+    /// True if this key runs on the prepared fast path rather than `CjoseWrapper`.
+    var isPrepared: Bool {
+        return self.prepared != nil
+    }
+    
+    // MARK: Encryption
+    
+    /// Encrypts `content` into a JWE compact serialization, or returns nil on failure. The header
+    /// carries no `kid`; see the class doc.
+    func encrypt(_ content: Data) -> String? {
+        guard let prepared = self.prepared else {
+            return try? CjoseWrapper.ciphertext(fromContent: content, key: self.jwk)
+        }
+        let iv = JWEKey.random(12)
+        guard let cipher = try? ParallelCipherA256GCM(prepared: prepared, iv: iv, aad: JWEKey.headerAAD) else {
+            return nil
+        }
+        var ciphertext = Data(count: content.count)
+        do {
+            if content.count > 0 {
+                _ = try content.withUnsafeBytes { (rbuf: UnsafePointer<UInt8>) in
+                    try ciphertext.withUnsafeMutableBytes { (wbuf: UnsafeMutablePointer<UInt8>) in
+                        try cipher.encryptBytes(rbuf, toBuffer: wbuf, withLength: content.count)
+                    }
+                }
+            }
+            try cipher.finalize()
+        }
+        catch {
+            return nil
+        }
+        guard let tag = cipher.tag else {
+            return nil
+        }
+        return JWEKey.header + ".." + JWEKey.base64URLEncode(iv) + "." + JWEKey.base64URLEncode(ciphertext) + "." + JWEKey.base64URLEncode(tag)
+    }
+    
+    /// Encrypts many payloads at once, in order. Failed entries are nil.
+    func encrypt(_ contents: [Data]) -> [String?] {
+        return JWEKey.batch(contents) { self.encrypt($0) }
+    }
+    
+    // MARK: Decryption
+    
+    /// Decrypts a JWE compact serialization, or returns nil if it is malformed or not authentic.
+    func decrypt(_ ciphertext: String) -> Data? {
+        guard let prepared = self.prepared else {
+            return try? CjoseWrapper.content(fromCiphertext: ciphertext, key: self.jwk)
+        }
+        let segments = ciphertext.split(separator: ".", omittingEmptySubsequences: false)
+        let header = segments.count == 5 ? String(segments[0]) : ""
+        guard segments.count == 5, segments[1].isEmpty, self.supports(header: header) else {
+            return try? CjoseWrapper.content(fromCiphertext: ciphertext, key: self.jwk)
+        }
+        guard let aad = header.data(using: .ascii),
+            let iv = JWEKey.base64URLDecode(segments[2]),
+            let content = JWEKey.base64URLDecode(segments[3]),
+            let tag = JWEKey.base64URLDecode(segments[4]), tag.count == 16,
+            let cipher = try? ParallelCipherA256GCM(prepared: prepared, iv: iv, aad: aad, tag: tag) else {
+            return nil
+        }
+        var plaintext = Data(count: content.count)
+        do {
+            if content.count > 0 {
+                _ = try content.withUnsafeBytes { (rbuf: UnsafePointer<UInt8>) in
+                    try plaintext.withUnsafeMutableBytes { (wbuf: UnsafeMutablePointer<UInt8>) in
+                        try cipher.decryptBytes(rbuf, toBuffer: wbuf, withLength: content.count)
+                    }
+                }
+            }
+            try cipher.finalize()
+        }
+        catch {
+            return nil
+        }
+        return plaintext
+    }
+    
+    /// Decrypts many JWEs at once, in order. Failed entries are nil.
+    func decrypt(_ ciphertexts: [String]) -> [Data?] {
+        return JWEKey.batch(ciphertexts) { self.decrypt($0) }
+    }
+    
+    private func supports(header: String) -> Bool {
+        if header == JWEKey.header {
+            return true
+        }
+        self.lock.lock()
+        let known = self.headers.contains(header)
+        self.lock.unlock()
+        if known {
+            return true
+        }
+        guard let data = JWEKey.base64URLDecode(header),
+            let json = (try? JSONSerialization.jsonObject(with: data, options: [])) as? [String: Any],
+            json["alg"] as? String == "dir", json["enc"] as? String == "A256GCM", json["zip"] == nil, json["crit"] == nil else {
+            return false
+        }
+        self.lock.lock()
+        self.headers.insert(header)
+        self.lock.unlock()
+        return true
+    }
+    
+    private static func batch<T, R>(_ inputs: [T], _ transform: (T) -> R?) -> [R?] {
+        if inputs.count < JWEKey.parallelBatchThreshold {
+            return inputs.map(transform)
+        }
+        var results = [R?](repeating: nil, count: inputs.count)
+        results.withUnsafeMutableBufferPointer { buffer in
+            let output = buffer
+            DispatchQueue.concurrentPerform(iterations: inputs.count) { index in
+                output[index] = transform(inputs[index])
+            }
+        }
+        return results
+    }
+    
+    private static func random(_ count: Int) -> Data {
+        var data = Data(count: count)
+        let status = data.withUnsafeMutableBytes { (bytes: UnsafeMutablePointer<UInt8>) in
+            SecRandomCopyBytes(kSecRandomDefault, count, bytes)
+        }
+        precondition(status == errSecSuccess, "SecRandomCopyBytes failed")
+        return data
+    }
+    
+    // MARK: Base64url
+    
+    private static let alphabet = [UInt8]("ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789-_".utf8)
+    
+    private static let inverse: [UInt8] = {
+        var table = [UInt8](repeating: 0xff, count: 256)
+        for (index, char) in JWEKey.alphabet.enumerated() {
+            table[Int(char)] = UInt8(index)
+        }
+        return table
+    }()
+    
+    /// Unpadded base64url, as used by JOSE.
+    static func base64URLEncode(_ data: Data) -> String {
+        let alphabet = JWEKey.alphabet
+        var output = [UInt8]()
+        output.reserveCapacity((data.count * 4 + 2) / 3)
+        data.withUnsafeBytes { (bytes: UnsafePointer<UInt8>) in
+            var index = 0
+            while index + 3 <= data.count {
+                let value = UInt32(bytes[index]) << 16 | UInt32(bytes[index + 1]) << 8 | UInt32(bytes[index + 2])
+                output.append(alphabet[Int(value >> 18 & 0x3f)])
+                output.append(alphabet[Int(value >> 12 & 0x3f)])
+                output.append(alphabet[Int(value >> 6 & 0x3f)])
+                output.append(alphabet[Int(value & 0x3f)])
+                index += 3
+            }
+            let remainder = data.count - index
+            if remainder > 0 {
+                let value = UInt32(bytes[index]) << 16 | (remainder == 2 ? UInt32(bytes[index + 1]) << 8 : 0)
+                output.append(alphabet[Int(value >> 18 & 0x3f)])
+                output.append(alphabet[Int(value >> 12 & 0x3f)])
+                if remainder == 2 {
+                    output.append(alphabet[Int(value >> 6 & 0x3f)])
+                }
+            }
+        }
+        return String(decoding: output, as: UTF8.self)
+    }
+    
+    /// Decodes unpadded (or padded) base64url, returning nil on any invalid character.
+    static func base64URLDecode<S: StringProtocol>(_ string: S) -> Data? {
+        let inverse = JWEKey.inverse
+        var utf8 = Array(string.utf8)
+        while utf8.last == UInt8(ascii: "=") {
+            utf8.removeLast()
+        }
+        if utf8.count % 4 == 1 {
+            return nil
+        }
+        var output = Data(capacity: utf8.count * 3 / 4)
+        var buffer: UInt32 = 0
+        var bits = 0
+        for char in utf8 {
+            let value = inverse[Int(char)]
+            if value == 0xff {
+                return nil
+            }
+            buffer = buffer << 6 | UInt32(value)
+            bits += 6
+            if bits >= 8 {
+                bits -= 8
+                output.append(UInt8(truncatingIfNeeded: buffer >> UInt32(bits)))
+            }
+        }
+        return output
+    }
+}
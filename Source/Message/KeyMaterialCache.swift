@@ -0,0 +1,373 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import Security
+import KeychainAccess
+
+/// Process wide cache of KMS key material, shared by every `MessageClientImpl`.
+///
+/// Entries are keyed by encryption URL and bounded both by count, evicting the least recently
+/// used first, and by age: an entry expires at the earlier of the key's KMS `expirationDate` and
+/// `timeToLive` after it was fetched. The material is persisted sealed with AES-256-GCM under a
+/// random key kept in the keychain, so after a cold start a message decrypts with the key its
+/// activity names without asking the KMS.
+///
+/// The cache also remembers which key each room last used, but only for the session: a room's key
+/// can be rotated while the app isn't running, and the conversation service is the one to ask.
+///
+/// - note: for internal use only.
+class KeyMaterialCache {
+    
+    struct Statistics {
+        var hits: Int = 0
+        var misses: Int = 0
+        var evictions: Int = 0
+    }
+    
+    struct Entry: Codable {
+        let uri: String
+        let material: String
+        let expiration: Date
+        var lastUsed: Date
+    }
+    
+    struct Room {
+        var uri: String
+        var lastUsed: Date
+    }
+    
+    private struct Snapshot: Codable {
+        var owner: String?
+        var entries: [String: Entry]
+    }
+    
+    static let defaultCapacity = 512
+    
+    static let defaultTimeToLive: TimeInterval = 7 * 24 * 60 * 60
+    
+    /// Entries this close to expiring are refreshed by a prefetch.
+    static let refreshWindow: TimeInterval = 24 * 60 * 60
+    
+    static let prefetchLimit = 20
+    
+    static let shared = KeyMaterialCache(keychain: Keychain(service: "\(Bundle.main.bundleIdentifier ?? "").sparksdk.kms"),
+                                         url: KeyMaterialCache.defaultURL)
+    
+    private static let sealingKeyName = "keyMaterialCacheKey"
+    
+    private static let saveDelay: TimeInterval = 1
+    
+    let capacity: Int
+    let timeToLive: TimeInterval
+    
+    private(set) var statistics = Statistics()
+    
+    private let keychain: KeychainProtocol
+    private let url: URL?
+    private let clock: Clock
+    private let io = DispatchQueue(label: "com.ciscospark.sdk.KeyMaterialCache")
+    private var snapshot = Snapshot(owner: nil, entries: [:])
+    private var rooms = [String: Room]()
+    private var saveScheduled = false
+    
+    init(keychain: KeychainProtocol, url: URL?, capacity: Int = KeyMaterialCache.defaultCapacity, timeToLive: TimeInterval = KeyMaterialCache.defaultTimeToLive, clock: Clock = Clock()) {
+        self.keychain = keychain
+        self.url = url
+        self.capacity = capacity
+        self.timeToLive = timeToLive
+        self.clock = clock
+        self.load()
+    }
+    
+    var count: Int {
+        var count = 0
+        synchronized(lock: self) {
+            count = self.snapshot.entries.count
+        }
+        return count
+    }
+    
+    /// Returns the cached material for the key at `uri`, or nil if it is unknown or expired.
+    func material(uri: String) -> String? {
+        var material: String?
+        synchronized(lock: self) {
+            material = self.lookup(uri: uri)
+        }
+        return material
+    }
+    
+    /// Returns the encryption URL and material the room last used, if the key is still cached.
+    func material(roomId: String) -> (String, String)? {
+        var result: (String, String)?
+        synchronized(lock: self) {
+            if let uri = self.rooms[roomId]?.uri {
+                if let material = self.lookup(uri: uri) {
+                    self.rooms[roomId]?.lastUsed = self.clock.currentTime
+                    result = (uri, material)
+                }
+            }
+            else {
+                self.statistics.misses += 1
+            }
+        }
+        return result
+    }
+    
+    /// Returns the encryption URL the room last used, whether or not its material is cached.
+    func uri(roomId: String) -> String? {
+        var uri: String?
+        synchronized(lock: self) {
+            uri = self.rooms[roomId]?.uri
+        }
+        return uri
+    }
+    
+    func store(uri: String, material: String, expiration: Date? = nil) {
+        synchronized(lock: self) {
+            let now = self.clock.currentTime
+            let limit = now.addingTimeInterval(self.timeToLive)
+            let expiration = min(expiration ?? limit, limit)
+            guard expiration > now else {
+                return
+            }
+            self.snapshot.entries[uri] = Entry(uri: uri, material: material, expiration: expiration, lastUsed: now)
+            if self.snapshot.entries.count > self.capacity, let victim = self.snapshot.entries.values.min(by: { $0.lastUsed < $1.lastUsed }) {
+                self.snapshot.entries[victim.uri] = nil
+                self.statistics.evictions += 1
+            }
+            self.scheduleSave()
+        }
+    }
+    
+    func bind(roomId: String, uri: String) {
+        synchronized(lock: self) {
+            self.rooms[roomId] = Room(uri: uri, lastUsed: self.clock.currentTime)
+            if self.rooms.count > self.capacity, let victim = self.rooms.min(by: { $0.value.lastUsed < $1.value.lastUsed }) {
+                self.rooms[victim.key] = nil
+            }
+        }
+    }
+    
+    /// Encryption URLs of the most recently active rooms whose material is missing or about to expire,
+    /// then of the most recently used keys about to expire.
+    func prefetchCandidates(limit: Int = KeyMaterialCache.prefetchLimit) -> [String] {
+        var uris = [String]()
+        synchronized(lock: self) {
+            let horizon = self.clock.currentTime.addingTimeInterval(KeyMaterialCache.refreshWindow)
+            for room in self.rooms.values.sorted(by: { $0.lastUsed > $1.lastUsed }) where uris.count < limit {
+                if !uris.contains(room.uri) && (self.snapshot.entries[room.uri]?.expiration ?? Date.distantPast) < horizon {
+                    uris.append(room.uri)
+                }
+            }
+            // After a cold start no room is bound yet; the keys used last stand in for them.
+            for entry in self.snapshot.entries.values.sorted(by: { $0.lastUsed > $1.lastUsed }) where uris.count < limit {
+                if !uris.contains(entry.uri) && entry.expiration < horizon {
+                    uris.append(entry.uri)
+                }
+            }
+        }
+        return uris
+    }
+    
+    /// Ties the cache to the authenticated user, dropping everything cached for anyone else.
+    func claim(owner: String) {
+        synchronized(lock: self) {
+            if self.snapshot.owner == owner {
+                return
+            }
+            if self.snapshot.owner != nil {
+                SDKLogger.shared.info("Key material cache belongs to another user, clearing")
+                self.snapshot.entries.removeAll()
+                self.rooms.removeAll()
+            }
+            self.snapshot.owner = owner
+            self.scheduleSave()
+        }
+    }
+    
+    func removeAll() {
+        synchronized(lock: self) {
+            self.snapshot = Snapshot(owner: nil, entries: [:])
+            self.rooms.removeAll()
+        }
+        self.io.async {
+            if let url = self.url {
+                try? FileManager.default.removeItem(at: url)
+            }
+            try? self.keychain.remove(KeyMaterialCache.sealingKeyName)
+        }
+    }
+    
+    /// Blocks until pending writes reached the disk.
+    func flush() {
+        self.io.sync {
+            self.save()
+        }
+    }
+    
+    // Must be called with the lock held.
+    private func lookup(uri: String) -> String? {
+        guard var entry = self.snapshot.entries[uri] else {
+            self.statistics.misses += 1
+            return nil
+        }
+        let now = self.clock.currentTime
+        if entry.expiration <= now {
+            self.snapshot.entries[uri] = nil
+            self.statistics.misses += 1
+            self.scheduleSave()
+            return nil
+        }
+        entry.lastUsed = now
+        self.snapshot.entries[uri] = entry
+        self.statistics.hits += 1
+        return entry.material
+    }
+    
+    // MARK: Persistence
+    
+    private static var defaultURL: URL? {
+        guard let directory = FileManager.default.urls(for: .applicationSupportDirectory, in: .userDomainMask).first?.appendingPathComponent("com.ciscospark.sdk") else {
+            return nil
+        }
+        return directory.appendingPathComponent("kms.cache")
+    }
+    
+    // Must be called with the lock held.
+    private func scheduleSave() {
+        guard self.url != nil, !self.saveScheduled else {
+            return
+        }
+        self.saveScheduled = true
+        self.io.asyncAfter(deadline: .now() + KeyMaterialCache.saveDelay) {
+            self.save()
+        }
+    }
+    
+    private func save() {
+        guard let url = self.url else {
+            return
+        }
+        var snapshot: Snapshot?
+        synchronized(lock: self) {
+            if self.saveScheduled {
+                self.saveScheduled = false
+                snapshot = self.snapshot
+            }
+        }
+        guard let current = snapshot else {
+            return
+        }
+        do {
+            guard let key = self.sealingKey(create: true) else {
+                throw SparkError.illegalStatus(reason: "No sealing key")
+            }
+            let sealed = try KeyMaterialCache.seal(JSONEncoder().encode(current), key: key)
+            try FileManager.default.createDirectory(at: url.deletingLastPathComponent(), withIntermediateDirectories: true, attributes: nil)
+            try sealed.write(to: url, options: [.atomic, .completeFileProtectionUntilFirstUserAuthentication])
+        }
+        catch let error {
+            SDKLogger.shared.error("Failed to save key material cache", error: error)
+        }
+    }
+    
+    private func load() {
+        guard let url = self.url, let sealed = try? Data(contentsOf: url) else {
+            return
+        }
+        do {
+            guard let key = self.sealingKey(create: false) else {
+                throw SparkError.illegalStatus(reason: "No sealing key")
+            }
+            self.snapshot = try JSONDecoder().decode(Snapshot.self, from: KeyMaterialCache.open(sealed, key: key))
+            let now = self.clock.currentTime
+            self.snapshot.entries = self.snapshot.entries.filter { $0.value.expiration > now }
+        }
+        catch let error {
+            SDKLogger.shared.error("Discarding unreadable key material cache", error: error)
+            try? FileManager.default.removeItem(at: url)
+        }
+    }
+    
+    private func sealingKey(create: Bool) -> Data? {
+        if let value = (try? self.keychain.get(KeyMaterialCache.sealingKeyName)) ?? nil, let key = Data(base64Encoded: value), key.count == 32 {
+            return key
+        }
+        guard create else {
+            return nil
+        }
+        let key = KeyMaterialCache.random(32)
+        do {
+            try self.keychain.set(key.base64EncodedString(), key: KeyMaterialCache.sealingKeyName)
+            return key
+        }
+        catch let error {
+            SDKLogger.shared.error("Failed to store key material cache key", error: error)
+            return nil
+        }
+    }
+    
+    // Layout: iv (12 bytes) | tag (16 bytes) | ciphertext.
+    static func seal(_ plaintext: Data, key: Data) throws -> Data {
+        let iv = KeyMaterialCache.random(12)
+        let cipher = try ParallelCipherA256GCM(key: key, iv: iv, aad: Data())
+        var ciphertext = Data(count: plaintext.count)
+        if plaintext.count > 0 {
+            _ = try plaintext.withUnsafeBytes { (rbuf: UnsafePointer<UInt8>) in
+                try ciphertext.withUnsafeMutableBytes { (wbuf: UnsafeMutablePointer<UInt8>) in
+                    try cipher.encryptBytes(rbuf, toBuffer: wbuf, withLength: plaintext.count)
+                }
+            }
+        }
+        try cipher.finalize()
+        guard let tag = cipher.tag else {
+            throw SparkError.illegalStatus(reason: "No authentication tag")
+        }
+        return iv + tag + ciphertext
+    }
+    
+    static func open(_ sealed: Data, key: Data) throws -> Data {
+        guard sealed.count >= 28 else {
+            throw SparkError.illegalStatus(reason: "Truncated key material cache")
+        }
+        let ciphertext = sealed.subdata(in: 28..<sealed.count)
+        let cipher = try ParallelCipherA256GCM(key: key, iv: sealed.subdata(in: 0..<12), aad: Data(), tag: sealed.subdata(in: 12..<28))
+        var plaintext = Data(count: ciphertext.count)
+        if ciphertext.count > 0 {
+            _ = try ciphertext.withUnsafeBytes { (rbuf: UnsafePointer<UInt8>) in
+                try plaintext.withUnsafeMutableBytes { (wbuf: UnsafeMutablePointer<UInt8>) in
+                    try cipher.decryptBytes(rbuf, toBuffer: wbuf, withLength: ciphertext.count)
+                }
+            }
+        }
+        try cipher.finalize()
+        return plaintext
+    }
+    
+    private static func random(_ count: Int) -> Data {
+        var data = Data(count: count)
+        let status = data.withUnsafeMutableBytes { (bytes: UnsafeMutablePointer<UInt8>) in
+            SecRandomCopyBytes(kSecRandomDefault, count, bytes)
+        }
+        precondition(status == errSecSuccess, "SecRandomCopyBytes failed")
+        return data
+    }
+}
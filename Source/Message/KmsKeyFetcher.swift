@@ -0,0 +1,157 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+
+/// Coalesces KMS key retrievals into multi-key requests.
+///
+/// Callers asking for a key URI within `window` of each other are sent together as one KMS
+/// request carrying one message per URI, and callers asking for a URI that is already pending or
+/// in flight simply wait for it. Responses are handed to `resolve(uri:material:)`, which completes
+/// every waiting handler; a batch that got no answer within `timeout` fails its remaining handlers.
+/// Handlers are called on the main queue.
+///
+/// - note: for internal use only.
+class KmsKeyFetcher {
+    
+    typealias Handler = (Result<(String, String)>) -> Void
+    
+    /// Sends one batch of key URIs, calling the failure closure if the request could not be made.
+    typealias Sender = (_ uris: [String], _ failed: @escaping (Error) -> Void) -> Void
+    
+    struct Statistics {
+        /// KMS requests actually sent.
+        var batches: Int = 0
+        /// Distinct keys requested across all batches.
+        var keys: Int = 0
+        /// Callers asking for a key.
+        var requests: Int = 0
+        
+        /// KMS requests the callers would have made without coalescing, less the ones sent.
+        var savedRequests: Int {
+            return self.requests - self.batches
+        }
+    }
+    
+    static let defaultWindow: TimeInterval = 0.05
+    
+    static let defaultMaxBatchSize = 50
+    
+    static let defaultTimeout: TimeInterval = 30
+    
+    let window: TimeInterval
+    let maxBatchSize: Int
+    let timeout: TimeInterval
+    
+    private let queue = DispatchQueue(label: "com.ciscospark.sdk.KmsKeyFetcher")
+    private let send: Sender
+    private var stats = Statistics()
+    private var pending = [String]()
+    private var handlers = [String: [Handler]]()
+    // Key URI -> the batch it was sent in.
+    private var inflight = [String: Int]()
+    private var flushScheduled = false
+    
+    init(window: TimeInterval = KmsKeyFetcher.defaultWindow, maxBatchSize: Int = KmsKeyFetcher.defaultMaxBatchSize, timeout: TimeInterval = KmsKeyFetcher.defaultTimeout, send: @escaping Sender) {
+        self.window = window
+        self.maxBatchSize = maxBatchSize
+        self.timeout = timeout
+        self.send = send
+    }
+    
+    var statistics: Statistics {
+        return self.queue.sync {
+            self.stats
+        }
+    }
+    
+    func fetch(uri: String, completionHandler: @escaping Handler) {
+        self.queue.async {
+            self.stats.requests += 1
+            let waiting = self.handlers[uri] != nil
+            self.handlers[uri, default: []].append(completionHandler)
+            if waiting {
+                return
+            }
+            self.pending.append(uri)
+            if self.pending.count >= self.maxBatchSize {
+                self.flush()
+            }
+            else if !self.flushScheduled {
+                self.flushScheduled = true
+                self.queue.asyncAfter(deadline: .now() + self.window) {
+                    self.flushScheduled = false
+                    self.flush()
+                }
+            }
+        }
+    }
+    
+    /// Completes everyone waiting for `uri` with its material.
+    func resolve(uri: String, material: String) {
+        self.queue.async {
+            self.inflight[uri] = nil
+            if let index = self.pending.index(of: uri) {
+                self.pending.remove(at: index)
+            }
+            self.complete(uri: uri, result: Result.success((uri, material)))
+        }
+    }
+    
+    // Must be called on `queue`.
+    private func flush() {
+        while !self.pending.isEmpty {
+            let uris = Array(self.pending.prefix(self.maxBatchSize))
+            self.pending.removeFirst(uris.count)
+            self.stats.batches += 1
+            self.stats.keys += uris.count
+            let batch = self.stats.batches
+            let callers = uris.reduce(0) { $0 + (self.handlers[$1]?.count ?? 0) }
+            uris.forEach { self.inflight[$0] = batch }
+            SDKLogger.shared.debug("KMS key batch \(batch): \(uris.count) keys for \(callers) callers, saved \(callers - 1) requests, \(self.stats.savedRequests) in total")
+            self.send(uris) { error in
+                self.queue.async {
+                    self.fail(batch: batch, uris: uris, error: error)
+                }
+            }
+            self.queue.asyncAfter(deadline: .now() + self.timeout) {
+                self.fail(batch: batch, uris: uris, error: MessageClientImpl.MSGError.Timeout)
+            }
+        }
+    }
+    
+    // Must be called on `queue`.
+    private func fail(batch: Int, uris: [String], error: Error) {
+        for uri in uris where self.inflight[uri] == batch {
+            self.inflight[uri] = nil
+            self.complete(uri: uri, result: Result.failure(error))
+        }
+    }
+    
+    // Must be called on `queue`.
+    private func complete(uri: String, result: Result<(String, String)>) {
+        guard let handlers = self.handlers.removeValue(forKey: uri) else {
+            return
+        }
+        DispatchQueue.main.async {
+            handlers.forEach { $0(result) }
+        }
+    }
+}
@@ -256,7 +256,7 @@ extension RemoteFile {
         }
     }
     
-    mutating func decrypt(key: String?) {
+    mutating func decrypt(key: JWEKey?) {
         self.displayName = self.displayName?.decrypt(key: key)
         self.secureContentRef = self.secureContentRef?.decrypt(key: key)
         self.thumbnail?.decrypt(key: key)
@@ -278,7 +278,7 @@ extension RemoteFile.Thumbnail {
         }
     }
     
-    fileprivate mutating func decrypt(key: String?) {
+    fileprivate mutating func decrypt(key: JWEKey?) {
         self.secureContentRef = self.secureContentRef?.decrypt(key: key)
     }
     
@@ -60,6 +60,11 @@ public class MessageClient {
         }
     }
     
+    /// The maximum number of files uploaded at the same time when posting a message with attachments.
+    ///
+    /// - since: 1.4.2
+    public var maxConcurrentUploads: Int = UploadFileOperations.defaultMaxConcurrentUploads
+    
     private let phone: Phone
     
     private let queue = SerialQueue()
@@ -285,6 +290,7 @@ public class MessageClient {
     /// - parameter personEmail: The EmailAddress of the user to whom the message is to be posted.
     /// - parameter content: The plain text message to be posted to the room.
     /// - parameter files: Local file objects to be uploaded to the room.
+    /// - parameter progressHandler: If not nil, called with the overall progress, from 0 to 1, of uploading all the files, on the same queue as the completion handler.
     /// - parameter queue: If not nil, the queue on which the completion handler is dispatched. Otherwise, the handler is dispatched on the application's main thread.
     /// - parameter completionHandler: A closure to be executed once the request has finished.
     /// - returns: Void
@@ -292,11 +298,12 @@ public class MessageClient {
     public func post(personEmail: EmailAddress,
                      text: String? = nil,
                      files: [LocalFile]? = nil,
+                     progressHandler: ((Double) -> Void)? = nil,
                      queue: DispatchQueue? = nil,
                      completionHandler: @escaping (ServiceResponse<Message>) -> Void) {
         self.doSomethingAfterRegistered { error in
             if let impl = self.phone.messages {
-                impl.post(person: personEmail.toString(), text: text, files: files, queue: queue, completionHandler: completionHandler)
+                impl.post(person: personEmail.toString(), text: text, files: files, maxConcurrentUploads: self.maxConcurrentUploads, progressHandler: progressHandler, queue: queue, completionHandler: completionHandler)
             }
             else {
                 (queue ?? DispatchQueue.main).async {
@@ -312,6 +319,7 @@ public class MessageClient {
     /// - parameter personId: The personId of the user to whom the message is to be posted.
     /// - parameter text: The plain text message to be posted to the room.
     /// - parameter files: Local file objects to be uploaded to the room.
+    /// - parameter progressHandler: If not nil, called with the overall progress, from 0 to 1, of uploading all the files, on the same queue as the completion handler.
     /// - parameter queue: If not nil, the queue on which the completion handler is dispatched. Otherwise, the handler is dispatched on the application's main thread.
     /// - parameter completionHandler: A closure to be executed once the request has finished.
     /// - returns: Void
@@ -319,11 +327,12 @@ public class MessageClient {
     public func post(personId: String,
                      text: String? = nil,
                      files: [LocalFile]? = nil,
+                     progressHandler: ((Double) -> Void)? = nil,
                      queue: DispatchQueue? = nil,
                      completionHandler: @escaping (ServiceResponse<Message>) -> Void) {
         self.doSomethingAfterRegistered { error in
             if let impl = self.phone.messages {
-                impl.post(person: personId, text: text, files: files, queue: queue, completionHandler: completionHandler)
+                impl.post(person: personId, text: text, files: files, maxConcurrentUploads: self.maxConcurrentUploads, progressHandler: progressHandler, queue: queue, completionHandler: completionHandler)
             }
             else {
                 (queue ?? DispatchQueue.main).async {
@@ -340,6 +349,7 @@ public class MessageClient {
     /// - parameter text: The plain text message to be posted to the room.
     /// - parameter mentions: The mention items to be posted to the room.
     /// - parameter files: Local file objects to be uploaded to the room.
+    /// - parameter progressHandler: If not nil, called with the overall progress, from 0 to 1, of uploading all the files, on the same queue as the completion handler.
     /// - parameter queue: If not nil, the queue on which the completion handler is dispatched. Otherwise, the handler is dispatched on the application's main thread.
     /// - parameter completionHandler: A closure to be executed once the request has finished.
     /// - returns: Void
@@ -348,11 +358,12 @@ public class MessageClient {
                      text: String? = nil,
                      mentions: [Mention]? = nil,
                      files: [LocalFile]? = nil,
+                     progressHandler: ((Double) -> Void)? = nil,
                      queue: DispatchQueue? = nil,
                      completionHandler: @escaping (ServiceResponse<Message>) -> Void) {
         self.doSomethingAfterRegistered { error in
             if let impl = self.phone.messages {
-                impl.post(roomId: roomId, text: text, mentions: mentions, files: files, queue: queue, completionHandler: completionHandler)
+                impl.post(roomId: roomId, text: text, mentions: mentions, files: files, maxConcurrentUploads: self.maxConcurrentUploads, progressHandler: progressHandler, queue: queue, completionHandler: completionHandler)
             }
             else {
                 (queue ?? DispatchQueue.main).async {
@@ -47,12 +47,17 @@ class MessageClientImpl {
     
     private static let KMS_MSG_SERVER_URL = URL(string: ServiceRequest.KMS_SERVER_ADDRESS + "/kms/messages")!
     
+    /// Pages fetched to catch a room up with the message store before starting it over.
+    private static let maxSyncPages = 10
+    
     var onEvent: ((MessageEvent) -> Void)?
     
     let authenticator: Authenticator
     var deviceUrl : URL
+    let store: MessageStore
     
     private let queue = SerialQueue()
+    private let decryptionQueue = DispatchQueue(label: "com.ciscospark.sdk.MessageClient.decryption", qos: .userInitiated)
     
     private var uuid: String = UUID().uuidString
     private var userId : String?
@@ -62,15 +67,23 @@ class MessageClientImpl {
     private var keySerialization: String?
     
     private var ephemeralKeyRequest: (KmsEphemeralKeyRequest, (Error?) -> Void)?
-    private var keyMaterialCompletionHandlers: [String: [(Result<(String, String)>) -> Void]] = [String: [(Result<(String, String)>) -> Void]]()
+    private lazy var keyFetcher: KmsKeyFetcher = KmsKeyFetcher { [weak self] uris, failed in
+        if let strong = self {
+            strong.retrieveKeyMaterials(uris: uris, failed: failed)
+        }
+        else {
+            failed(MSGError.keyMaterialFetchFail)
+        }
+    }
     private var keysCompletionHandlers: [String: [(Result<(String, String)>) -> Void]] = [String: [(Result<(String, String)>) -> Void]]()
     private var encryptionKeys: [String: EncryptionKey] = [String: EncryptionKey]()
     private var rooms: [String: String] = [String: String]()
     private typealias KeyHandler = (Result<(String, String)>) -> Void
     
-    init(authenticator: Authenticator, deviceUrl: URL) {
+    init(authenticator: Authenticator, deviceUrl: URL, store: MessageStore = MessageStore.shared) {
         self.authenticator = authenticator
         self.deviceUrl = deviceUrl
+        self.store = store
     }
     
     func list(roomId: String,
@@ -87,61 +100,197 @@ class MessageClientImpl {
             return
         }
         
-        func listBefore(date: Date?, result: [ActivityModel], completionHandler: @escaping (ServiceResponse<[Message]>) -> Void) {
-            let dateKey = mentionedPeople == nil ? "maxDate" : "sinceDate"
-            let request = self.messageServiceBuilder.path(mentionedPeople == nil ? "activities" : "mentions")
+        func listBefore(date: Date?) {
+            if mentionedPeople == nil {
+                self.listStored(roomId: roomId, before: date, max: max, queue: queue, completionHandler: completionHandler)
+            }
+            else {
+                self.listRemote(roomId: roomId, mentionedPeople: mentionedPeople, before: date, max: max, queue: queue, completionHandler: completionHandler)
+            }
+        }
+        
+        if let before = before {
+            switch before {
+            case .message(let messageId):
+                if let created = self.store.created(roomId: roomId, messageId: messageId) {
+                    listBefore(date: created)
+                    return
+                }
+                self.get(messageId: messageId, decrypt: false, queue: queue) { response in
+                    if let error = response.result.error {
+                        completionHandler(ServiceResponse(response.response, Result.failure(error)))
+                    }
+                    else {
+                        listBefore(date: response.result.data?.created)
+                    }
+                }
+            case .date(let date):
+                listBefore(date: date)
+            }
+        }
+        else {
+            listBefore(date: nil)
+        }
+    }
+    
+    /// Lists from the message store. What was posted since the last sync is fetched first, then
+    /// older pages only if the store holds fewer than `max` messages before `before`.
+    private func listStored(roomId: String, before: Date?, max: Int, queue: DispatchQueue?, completionHandler: @escaping (ServiceResponse<[Message]>) -> Void) {
+        let room = self.store.room(roomId)
+        if let before = before, room?.covers(before) != true {
+            // Far back in a room; not worth filling the store up to there.
+            self.listRemote(roomId: roomId, mentionedPeople: nil, before: before, max: max, queue: queue, completionHandler: completionHandler)
+            return
+        }
+        func finish(_ response: HTTPURLResponse?, _ error: Error?) {
+            let activities = self.store.activities(roomId: roomId, before: before, max: max)
+            (queue ?? DispatchQueue.main).async {
+                if let error = error, activities.isEmpty {
+                    completionHandler(ServiceResponse(response, Result.failure(error)))
+                }
+                else {
+                    if let error = error {
+                        SDKLogger.shared.warn("Listing stored messages, sync failed", error: error)
+                    }
+                    completionHandler(ServiceResponse(response, Result.success(activities.map { Message(activity: $0) })))
+                }
+            }
+        }
+        self.encryptionKey(roomId: roomId).material(client: self) { material in
+            guard let key = material.data else {
+                finish(nil, material.error ?? MSGError.keyMaterialFetchFail)
+                return
+            }
+            let started = Date()
+            let syncedUntil = room?.syncedUntil
+            var pages = 0
+            self.walk(roomId: roomId, from: nil, pageSize: max, key: key, enough: { activities in
+                pages += 1
+                if let syncedUntil = syncedUntil {
+                    // A room that was busy for long is started over rather than synced page by page.
+                    return (activities.last?.created ?? Date.distantFuture) <= syncedUntil || pages >= MessageClientImpl.maxSyncPages
+                }
+                return activities.filter { $0.kind == .post || $0.kind == .share }.count >= max
+            }) { result in
+                guard let (activities, start) = result.data else {
+                    finish(nil, result.error)
+                    return
+                }
+                let until = started.addingTimeInterval(-MessageStore.syncMargin)
+                let from = start ? Date.distantPast : min(activities.last?.created ?? until, until)
+                self.store.merge(roomId: roomId, activities: activities, from: from, until: until, complete: start)
+                guard let room = self.store.room(roomId), !room.complete, let coveredFrom = room.coveredFrom else {
+                    finish(nil, nil)
+                    return
+                }
+                let missing = max - self.store.activities(roomId: roomId, before: before, max: max).count
+                if missing <= 0 {
+                    finish(nil, nil)
+                    return
+                }
+                self.walk(roomId: roomId, from: coveredFrom, pageSize: max, key: key, enough: { activities in
+                    activities.filter { $0.kind == .post || $0.kind == .share }.count >= missing
+                }) { result in
+                    guard let (activities, start) = result.data else {
+                        finish(nil, result.error)
+                        return
+                    }
+                    self.store.merge(roomId: roomId, activities: activities, from: start ? Date.distantPast : activities.last?.created ?? coveredFrom, until: coveredFrom, complete: start)
+                    finish(nil, nil)
+                }
+            }
+        }
+    }
+    
+    /// Fetches and decrypts pages of the room's activities, newest first, going back from `date`
+    /// until `enough` is satisfied or the first activity of the room was reached. Hands out the
+    /// posts, shares and deletes fetched, and whether the first activity was reached.
+    /// Pages are decrypted while the next ones are fetched, so `enough` sees them still encrypted.
+    private func walk(roomId: String, from date: Date?, pageSize: Int, key: String, enough: @escaping ([ActivityModel]) -> Bool, completionHandler: @escaping (Result<([ActivityModel], Bool)>) -> Void) {
+        let pipeline = ActivityDecryptionPipeline(limit: Int.max)
+        pipeline.resolve(material: Result.success(key))
+        var fetched = [ActivityModel]()
+        
+        func walkBefore(date: Date?) {
+            // `iso8601String` reaches back a little; going forward by as much keeps pages adjacent.
+            let maxDate = (date?.addingTimeInterval(0.1) ?? Date()).iso8601String
+            let request = self.messageServiceBuilder.path("activities")
                 .keyPath("items")
                 .method(.get)
-                .query(RequestParameter(["conversationId": roomId.locusFormat, "limit": max, dateKey: (date ?? Date()).iso8601String]))
-                .queue(queue)
+                .query(RequestParameter(["conversationId": roomId.locusFormat, "limit": pageSize, "maxDate": maxDate]))
+                .queue(DispatchQueue.global(qos: .userInitiated))
                 .build()
             request.responseArray { (response: ServiceResponse<[ActivityModel]>) in
                 switch response.result {
-                case .success(let value):
-                    let result = result + value.filter({$0.kind == ActivityModel.Kind.post || $0.kind == ActivityModel.Kind.share})
-                    if result.count >= max || value.count < max {
-                        let key = self.encryptionKey(roomId: roomId)
-                        key.material(client: self) { material in
-                            if let material = material.data {
-                                let messages = result.prefix(max).map { $0.decrypt(key: material) }.map { Message(activity: $0) }
-                                (queue ?? DispatchQueue.main).async {
-                                    completionHandler(ServiceResponse(response.response, Result.success(messages)))
-                                }
+                case .success(let page):
+                    let kept = page.filter { $0.kind == .post || $0.kind == .share || $0.kind == .delete }
+                    fetched += kept
+                    _ = pipeline.submit(kept)
+                    let start = page.count < pageSize
+                    if start || enough(fetched) {
+                        pipeline.finish { result in
+                            if let activities = result.data {
+                                completionHandler(Result.success((activities, start)))
                             }
                             else {
-                                (queue ?? DispatchQueue.main).async {
-                                    completionHandler(ServiceResponse(response.response, Result.failure(material.error ?? MSGError.keyMaterialFetchFail)))
-                                }
+                                completionHandler(Result.failure(result.error ?? MSGError.keyMaterialFetchFail))
                             }
                         }
                     }
                     else {
-                        listBefore(date: value.last?.created, result: result, completionHandler: completionHandler)
+                        walkBefore(date: page.last?.created)
                     }
                 case .failure(let error):
-                    completionHandler(ServiceResponse(response.response, Result.failure(error)))
+                    completionHandler(Result.failure(error))
                 }
             }
         }
         
-        if let before = before {
-            switch before {
-            case .message(let messageId):
-                self.get(messageId: messageId, decrypt: false, queue: queue) { response in
-                    if let error = response.result.error {
-                        completionHandler(ServiceResponse(response.response, Result.failure(error)))
+        walkBefore(date: date)
+    }
+    
+    /// Lists straight from the service, decrypting pages while further ones are fetched.
+    private func listRemote(roomId: String, mentionedPeople: Mention?, before: Date?, max: Int, queue: DispatchQueue?, completionHandler: @escaping (ServiceResponse<[Message]>) -> Void) {
+        // The key is resolved, and every page decrypted, while further pages are fetched.
+        let pipeline = ActivityDecryptionPipeline(limit: max)
+        self.encryptionKey(roomId: roomId).material(client: self) { material in
+            pipeline.resolve(material: material)
+        }
+        
+        func listBefore(date: Date?) {
+            let dateKey = mentionedPeople == nil ? "maxDate" : "sinceDate"
+            let request = self.messageServiceBuilder.path(mentionedPeople == nil ? "activities" : "mentions")
+                .keyPath("items")
+                .method(.get)
+                .query(RequestParameter(["conversationId": roomId.locusFormat, "limit": max, dateKey: (date ?? Date()).iso8601String]))
+                .queue(queue)
+                .build()
+            request.responseArray { (response: ServiceResponse<[ActivityModel]>) in
+                switch response.result {
+                case .success(let value):
+                    let count = pipeline.submit(value.filter({$0.kind == ActivityModel.Kind.post || $0.kind == ActivityModel.Kind.share}))
+                    if count >= max || value.count < max {
+                        pipeline.finish { result in
+                            (queue ?? DispatchQueue.main).async {
+                                if let activities = result.data {
+                                    completionHandler(ServiceResponse(response.response, Result.success(activities.map { Message(activity: $0) })))
+                                }
+                                else {
+                                    completionHandler(ServiceResponse(response.response, Result.failure(result.error ?? MSGError.keyMaterialFetchFail)))
+                                }
+                            }
+                        }
                     }
                     else {
-                        listBefore(date: response.result.data?.created, result: [], completionHandler: completionHandler)
+                        listBefore(date: value.last?.created)
                     }
+                case .failure(let error):
+                    completionHandler(ServiceResponse(response.response, Result.failure(error)))
                 }
-            case .date(let date):
-                listBefore(date: date, result: [], completionHandler: completionHandler)
             }
         }
-        else {
-            listBefore(date: nil, result: [], completionHandler: completionHandler)
-        }
+        
+        listBefore(date: before)
     }
     
     func get(messageId: String, decrypt: Bool, queue: DispatchQueue?, completionHandler: @escaping (ServiceResponse<Message>) -> Void) {
@@ -173,11 +322,13 @@ class MessageClientImpl {
     func post(person: String,
               text: String? = nil,
               files: [LocalFile]? = nil,
+              maxConcurrentUploads: Int = UploadFileOperations.defaultMaxConcurrentUploads,
+              progressHandler: ((Double) -> Void)? = nil,
               queue: DispatchQueue? = nil,
               completionHandler: @escaping (ServiceResponse<Message>) -> Void) {
         self.lookupRoom(person: person, queue: queue) { result in
             if let roomId = result.data {
-                self.post(roomId: roomId, text: text, files: files, queue: queue, completionHandler: completionHandler)
+                self.post(roomId: roomId, text: text, files: files, maxConcurrentUploads: maxConcurrentUploads, progressHandler: progressHandler, queue: queue, completionHandler: completionHandler)
             }
             else {
                 completionHandler(ServiceResponse(nil, Result.failure(result.error ?? MSGError.roomFetchFail)))
@@ -189,6 +340,8 @@ class MessageClientImpl {
               text: String? = nil,
               mentions: [Mention]? = nil,
               files: [LocalFile]? = nil,
+              maxConcurrentUploads: Int = UploadFileOperations.defaultMaxConcurrentUploads,
+              progressHandler: ((Double) -> Void)? = nil,
               queue: DispatchQueue? = nil,
               completionHandler: @escaping (ServiceResponse<Message>) -> Void) {
         var object = [String: Any]()
@@ -215,8 +368,8 @@ class MessageClientImpl {
                 object["displayName"] = encrypt
                 object["content"] = encrypt
             }
-            let opeations = UploadFileOperations(key: key, files: files ?? [LocalFile]())
-            opeations.run(client: self) { result in
+            let opeations = UploadFileOperations(key: key, files: files ?? [LocalFile](), maxConcurrentUploads: maxConcurrentUploads)
+            opeations.run(client: self, progressHandler: progressHandler, queue: queue) { result in
                 if let files = result.data, files.count > 0 {
                     object["objectType"] = ObjectType.content.rawValue
                     object["contentCategory"] = "documents"
@@ -335,53 +488,114 @@ class MessageClientImpl {
             key.tryRefresh(encryptionUrl: encryptionUrl)
         }
         key.material(client: self) { material in
-            var decryption = activity.decrypt(key: material.data)
-            guard let kind = decryption.kind else {
-                SDKLogger.shared.error("Not a valid message \(activity.id ?? (activity.toJSONString() ?? ""))")
-                return
-            }
-            DispatchQueue.main.async {
-                switch kind {
-                case .post, .share:
-                    decryption.toPersonId = self.userId?.hydraFormat(for: .people)
-                    self.onEvent?(MessageEvent.messageReceived(Message(activity: decryption)))
-                case .delete:
-                    self.onEvent?(MessageEvent.messageDeleted(decryption.id ?? "illegal id"))
-                default:
+            // Decrypted off the caller's queue; the serial queue keeps events in arrival order.
+            self.decryptionQueue.async {
+                var decryption = activity.decrypt(key: material.data)
+                guard let kind = decryption.kind else {
                     SDKLogger.shared.error("Not a valid message \(activity.id ?? (activity.toJSONString() ?? ""))")
+                    return
+                }
+                self.store.append(roomId: roomId, activity: decryption)
+                DispatchQueue.main.async {
+                    switch kind {
+                    case .post, .share:
+                        decryption.toPersonId = self.userId?.hydraFormat(for: .people)
+                        self.onEvent?(MessageEvent.messageReceived(Message(activity: decryption)))
+                    case .delete:
+                        self.onEvent?(MessageEvent.messageDeleted(decryption.id ?? "illegal id"))
+                    default:
+                        SDKLogger.shared.error("Not a valid message \(activity.id ?? (activity.toJSONString() ?? ""))")
+                    }
                 }
             }
         }
     }
     
     func handle(kms: KmsMessageModel) {
-        if let response = kms.kmsMessages?.first {
-            if let request = self.ephemeralKeyRequest {
-                if let key = try? KmsEphemeralKeyResponse(responseMessage: response, request: request.0).jwkEphemeralKey {
-                    self.ephemeralKey = key
-                    request.1(nil)
+        guard let responses = kms.kmsMessages, let response = responses.first else {
+            return
+        }
+        if let request = self.ephemeralKeyRequest {
+            if let key = try? KmsEphemeralKeyResponse(responseMessage: response, request: request.0).jwkEphemeralKey {
+                self.ephemeralKey = key
+                request.1(nil)
+            }
+            else {
+                request.1(MSGError.ephemaralKeyFetchFail)
+            }
+            self.ephemeralKeyRequest = nil
+            return
+        }
+        // A batched retrieve is answered with one KMS message per requested key.
+        for response in responses {
+            guard let key = self.ephemeralKey, let data = try? CjoseWrapper.content(fromCiphertext: response, key: key), let json = try? JSON(data: data) else {
+                continue
+            }
+            if let key = json["key"].object as? [String:Any] {
+                if let jwk = key["jwk"], let uri = key["uri"], let keyMaterial = JSON(jwk).rawString(), let keyUri = JSON(uri).rawString() {
+                    KeyMaterialCache.shared.store(uri: keyUri, material: keyMaterial, expiration: (key["expirationDate"] as? String).flatMap { Date.fromISO860($0) })
+                    self.keyFetcher.resolve(uri: keyUri, material: keyMaterial)
                 }
-                else {
-                    request.1(MSGError.ephemaralKeyFetchFail)
+            }
+            else if let dict = (json["keys"].object as? [[String : Any]])?.first {
+                if let key = try? KmsKey(from: dict), let roomId = self.keysCompletionHandlers.keys.first ,let handlers = self.keysCompletionHandlers.popFirst()?.value  {
+                    self.updateConversationWithKey(key: key, roomId: roomId, handlers: handlers)
                 }
-                self.ephemeralKeyRequest = nil
             }
-            else if let key = self.ephemeralKey, let data = try? CjoseWrapper.content(fromCiphertext: response, key: key), let json = try? JSON(data: data) {
-                if let key = json["key"].object as? [String:Any] {
-                    if let jwk = key["jwk"], let uri = key["uri"], let keyMaterial = JSON(jwk).rawString(), let keyUri = JSON(uri).rawString() {
-                        if var handlers = self.keyMaterialCompletionHandlers[keyUri], handlers.count > 0 {
-                            let handler = handlers.removeFirst()
-                            self.keyMaterialCompletionHandlers[keyUri] = handlers
-                            handler(Result.success((keyUri, keyMaterial)))
-                        }
-                        if let handlers = self.keyMaterialCompletionHandlers[keyUri], handlers.count == 0 {
-                            self.keyMaterialCompletionHandlers[keyUri] = nil
-                        }
+        }
+    }
+    
+    /// Fetches the keys of recently active rooms that are missing from the key material cache or
+    /// about to expire. The key fetcher sends them as a single KMS request.
+    func prefetchKeyMaterials(limit: Int = KeyMaterialCache.prefetchLimit) {
+        let uris = KeyMaterialCache.shared.prefetchCandidates(limit: limit)
+        if uris.count > 0 {
+            SDKLogger.shared.debug("Prefetch \(uris.count) key materials")
+        }
+        uris.forEach { uri in
+            self.keyFetcher.fetch(uri: uri) { result in
+                if let error = result.error {
+                    SDKLogger.shared.error("Failed to prefetch key material", error: error)
+                }
+            }
+        }
+    }
+    
+    /// Sends one KMS request carrying a retrieve message for each of `uris`.
+    /// The keys arrive over the websocket and are dispatched by `handle(kms:)`.
+    private func retrieveKeyMaterials(uris: [String], failed: @escaping (Error) -> Void) {
+        self.prepareEncryptionKey { error in
+            if let error = error {
+                failed(error)
+                return
+            }
+            self.authenticator.accessToken { token in
+                guard let token = token else {
+                    failed(SparkError.noAuth)
+                    return
+                }
+                guard let userId = self.userId, let ephemeralKey = self.ephemeralKey else {
+                    failed(MSGError.ephemaralKeyFetchFail)
+                    return
+                }
+                let messages: [String] = uris.compactMap { uri in
+                    guard let request = try? KmsRequest(requestId: self.uuid, clientId: self.deviceUrl.absoluteString, userId: userId, bearer: token, method: "retrieve", uri: uri),
+                        let serialize = request.serialize() else {
+                        return nil
                     }
+                    return try? CjoseWrapper.ciphertext(fromContent: serialize.data(using: .utf8), key: ephemeralKey)
+                }
+                guard messages.count == uris.count, let last = messages.last else {
+                    failed(MSGError.keyMaterialFetchFail)
+                    return
                 }
-                else if let dict = (json["keys"].object as? [[String : Any]])?.first {
-                    if let key = try? KmsKey(from: dict), let roomId = self.keysCompletionHandlers.keys.first ,let handlers = self.keysCompletionHandlers.popFirst()?.value  {
-                        self.updateConversationWithKey(key: key, roomId: roomId, handlers: handlers)
+                self.keySerialization = last
+                let parameters: [String: Any] = ["kmsMessages": messages, "destination": "unused"]
+                let header: [String: String]  = ["Cisco-Request-ID": self.uuid, "Authorization": "Bearer " + token]
+                Alamofire.request(MessageClientImpl.KMS_MSG_SERVER_URL, method: .post, parameters: parameters, encoding: JSONEncoding.default, headers: header).responseString { response in
+                    SDKLogger.shared.debug("RequestKMS Material Response ============  \(response)")
+                    if response.result.isFailure {
+                        failed(response.result.error ?? MSGError.keyMaterialFetchFail)
                     }
                 }
             }
@@ -423,6 +637,10 @@ class MessageClientImpl {
     }
     
     func requestRoomKeyMaterial(roomId: String, encryptionUrl: String?, completionHandler: @escaping (Result<(String, String)>) -> Void) {
+        if let encryptionUrl = encryptionUrl {
+            self.keyFetcher.fetch(uri: encryptionUrl, completionHandler: completionHandler)
+            return
+        }
         self.prepareEncryptionKey { error in
             if let error = error {
                 completionHandler(Result.failure(error))
@@ -439,39 +657,21 @@ class MessageClientImpl {
                 }
                 let header: [String: String]  = ["Cisco-Request-ID": self.uuid, "Authorization": "Bearer " + token]
                 var parameters: [String: Any]?
-                var failed: () -> Void
-                if let encryptionUrl = encryptionUrl {
-                    if let request = try? KmsRequest(requestId: self.uuid, clientId: self.deviceUrl.absoluteString, userId: userId, bearer: token, method: "retrieve", uri: encryptionUrl),
-                        let serialize = request.serialize(),
-                        let chiperText = try? CjoseWrapper.ciphertext(fromContent: serialize.data(using: .utf8), key: ephemeralKey) {
+                if let request = try? KmsRequest(requestId: self.uuid, clientId: self.deviceUrl.absoluteString, userId: userId, bearer: token, method: "create", uri: "/keys") {
+                    request.additionalAttributes = ["count": 1]
+                    if let serialize = request.serialize(), let chiperText = try? CjoseWrapper.ciphertext(fromContent: serialize.data(using: .utf8), key: ephemeralKey) {
                         self.keySerialization = chiperText
-                        parameters = ["kmsMessages": [chiperText], "destination": "unused" ] as [String : Any]
-                        var handlers: [(Result<(String, String)>) -> Void] = self.keyMaterialCompletionHandlers[encryptionUrl] ?? []
+                        parameters = ["kmsMessages": [chiperText], "destination": "unused" ] as [String: Any]
+                        var handlers: [(Result<(String, String)>) -> Void] = self.keysCompletionHandlers[roomId] ?? []
                         handlers.append(completionHandler)
-                        self.keyMaterialCompletionHandlers[encryptionUrl] = handlers
-                    }
-                    failed = {
-                        self.keyMaterialCompletionHandlers[encryptionUrl]?.forEach { $0(Result.failure(MSGError.keyMaterialFetchFail)) }
-                        self.keyMaterialCompletionHandlers[encryptionUrl] = nil
+                        self.keysCompletionHandlers[roomId] = handlers
                     }
                 }
-                else {
-                    if let request = try? KmsRequest(requestId: self.uuid, clientId: self.deviceUrl.absoluteString, userId: userId, bearer: token, method: "create", uri: "/keys") {
-                        request.additionalAttributes = ["count": 1]
-                        if let serialize = request.serialize(), let chiperText = try? CjoseWrapper.ciphertext(fromContent: serialize.data(using: .utf8), key: ephemeralKey) {
-                            self.keySerialization = chiperText
-                            parameters = ["kmsMessages": [chiperText], "destination": "unused" ] as [String: Any]
-                            var handlers: [(Result<(String, String)>) -> Void] = self.keysCompletionHandlers[roomId] ?? []
-                            handlers.append(completionHandler)
-                            self.keysCompletionHandlers[roomId] = handlers
-                        }
-                    }
-                    failed = {
-                        self.keysCompletionHandlers[roomId]?.forEach { $0(Result.failure(MSGError.keyMaterialFetchFail)) }
-                        self.keysCompletionHandlers[roomId] = nil
-                    }
+                let failed = {
+                    self.keysCompletionHandlers[roomId]?.forEach { $0(Result.failure(MSGError.keyMaterialFetchFail)) }
+                    self.keysCompletionHandlers[roomId] = nil
                 }
-                if let parameters = parameters, parameters.count >= 2 {
+                if let parameters = parameters {
                     Alamofire.request(MessageClientImpl.KMS_MSG_SERVER_URL, method: .post, parameters: parameters, encoding: JSONEncoding.default, headers: header).responseString { (response) in
                         SDKLogger.shared.debug("RequestKMS Material Response ============  \(response)")
                         if response.result.isFailure {
@@ -480,7 +680,7 @@ class MessageClientImpl {
                     }
                 }
                 else {
-                    failed()
+                    completionHandler(Result.failure(MSGError.keyMaterialFetchFail))
                 }
             }
         }
@@ -528,6 +728,8 @@ class MessageClientImpl {
         request.responseJSON { (response: ServiceResponse<Any>) in
             if let usersDict = response.result.data as? [String: Any], let userId = usersDict["id"] as? String {
                 self.userId = userId
+                KeyMaterialCache.shared.claim(owner: userId)
+                self.store.claim(owner: userId)
                 completionHandler(nil)
             }
             else {
@@ -618,6 +820,7 @@ class MessageClientImpl {
                     request.responseJSON { (response: ServiceResponse<Any>) in
                         switch response.result {
                         case .success(_):
+                            KeyMaterialCache.shared.store(uri: key.uri, material: key.jwk, expiration: Date.fromISO860(key.expirationDate))
                             handlers.forEach { $0(Result.success((key.uri, key.jwk))) }
                         case .failure(let error):
                             handlers.forEach { $0(Result.failure(error)) }
@@ -0,0 +1,371 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import Security
+import KeychainAccess
+import ObjectMapper
+
+/// On-disk store of the decrypted messages of each room, shared by every `MessageClientImpl`.
+///
+/// A room keeps its newest messages in created order, along with the time range they are known
+/// to be complete for: from `coveredFrom` (or the start of the room, once `complete`) up to
+/// `syncedUntil`. A listing then only has to fetch what was posted after `syncedUntil`, and pages
+/// older than `coveredFrom` if it asks for more than is stored. Each room is persisted to its own
+/// file, sealed with AES-256-GCM under a random key kept in the keychain, and loaded on first use.
+///
+/// - note: for internal use only.
+class MessageStore {
+    
+    struct Room {
+        /// Posts and shares, oldest first.
+        fileprivate(set) var activities = [ActivityModel]()
+        fileprivate(set) var coveredFrom: Date?
+        fileprivate(set) var syncedUntil: Date?
+        /// Whether `activities` reaches back to the first message of the room.
+        fileprivate(set) var complete = false
+        fileprivate var lastUsed = Date()
+        
+        /// Returns whether the stored range holds every message created before `date`, down to `coveredFrom`.
+        func covers(_ date: Date) -> Bool {
+            guard let from = self.coveredFrom, let until = self.syncedUntil else {
+                return false
+            }
+            return date <= until && (self.complete || date >= from)
+        }
+    }
+    
+    /// Messages kept per room; older ones are dropped and fetched again if asked for.
+    static let defaultCapacity = 1000
+    
+    /// Rooms kept in memory at once.
+    static let loadedLimit = 32
+    
+    /// How far before a listing request `syncedUntil` is set, so messages the service had not made
+    /// visible yet when it answered are picked up by the next sync.
+    static let syncMargin: TimeInterval = 5
+    
+    static let shared = MessageStore(keychain: Keychain(service: "\(Bundle.main.bundleIdentifier ?? "").sparksdk.messages"),
+                                     directory: MessageStore.defaultDirectory)
+    
+    private static let sealingKeyName = "messageStoreKey"
+    
+    private static let ownerFile = "owner"
+    
+    private static let saveDelay: TimeInterval = 1
+    
+    let capacity: Int
+    
+    private let keychain: KeychainProtocol
+    private let directory: URL?
+    private let io = DispatchQueue(label: "com.ciscospark.sdk.MessageStore")
+    private var rooms = [String: Room]()
+    private var dirty = Set<String>()
+    private var owner: String?
+    private var saveScheduled = false
+    
+    init(keychain: KeychainProtocol, directory: URL?, capacity: Int = MessageStore.defaultCapacity) {
+        self.keychain = keychain
+        self.directory = directory
+        self.capacity = capacity
+        if let directory = directory, let data = try? Data(contentsOf: directory.appendingPathComponent(MessageStore.ownerFile)) {
+            self.owner = String(data: data, encoding: .utf8)
+        }
+    }
+    
+    func room(_ roomId: String) -> Room? {
+        var room: Room?
+        synchronized(lock: self) {
+            room = self.load(roomId)
+        }
+        return room
+    }
+    
+    /// Returns up to `max` stored messages of the room created before `before`, newest first.
+    func activities(roomId: String, before: Date?, max: Int) -> [ActivityModel] {
+        var result = [ActivityModel]()
+        synchronized(lock: self) {
+            guard let activities = self.load(roomId)?.activities else {
+                return
+            }
+            var end = activities.count
+            if let before = before {
+                end = MessageStore.index(in: activities, before: before)
+            }
+            result = activities[Swift.max(0, end - max)..<end].reversed()
+        }
+        return result
+    }
+    
+    /// Returns when the stored message with `messageId` was created.
+    func created(roomId: String, messageId: String) -> Date? {
+        var created: Date?
+        synchronized(lock: self) {
+            created = self.load(roomId)?.activities.first { $0.id == messageId }?.created
+        }
+        return created
+    }
+    
+    /// Adds activities fetched from the service that are known to be every activity of the room
+    /// created between `from` and `until`. If that range doesn't touch the stored one, the stored
+    /// messages are dropped instead of leaving a gap. Deletes remove the messages they act on.
+    func merge(roomId: String, activities: [ActivityModel], from: Date, until: Date, complete: Bool) {
+        synchronized(lock: self) {
+            var room = self.load(roomId) ?? Room()
+            if let coveredFrom = room.coveredFrom, let syncedUntil = room.syncedUntil, from > syncedUntil || (until < coveredFrom && !room.complete) {
+                room = Room()
+            }
+            room.coveredFrom = min(room.coveredFrom ?? from, from)
+            room.syncedUntil = max(room.syncedUntil ?? until, until)
+            room.complete = room.complete || complete
+            self.apply(activities, to: &room)
+            self.rooms[roomId] = room
+            self.markDirty(roomId)
+        }
+    }
+    
+    /// Adds an activity received as it happened. The synced range is left alone, since events
+    /// missed while disconnected can only be told apart by the next sync.
+    func append(roomId: String, activity: ActivityModel) {
+        synchronized(lock: self) {
+            guard var room = self.load(roomId), let created = activity.created, created >= (room.coveredFrom ?? Date.distantFuture) || room.complete else {
+                return
+            }
+            self.apply([activity], to: &room)
+            self.rooms[roomId] = room
+            self.markDirty(roomId)
+        }
+    }
+    
+    /// Ties the store to the authenticated user, dropping everything stored for anyone else.
+    func claim(owner: String) {
+        var changed = false
+        synchronized(lock: self) {
+            if self.owner == owner {
+                return
+            }
+            if self.owner != nil {
+                SDKLogger.shared.info("Message store belongs to another user, clearing")
+                self.rooms.removeAll()
+                self.dirty.removeAll()
+            }
+            self.owner = owner
+            changed = true
+        }
+        // Synchronously, so rooms of the previous owner can't be loaded back from disk afterwards.
+        if changed {
+            self.io.sync {
+                guard let directory = self.directory else {
+                    return
+                }
+                try? FileManager.default.removeItem(at: directory)
+                try? FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true, attributes: nil)
+                try? Data(owner.utf8).write(to: directory.appendingPathComponent(MessageStore.ownerFile), options: .atomic)
+            }
+        }
+    }
+    
+    func removeAll() {
+        synchronized(lock: self) {
+            self.rooms.removeAll()
+            self.dirty.removeAll()
+            self.owner = nil
+        }
+        self.io.sync {
+            if let directory = self.directory {
+                try? FileManager.default.removeItem(at: directory)
+            }
+            try? self.keychain.remove(MessageStore.sealingKeyName)
+        }
+    }
+    
+    /// Blocks until pending writes reached the disk.
+    func flush() {
+        self.io.sync {
+            self.save()
+        }
+    }
+    
+    // Must be called with the lock held.
+    private func apply(_ activities: [ActivityModel], to room: inout Room) {
+        var byId = [String: ActivityModel]()
+        room.activities.forEach { byId[$0.id ?? ""] = $0 }
+        for activity in activities {
+            guard let id = activity.id, activity.created != nil else {
+                continue
+            }
+            switch activity.kind {
+            case .post?, .share?:
+                byId[id] = activity
+            case .delete?:
+                if let objectId = activity.objectId {
+                    byId[objectId] = nil
+                }
+            default:
+                break
+            }
+        }
+        room.activities = byId.values.sorted { ($0.created ?? Date.distantPast) < ($1.created ?? Date.distantPast) }
+        if room.activities.count > self.capacity {
+            room.activities.removeFirst(room.activities.count - self.capacity)
+            room.coveredFrom = room.activities.first?.created
+            room.complete = false
+        }
+        room.lastUsed = Date()
+    }
+    
+    // Must be called with the lock held.
+    private func load(_ roomId: String) -> Room? {
+        if var room = self.rooms[roomId] {
+            room.lastUsed = Date()
+            self.rooms[roomId] = room
+            return room
+        }
+        guard let url = self.url(roomId), let sealed = try? Data(contentsOf: url) else {
+            return nil
+        }
+        do {
+            guard let key = self.sealingKey(create: false) else {
+                throw SparkError.illegalStatus(reason: "No sealing key")
+            }
+            guard let json = try JSONSerialization.jsonObject(with: KeyMaterialCache.open(sealed, key: key), options: []) as? [String: Any] else {
+                throw SparkError.illegalStatus(reason: "Malformed message store")
+            }
+            var room = Room()
+            room.activities = (json["activities"] as? [[String: Any]] ?? []).compactMap { try? ActivityModel(JSON: $0) }
+            room.coveredFrom = (json["coveredFrom"] as? TimeInterval).map { Date(timeIntervalSince1970: $0) }
+            room.syncedUntil = (json["syncedUntil"] as? TimeInterval).map { Date(timeIntervalSince1970: $0) }
+            room.complete = json["complete"] as? Bool ?? false
+            self.rooms[roomId] = room
+            self.evict()
+            return room
+        }
+        catch let error {
+            SDKLogger.shared.error("Discarding unreadable message store of a room", error: error)
+            try? FileManager.default.removeItem(at: url)
+            return nil
+        }
+    }
+    
+    // Must be called with the lock held. Unloads the least recently used rooms already on disk.
+    private func evict() {
+        while self.rooms.count > MessageStore.loadedLimit, let victim = self.rooms.filter({ !self.dirty.contains($0.key) }).min(by: { $0.value.lastUsed < $1.value.lastUsed }) {
+            self.rooms[victim.key] = nil
+        }
+    }
+    
+    // MARK: Persistence
+    
+    private static var defaultDirectory: URL? {
+        return FileManager.default.urls(for: .applicationSupportDirectory, in: .userDomainMask).first?.appendingPathComponent("com.ciscospark.sdk/messages")
+    }
+    
+    private func url(_ roomId: String) -> URL? {
+        return self.directory?.appendingPathComponent(roomId.locusFormat + ".store")
+    }
+    
+    // Must be called with the lock held.
+    private func markDirty(_ roomId: String) {
+        guard self.directory != nil else {
+            return
+        }
+        self.dirty.insert(roomId)
+        if !self.saveScheduled {
+            self.saveScheduled = true
+            self.io.asyncAfter(deadline: .now() + MessageStore.saveDelay) {
+                self.save()
+            }
+        }
+    }
+    
+    private func save() {
+        var rooms = [String: Room]()
+        synchronized(lock: self) {
+            self.saveScheduled = false
+            for roomId in self.dirty {
+                rooms[roomId] = self.rooms[roomId]
+            }
+            self.dirty.removeAll()
+            self.evict()
+        }
+        guard !rooms.isEmpty, let directory = self.directory else {
+            return
+        }
+        do {
+            guard let key = self.sealingKey(create: true) else {
+                throw SparkError.illegalStatus(reason: "No sealing key")
+            }
+            try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true, attributes: nil)
+            for (roomId, room) in rooms {
+                var json: [String: Any] = ["activities": room.activities.map { $0.serviceJSON }, "complete": room.complete]
+                json["coveredFrom"] = room.coveredFrom?.timeIntervalSince1970
+                json["syncedUntil"] = room.syncedUntil?.timeIntervalSince1970
+                let sealed = try KeyMaterialCache.seal(JSONSerialization.data(withJSONObject: json, options: []), key: key)
+                if let url = self.url(roomId) {
+                    try sealed.write(to: url, options: [.atomic, .completeFileProtectionUntilFirstUserAuthentication])
+                }
+            }
+        }
+        catch let error {
+            SDKLogger.shared.error("Failed to save message store", error: error)
+        }
+    }
+    
+    private func sealingKey(create: Bool) -> Data? {
+        if let value = (try? self.keychain.get(MessageStore.sealingKeyName)) ?? nil, let key = Data(base64Encoded: value), key.count == 32 {
+            return key
+        }
+        guard create else {
+            return nil
+        }
+        var key = Data(count: 32)
+        let status = key.withUnsafeMutableBytes { (bytes: UnsafeMutablePointer<UInt8>) in
+            SecRandomCopyBytes(kSecRandomDefault, 32, bytes)
+        }
+        guard status == errSecSuccess else {
+            return nil
+        }
+        do {
+            try self.keychain.set(key.base64EncodedString(), key: MessageStore.sealingKeyName)
+            return key
+        }
+        catch let error {
+            SDKLogger.shared.error("Failed to store message store key", error: error)
+            return nil
+        }
+    }
+    
+    /// The index of the first activity created at or after `date`.
+    private static func index(in activities: [ActivityModel], before date: Date) -> Int {
+        var low = 0
+        var high = activities.count
+        while low < high {
+            let middle = (low + high) / 2
+            if (activities[middle].created ?? Date.distantPast) < date {
+                low = middle + 1
+            }
+            else {
+                high = middle
+            }
+        }
+        return low
+    }
+}
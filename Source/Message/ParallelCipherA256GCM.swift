@@ -0,0 +1,484 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+
+/// AES-256-GCM cipher with the same contract as `CipherA256GCM`, but splitting large buffers
+/// into chunks that are enciphered and authenticated on all cores.
+///
+/// The CTR keystream comes from CommonCrypto (which uses the AES instructions of the CPU),
+/// so every chunk can start at its own counter block. GHASH is linear, so each chunk hashes
+/// its blocks from zero and the partial results are folded together in order with
+/// `acc * H^n + Y`. Callers may pass buffers of any length; alignment to 16-byte blocks is
+/// tracked across calls.
+///
+/// - note: for internal use only.
+class ParallelCipherA256GCM {
+
+    enum Mode {
+        case encrypt
+        case decrypt
+    }
+
+    /// The running GHASH state. Together with the SCR it is enough to pick up a cipher where a
+    /// previous one stopped, e.g. when resuming a download.
+    struct State: Codable {
+        let accumulator: [String]
+        let pending: Data
+        let processed: UInt64
+    }
+
+    /// Everything derived from the AES key alone: the key schedule input and the GHASH tables
+    /// for H. Building it costs an AES call and a table setup, so callers that run many short
+    /// messages under one key (e.g. JWE fields of a room) prepare it once and share it.
+    struct PreparedKey {
+        let key: [UInt8]
+        let h: GF128
+        let table: GHashTable
+
+        init(key: Data) throws {
+            guard key.count == 32 else {
+                throw SparkError.illegalOperation(reason: "A256GCM requires a 256-bit key")
+            }
+            self.key = [UInt8](key)
+            self.h = try GF128(bytes: ParallelCipherA256GCM.encryptBlock([UInt8](repeating: 0, count: 16), key: self.key))
+            self.table = GHashTable(h: self.h)
+        }
+    }
+
+    /// Bytes handed to one worker. A multiple of the AES block size.
+    static let chunkSize = 256 * 1024
+
+    let blockSize = 16
+
+    let mode: Mode
+
+    private(set) var tag: Data?
+
+    private let key: [UInt8]
+    private let j0: [UInt8]
+    private let h: GF128
+    private let table: GHashTable
+    private let aadLength: UInt64
+    private let expectedTag: Data?
+    private var scr: SecureContentReference?
+
+    private var accumulator = GF128.zero
+    private var pending = [UInt8]()
+    private var processed: UInt64 = 0
+    private var finalized = false
+
+    /// Mirrors `CipherA256GCM(secureContentReference:)`: a SCR that carries a MAC tag puts
+    /// the cipher in decrypt mode, otherwise it encrypts and provisions the tag on finalize.
+    convenience init(scr: SecureContentReference) throws {
+        let aad = scr.aad?.data(using: .utf8) ?? Data()
+        try self.init(key: scr.key, iv: scr.iv, aad: aad, tag: scr.tag)
+        self.scr = scr
+    }
+
+    convenience init(key: Data, iv: Data, aad: Data, tag: Data? = nil) throws {
+        try self.init(prepared: PreparedKey(key: key), iv: iv, aad: aad, tag: tag)
+    }
+
+    init(prepared: PreparedKey, iv: Data, aad: Data, tag: Data? = nil) throws {
+        guard iv.count == 12 else {
+            throw SparkError.illegalOperation(reason: "A256GCM requires a 96-bit iv")
+        }
+        self.key = prepared.key
+        self.j0 = [UInt8](iv) + [0, 0, 0, 1]
+        if let tag = tag, tag.count > 0 {
+            self.mode = .decrypt
+            self.expectedTag = tag
+        }
+        else {
+            self.mode = .encrypt
+            self.expectedTag = nil
+        }
+        self.h = prepared.h
+        self.table = prepared.table
+        self.aadLength = UInt64(aad.count)
+        [UInt8](aad).withUnsafeBufferPointer { buffer in
+            self.absorb(buffer.baseAddress, count: buffer.count)
+        }
+        if self.pending.count > 0 {
+            self.absorbPendingPadded()
+        }
+    }
+
+    /// Encrypts `length` bytes from `rbuf` into `wbuf`, which may be the same buffer.
+    ///
+    /// - returns: the number of bytes encrypted.
+    func encryptBytes(_ rbuf: UnsafePointer<UInt8>, toBuffer wbuf: UnsafeMutablePointer<UInt8>, withLength length: Int) throws -> Int {
+        guard self.mode == .encrypt else {
+            throw SparkError.illegalStatus(reason: "Cipher is in decrypt mode")
+        }
+        try self.process(rbuf, wbuf, length)
+        return length
+    }
+
+    /// Decrypts `length` bytes from `rbuf` into `wbuf`, which may be the same buffer.
+    ///
+    /// - returns: the number of bytes decrypted.
+    func decryptBytes(_ rbuf: UnsafePointer<UInt8>, toBuffer wbuf: UnsafeMutablePointer<UInt8>, withLength length: Int) throws -> Int {
+        guard self.mode == .decrypt else {
+            throw SparkError.illegalStatus(reason: "Cipher is in encrypt mode")
+        }
+        try self.process(rbuf, wbuf, length)
+        return length
+    }
+
+    /// Computes the GCM tag. In encrypt mode the tag is provisioned on the SCR the cipher was
+    /// created from, in decrypt mode it is checked against the tag given by the SCR.
+    func finalize() throws {
+        guard !self.finalized else {
+            throw SparkError.illegalStatus(reason: "Cipher already finalized")
+        }
+        self.finalized = true
+        if self.pending.count > 0 {
+            self.absorbPendingPadded()
+        }
+        self.accumulator = self.table.multiply(self.accumulator ^ GF128(hi: self.aadLength &* 8, lo: self.processed &* 8))
+        let mask = try GF128(bytes: ParallelCipherA256GCM.encryptBlock(self.j0, key: self.key))
+        let tag = Data((self.accumulator ^ mask).bytes)
+        self.tag = tag
+        switch self.mode {
+        case .encrypt:
+            self.scr?.tag = tag
+        case .decrypt:
+            // A truncated tag would authenticate next to nothing, so only the full 16 bytes are accepted.
+            guard let expected = self.expectedTag, expected.count == tag.count else {
+                throw SparkError.illegalStatus(reason: "GCM tag mismatch")
+            }
+            var diff: UInt8 = 0
+            for (a, b) in zip(expected, tag) {
+                diff |= a ^ b
+            }
+            if diff != 0 {
+                throw SparkError.illegalStatus(reason: "GCM tag mismatch")
+            }
+        }
+    }
+
+    var state: State {
+        return State(accumulator: [String(self.accumulator.hi, radix: 16), String(self.accumulator.lo, radix: 16)], pending: Data(self.pending), processed: self.processed)
+    }
+
+    /// Restores the state saved from a cipher over the same SCR. Only allowed before any content
+    /// has been processed.
+    func resume(from state: State) throws {
+        guard self.processed == 0, !self.finalized, state.accumulator.count == 2, state.pending.count == Int(state.processed % 16),
+            let hi = UInt64(state.accumulator[0], radix: 16), let lo = UInt64(state.accumulator[1], radix: 16) else {
+            throw SparkError.illegalStatus(reason: "Cannot resume cipher")
+        }
+        self.accumulator = GF128(hi: hi, lo: lo)
+        self.pending = [UInt8](state.pending)
+        self.processed = state.processed
+    }
+
+    // MARK: Chunking
+
+    private func process(_ input: UnsafePointer<UInt8>, _ output: UnsafeMutablePointer<UInt8>, _ length: Int) throws {
+        guard !self.finalized else {
+            throw SparkError.illegalStatus(reason: "Cipher already finalized")
+        }
+        guard length > 0 else {
+            return
+        }
+        // The 32-bit GCM counter must not wrap, which bounds a message to 2^32 - 2 blocks.
+        guard (self.processed + UInt64(length) + 15) / 16 < UInt64(UInt32.max) - 1 else {
+            throw SparkError.illegalOperation(reason: "A256GCM content too large")
+        }
+        let encrypting = self.mode == .encrypt
+
+        // Head: finish the partial block left over from the previous call.
+        let head = min(length, (16 - Int(self.processed % 16)) % 16)
+        if head > 0 {
+            if !encrypting {
+                self.absorb(input, count: head)
+            }
+            try self.crypt(input, output, head, at: self.processed)
+            if encrypting {
+                self.absorb(UnsafePointer(output), count: head)
+            }
+        }
+
+        // Body: whole blocks, fanned out to workers chunk by chunk.
+        let body = (length - head) / 16 * 16
+        if body > 0 {
+            let start = self.processed + UInt64(head)
+            let chunkSize = ParallelCipherA256GCM.chunkSize
+            let count = (body + chunkSize - 1) / chunkSize
+            var partials = [GF128](repeating: GF128.zero, count: count)
+            var failure: Error?
+            let lock = NSLock()
+            let work: (Int) -> Void = { index in
+                let offset = head + index * chunkSize
+                let size = min(chunkSize, head + body - offset)
+                do {
+                    var y = GF128.zero
+                    if !encrypting {
+                        y = self.table.hash(input + offset, count: size)
+                    }
+                    try self.crypt(input + offset, output + offset, size, at: start + UInt64(offset - head))
+                    if encrypting {
+                        y = self.table.hash(UnsafePointer(output + offset), count: size)
+                    }
+                    lock.lock()
+                    partials[index] = y
+                    lock.unlock()
+                }
+                catch {
+                    lock.lock()
+                    failure = error
+                    lock.unlock()
+                }
+            }
+            if count > 1 {
+                DispatchQueue.concurrentPerform(iterations: count, execute: work)
+            }
+            else {
+                work(0)
+            }
+            if let error = failure {
+                throw error
+            }
+            for index in 0..<count {
+                let size = min(chunkSize, body - index * chunkSize)
+                self.accumulator = (self.accumulator * self.h.power(UInt64(size / 16))) ^ partials[index]
+            }
+        }
+
+        // Tail: the trailing partial block waits for the next call or for finalize.
+        let tail = length - head - body
+        if tail > 0 {
+            let offset = head + body
+            if !encrypting {
+                self.absorb(input + offset, count: tail)
+            }
+            try self.crypt(input + offset, output + offset, tail, at: self.processed + UInt64(offset))
+            if encrypting {
+                self.absorb(UnsafePointer(output + offset), count: tail)
+            }
+        }
+        self.processed += UInt64(length)
+    }
+
+    /// XORs the keystream for absolute content offset `offset` onto `length` bytes.
+    private func crypt(_ input: UnsafePointer<UInt8>, _ output: UnsafeMutablePointer<UInt8>, _ length: Int, at offset: UInt64) throws {
+        var counter = self.j0
+        let block = UInt32(truncatingIfNeeded: offset / 16 + 2)
+        counter[12] = UInt8(truncatingIfNeeded: block >> 24)
+        counter[13] = UInt8(truncatingIfNeeded: block >> 16)
+        counter[14] = UInt8(truncatingIfNeeded: block >> 8)
+        counter[15] = UInt8(truncatingIfNeeded: block)
+        var cryptor: CCCryptorRef?
+        var status = CCCryptorCreateWithMode(CCOperation(kCCEncrypt), CCMode(kCCModeCTR), CCAlgorithm(kCCAlgorithmAES), CCPadding(ccNoPadding), counter, self.key, self.key.count, nil, 0, 0, CCModeOptions(kCCModeOptionCTR_BE), &cryptor)
+        guard status == CCCryptorStatus(kCCSuccess), let ref = cryptor else {
+            throw SparkError.illegalStatus(reason: "AES-CTR setup failed \(status)")
+        }
+        defer {
+            CCCryptorRelease(ref)
+        }
+        var moved = 0
+        let skip = Int(offset % 16)
+        if skip > 0 {
+            let zeros = [UInt8](repeating: 0, count: 16)
+            var scratch = [UInt8](repeating: 0, count: 16)
+            status = CCCryptorUpdate(ref, zeros, skip, &scratch, scratch.count, &moved)
+        }
+        if status == CCCryptorStatus(kCCSuccess) {
+            status = CCCryptorUpdate(ref, input, length, output, length, &moved)
+        }
+        guard status == CCCryptorStatus(kCCSuccess) else {
+            throw SparkError.illegalStatus(reason: "AES-CTR failed \(status)")
+        }
+    }
+
+    /// Feeds bytes through GHASH, keeping any incomplete block in `pending`.
+    private func absorb(_ bytes: UnsafePointer<UInt8>?, count: Int) {
+        guard let bytes = bytes else {
+            return
+        }
+        for i in 0..<count {
+            self.pending.append(bytes[i])
+            if self.pending.count == 16 {
+                self.accumulator = self.table.multiply(self.accumulator ^ GF128(bytes: self.pending))
+                self.pending.removeAll(keepingCapacity: true)
+            }
+        }
+    }
+
+    private func absorbPendingPadded() {
+        self.pending += [UInt8](repeating: 0, count: 16 - self.pending.count)
+        self.accumulator = self.table.multiply(self.accumulator ^ GF128(bytes: self.pending))
+        self.pending.removeAll(keepingCapacity: true)
+    }
+
+    fileprivate static func encryptBlock(_ block: [UInt8], key: [UInt8]) throws -> [UInt8] {
+        var out = [UInt8](repeating: 0, count: 16)
+        var moved = 0
+        let status = CCCrypt(CCOperation(kCCEncrypt), CCAlgorithm(kCCAlgorithmAES), CCOptions(kCCOptionECBMode), key, key.count, nil, block, block.count, &out, out.count, &moved)
+        guard status == CCCryptorStatus(kCCSuccess) else {
+            throw SparkError.illegalStatus(reason: "AES-ECB failed \(status)")
+        }
+        return out
+    }
+}
+
+/// An element of GF(2^128) in the bit order used by GCM: `hi` holds the first eight bytes.
+struct GF128 {
+
+    static let zero = GF128(hi: 0, lo: 0)
+    static let one = GF128(hi: 0x8000000000000000, lo: 0)
+
+    var hi: UInt64
+    var lo: UInt64
+
+    init(hi: UInt64, lo: UInt64) {
+        self.hi = hi
+        self.lo = lo
+    }
+
+    init(bytes: [UInt8]) {
+        self.hi = bytes[0..<8].reduce(0) { ($0 << 8) | UInt64($1) }
+        self.lo = bytes[8..<16].reduce(0) { ($0 << 8) | UInt64($1) }
+    }
+
+    init(pointer: UnsafePointer<UInt8>) {
+        var hi: UInt64 = 0
+        var lo: UInt64 = 0
+        memcpy(&hi, pointer, 8)
+        memcpy(&lo, pointer + 8, 8)
+        self.hi = UInt64(bigEndian: hi)
+        self.lo = UInt64(bigEndian: lo)
+    }
+
+    var bytes: [UInt8] {
+        return (0..<16).map { i in
+            UInt8(truncatingIfNeeded: (i < 8 ? self.hi : self.lo) >> UInt64(56 - 8 * (i % 8)))
+        }
+    }
+
+    static func ^ (a: GF128, b: GF128) -> GF128 {
+        return GF128(hi: a.hi ^ b.hi, lo: a.lo ^ b.lo)
+    }
+
+    /// Bitwise multiplication. Only used to fold chunk results, never per block.
+    static func * (x: GF128, y: GF128) -> GF128 {
+        var z = GF128.zero
+        var v = y
+        for i in 0..<128 {
+            let bit = i < 64 ? (x.hi >> UInt64(63 - i)) & 1 : (x.lo >> UInt64(127 - i)) & 1
+            if bit == 1 {
+                z = z ^ v
+            }
+            let lsb = v.lo & 1
+            v.lo = (v.lo >> 1) | (v.hi << 63)
+            v.hi = v.hi >> 1
+            if lsb == 1 {
+                v.hi ^= 0xE100000000000000
+            }
+        }
+        return z
+    }
+
+    func power(_ n: UInt64) -> GF128 {
+        var result = GF128.one
+        var base = self
+        var n = n
+        while n > 0 {
+            if n & 1 == 1 {
+                result = result * base
+            }
+            base = base * base
+            n >>= 1
+        }
+        return result
+    }
+}
+
+/// Shoup's 4-bit table for multiplying by a fixed H.
+struct GHashTable {
+
+    private static let last4: [UInt64] = [0x0000, 0x1c20, 0x3840, 0x2460, 0x7080, 0x6ca0, 0x48c0, 0x54e0,
+                                          0xe100, 0xfd20, 0xd940, 0xc560, 0x9180, 0x8da0, 0xa9c0, 0xb5e0]
+
+    private var hh = [UInt64](repeating: 0, count: 16)
+    private var hl = [UInt64](repeating: 0, count: 16)
+
+    init(h: GF128) {
+        var vh = h.hi
+        var vl = h.lo
+        self.hh[8] = vh
+        self.hl[8] = vl
+        var i = 4
+        while i > 0 {
+            let t = (vl & 1) * 0xe1000000
+            vl = (vh << 63) | (vl >> 1)
+            vh = (vh >> 1) ^ (t << 32)
+            self.hh[i] = vh
+            self.hl[i] = vl
+            i >>= 1
+        }
+        i = 2
+        while i <= 8 {
+            vh = self.hh[i]
+            vl = self.hl[i]
+            for j in 1..<i {
+                self.hh[i + j] = vh ^ self.hh[j]
+                self.hl[i + j] = vl ^ self.hl[j]
+            }
+            i *= 2
+        }
+    }
+
+    func multiply(_ x: GF128) -> GF128 {
+        let last4 = GHashTable.last4
+        var zh = self.hh[Int(x.lo & 0xf)]
+        var zl = self.hl[Int(x.lo & 0xf)]
+        for i in stride(from: 15, through: 0, by: -1) {
+            let byte = i < 8 ? x.hi >> UInt64(56 - 8 * i) : x.lo >> UInt64(56 - 8 * (i - 8))
+            let lo = Int(byte & 0xf)
+            let hi = Int((byte >> 4) & 0xf)
+            if i != 15 {
+                let rem = Int(zl & 0xf)
+                zl = (zh << 60) | (zl >> 4)
+                zh = (zh >> 4) ^ (last4[rem] << 48) ^ self.hh[lo]
+                zl ^= self.hl[lo]
+            }
+            let rem = Int(zl & 0xf)
+            zl = (zh << 60) | (zl >> 4)
+            zh = (zh >> 4) ^ (last4[rem] << 48) ^ self.hh[hi]
+            zl ^= self.hl[hi]
+        }
+        return GF128(hi: zh, lo: zl)
+    }
+
+    /// GHASH of `count` bytes (a multiple of 16) starting from a zero state.
+    func hash(_ bytes: UnsafePointer<UInt8>, count: Int) -> GF128 {
+        var y = GF128.zero
+        var offset = 0
+        while offset < count {
+            y = self.multiply(y ^ GF128(pointer: bytes + offset))
+            offset += 16
+        }
+        return y
+    }
+}
@@ -0,0 +1,313 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+
+/// Streaming replacement for `SecureInputStream` when the cleartext is a local file.
+///
+/// The file is memory mapped (or, if mapping fails, read in large page-aligned blocks), and a
+/// background producer encrypts it with `ParallelCipherA256GCM` into a fixed ring of buffers
+/// ahead of the consumer. `read(_:maxLength:)` only copies already encrypted bytes out of the
+/// ring, so the upload socket is never waiting on the cipher. The GCM tag is provisioned on the
+/// SCR before the stream reports its end.
+///
+/// - note: for internal use only.
+class StreamingSecureInputStream: InputStream {
+
+    struct Statistics {
+        var chunks: Int = 0
+        var bytes: UInt64 = 0
+        var reads: Int = 0
+        var stalls: Int = 0
+        var readLatency: TimeInterval = 0
+        var maxReadLatency: TimeInterval = 0
+        var encryptTime: TimeInterval = 0
+        var producerCPUTime: TimeInterval = 0
+    }
+
+    static let bufferSize = 1024 * 1024
+
+    static let ringCapacity = 4
+
+    private(set) var statistics = Statistics()
+
+    private let path: String
+    private let cipher: ParallelCipherA256GCM
+    private let condition = NSCondition()
+    private let slots: [UnsafeMutablePointer<UInt8>]
+    private var lengths: [Int]
+    private var head = 0
+    private var count = 0
+    private var offset = 0
+    private var produced = false
+    private var closed = false
+    private var status: Stream.Status = .notOpen
+    private var error: Error?
+    private weak var streamDelegate: StreamDelegate?
+
+    init(path: String, scr: SecureContentReference) throws {
+        self.path = path
+        self.cipher = try ParallelCipherA256GCM(scr: scr)
+        self.slots = (0..<StreamingSecureInputStream.ringCapacity).map { _ in
+            UnsafeMutablePointer<UInt8>.allocate(capacity: StreamingSecureInputStream.bufferSize)
+        }
+        self.lengths = [Int](repeating: 0, count: StreamingSecureInputStream.ringCapacity)
+        super.init(data: Data())
+    }
+
+    deinit {
+        self.slots.forEach { $0.deallocate() }
+    }
+
+    override var delegate: StreamDelegate? {
+        get {
+            return self.streamDelegate
+        }
+        set {
+            self.streamDelegate = newValue
+        }
+    }
+
+    override var streamStatus: Stream.Status {
+        self.condition.lock()
+        defer {
+            self.condition.unlock()
+        }
+        return self.status
+    }
+
+    override var streamError: Error? {
+        self.condition.lock()
+        defer {
+            self.condition.unlock()
+        }
+        return self.error
+    }
+
+    override var hasBytesAvailable: Bool {
+        self.condition.lock()
+        defer {
+            self.condition.unlock()
+        }
+        return self.status == .open || self.status == .reading
+    }
+
+    override func open() {
+        self.condition.lock()
+        guard self.status == .notOpen else {
+            self.condition.unlock()
+            return
+        }
+        self.status = .open
+        self.condition.unlock()
+        DispatchQueue.global(qos: .utility).async {
+            self.produce()
+        }
+    }
+
+    override func close() {
+        self.condition.lock()
+        self.closed = true
+        self.status = .closed
+        self.condition.broadcast()
+        let statistics = self.statistics
+        self.condition.unlock()
+        if statistics.reads > 0 {
+            SDKLogger.shared.debug("Upload stream: \(statistics.bytes) bytes in \(statistics.chunks) chunks, \(statistics.reads) reads, "
+                + "\(statistics.stalls) stalls, avg read \(statistics.readLatency / Double(statistics.reads) * 1000) ms, "
+                + "max read \(statistics.maxReadLatency * 1000) ms, encrypt \(statistics.encryptTime) s, producer CPU \(statistics.producerCPUTime) s")
+        }
+    }
+
+    override func read(_ buffer: UnsafeMutablePointer<UInt8>, maxLength len: Int) -> Int {
+        let start = Date()
+        self.condition.lock()
+        defer {
+            let latency = Date().timeIntervalSince(start)
+            self.statistics.reads += 1
+            self.statistics.readLatency += latency
+            self.statistics.maxReadLatency = max(self.statistics.maxReadLatency, latency)
+            self.condition.unlock()
+        }
+        if self.count == 0 && !self.produced && self.error == nil && !self.closed {
+            self.statistics.stalls += 1
+            while self.count == 0 && !self.produced && self.error == nil && !self.closed {
+                self.condition.wait()
+            }
+        }
+        if self.error != nil {
+            self.status = .error
+            return -1
+        }
+        if self.count == 0 || self.closed {
+            if self.status != .closed {
+                self.status = .atEnd
+            }
+            return 0
+        }
+        self.status = .reading
+        let length = min(len, self.lengths[self.head] - self.offset)
+        memcpy(buffer, self.slots[self.head] + self.offset, length)
+        self.offset += length
+        if self.offset == self.lengths[self.head] {
+            self.offset = 0
+            self.head = (self.head + 1) % self.slots.count
+            self.count -= 1
+            self.condition.signal()
+        }
+        if self.count == 0 && self.produced {
+            self.status = .atEnd
+        }
+        else {
+            self.status = .open
+        }
+        return length
+    }
+
+    override func getBuffer(_ buffer: UnsafeMutablePointer<UnsafeMutablePointer<UInt8>?>, length len: UnsafeMutablePointer<Int>) -> Bool {
+        return false
+    }
+
+    override func property(forKey key: Stream.PropertyKey) -> Any? {
+        return nil
+    }
+
+    override func setProperty(_ property: Any?, forKey key: Stream.PropertyKey) -> Bool {
+        return false
+    }
+
+    #if swift(>=4.2)
+    override func schedule(in aRunLoop: RunLoop, forMode mode: RunLoop.Mode) {
+    }
+
+    override func remove(from aRunLoop: RunLoop, forMode mode: RunLoop.Mode) {
+    }
+    #else
+    override func schedule(in aRunLoop: RunLoop, forMode mode: RunLoopMode) {
+    }
+
+    override func remove(from aRunLoop: RunLoop, forMode mode: RunLoopMode) {
+    }
+    #endif
+
+    // CFNetwork schedules request body streams through these private CFReadStream hooks.
+    // Reads here never return without data unless the stream ended, so polling is enough.
+    @objc func _scheduleInCFRunLoop(_ runLoop: CFRunLoop, forMode mode: CFString) {
+    }
+
+    @objc func _unscheduleFromCFRunLoop(_ runLoop: CFRunLoop, forMode mode: CFString) {
+    }
+
+    @objc func _setCFClientFlags(_ flags: CFOptionFlags, callback: CFReadStreamClientCallBack?, context: UnsafeMutablePointer<CFStreamClientContext>?) -> Bool {
+        return false
+    }
+
+    // MARK: Producer
+
+    private func produce() {
+        let cpuStart = StreamingSecureInputStream.threadCPUTime()
+        defer {
+            self.condition.lock()
+            self.statistics.producerCPUTime += StreamingSecureInputStream.threadCPUTime() - cpuStart
+            self.condition.unlock()
+        }
+        do {
+            if let mapped = try? Data(contentsOf: URL(fileURLWithPath: self.path), options: .alwaysMapped) {
+                try mapped.withUnsafeBytes { (bytes: UnsafePointer<UInt8>) in
+                    var position = 0
+                    while position < mapped.count {
+                        let length = min(StreamingSecureInputStream.bufferSize, mapped.count - position)
+                        guard try self.fill(from: bytes + position, length: length) else {
+                            return
+                        }
+                        position += length
+                    }
+                }
+            }
+            else {
+                guard let handle = FileHandle(forReadingAtPath: self.path) else {
+                    throw SparkError.illegalOperation(reason: "Cannot open \(self.path)")
+                }
+                defer {
+                    handle.closeFile()
+                }
+                while true {
+                    let data = handle.readData(ofLength: StreamingSecureInputStream.bufferSize)
+                    if data.count == 0 {
+                        break
+                    }
+                    let more = try data.withUnsafeBytes { (bytes: UnsafePointer<UInt8>) in
+                        try self.fill(from: bytes, length: data.count)
+                    }
+                    if !more {
+                        return
+                    }
+                }
+            }
+            try self.cipher.finalize()
+            self.condition.lock()
+            self.produced = true
+            self.condition.broadcast()
+            self.condition.unlock()
+        }
+        catch let error {
+            SDKLogger.shared.error("Upload stream failed", error: error)
+            self.condition.lock()
+            self.error = error
+            self.condition.broadcast()
+            self.condition.unlock()
+        }
+    }
+
+    /// Encrypts one buffer into the next free slot. Returns false once the stream was closed.
+    private func fill(from bytes: UnsafePointer<UInt8>, length: Int) throws -> Bool {
+        self.condition.lock()
+        while self.count == self.slots.count && !self.closed {
+            self.condition.wait()
+        }
+        if self.closed {
+            self.condition.unlock()
+            return false
+        }
+        let tail = (self.head + self.count) % self.slots.count
+        self.condition.unlock()
+
+        // Only the producer touches a free slot, so the cipher runs without the lock.
+        let start = Date()
+        _ = try self.cipher.encryptBytes(bytes, toBuffer: self.slots[tail], withLength: length)
+        let elapsed = Date().timeIntervalSince(start)
+
+        self.condition.lock()
+        self.lengths[tail] = length
+        self.count += 1
+        self.statistics.chunks += 1
+        self.statistics.bytes += UInt64(length)
+        self.statistics.encryptTime += elapsed
+        self.condition.broadcast()
+        self.condition.unlock()
+        return true
+    }
+
+    static func threadCPUTime() -> TimeInterval {
+        var time = timespec()
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time)
+        return TimeInterval(time.tv_sec) + TimeInterval(time.tv_nsec) / 1_000_000_000
+    }
+}
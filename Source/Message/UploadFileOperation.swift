@@ -23,32 +23,87 @@ import Alamofire
 
 class UploadFileOperations {
     
-    private let queue = SerialQueue()
+    static let defaultMaxConcurrentUploads = 3
+    
+    private let queue = DispatchQueue(label: "com.ciscospark.sdk.UploadFileOperations")
+    
+    private let key: EncryptionKey
+    
+    private let maxConcurrentUploads: Int
     
     private var operations: [UploadFileOperation]
     
-    init(key: EncryptionKey, files: [LocalFile]) {
-        self.operations = files.map { file in
+    convenience init(key: EncryptionKey, files: [LocalFile], maxConcurrentUploads: Int = UploadFileOperations.defaultMaxConcurrentUploads) {
+        self.init(key: key, operations: files.map { file in
             return UploadFileOperation(key: key, local: file)
-        }
+        }, maxConcurrentUploads: maxConcurrentUploads)
     }
     
-    func run(client: MessageClientImpl, completionHandler: @escaping (Result<[RemoteFile]>) -> Void) {
-        var sucess = [RemoteFile]()
-        self.operations.forEach { operation in
-            if !operation.done {
-                self.queue.sync {
-                    operation.run(client: client) { result in
-                        if let file = result.data {
-                            sucess.append(file)
+    init(key: EncryptionKey, operations: [UploadFileOperation], maxConcurrentUploads: Int = UploadFileOperations.defaultMaxConcurrentUploads) {
+        self.key = key
+        self.maxConcurrentUploads = max(1, maxConcurrentUploads)
+        self.operations = operations
+    }
+    
+    /// Uploads up to `maxConcurrentUploads` files at a time. The remote files are handed back in
+    /// the order of the local files; files that failed to upload are left out.
+    /// The overall progress is reported on `queue`, or on the main queue if it is nil.
+    func run(client: MessageClientImpl, progressHandler: ((Double) -> Void)? = nil, queue: DispatchQueue? = nil, completionHandler: @escaping (Result<[RemoteFile]>) -> Void) {
+        let operations = self.operations.filter { !$0.done }
+        if operations.isEmpty {
+            completionHandler(Result.success([]))
+            return
+        }
+        var results = [RemoteFile?](repeating: nil, count: operations.count)
+        var progress = [Double](repeating: 0, count: operations.count)
+        let weights = operations.map { Double($0.size) }
+        let total = max(weights.reduce(0, +), 1)
+        var next = 0
+        var running = 0
+        var finished = 0
+        let progressQueue = queue ?? DispatchQueue.main
+        
+        func launch() {
+            while running < self.maxConcurrentUploads && next < operations.count {
+                let index = next
+                next += 1
+                running += 1
+                DispatchQueue.main.async {
+                    operations[index].run(client: client, progressHandler: { fraction in
+                        self.queue.async {
+                            progress[index] = fraction
+                            let value = zip(progress, weights).reduce(0) { $0 + $1.0 * $1.1 } / total
+                            if let handler = progressHandler {
+                                progressQueue.async {
+                                    handler(value)
+                                }
+                            }
+                        }
+                    }) { result in
+                        self.queue.async {
+                            results[index] = result.data
+                            running -= 1
+                            finished += 1
+                            if finished == operations.count {
+                                let files = results.compactMap { $0 }
+                                DispatchQueue.main.async {
+                                    completionHandler(Result.success(files))
+                                }
+                            }
+                            else {
+                                launch()
+                            }
                         }
-                        self.queue.yield()
                     }
                 }
             }
         }
-        self.queue.sync {
-            completionHandler(Result.success(sucess))
+        
+        // Resolve the space once so that the parallel uploads do not each ask for it.
+        self.key.spaceUrl(authenticator: client.authenticator) { _ in
+            self.queue.async {
+                launch()
+            }
         }
     }
 }
@@ -59,43 +114,95 @@ class UploadFileOperation {
     private let key: EncryptionKey
     private(set) var done: Bool = false
     
+    var size: UInt64 {
+        return self.local.size + (self.local.thumbnail?.size ?? 0)
+    }
+    
     init(key: EncryptionKey, local: LocalFile) {
         self.local = local
         self.key = key
     }
     
-    func run(client: MessageClientImpl, completionHandler: @escaping (Result<RemoteFile>) -> Void) {
-        self.doUpload(client: client, path: self.local.path, size: self.local.size, progressStart: 0, progressHandler: self.local.progressHandler) { url, scr, error in
-            if let url = url, let scr = scr {
-                self.key.material(client: client) { material in
-                    var file = RemoteFile(local: self.local, downloadUrl: url)
-                    file.encrypt(key: material.data, scr: scr)
-                    if let thumb = self.local.thumbnail {
-                        self.doUpload(client: client, path: thumb.path, size: thumb.size, progressStart: 0.5, progressHandler: self.local.progressHandler) { url, scr, error in
-                            if let url = url, let scr = scr {
-                                var thumb = RemoteFile.Thumbnail(local: thumb, downloadUrl: url)
-                                thumb.encrypt(key: material.data, scr: scr)
-                                file.thumbnail = thumb
-                            }
-                            self.done = true
-                            completionHandler(Result.success(file))
-                        }
-                    }
-                    else {
-                        self.done = true
-                        completionHandler(Result.success(file))
-                    }
+    /// Uploads the file, its thumbnail and fetches the key material all at once.
+    /// `LocalFile.progressHandler` is called on the main queue, as it was when it came straight from
+    /// Alamofire; `progressHandler` is called on an internal queue.
+    func run(client: MessageClientImpl, progressHandler: ((Double) -> Void)? = nil, completionHandler: @escaping (Result<RemoteFile>) -> Void) {
+        let queue = DispatchQueue(label: "com.ciscospark.sdk.UploadFileOperation")
+        let group = DispatchGroup()
+        let total = Double(max(self.size, 1))
+        var fileProgress: Double = 0
+        var thumbProgress: Double = 0
+        var file: (url: String?, scr: SecureContentReference?, error: Error?) = (nil, nil, nil)
+        var thumb: (url: String?, scr: SecureContentReference?, error: Error?) = (nil, nil, nil)
+        var material: String?
+        
+        func report() {
+            let value = (fileProgress * Double(self.local.size) + thumbProgress * Double(self.local.thumbnail?.size ?? 0)) / total
+            if let handler = self.local.progressHandler {
+                DispatchQueue.main.async {
+                    handler(value)
+                }
+            }
+            progressHandler?(value)
+        }
+        
+        group.enter()
+        self.doUpload(client: client, path: self.local.path, size: self.local.size, progressHandler: { fraction in
+            queue.async {
+                fileProgress = fraction
+                report()
+            }
+        }) { url, scr, error in
+            queue.async {
+                file = (url, scr, error)
+                group.leave()
+            }
+        }
+        if let local = self.local.thumbnail {
+            group.enter()
+            self.doUpload(client: client, path: local.path, size: local.size, progressHandler: { fraction in
+                queue.async {
+                    thumbProgress = fraction
+                    report()
+                }
+            }) { url, scr, error in
+                queue.async {
+                    thumb = (url, scr, error)
+                    group.leave()
                 }
             }
-            else {
+        }
+        group.enter()
+        self.key.material(client: client) { result in
+            queue.async {
+                material = result.data
+                group.leave()
+            }
+        }
+        
+        group.notify(queue: queue) {
+            self.done = true
+            guard let url = file.url, let scr = file.scr else {
                 SDKLogger.shared.info("File Uoload Fail...")
-                self.done = true
-                completionHandler(Result.failure(error ?? SparkError.serviceFailed(code: -7000, reason: "upload error")))
+                DispatchQueue.main.async {
+                    completionHandler(Result.failure(file.error ?? SparkError.serviceFailed(code: -7000, reason: "upload error")))
+                }
+                return
+            }
+            var remote = RemoteFile(local: self.local, downloadUrl: url)
+            remote.encrypt(key: material, scr: scr)
+            if let local = self.local.thumbnail, let url = thumb.url, let scr = thumb.scr {
+                var thumbnail = RemoteFile.Thumbnail(local: local, downloadUrl: url)
+                thumbnail.encrypt(key: material, scr: scr)
+                remote.thumbnail = thumbnail
+            }
+            DispatchQueue.main.async {
+                completionHandler(Result.success(remote))
             }
         }
     }
     
-    func doUpload(client: MessageClientImpl, path: String, size: UInt64, progressStart: Double, progressHandler: ((Double) -> Void)?, completionHandler: @escaping (String?, SecureContentReference?, Error?) -> Void) {
+    func doUpload(client: MessageClientImpl, path: String, size: UInt64, progressHandler: ((Double) -> Void)?, completionHandler: @escaping (String?, SecureContentReference?, Error?) -> Void) {
         client.authenticator.accessToken { token in
             guard let token = token else {
                 completionHandler(nil, nil, SparkError.noAuth)
@@ -110,10 +217,10 @@ class UploadFileOperation {
                             let uploadUrl = dict["uploadUrl"] as? String,
                             let finishUrl = dict["finishUploadUrl"] as? String,
                             let scr = try? SecureContentReference(error: ()),
-                            let inputStream = try? SecureInputStream(stream: InputStream(fileAtPath: path), scr: scr) {
+                            let inputStream = try? StreamingSecureInputStream(path: path, scr: scr) {
                             let uploadHeaders: HTTPHeaders = ["Content-Length": String(size)]
                             Alamofire.upload(inputStream, to: uploadUrl, method: .put, headers: uploadHeaders).uploadProgress(closure: { (progress) in
-                                progressHandler?(progressStart + progress.fractionCompleted/2)
+                                progressHandler?(progress.fractionCompleted)
                             }).responseString { response in
                                 if let _ = response.result.value {
                                     let finishHeaders: HTTPHeaders = ["Authorization": "Bearer " + token, "Content-Type": "application/json;charset=UTF-8"]
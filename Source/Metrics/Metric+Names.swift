@@ -28,9 +28,15 @@ extension Metric {
         static let End = "callEnd";
         static let Request = "callRequest";
         static let Alert = "callAlert";
+        static let MediaSetup = "callMediaSetup"
         
         static let Error = "errorCode";
         static let NetworkError = "networkError";
         static let HttpStatusCode = "httpStatusCode";
     }
+    
+    struct Startup {
+        
+        static let Timeline = "startupTimeline"
+    }
 }
@@ -31,7 +31,8 @@ struct Metric {
         
     var name: String
     var data: [String: String]
-    var time: String
+    /// `Timestamp.monotonicNow` when the metric was recorded. Only formatted when posted.
+    var timestamp: UInt64
     var background: Bool
     var type: MetricsType
     
@@ -39,11 +40,15 @@ struct Metric {
         return (name.count > 0) && (data.count > 0)
     }
     
+    var time: String {
+        return Timestamp.ISO8601FullFormatterInUTC.string(from: Timestamp.date(monotonic: self.timestamp))
+    }
+    
     init(name: String, type: MetricsType = MetricsType.Generic, data: [String: String]) {
         self.name = name
         self.type = type        
         self.data = data
-        self.time = Timestamp.nowInUTC
+        self.timestamp = Timestamp.monotonicNow
         self.background = false
 
     }
@@ -20,57 +20,112 @@
 
 import Foundation
 
-class MetricsBuffer: NSObject {
-    private var metrics = [Metric]()
+/// Bounded multi-producer queue of metrics.
+///
+/// Recording a metric never takes a lock: producers claim a slot with a compare-and-swap on the
+/// enqueue position and publish it through the slot's sequence number, after Vyukov's bounded
+/// MPMC queue. When the ring is full `add(metric:)` returns false and the caller decides where
+/// the metric goes instead.
+class MetricsBuffer {
     
-    var count: Int {
-        var count: Int = 0
-        synchronized(lock: self) {
-            count = metrics.count
-        }
-        return count
+    static let defaultCapacity = 1024
+    
+    let capacity: Int
+    
+    private let mask: Int64
+    private let sequences: UnsafeMutablePointer<Int64>
+    private let slots: UnsafeMutablePointer<Metric>
+    // Enqueue and dequeue positions, a cache line apart.
+    private let positions: UnsafeMutablePointer<Int64>
+    private var enqueuePosition: UnsafeMutablePointer<Int64> {
+        return self.positions
+    }
+    private var dequeuePosition: UnsafeMutablePointer<Int64> {
+        return self.positions + 8
     }
     
-    func add(metric: Metric) {
-        synchronized(lock: self) {
-            metrics.append(metric)
+    init(capacity: Int = MetricsBuffer.defaultCapacity) {
+        var size = 2
+        while size < capacity {
+            size <<= 1
+        }
+        self.capacity = size
+        self.mask = Int64(size - 1)
+        self.sequences = UnsafeMutablePointer<Int64>.allocate(capacity: size)
+        for index in 0..<size {
+            (self.sequences + index).initialize(to: Int64(index))
         }
+        self.slots = UnsafeMutablePointer<Metric>.allocate(capacity: size)
+        self.positions = UnsafeMutablePointer<Int64>.allocate(capacity: 16)
+        self.positions.initialize(repeating: 0, count: 16)
     }
     
-    func add(metrics: [Metric]) {
-        synchronized(lock: self) {
-            self.metrics.append(contentsOf: metrics)
+    deinit {
+        while self.pop() != nil {
         }
+        self.sequences.deallocate()
+        self.slots.deallocate()
+        self.positions.deallocate()
     }
     
-    func popAllIfGreaterThan(_ amount: Int) -> [Metric]? {
-        var metricsCopy: [Metric]?
-        synchronized(lock: self) {
-            if metrics.count > amount {
-                metricsCopy = metrics
-                metrics.removeAll()
+    var count: Int {
+        return Int(max(0, spark_atomic_load(self.enqueuePosition) - spark_atomic_load(self.dequeuePosition)))
+    }
+    
+    /// Queues a metric, returning false if the buffer is full.
+    @discardableResult
+    func add(metric: Metric) -> Bool {
+        var position = spark_atomic_load(self.enqueuePosition)
+        while true {
+            let index = Int(position & self.mask)
+            let difference = spark_atomic_load(self.sequences + index) - position
+            if difference == 0 {
+                if spark_atomic_compare_exchange(self.enqueuePosition, &position, position + 1) {
+                    (self.slots + index).initialize(to: metric)
+                    spark_atomic_store(self.sequences + index, position + 1)
+                    return true
+                }
+            }
+            else if difference < 0 {
+                return false
+            }
+            else {
+                position = spark_atomic_load(self.enqueuePosition)
             }
         }
-        return metricsCopy
     }
     
-    func popAmount(_ amount: Int) -> [Metric]? {
-        var metricsCopy: [Metric]?
-        synchronized(lock: self) {
-            if metrics.count >= amount {
-                metricsCopy = Array(metrics.prefix(amount))
-                metrics.removeFirst(amount)
+    func pop() -> Metric? {
+        var position = spark_atomic_load(self.dequeuePosition)
+        while true {
+            let index = Int(position & self.mask)
+            let difference = spark_atomic_load(self.sequences + index) - (position + 1)
+            if difference == 0 {
+                if spark_atomic_compare_exchange(self.dequeuePosition, &position, position + 1) {
+                    let metric = (self.slots + index).move()
+                    spark_atomic_store(self.sequences + index, position + self.mask + 1)
+                    return metric
+                }
+            }
+            else if difference < 0 {
+                return nil
+            }
+            else {
+                position = spark_atomic_load(self.dequeuePosition)
             }
         }
-        return metricsCopy
     }
     
-    func popAll() -> [Metric]? {
-        var metricsCopy: [Metric]?
-        synchronized(lock: self) {
-            metricsCopy = metrics
-            metrics.removeAll()
+    /// Takes up to `amount` metrics, oldest first.
+    func pop(_ amount: Int) -> [Metric] {
+        var metrics = [Metric]()
+        while metrics.count < amount, let metric = self.pop() {
+            metrics.append(metric)
         }
-        return metricsCopy
+        return metrics
+    }
+    
+    func popAll() -> [Metric] {
+        return self.pop(self.capacity)
     }
 }
@@ -37,6 +37,7 @@ class MetricsClient {
                 .path("metrics")
                 .method(.post)
                 .body(metrics)
+                .compressBody(true)
                 .build()
             request.responseJSON(completionHandler)
         }
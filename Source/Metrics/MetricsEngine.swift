@@ -18,25 +18,45 @@
 // OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
 // THE SOFTWARE.
 
-import Foundation
+import UIKit
 
 class MetricsEngine {
 
     private let bufferLimit = 50
+    private let batchLimit = 200
     private let client: MetricsClient
-    private var buffer = MetricsBuffer()
+    private let buffer = MetricsBuffer()
+    private let spill: MetricsSpillLog?
+    // Formatting, posting and spilling all happen here, off the recording threads.
+    private let queue = DispatchQueue(label: "com.ciscospark.sdk.MetricsEngine", qos: .utility)
+    // Set while a flush is queued, so a burst of metrics over the limit queues only one.
+    private let flushScheduled: UnsafeMutablePointer<Int64> = {
+        let flag = UnsafeMutablePointer<Int64>.allocate(capacity: 1)
+        flag.initialize(to: 0)
+        return flag
+    }()
     private lazy var timer: Timer = Timer(timeInterval: 30, target: self, selector: #selector(flush), userInfo: nil, repeats: true)
     let authenticator: Authenticator
     
-    init(authenticator: Authenticator, service: DeviceService) {
+    init(authenticator: Authenticator, service: DeviceService, spill: MetricsSpillLog? = MetricsSpillLog()) {
         self.authenticator = authenticator
         self.client = MetricsClient(authenticator: authenticator, service: service)
+        self.spill = spill
         #if swift(>=4.2)
         RunLoop.current.add(self.timer, forMode: RunLoop.Mode.common)
+        NotificationCenter.default.addObserver(self, selector: #selector(self.persist), name: UIApplication.didEnterBackgroundNotification, object: nil)
+        NotificationCenter.default.addObserver(self, selector: #selector(self.persist), name: UIApplication.willTerminateNotification, object: nil)
         #else
         RunLoop.current.add(self.timer, forMode: RunLoopMode.commonModes)
+        NotificationCenter.default.addObserver(self, selector: #selector(self.persist), name: .UIApplicationDidEnterBackground, object: nil)
+        NotificationCenter.default.addObserver(self, selector: #selector(self.persist), name: .UIApplicationWillTerminate, object: nil)
         #endif
     }
+    
+    deinit {
+        NotificationCenter.default.removeObserver(self)
+        self.flushScheduled.deallocate()
+    }
 
     func release() {
         flush()
@@ -44,54 +64,47 @@ class MetricsEngine {
     }
 
     func track(name: String, type: MetricsType = MetricsType.Generic, _ data: [String: String]) {
-        self.track(metric: Metric(name: name, data: data))
+        self.track(metric: Metric(name: name, type: type, data: data))
     }
     
     private func track(metric: Metric) {
-        self.buffer.add(metric: metric)
-        if buffer.count > bufferLimit {
-            flush()
+        if !self.buffer.add(metric: metric) {
+            // Only when posting can't keep up; the flush queue owns the overflow.
+            self.queue.async {
+                self.spill?.append([self.makePayloadWith(metric: metric, postTime: Timestamp.nowInUTC)])
+            }
         }
-    }
-    
-    private func track(metrics: [Metric]) {
-        self.buffer.add(metrics: metrics)
         if buffer.count > bufferLimit {
-            flush()
+            var idle: Int64 = 0
+            if spark_atomic_compare_exchange(self.flushScheduled, &idle, 1) {
+                self.queue.async {
+                    spark_atomic_store(self.flushScheduled, 0)
+                    self.drain()
+                }
+            }
         }
     }
     
-    private func track(metrics: [Metric], completionHandler: ((Bool) -> Void)? = nil) {
-        var payloads = [[String: Any]]()
-        for metric in metrics {
-            if metric.isValid {
-                let payload = self.makePayloadWith(metric: metric)
-                payloads.append(payload)
-            }
-            else {
-                SDKLogger.shared.warn("Skipping invalid metric \(metric.name)")
-            }
-        }
-        if payloads.count > 0 {
-            self.client.post(RequestParameter(["metrics": payloads])) { response in
-                SDKLogger.shared.debug("\(response)")
-                switch response.result {
-                case .success:
-                    SDKLogger.shared.info("Success: post metrics")
-                    completionHandler?(true)
-                case .failure(let error):
-                    SDKLogger.shared.error("Failure", error: error)
-                    completionHandler?(false)
+    private func post(payloads: [[String: String]]) {
+        self.client.post(RequestParameter(["metrics": payloads])) { response in
+            SDKLogger.shared.debug("\(response)")
+            switch response.result {
+            case .success:
+                SDKLogger.shared.info("Success: post metrics")
+            case .failure(let error):
+                SDKLogger.shared.error("Failure", error: error)
+                self.queue.async {
+                    self.spill?.append(payloads)
                 }
             }
         }
     }
     
-    private func makePayloadWith(metric: Metric) -> [String: String] {
+    private func makePayloadWith(metric: Metric, postTime: String) -> [String: String] {
         var payload: [String: String] = metric.data
         payload["key"] = metric.name
         payload["time"] = metric.time
-        payload["postTime"] = Timestamp.nowInUTC
+        payload["postTime"] = postTime
         payload["type"] = metric.type.rawValue
         if metric.background {
             payload["background"] = String(metric.background)
@@ -99,18 +112,44 @@ class MetricsEngine {
         return payload
     }
     
-    @objc func flush() {
-        if buffer.count > 0 {
-            if let metrics = buffer.popAll() {
-                self.track(metrics: metrics, completionHandler: nil)
+    private func payloads(of metrics: [Metric]) -> [[String: String]] {
+        let postTime = Timestamp.nowInUTC
+        var payloads = [[String: String]]()
+        for metric in metrics {
+            if metric.isValid {
+                payloads.append(self.makePayloadWith(metric: metric, postTime: postTime))
             }
+            else {
+                SDKLogger.shared.warn("Skipping invalid metric \(metric.name)")
+            }
+        }
+        return payloads
+    }
+    
+    // Must be called on `queue`.
+    private func drain() {
+        // Anything spilled earlier goes first, in the order it was recorded.
+        var payloads = self.spill?.takeAll() ?? []
+        payloads += self.payloads(of: self.buffer.popAll())
+        var start = 0
+        while start < payloads.count {
+            let end = min(start + self.batchLimit, payloads.count)
+            self.post(payloads: Array(payloads[start..<end]))
+            start = end
+        }
+    }
+    
+    @objc func flush() {
+        self.queue.async {
+            self.drain()
+        }
+    }
+    
+    /// Writes what is still buffered to the spill log, so it survives the process being killed.
+    @objc func persist() {
+        self.queue.sync {
+            self.spill?.append(self.payloads(of: self.buffer.popAll()))
         }
     }
     
 }
-
-
-
-
-
-
@@ -0,0 +1,94 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+
+/// Append-only on-disk log of metric payloads that could not be posted yet, one JSON object per
+/// line. It survives process death, so metrics recorded while offline are posted on a later
+/// flush instead of being lost.
+///
+/// Not thread safe; `MetricsEngine` only touches it from its flush queue.
+class MetricsSpillLog {
+    
+    static let defaultMaxSize: UInt64 = 1024 * 1024
+    
+    let url: URL
+    let maxSize: UInt64
+    
+    init(url: URL, maxSize: UInt64 = MetricsSpillLog.defaultMaxSize) {
+        self.url = url
+        self.maxSize = maxSize
+    }
+    
+    convenience init?() {
+        guard let directory = FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first else {
+            return nil
+        }
+        self.init(url: directory.appendingPathComponent("com.ciscospark.sdk").appendingPathComponent("metrics.log"))
+    }
+    
+    var size: UInt64 {
+        return ((try? FileManager.default.attributesOfItem(atPath: self.url.path))?[.size] as? NSNumber)?.uint64Value ?? 0
+    }
+    
+    func append(_ payloads: [[String: String]]) {
+        guard payloads.count > 0 else {
+            return
+        }
+        var data = Data()
+        for payload in payloads {
+            if let line = try? JSONSerialization.data(withJSONObject: payload, options: []) {
+                data.append(line)
+                data.append(0x0a)
+            }
+        }
+        guard self.size + UInt64(data.count) <= self.maxSize else {
+            SDKLogger.shared.warn("Metrics log full, dropping \(payloads.count) metrics")
+            return
+        }
+        do {
+            if !FileManager.default.fileExists(atPath: self.url.path) {
+                try FileManager.default.createDirectory(at: self.url.deletingLastPathComponent(), withIntermediateDirectories: true, attributes: nil)
+                try data.write(to: self.url)
+                return
+            }
+            let handle = try FileHandle(forWritingTo: self.url)
+            defer {
+                handle.closeFile()
+            }
+            handle.seekToEndOfFile()
+            handle.write(data)
+        }
+        catch let error {
+            SDKLogger.shared.error("Failed to spill metrics", error: error)
+        }
+    }
+    
+    /// Reads and removes everything logged so far.
+    func takeAll() -> [[String: String]] {
+        guard let data = try? Data(contentsOf: self.url) else {
+            return []
+        }
+        try? FileManager.default.removeItem(at: self.url)
+        return data.split(separator: 0x0a).compactMap { line in
+            (try? JSONSerialization.jsonObject(with: Data(line), options: [])) as? [String: String]
+        }
+    }
+}
@@ -25,6 +25,9 @@ import Foundation
 /// - since: 1.2.0
 public class PersonClient {
     
+    // Person details change rarely and are looked up repeatedly, e.g. once per UI cell.
+    static let cacheTTL: TimeInterval = 60
+    
     let authenticator: Authenticator
     
     init(authenticator: Authenticator) {
@@ -57,6 +60,23 @@ public class PersonClient {
         request.responseArray(completionHandler)
     }
     
+    /// Lists people in the authenticated user's organization, page by page, through a cursor.
+    ///
+    /// - parameter email: if not nil, only list people with this email address.
+    /// - parameter displayName: if not nil, only list people whose name starts with this string.
+    /// - parameter id: List people by ID. Accepts up to 85 person IDs separated by commas.
+    /// - parameter orgId: List people in this organization. Only admin users of another organization (such as partners) may use this parameter.
+    /// - parameter pageSize: The number of people fetched per request, or the service default if nil.
+    /// - parameter queue: If not nil, the queue on which the cursor hands out people. Otherwise, they're handed out on the application's main thread.
+    /// - returns: A cursor over the people.
+    /// - since: 1.4.2
+    public func listAll(email: EmailAddress? = nil, displayName: String? = nil, id: String? = nil, orgId: String? = nil, pageSize: Int? = nil, queue: DispatchQueue? = nil) -> ListCursor<Person> {
+        let request = requestBuilder()
+            .method(.get)
+            .query(RequestParameter(["email": email?.toString(), "displayName": displayName, "id": id, "orgId":orgId, "max": pageSize]))
+        return ListCursor(authenticator: self.authenticator, request: request, queue: queue)
+    }
+    
     /// Retrieves the details for a person by person id.
     ///
     /// - parameter personId: The identifier of the person.
@@ -68,6 +88,7 @@ public class PersonClient {
         let request = requestBuilder()
             .method(.get)
             .path(personId)
+            .cache(ttl: PersonClient.cacheTTL)
             .queue(queue)
             .build()
         
@@ -84,6 +105,7 @@ public class PersonClient {
         let request = requestBuilder()
             .method(.get)
             .path("me")
+            .cache(ttl: PersonClient.cacheTTL)
             .queue(queue)
             .build()
         
@@ -143,6 +165,7 @@ public class PersonClient {
         let request = requestBuilder()
             .method(.put)
             .path(personId)
+            .invalidates("people/me")
             .query(RequestParameter(["email": email?.toString(),
                                      "displayName": displayName,
                                      "orgId":orgId,
@@ -170,6 +193,7 @@ public class PersonClient {
         let request = requestBuilder()
             .method(.delete)
             .path(personId)
+            .invalidates("people/me")
             .queue(queue)
             .build()
         
@@ -202,13 +202,13 @@ public class Call {
     /// - since: 1.2.0
     public var onRinging: (() -> Void)? {
         didSet {
-            self.device.phone.queue.sync {
+            self.queue.sync {
                 if let block = self.onRinging, self.status == CallStatus.ringing {
                     DispatchQueue.main.async {
                         block()
                     }
                 }
-                self.device.phone.queue.yield()
+                self.queue.yield()
             }
         }
     }
@@ -218,14 +218,14 @@ public class Call {
     /// - since: 1.2.0
     public var onConnected: (() -> Void)? {
         didSet {
-            self.device.phone.queue.sync {
+            self.queue.sync {
                 self.onConnectedOnceToken = UUID().uuidString
                 if let block = self.onConnected, self.status == CallStatus.connected {
                     DispatchQueue.main.asyncOnce(token: self.onConnectedOnceToken) {
                         block()
                     }
                 }
-                self.device.phone.queue.yield()
+                self.queue.yield()
             }
         }
     }
@@ -433,9 +433,8 @@ public class Call {
     /// Call Memberships represent participants in this *call*.
     ///
     /// - since: 1.2.0
-    public private(set) var memberships: [CallMembership] {
-        get { lock(); defer { unlock() }; return _memberships ?? [] }
-        set { lock(); defer { unlock() }; _memberships = newValue }
+    public var memberships: [CallMembership] {
+        lock(); defer { unlock() }; return _memberships ?? []
     }
     
     /// The initiator of this *call*.
@@ -456,7 +455,11 @@ public class Call {
     /// If is nil, it will update the video state as inactive to the server side.
     /// - since: 1.3.0
     public var videoRenderViews: (local:MediaRenderView, remote:MediaRenderView)? {
-        didSet {
+        get { lock(); defer { unlock() }; return _videoRenderViews }
+        set {
+            lock()
+            _videoRenderViews = newValue
+            unlock()
             DispatchQueue.main.async {
                 if !self.mediaSession.hasVideo {
                     return
@@ -464,7 +467,7 @@ public class Call {
                 //update media session
                 self.mediaSession.updateMedia(mediaType:MediaSessionWrapper.MediaType.video(self.videoRenderViews))
                 //update locus local medias
-                self.device.phone.update(call: self, sendingAudio: self.sendingAudio, sendingVideo: self.sendingVideo,localSDP: self.mediaSession.getLocalSdp())
+                self.updateMedia(sendingAudio: self.sendingAudio, sendingVideo: self.sendingVideo, localSDP: self.mediaSession.getLocalSdp())
             }
         }
     }
@@ -474,7 +477,11 @@ public class Call {
     ///
     /// - since: 1.3.0
     public var screenShareRenderView: MediaRenderView? {
-        didSet {
+        get { lock(); defer { unlock() }; return _screenShareRenderView }
+        set {
+            lock()
+            _screenShareRenderView = newValue
+            unlock()
             DispatchQueue.main.async {
                 if !self.mediaSession.hasScreenShare {
                     return
@@ -482,7 +489,7 @@ public class Call {
                 //update media session
                 self.mediaSession.updateMedia(mediaType:MediaSessionWrapper.MediaType.screenShare(self.screenShareRenderView))
                 //update locus local medias
-                self.device.phone.update(call: self, sendingAudio: self.sendingAudio, sendingVideo: self.sendingVideo,localSDP: self.mediaSession.getLocalSdp())
+                self.updateMedia(sendingAudio: self.sendingAudio, sendingVideo: self.sendingVideo, localSDP: self.mediaSession.getLocalSdp())
                 //join or leave screen share
                 if let granted = self.model.screenMediaShare?.shareFloor?.granted {
                     if self.screenShareRenderView != nil {
@@ -505,18 +512,65 @@ public class Call {
         return self.model.callUrl!
     }
     
+    struct Tones {
+        let url: String
+        let events: String
+    }
+    
+    struct MediaUpdate {
+        let sendingAudio: Bool
+        let sendingVideo: Bool
+        let localSDP: String?
+    }
+    
     let isGroup: Bool
     
     let device: Device
-    let mediaSession: MediaSessionWrapper
+    // Serializes the locus operations and events of this call only; other calls and the
+    // device registration run on their own queues.
+    let queue: SerialQueue
+    // Replaced by a warm session from the pool when an incoming call is answered, see `use(media:)`.
+    var mediaSession: MediaSessionWrapper {
+        lock(); defer { unlock() }; return _mediaSession
+    }
     var _uuid: UUID
     
     let metrics: CallMetrics
-    private let dtmfQueue: DtmfQueue
+    let commands = CallCommandScheduler()
+    // Tones waiting for a slot are sent as one string. Only one request is in flight: whether locus
+    // plays tones in correlation id order is not confirmed, and a failed request must not let the
+    // tones after it through.
+    private lazy var dtmf: CallCommandScheduler.Lane<Tones> = self.commands.lane("DTMF", window: 1, combine: { (a: Tones, b: Tones) in
+        Tones(url: b.url, events: a.events + b.events)
+    }) { [weak self] tones, correlationId, completionHandler in
+        guard let strong = self else {
+            completionHandler(SparkError.illegalStatus(reason: "Call ended"))
+            return
+        }
+        strong.device.phone.client.sendDtmf(tones.url, by: strong.device, correlationId: correlationId, events: tones.events) { response in
+            completionHandler(response.result.error)
+        }
+    }
+    // Each update carries the whole media state, so one waiting for a slot is replaced by the next.
+    private lazy var media: CallCommandScheduler.Lane<MediaUpdate> = self.commands.lane("media update", combine: { (a: MediaUpdate, b: MediaUpdate) in
+        MediaUpdate(sendingAudio: b.sendingAudio, sendingVideo: b.sendingVideo, localSDP: b.localSDP ?? a.localSDP)
+    }) { [weak self] update, _, completionHandler in
+        guard let strong = self else {
+            completionHandler(SparkError.illegalStatus(reason: "Call ended"))
+            return
+        }
+        strong.device.phone.update(call: strong, sendingAudio: update.sendingAudio, sendingVideo: update.sendingVideo, localSDP: update.localSDP, completionHandler: completionHandler)
+    }
+    private let sequence = CallSequenceState()
     
     private var _dail: String?
     private var _model: CallModel
+    private var _mediaSession: MediaSessionWrapper
+    private var _videoRenderViews: (local:MediaRenderView, remote:MediaRenderView)?
+    private var _screenShareRenderView: MediaRenderView?
     private var _memberships: [CallMembership]?
+    // Position of each participant id in `_memberships`.
+    private var _membershipIndex = [String: Int]()
     var _mutex = pthread_mutex_t()
     
     var onConnectedOnceToken :String = "" {
@@ -542,23 +596,24 @@ public class Call {
         return nil
     }
     
-    init(model: CallModel, device: Device, media: MediaSessionWrapper, direction: Direction, group: Bool, uuid: UUID?) {
+    init(model: CallModel, device: Device, media: MediaSessionWrapper, direction: Direction, group: Bool, uuid: UUID?, queue: SerialQueue? = nil) {
         self.direction = direction
         self.isGroup = group
         self.device = device
-        self.mediaSession = media
+        self.queue = queue ?? SerialQueue()
+        self._mediaSession = media
         self._model = model
         self._uuid = uuid ?? UUID()
-        self.dtmfQueue = DtmfQueue(client: device.phone.client)
         self.metrics = CallMetrics()
         self.metrics.trackCallStarted()
-        self.videoRenderViews = media.videoViews
-        self.screenShareRenderView = media.screenShareView
+        self._videoRenderViews = media.videoViews
+        self._screenShareRenderView = media.screenShareView
+        pthread_mutex_init(&_mutex, nil)
         self.doCallModel(model)
     }
     
     deinit{
-        pthread_mutex_init(&_mutex, nil)
+        pthread_mutex_destroy(&_mutex)
         DispatchQueue.main.removeOnceToken(token: self.onConnectedOnceToken)
     }
     
@@ -569,6 +624,15 @@ public class Call {
         pthread_mutex_unlock(&_mutex)
     }
     
+    /// Switches to `media`, prepared for answering, and takes the render views from it. The views
+    /// are already set on the session, so locus is not told about them again.
+    func use(media: MediaSessionWrapper) {
+        lock(); defer { unlock() }
+        self._mediaSession = media
+        self._videoRenderViews = media.videoViews
+        self._screenShareRenderView = media.screenShareView
+    }
+    
     /// Acknowledge (without answering) an incoming call.
     /// Will cause the initiator's Call instance to emit the ringing event.
     ///
@@ -634,7 +698,13 @@ public class Call {
     public func send(dtmf: String, completionHandler: ((Error?) -> Void)?) {
         if let url = self.model.myself?.url {
             if self.sendingDTMFEnabled {
-                self.dtmfQueue.push(participantUrl: url, device: self.device, event: dtmf, completionHandler: completionHandler)
+                if dtmf.rangeOfCharacter(from: CharacterSet(charactersIn: "1234567890*#ABCDabcd").inverted) != nil {
+                    DispatchQueue.main.async {
+                        completionHandler?(SparkError.invalidDTMF)
+                    }
+                    return
+                }
+                self.dtmf.submit(Tones(url: url, events: dtmf), completionHandler: completionHandler)
             } else {
                 DispatchQueue.main.async {
                     completionHandler?(SparkError.unsupportedDTMF)
@@ -700,7 +770,7 @@ public class Call {
         switch reason {
         case .remoteDecline, .remoteLeft:
             if let url = self.model.myself?.url {
-                self.device.phone.client.leave(url, by: self.device, queue: self.device.phone.queue.underlying) { res in
+                self.device.phone.client.leave(url, by: self.device, queue: self.queue.underlying) { res in
                     switch res.result {
                     case .success(let model):
                         SDKLogger.shared.debug("Receive leave locus response: \(model.toJSONString(prettyPrint: self.device.phone.debug) ?? "Nil JSON")")
@@ -721,8 +791,8 @@ public class Call {
         }
     }
     
-    func updateMedia(sendingAudio: Bool, sendingVideo: Bool) {
-        self.device.phone.update(call: self, sendingAudio: sendingAudio, sendingVideo: sendingVideo)
+    func updateMedia(sendingAudio: Bool, sendingVideo: Bool, localSDP: String? = nil) {
+        self.media.submit(MediaUpdate(sendingAudio: sendingAudio, sendingVideo: sendingVideo, localSDP: localSDP))
     }
     
     func startMedia() {
@@ -750,6 +820,7 @@ public class Call {
             self.mediaSession.leaveScreenShare(granted, isSending: self.isScreenSharedBySelfDevice())
         }
         self.mediaSession.onBroadcasting = nil
+        self.mediaSession.trackSetup(call: self, firstPacket: false)
         self.mediaSession.stopMedia()
     }
     
@@ -768,7 +839,7 @@ public class Call {
     func update(model: CallModel) {
         if model.isValid {
             let old = self.model
-            if var new = CallEventSequencer.sequence(old: old, new: model, invalid: { self.device.phone.fetch(call: self) }) {
+            if var new = CallEventSequencer.sequence(old: old, new: model, state: self.sequence, invalid: { self.device.phone.fetch(call: self) }) {
                 //some response's mediaConnection is nil, sync all model hold the latest media connection
                 if new.mediaConnections == nil, let oldMediaConnextions = old.mediaConnections {
                     new.setMediaConnections(newMediaConnections: old.mediaConnections)
@@ -800,7 +871,7 @@ public class Call {
                             self.onMediaChanged?(MediaChangedEvent.remoteSendingScreenShare(false))
                         }
                         
-                        if let membership = self.memberships.filter({$0.id == participant.id}).first {
+                        if let membership = self.membership(id: participant.id) {
                             self.onCallMembershipChanged?(CallMembershipChangedEvent.sendingScreenShare(membership))
                         }
                     }
@@ -820,7 +891,7 @@ public class Call {
                             }
                             self.onMediaChanged?(MediaChangedEvent.remoteSendingScreenShare(true))
                         }
-                        if let membership = self.memberships.filter({$0.id == participant.id}).first {
+                        if let membership = self.membership(id: participant.id) {
                             if self.isScreenSharedBySelfDevice() && self.mediaSession.screenShareMuted {
                                 
                             } else {
@@ -853,7 +924,7 @@ public class Call {
                         } else {
                             
                         }
-                        if let sharingParticipantId = newFloor.beneficiary?.id ,let membership = self.memberships.filter({$0.id == sharingParticipantId}).first{
+                        if let sharingParticipantId = newFloor.beneficiary?.id ,let membership = self.membership(id: sharingParticipantId){
                             self.onCallMembershipChanged?(CallMembershipChangedEvent.sendingScreenShare(membership))
                         }
                     }
@@ -898,20 +969,33 @@ public class Call {
         }
     }
     
+    func membership(id: String?) -> CallMembership? {
+        lock(); defer { unlock() }
+        guard let id = id, let position = self._membershipIndex[id] else {
+            return nil
+        }
+        return self._memberships?[position]
+    }
+    
     private func doCallModel(_ model: CallModel) {
         self.model = model
         if let participants = model.participants?.filter({ $0.isCIUser() }) {
-            let oldMemberships = self.memberships
+            lock()
+            let oldMemberships = self._memberships ?? []
+            let oldIndex = self._membershipIndex
+            unlock()
             var newMemberships = [CallMembership]()
+            newMemberships.reserveCapacity(participants.count)
+            var newIndex = [String: Int](minimumCapacity: participants.count)
             var onCallMembershipChanges = [CallMembershipChangedEvent]()
             
             for participant in participants {
-                if var membership = oldMemberships.find(predicate: { $0.id == participant.id }) {
-                    let oldState = membership.state
-                    let sendingAudio = membership.sendingAudio
-                    let sendingVideo = membership.sendingVideo
+                let id = participant.id ?? ""
+                if let position = oldIndex[id] {
+                    var membership = oldMemberships[position]
+                    let old = membership.model
                     membership.model = participant
-                    if membership.state != oldState {
+                    if (participant.state ?? .idle) != (old.state ?? .idle) {
                         if membership.state == CallMembership.State.joined {
                             onCallMembershipChanges.append(CallMembershipChangedEvent.joined(membership))
                         }
@@ -922,10 +1006,10 @@ public class Call {
                             onCallMembershipChanges.append(CallMembershipChangedEvent.declined(membership))
                         }
                     }
-                    if membership.sendingAudio != sendingAudio {
+                    if (participant.status?.audioStatus == "SENDRECV") != (old.status?.audioStatus == "SENDRECV") {
                         onCallMembershipChanges.append(CallMembershipChangedEvent.sendingAudio(membership))
                     }
-                    if membership.sendingVideo != sendingVideo {
+                    if (participant.status?.videoStatus == "SENDRECV") != (old.status?.videoStatus == "SENDRECV") {
                         onCallMembershipChanges.append(CallMembershipChangedEvent.sendingVideo(membership))
                     }
                     newMemberships.append(membership)
@@ -933,16 +1017,28 @@ public class Call {
                 else {
                     newMemberships.append(CallMembership(participant: participant, call: self))
                 }
+                if newIndex[id] == nil {
+                    newIndex[id] = newMemberships.count - 1
+                }
             }
-            self.memberships = newMemberships
-            for callMembershipChange in onCallMembershipChanges {
+            lock()
+            self._memberships = newMemberships
+            self._membershipIndex = newIndex
+            unlock()
+            if onCallMembershipChanges.count > 0 {
+                // One hop to main for the whole locus update, delivered in order.
                 DispatchQueue.main.async {
-                    self.onCallMembershipChanged?(callMembershipChange)
+                    for callMembershipChange in onCallMembershipChanges {
+                        self.onCallMembershipChanged?(callMembershipChange)
+                    }
                 }
             }
         }
         else {
-            self.memberships = []
+            lock()
+            self._memberships = []
+            self._membershipIndex = [:]
+            unlock()
         }
         self.status.handle(model: model, for: self)
     }
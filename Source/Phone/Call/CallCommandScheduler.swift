@@ -0,0 +1,139 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// Sends the outbound commands of a call, such as DTMF tones and media state updates, to locus.
+///
+/// Each kind of command goes through its own `Lane`, so commands of different kinds never wait on
+/// each other. A lane keeps up to `window` requests in flight; commands submitted while the window
+/// is full wait, and are combined into one when the next slot frees up. For media state only the
+/// latest is kept; for DTMF the tones are joined. The slower locus answers, the more commands are
+/// combined, so bursts cost a few round trips instead of one each. Every request carries a
+/// correlation id, consecutive within its lane, and its round-trip time is tracked.
+///
+/// - note: for internal use only.
+class CallCommandScheduler {
+    
+    struct Statistics {
+        var sent = 0
+        /// Commands folded into another one instead of being sent on their own.
+        var combined = 0
+        var failures = 0
+        var lastRoundTrip: TimeInterval = 0
+        /// Smoothed like TCP's SRTT, with a gain of 1/8.
+        var smoothedRoundTrip: TimeInterval = 0
+    }
+    
+    /// A stream of commands of one kind, with a payload of type `P`.
+    class Lane<P> {
+        
+        typealias Send = (_ payload: P, _ correlationId: Int, _ completionHandler: @escaping (Error?) -> Void) -> Void
+        
+        let name: String
+        let window: Int
+        private let scheduler: CallCommandScheduler
+        private let combine: (P, P) -> P
+        private let send: Send
+        private var inFlight = 0
+        private var correlationId = 0
+        private var waiting: (payload: P, completionHandlers: [(Error?) -> Void])?
+        
+        fileprivate init(name: String, window: Int, scheduler: CallCommandScheduler, combine: @escaping (P, P) -> P, send: @escaping Send) {
+            self.name = name
+            self.window = window
+            self.scheduler = scheduler
+            self.combine = combine
+            self.send = send
+        }
+        
+        /// Queues `payload`. `completionHandler` is called on the main queue once the request that
+        /// carried it, possibly combined with others, was answered.
+        func submit(_ payload: P, completionHandler: ((Error?) -> Void)? = nil) {
+            self.scheduler.queue.async {
+                let handler = completionHandler ?? { _ in }
+                if let waiting = self.waiting {
+                    self.waiting = (self.combine(waiting.payload, payload), waiting.completionHandlers + [handler])
+                    self.scheduler._statistics.combined += 1
+                }
+                else {
+                    self.waiting = (payload, [handler])
+                }
+                self.flush()
+            }
+        }
+        
+        // Must run on the scheduler queue.
+        private func flush() {
+            guard self.inFlight < self.window, let (payload, completionHandlers) = self.waiting else {
+                return
+            }
+            self.waiting = nil
+            self.inFlight += 1
+            self.correlationId += 1
+            let correlationId = self.correlationId
+            self.scheduler._statistics.sent += 1
+            let start = Date()
+            SDKLogger.shared.debug("Send \(self.name) \(correlationId)")
+            self.send(payload, correlationId) { error in
+                self.scheduler.queue.async {
+                    let roundTrip = Date().timeIntervalSince(start)
+                    self.scheduler.record(roundTrip: roundTrip, failed: error != nil)
+                    SDKLogger.shared.debug("\(self.name) \(correlationId) answered in \(Int(roundTrip * 1000)) ms")
+                    self.inFlight -= 1
+                    DispatchQueue.main.async {
+                        completionHandlers.forEach { $0(error) }
+                    }
+                    self.flush()
+                }
+            }
+        }
+    }
+    
+    var statistics: Statistics {
+        return self.queue.sync {
+            self._statistics
+        }
+    }
+    
+    fileprivate let queue = DispatchQueue(label: "com.ciscospark.sdk.CallCommandScheduler")
+    fileprivate var _statistics = Statistics()
+    
+    /// Creates a lane that sends with `send`, keeping up to `window` requests in flight and
+    /// combining commands waiting for a slot with `combine`.
+    func lane<P>(_ name: String, window: Int = 1, combine: @escaping (P, P) -> P, send: @escaping Lane<P>.Send) -> Lane<P> {
+        return Lane(name: name, window: window, scheduler: self, combine: combine, send: send)
+    }
+    
+    // Must run on the queue.
+    fileprivate func record(roundTrip: TimeInterval, failed: Bool) {
+        self._statistics.lastRoundTrip = roundTrip
+        if self._statistics.smoothedRoundTrip == 0 {
+            self._statistics.smoothedRoundTrip = roundTrip
+        }
+        else {
+            self._statistics.smoothedRoundTrip += (roundTrip - self._statistics.smoothedRoundTrip) / 8
+        }
+        if failed {
+            self._statistics.failures += 1
+        }
+    }
+}
@@ -29,7 +29,7 @@ class CallEventSequencer {
         case deSync
     }
     
-    static func sequence(old: CallModel?, new: CallModel, invalid: () -> Void) -> CallModel? {
+    static func sequence(old: CallModel?, new: CallModel, state: CallSequenceState, invalid: () -> Void) -> CallModel? {
         guard let old = old, let oldSeq = old.sequence, let newSeq = new.sequence else {
             return new
         }
@@ -37,7 +37,7 @@ class CallEventSequencer {
         if oldSeq.empty || newSeq.empty {
             return new
         }
-        let compare = CallEventSequencer.compare(oldSeq, newSeq)
+        let compare = state.compare(oldSeq, newSeq)
         switch compare {
         case .equal:
             return nil
@@ -51,7 +51,60 @@ class CallEventSequencer {
         }
     }
     
-    private static func compare(_ a: SequenceModel, _ b: SequenceModel) -> CompareResult {
+    /// Same ordering as `compare(_:_:)`, worked out on the entries collapsed into ranges.
+    static func compare(_ a: SequenceModel, _ b: SequenceModel, _ aEntries: SequenceIntervals, _ bEntries: SequenceIntervals) -> CompareResult {
+        if a.end < b.start {
+            return CompareResult.lessThan
+        }
+        if a.start > b.end {
+            return CompareResult.greaterThan
+        }
+        
+        let aOnly = self.only(aEntries, notIn: bEntries, b)
+        let bOnly = self.only(bEntries, notIn: aEntries, a)
+        
+        if aOnly.isEmpty && bOnly.isEmpty {
+            return self.compareRanges(a, b)
+        }
+        if !aOnly.isEmpty && bOnly.isEmpty {
+            return CompareResult.greaterThan
+        }
+        if !bOnly.isEmpty && aOnly.isEmpty {
+            return CompareResult.lessThan
+        }
+        if aOnly.containsAny(between: b.start, and: b.end) || bOnly.containsAny(between: a.start, and: a.end) {
+            return CompareResult.deSync
+        }
+        if let aFirst = aOnly.first, let bFirst = bOnly.first, aFirst > bFirst {
+            return CompareResult.greaterThan
+        }
+        return CompareResult.lessThan
+    }
+    
+    // Entries neither listed in the other sequence nor covered by its range.
+    private static func only(_ entries: SequenceIntervals, notIn others: SequenceIntervals, _ other: SequenceModel) -> SequenceIntervals {
+        let only = entries.subtracting(others)
+        if other.rangeStart <= other.rangeEnd {
+            return only.subtracting(other.rangeStart...other.rangeEnd)
+        }
+        return only
+    }
+    
+    private static func compareRanges(_ a: SequenceModel, _ b: SequenceModel) -> CompareResult {
+        if a.rangeEnd > b.rangeEnd {
+            return CompareResult.greaterThan
+        } else if a.rangeEnd < b.rangeEnd {
+            return CompareResult.lessThan
+        } else if a.rangeStart < b.rangeStart {
+            return CompareResult.greaterThan
+        } else if a.rangeStart > b.rangeStart {
+            return CompareResult.lessThan
+        } else {
+            return CompareResult.equal
+        }
+    }
+    
+    static func compare(_ a: SequenceModel, _ b: SequenceModel) -> CompareResult {
         
         var aOnly = [UInt64]()
         var bOnly = [UInt64]()
@@ -70,17 +123,7 @@ class CallEventSequencer {
         
         if aOnly.isEmpty && bOnly.isEmpty {
             // both sets are completely empty, use range to figure out order
-            if a.rangeEnd > b.rangeEnd {
-                return CompareResult.greaterThan
-            } else if a.rangeEnd < b.rangeEnd {
-                return CompareResult.lessThan
-            } else if a.rangeStart < b.rangeStart {
-                return CompareResult.greaterThan
-            } else if a.rangeStart > b.rangeStart {
-                return CompareResult.lessThan
-            } else {
-                return CompareResult.equal
-            }
+            return self.compareRanges(a, b)
         }
         
         // If b has nothing unique and a does, then a is newer
@@ -0,0 +1,163 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// A set of locus sequence numbers kept as sorted, disjoint, non-adjacent closed ranges.
+///
+/// Locus entries are mostly runs of consecutive numbers, so a long entry list collapses into a
+/// handful of ranges and set operations work on those instead of on every entry.
+struct SequenceIntervals: Equatable {
+    
+    private(set) var ranges: [ClosedRange<UInt64>] = []
+    
+    init() {
+    }
+    
+    init(_ entries: [UInt64]) {
+        for value in entries {
+            guard let last = self.ranges.last else {
+                self.ranges.append(value...value)
+                continue
+            }
+            if value > last.upperBound {
+                if value - 1 == last.upperBound {
+                    self.ranges[self.ranges.count - 1] = last.lowerBound...value
+                }
+                else {
+                    self.ranges.append(value...value)
+                }
+            }
+            else if value < last.lowerBound {
+                // Locus sends its entries sorted; anything else takes the slow path once.
+                self = SequenceIntervals(entries.sorted())
+                return
+            }
+        }
+    }
+    
+    private init(ranges: [ClosedRange<UInt64>]) {
+        self.ranges = ranges
+    }
+    
+    var isEmpty: Bool {
+        return self.ranges.isEmpty
+    }
+    
+    var first: UInt64? {
+        return self.ranges.first?.lowerBound
+    }
+    
+    var count: UInt64 {
+        return self.ranges.reduce(0) { $0 + ($1.upperBound - $1.lowerBound + 1) }
+    }
+    
+    /// Index of the first range whose upper bound is at least `value`.
+    private func index(reaching value: UInt64) -> Int {
+        var low = 0
+        var high = self.ranges.count
+        while low < high {
+            let middle = (low + high) / 2
+            if self.ranges[middle].upperBound < value {
+                low = middle + 1
+            }
+            else {
+                high = middle
+            }
+        }
+        return low
+    }
+    
+    func contains(_ value: UInt64) -> Bool {
+        let index = self.index(reaching: value)
+        return index < self.ranges.count && self.ranges[index].lowerBound <= value
+    }
+    
+    /// Whether any member lies strictly between `lower` and `upper`, in O(log n).
+    func containsAny(between lower: UInt64, and upper: UInt64) -> Bool {
+        guard lower < UInt64.max, lower + 1 < upper else {
+            return false
+        }
+        let index = self.index(reaching: lower + 1)
+        return index < self.ranges.count && max(self.ranges[index].lowerBound, lower + 1) < upper
+    }
+    
+    func subtracting(_ other: SequenceIntervals) -> SequenceIntervals {
+        var result = [ClosedRange<UInt64>]()
+        var first = 0
+        for range in self.ranges {
+            while first < other.ranges.count && other.ranges[first].upperBound < range.lowerBound {
+                first += 1
+            }
+            var lower = range.lowerBound
+            var remains = true
+            var index = first
+            while index < other.ranges.count && other.ranges[index].lowerBound <= range.upperBound {
+                let cut = other.ranges[index]
+                if cut.lowerBound > lower {
+                    result.append(lower...(cut.lowerBound - 1))
+                }
+                if cut.upperBound >= range.upperBound {
+                    remains = false
+                    break
+                }
+                lower = cut.upperBound + 1
+                index += 1
+            }
+            if remains {
+                result.append(lower...range.upperBound)
+            }
+        }
+        return SequenceIntervals(ranges: result)
+    }
+    
+    func subtracting(_ range: ClosedRange<UInt64>) -> SequenceIntervals {
+        return self.subtracting(SequenceIntervals(ranges: [range]))
+    }
+}
+
+/// Locus sequence of the model a call currently holds.
+///
+/// Kept between locus events, so each event only has to collapse its own entries into ranges
+/// before being ordered against the current one.
+///
+/// - note: for internal use only.
+class CallSequenceState {
+    
+    private var current: SequenceModel?
+    private var intervals = SequenceIntervals()
+    
+    /// Orders `new` against `old` and, if `new` is newer, makes it the current sequence.
+    func compare(_ old: SequenceModel, _ new: SequenceModel) -> CallEventSequencer.CompareResult {
+        // Usually the very model accepted last time, which compares by identity of its storage.
+        if self.current != old {
+            self.current = old
+            self.intervals = SequenceIntervals(old.entries)
+        }
+        let incoming = SequenceIntervals(new.entries)
+        let result = CallEventSequencer.compare(old, new, self.intervals, incoming)
+        if result == CallEventSequencer.CompareResult.lessThan {
+            self.current = new
+            self.intervals = incoming
+        }
+        return result
+    }
+}
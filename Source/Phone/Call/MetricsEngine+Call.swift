@@ -25,6 +25,15 @@ extension MetricsEngine {
         self.track(name: Metric.Call.End, data)
     }
     
+    func trackMediaSetupMetric(call: Call, setup: MediaSessionWrapper.Setup) {
+        guard var data = self.basicCallInfo(call: call) else { return }
+        data["mediaSessionPooled"] = String(setup.pooled)
+        data["localSdpTime"] = String(self.milliseconds(from: setup.started, to: setup.offered))
+        data["mediaStartTime"] = String(self.milliseconds(from: setup.started, to: setup.connected))
+        data["firstPacketTime"] = String(self.milliseconds(from: setup.started, to: setup.firstPacket))
+        self.track(name: Metric.Call.MediaSetup, data)
+    }
+    
     func trackFeedbackMetric(call: Call, rating: Int, comments: String?, includeLogs: Bool) {
         guard var data = self.basicCallInfo(call: call) else { return }
         data["user.rating"] = String(rating)
@@ -50,6 +50,9 @@ struct SequenceModel {
 
 }
 
+extension SequenceModel: Equatable {
+}
+
 extension SequenceModel: Mappable {
     
     init?(map: Map) {
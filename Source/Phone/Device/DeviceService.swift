@@ -19,6 +19,7 @@
 // THE SOFTWARE.
 
 import Foundation
+import ObjectMapper
 
 struct Device {
     let phone: Phone
@@ -43,38 +44,60 @@ class DeviceService {
 
     var device: Device?
     
-    func registerDevice(phone: Phone, queue: DispatchQueue, completionHandler: @escaping (Result<Device>) -> Void) {
+    /// The device registered last, as persisted then, or nil if there is none.
+    func cachedDevice(phone: Phone) -> Device? {
+        guard let deviceUrl = UserDefaults.sharedInstance.deviceUrl,
+            let json = UserDefaults.sharedInstance.deviceModel,
+            let model = Mapper<DeviceModel>().map(JSONString: json),
+            model.deviceUrl == deviceUrl else {
+            return nil
+        }
+        let region = UserDefaults.sharedInstance.deviceRegion.flatMap { Mapper<RegionModel>().map(JSONString: $0) }
+        return self.makeDevice(phone: phone, model: model, region: region)
+    }
+    
+    func registerDevice(phone: Phone, queue: DispatchQueue, timeline: StartupTimeline? = nil, completionHandler: @escaping (Result<Device>) -> Void) {
+        // The region doesn't depend on the device, so both are asked for at once.
+        let group = DispatchGroup()
+        var registration: ServiceResponse<DeviceModel>?
+        var region: RegionModel?
         
+        group.enter()
         let registrationHandler: (ServiceResponse<DeviceModel>) -> Void = { response in
+            timeline?.mark(.device)
+            registration = response
+            group.leave()
+        }
+        if let deviceUrl = UserDefaults.sharedInstance.deviceUrl {
+            self.client.update(registeredDeviceUrl: deviceUrl, deviceInfo: UIDevice.current, queue: queue, completionHandler: registrationHandler)
+        }
+        else {
+            self.client.create(deviceInfo: UIDevice.current, queue: queue, completionHandler: registrationHandler)
+        }
+        
+        group.enter()
+        self.client.fetchRegion(queue: queue) { response in
+            timeline?.mark(.region)
+            if let model = response.result.data, model.regionCode != nil, model.countryCode != nil {
+                region = model
+            }
+            group.leave()
+        }
+        
+        group.notify(queue: queue) {
+            guard let response = registration else {
+                return
+            }
             switch response.result {
             case .success(let model):
-                if let deviceUrlString = model.deviceUrl,
-                    let deviceUrl = URL(string: deviceUrlString),
-                    let webSocketUrlString = model.webSocketUrl,
-                    let webSocketUrl = URL(string: webSocketUrlString),
-                    let servicesDictionary = model.services,
-                    let locusServiceUrlString = servicesDictionary["locusServiceUrl"],
-                    let locusServiceUrl = URL(string: locusServiceUrlString),
-                    let conversationServiceUrlString = servicesDictionary["conversationServiceUrl"],
-                    let conversationServiceUrl = URL(string: conversationServiceUrlString),
-                    let calliopeDiscoveryServiceUrlString = servicesDictionary["calliopeDiscoveryServiceUrl"],
-                    let calliopeDiscoveryServiceUrl = URL(string: calliopeDiscoveryServiceUrlString),
-                    let metricsServiceUrlString = servicesDictionary["metricsServiceUrl"],
-                    let metricsServiceUrl = URL(string: metricsServiceUrlString) {
-                    
-                    self.client.fetchRegion(queue: queue) { regionRes in
-                        var regionCode = "US-WEST";
-                        var countryCode = "US";
-                        if let model = regionRes.result.data, let rc = model.regionCode, let cc = model.countryCode {
-                            regionCode = rc
-                            countryCode = cc
-                        }
-                        let device = Device(phone: phone, deviceUrl: deviceUrl, webSocketUrl: webSocketUrl, locusServiceUrl: locusServiceUrl, calliopeDiscoveryServiceUrl: calliopeDiscoveryServiceUrl, metricsServiceUrl: metricsServiceUrl, conversationServiceUrl: conversationServiceUrl, deviceType: UIDevice.current.kind, regionCode: regionCode, countryCode: countryCode)
-                        self.device = device
-                        UserDefaults.sharedInstance.deviceUrl = deviceUrlString
-                        completionHandler(Result.success(device))
-                    }
-                    
+                // Keep the region found last time if the lookup failed.
+                let region = region ?? UserDefaults.sharedInstance.deviceRegion.flatMap { Mapper<RegionModel>().map(JSONString: $0) }
+                if let device = self.makeDevice(phone: phone, model: model, region: region) {
+                    self.device = device
+                    UserDefaults.sharedInstance.deviceUrl = model.deviceUrl
+                    UserDefaults.sharedInstance.deviceModel = model.toJSONString()
+                    UserDefaults.sharedInstance.deviceRegion = region?.toJSONString()
+                    completionHandler(Result.success(device))
                 } else {
                     let error = SparkError.serviceFailed(code: -7000, reason: "Missing required URLs when registering device")
                     SDKLogger.shared.error("Failed to register device", error: error)
@@ -85,13 +108,31 @@ class DeviceService {
                 completionHandler(Result.failure(error))
             }
         }
-        
-        if let deviceUrl = UserDefaults.sharedInstance.deviceUrl {
-            self.client.update(registeredDeviceUrl: deviceUrl, deviceInfo: UIDevice.current, queue: queue, completionHandler: registrationHandler)
+    }
+    
+    private func makeDevice(phone: Phone, model: DeviceModel, region: RegionModel?) -> Device? {
+        guard let deviceUrlString = model.deviceUrl,
+            let deviceUrl = URL(string: deviceUrlString),
+            let webSocketUrlString = model.webSocketUrl,
+            let webSocketUrl = URL(string: webSocketUrlString),
+            let servicesDictionary = model.services,
+            let locusServiceUrlString = servicesDictionary["locusServiceUrl"],
+            let locusServiceUrl = URL(string: locusServiceUrlString),
+            let conversationServiceUrlString = servicesDictionary["conversationServiceUrl"],
+            let conversationServiceUrl = URL(string: conversationServiceUrlString),
+            let calliopeDiscoveryServiceUrlString = servicesDictionary["calliopeDiscoveryServiceUrl"],
+            let calliopeDiscoveryServiceUrl = URL(string: calliopeDiscoveryServiceUrlString),
+            let metricsServiceUrlString = servicesDictionary["metricsServiceUrl"],
+            let metricsServiceUrl = URL(string: metricsServiceUrlString) else {
+            return nil
         }
-        else {
-            self.client.create(deviceInfo: UIDevice.current, queue: queue, completionHandler: registrationHandler)
+        var regionCode = "US-WEST";
+        var countryCode = "US";
+        if let rc = region?.regionCode, let cc = region?.countryCode {
+            regionCode = rc
+            countryCode = cc
         }
+        return Device(phone: phone, deviceUrl: deviceUrl, webSocketUrl: webSocketUrl, locusServiceUrl: locusServiceUrl, calliopeDiscoveryServiceUrl: calliopeDiscoveryServiceUrl, metricsServiceUrl: metricsServiceUrl, conversationServiceUrl: conversationServiceUrl, deviceType: UIDevice.current.kind, regionCode: regionCode, countryCode: countryCode)
     }
     
     func deregisterDevice(queue: DispatchQueue, completionHandler: @escaping (Error?) -> Void) {
@@ -106,6 +147,8 @@ class DeviceService {
                 }
             }
             UserDefaults.sharedInstance.deviceUrl = nil
+            UserDefaults.sharedInstance.deviceModel = nil
+            UserDefaults.sharedInstance.deviceRegion = nil
         } else {
             completionHandler(nil)
         }
@@ -0,0 +1,104 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// Times the phases of `Phone.register`, from the call until the phone can take calls, and
+/// reports them as one metric once every phase is done or `finish` is called.
+///
+/// - note: for internal use only.
+class StartupTimeline {
+    
+    enum Phase: String {
+        case device
+        case region
+        case webSocket
+        case activeCalls
+        case ready
+        
+        static let all: [Phase] = [.device, .region, .webSocket, .activeCalls, .ready]
+    }
+    
+    /// Whether the phone started on the device cached from the last registration.
+    let cached: Bool
+    private let start = Date()
+    private let lock = NSLock()
+    private var phases = [Phase: TimeInterval]()
+    private var finished = false
+    private let report: (StartupTimeline) -> Void
+    
+    init(cached: Bool, report: @escaping (StartupTimeline) -> Void) {
+        self.cached = cached
+        self.report = report
+    }
+    
+    /// Records that `phase` is done. Only the first time counts.
+    func mark(_ phase: Phase) {
+        self.lock.lock()
+        if self.phases[phase] == nil {
+            self.phases[phase] = Date().timeIntervalSince(self.start)
+        }
+        let complete = self.phases.count == Phase.all.count
+        self.lock.unlock()
+        if complete {
+            self.finish()
+        }
+    }
+    
+    /// Seconds from the start of the registration until `phase` was done.
+    func elapsed(_ phase: Phase) -> TimeInterval? {
+        self.lock.lock()
+        defer {
+            self.lock.unlock()
+        }
+        return self.phases[phase]
+    }
+    
+    /// Reports the phases done so far, if not reported yet.
+    func finish() {
+        self.lock.lock()
+        let first = !self.finished
+        self.finished = true
+        self.lock.unlock()
+        if first {
+            SDKLogger.shared.info("Startup timeline: \(self.data)")
+            self.report(self)
+        }
+    }
+    
+    /// Milliseconds per phase, and the mode of the start.
+    var data: [String: String] {
+        var data = ["mode": self.cached ? "cached" : "full"]
+        for phase in Phase.all {
+            if let elapsed = self.elapsed(phase) {
+                data[phase.rawValue] = String(Int(elapsed * 1000))
+            }
+        }
+        return data
+    }
+}
+
+extension MetricsEngine {
+    
+    func trackStartupMetric(_ timeline: StartupTimeline) {
+        self.track(name: Metric.Startup.Timeline, timeline.data)
+    }
+}
@@ -0,0 +1,299 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// Tile based delta coding of screen share frames between the broadcast extension and the app.
+///
+/// A frame is a list of planes, each a block of rows of `rowBytes` bytes. Planes are cut into
+/// tiles of `tileWidth` bytes by `tileRows` rows and every tile is hashed; a delta carries only the
+/// tiles whose hash changed since the last frame sent, a keyframe carries all of them. The
+/// `Decoder` keeps the last rebuilt frame, with the planes laid out one after another without
+/// row padding, and patches the tiles of each delta into it.
+///
+/// Payload: magic, flags, plane count, tile count (UInt32 each), then rowBytes and rows (UInt32)
+/// per plane, then per tile its index (UInt32) and bytes, padded to 4 bytes.
+///
+/// This file is compiled into both SparkSDK and SparkBroadcastExtensionKit.
+///
+/// - note: for internal use only.
+class BroadcastFrameDelta {
+    
+    struct Plane {
+        let base: UnsafeRawPointer
+        let bytesPerRow: Int
+        let rowBytes: Int
+        let rows: Int
+    }
+    
+    static let tileWidth = 64
+    static let tileRows = 16
+    
+    private static let magic: UInt32 = 0x53424654 // "SBFT"
+    private static let keyframeFlag: UInt32 = 1
+    
+    /// The most a frame of `length` bytes can take encoded, with every tile sent.
+    static func capacity(forFrameLength length: Int) -> Int {
+        return length + length / 64 + 4096
+    }
+    
+    private struct Geometry: Equatable {
+        let planes: [(rowBytes: Int, rows: Int)]
+        
+        var length: Int {
+            return self.planes.reduce(0) { $0 + $1.rowBytes * $1.rows }
+        }
+        
+        var tileCount: Int {
+            return self.planes.reduce(0) { $0 + Geometry.columns($1.rowBytes) * Geometry.bands($1.rows) }
+        }
+        
+        static func columns(_ rowBytes: Int) -> Int {
+            return (rowBytes + BroadcastFrameDelta.tileWidth - 1) / BroadcastFrameDelta.tileWidth
+        }
+        
+        static func bands(_ rows: Int) -> Int {
+            return (rows + BroadcastFrameDelta.tileRows - 1) / BroadcastFrameDelta.tileRows
+        }
+        
+        /// Calls `body` with the plane, the first row, the first byte in the row and the size of
+        /// every tile, in index order.
+        func forEachTile(_ body: (_ plane: Int, _ y: Int, _ x: Int, _ width: Int, _ height: Int) -> Void) {
+            for (index, plane) in self.planes.enumerated() {
+                for band in 0..<Geometry.bands(plane.rows) {
+                    let y = band * BroadcastFrameDelta.tileRows
+                    let height = min(BroadcastFrameDelta.tileRows, plane.rows - y)
+                    for column in 0..<Geometry.columns(plane.rowBytes) {
+                        let x = column * BroadcastFrameDelta.tileWidth
+                        body(index, y, x, min(BroadcastFrameDelta.tileWidth, plane.rowBytes - x), height)
+                    }
+                }
+            }
+        }
+        
+        static func == (lhs: Geometry, rhs: Geometry) -> Bool {
+            return lhs.planes.count == rhs.planes.count && !zip(lhs.planes, rhs.planes).contains { $0.rowBytes != $1.rowBytes || $0.rows != $1.rows }
+        }
+    }
+    
+    private static func padded(_ count: Int) -> Int {
+        return (count + 3) & ~3
+    }
+    
+    /// Hashes a tile with four independent multiply-xor lanes over 8 byte words, which the compiler
+    /// keeps in registers side by side. Each step is invertible, so a single changed word always
+    /// changes the hash.
+    static func hash(_ base: UnsafeRawPointer, bytesPerRow: Int, width: Int, height: Int) -> UInt64 {
+        let prime: UInt64 = 0x100000001b3
+        var h0: UInt64 = 0xcbf29ce484222325, h1: UInt64 = 0x84222325cbf29ce4, h2: UInt64 = 0x9e3779b97f4a7c15, h3: UInt64 = 0xc2b2ae3d27d4eb4f
+        let aligned = Int(bitPattern: base) & 7 == 0 && bytesPerRow & 7 == 0
+        for row in 0..<height {
+            let start = base + row * bytesPerRow
+            var i = 0
+            if aligned {
+                while i + 32 <= width {
+                    h0 = (h0 ^ start.load(fromByteOffset: i, as: UInt64.self)) &* prime
+                    h1 = (h1 ^ start.load(fromByteOffset: i + 8, as: UInt64.self)) &* prime
+                    h2 = (h2 ^ start.load(fromByteOffset: i + 16, as: UInt64.self)) &* prime
+                    h3 = (h3 ^ start.load(fromByteOffset: i + 24, as: UInt64.self)) &* prime
+                    i += 32
+                }
+                while i + 8 <= width {
+                    h0 = (h0 ^ start.load(fromByteOffset: i, as: UInt64.self)) &* prime
+                    i += 8
+                }
+            }
+            while i < width {
+                h1 = (h1 ^ UInt64(start.load(fromByteOffset: i, as: UInt8.self))) &* prime
+                i += 1
+            }
+        }
+        return h0 ^ (h1 << 16 | h1 >> 48) ^ (h2 << 32 | h2 >> 32) ^ (h3 << 48 | h3 >> 16)
+    }
+    
+    // MARK: Encoder
+    
+    /// Used by the extension. `prepare` a frame, write it to the ring, and `commit` it once written,
+    /// so a frame dropped for lack of room doesn't become the base of the next delta.
+    class Encoder {
+        
+        struct Delta {
+            fileprivate let planes: [Plane]
+            fileprivate let geometry: Geometry
+            fileprivate let hashes: [UInt64]
+            fileprivate let dirty: [Int]
+            let keyframe: Bool
+            let length: Int
+            
+            var tiles: Int {
+                return self.dirty.count
+            }
+        }
+        
+        let keyframeInterval: Int
+        private var geometry: Geometry?
+        private var hashes: [UInt64] = []
+        private var sinceKeyframe = 0
+        
+        init(keyframeInterval: Int = 60) {
+            self.keyframeInterval = keyframeInterval
+        }
+        
+        func prepare(_ planes: [Plane], keyframe: Bool = false) -> Delta {
+            let geometry = Geometry(planes: planes.map { ($0.rowBytes, $0.rows) })
+            let keyframe = keyframe || geometry != self.geometry || self.sinceKeyframe + 1 >= self.keyframeInterval
+            var hashes = [UInt64]()
+            hashes.reserveCapacity(geometry.tileCount)
+            var dirty = [Int]()
+            var length = 16 + planes.count * 8
+            geometry.forEachTile { plane, y, x, width, height in
+                let index = hashes.count
+                let hash = BroadcastFrameDelta.hash(planes[plane].base + y * planes[plane].bytesPerRow + x, bytesPerRow: planes[plane].bytesPerRow, width: width, height: height)
+                hashes.append(hash)
+                if keyframe || hash != self.hashes[index] {
+                    dirty.append(index)
+                    length += 4 + BroadcastFrameDelta.padded(width * height)
+                }
+            }
+            return Delta(planes: planes, geometry: geometry, hashes: hashes, dirty: dirty, keyframe: keyframe, length: length)
+        }
+        
+        /// Writes the `length` bytes of `delta` to `target`.
+        func write(_ delta: Delta, to target: UnsafeMutableRawPointer) {
+            target.storeBytes(of: BroadcastFrameDelta.magic, as: UInt32.self)
+            target.storeBytes(of: delta.keyframe ? BroadcastFrameDelta.keyframeFlag : 0, toByteOffset: 4, as: UInt32.self)
+            target.storeBytes(of: UInt32(delta.planes.count), toByteOffset: 8, as: UInt32.self)
+            target.storeBytes(of: UInt32(delta.dirty.count), toByteOffset: 12, as: UInt32.self)
+            var offset = 16
+            for plane in delta.planes {
+                target.storeBytes(of: UInt32(plane.rowBytes), toByteOffset: offset, as: UInt32.self)
+                target.storeBytes(of: UInt32(plane.rows), toByteOffset: offset + 4, as: UInt32.self)
+                offset += 8
+            }
+            var index = 0
+            var next = 0
+            delta.geometry.forEachTile { plane, y, x, width, height in
+                defer {
+                    index += 1
+                }
+                guard next < delta.dirty.count, delta.dirty[next] == index else {
+                    return
+                }
+                next += 1
+                target.storeBytes(of: UInt32(index), toByteOffset: offset, as: UInt32.self)
+                offset += 4
+                let source = delta.planes[plane]
+                for row in 0..<height {
+                    memcpy(target + offset + row * width, source.base + (y + row) * source.bytesPerRow + x, width)
+                }
+                offset += BroadcastFrameDelta.padded(width * height)
+            }
+        }
+        
+        func commit(_ delta: Delta) {
+            self.geometry = delta.geometry
+            self.hashes = delta.hashes
+            self.sinceKeyframe = delta.keyframe ? 0 : self.sinceKeyframe + 1
+        }
+    }
+    
+    // MARK: Decoder
+    
+    /// Used by the app. Rebuilds full frames from the payloads the encoder wrote.
+    class Decoder {
+        
+        /// The last frame rebuilt.
+        private(set) var frame = Data()
+        private var geometry: Geometry?
+        private var tiles: [(plane: Int, y: Int, x: Int, width: Int, height: Int)] = []
+        private var planeOffsets: [Int] = []
+        private var next: UInt64?
+        
+        /// Patches the payload of frame `sequence` into `frame`. Returns false when the frame can't
+        /// be rebuilt, because an earlier one was missed or the payload is malformed, in which case
+        /// no delta is taken until the next keyframe.
+        func apply(_ payload: UnsafeRawBufferPointer, sequence: UInt64) -> Bool {
+            guard let base = payload.baseAddress, payload.count >= 16, base.load(as: UInt32.self) == BroadcastFrameDelta.magic else {
+                return self.fail()
+            }
+            let keyframe = base.load(fromByteOffset: 4, as: UInt32.self) & BroadcastFrameDelta.keyframeFlag != 0
+            let planeCount = Int(base.load(fromByteOffset: 8, as: UInt32.self))
+            let tileCount = Int(base.load(fromByteOffset: 12, as: UInt32.self))
+            guard payload.count >= 16 + planeCount * 8 else {
+                return self.fail()
+            }
+            let geometry = Geometry(planes: (0..<planeCount).map {
+                (Int(base.load(fromByteOffset: 16 + $0 * 8, as: UInt32.self)), Int(base.load(fromByteOffset: 20 + $0 * 8, as: UInt32.self)))
+            })
+            if keyframe {
+                if geometry != self.geometry {
+                    self.frame = Data(count: geometry.length)
+                    self.geometry = geometry
+                    self.tiles = []
+                    geometry.forEachTile { self.tiles.append(($0, $1, $2, $3, $4)) }
+                    var start = 0
+                    self.planeOffsets = geometry.planes.map { plane in
+                        defer {
+                            start += plane.rowBytes * plane.rows
+                        }
+                        return start
+                    }
+                }
+            }
+            else if self.next != sequence || geometry != self.geometry {
+                return self.fail()
+            }
+            let tiles = self.tiles
+            let planeOffsets = self.planeOffsets
+            var offset = 16 + planeCount * 8
+            let complete: Bool = self.frame.withUnsafeMutableBytes { (bytes: UnsafeMutablePointer<UInt8>) in
+                let target = UnsafeMutableRawPointer(bytes)
+                for _ in 0..<tileCount {
+                    guard offset + 4 <= payload.count else {
+                        return false
+                    }
+                    let index = Int(base.load(fromByteOffset: offset, as: UInt32.self))
+                    guard index < tiles.count, offset + 4 + tiles[index].width * tiles[index].height <= payload.count else {
+                        return false
+                    }
+                    offset += 4
+                    let tile = tiles[index]
+                    let rowBytes = geometry.planes[tile.plane].rowBytes
+                    for row in 0..<tile.height {
+                        memcpy(target + planeOffsets[tile.plane] + (tile.y + row) * rowBytes + tile.x, base + offset + row * tile.width, tile.width)
+                    }
+                    offset += BroadcastFrameDelta.padded(tile.width * tile.height)
+                }
+                return true
+            }
+            guard complete else {
+                return self.fail()
+            }
+            self.next = sequence + 1
+            return true
+        }
+        
+        private func fail() -> Bool {
+            self.next = nil
+            return false
+        }
+    }
+}
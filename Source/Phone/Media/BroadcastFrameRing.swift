@@ -0,0 +1,310 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// A ring of frame slots in a memory mapped file shared by the broadcast extension and the
+/// containing app.
+///
+/// The extension writes each frame straight into a free slot and only sends the small
+/// `Descriptor` of the frame over the broadcast socket; the app reads the frame in place. The
+/// ring header holds how many frames were written and how many the app let go of, so the
+/// extension only writes while it has a credit (a free slot) and drops frames otherwise, without
+/// waiting for a feedback message. Frames are delta coded with `BroadcastFrameDelta`, so the app
+/// reads every frame, and asks for a keyframe through the header when one went missing.
+///
+/// The file is created by the app and opened by the extension. Only plain POSIX calls are used, and
+/// the header is guarded by `flock`, so two instances in one process behave as two processes would.
+///
+/// This file is compiled into both SparkSDK and SparkBroadcastExtensionKit.
+///
+/// - note: for internal use only.
+class BroadcastFrameRing {
+    
+    /// What the extension sends over the socket for every frame in the ring.
+    struct Descriptor {
+        
+        static let size = 40
+        
+        private static let magic: UInt32 = 0x53424644 // "SBFD"
+        
+        let sequence: UInt64
+        let slot: UInt32
+        let width: Int32
+        let height: Int32
+        let length: UInt32
+        /// `DispatchTime` uptime in nanoseconds, which is the same clock in both processes.
+        let captured: UInt64
+        
+        init(sequence: UInt64, slot: UInt32, width: Int32, height: Int32, length: UInt32, captured: UInt64) {
+            self.sequence = sequence
+            self.slot = slot
+            self.width = width
+            self.height = height
+            self.length = length
+            self.captured = captured
+        }
+        
+        init?(data: Data) {
+            guard data.count == Descriptor.size else {
+                return nil
+            }
+            let fields: Descriptor? = data.withUnsafeBytes { (bytes: UnsafePointer<UInt8>) in
+                let raw = UnsafeRawPointer(bytes)
+                guard raw.load(as: UInt32.self) == Descriptor.magic else {
+                    return nil
+                }
+                return Descriptor(sequence: raw.load(fromByteOffset: 8, as: UInt64.self),
+                                  slot: raw.load(fromByteOffset: 4, as: UInt32.self),
+                                  width: raw.load(fromByteOffset: 16, as: Int32.self),
+                                  height: raw.load(fromByteOffset: 20, as: Int32.self),
+                                  length: raw.load(fromByteOffset: 24, as: UInt32.self),
+                                  captured: raw.load(fromByteOffset: 32, as: UInt64.self))
+            }
+            guard let descriptor = fields else {
+                return nil
+            }
+            self = descriptor
+        }
+        
+        /// How long ago the frame was captured.
+        var age: TimeInterval {
+            return Double(BroadcastFrameRing.now() &- self.captured) / 1_000_000_000
+        }
+        
+        var data: Data {
+            var data = Data(count: Descriptor.size)
+            data.withUnsafeMutableBytes { (bytes: UnsafeMutablePointer<UInt8>) in
+                let raw = UnsafeMutableRawPointer(bytes)
+                raw.storeBytes(of: Descriptor.magic, as: UInt32.self)
+                raw.storeBytes(of: self.slot, toByteOffset: 4, as: UInt32.self)
+                raw.storeBytes(of: self.sequence, toByteOffset: 8, as: UInt64.self)
+                raw.storeBytes(of: self.width, toByteOffset: 16, as: Int32.self)
+                raw.storeBytes(of: self.height, toByteOffset: 20, as: Int32.self)
+                raw.storeBytes(of: self.length, toByteOffset: 24, as: UInt32.self)
+                raw.storeBytes(of: self.captured, toByteOffset: 32, as: UInt64.self)
+            }
+            return data
+        }
+    }
+    
+    struct Statistics {
+        var written = 0
+        /// Frames the writer had no free slot for.
+        var dropped = 0
+        var read = 0
+        /// Frames the reader found overwritten.
+        var lost = 0
+    }
+    
+    static let fileName = "BroadcastFrames"
+    
+    private static let magic: UInt32 = 0x53424652 // "SBFR"
+    private static let version: UInt32 = 1
+    // Header: magic, version, slot count, slot capacity, written (UInt64), released (UInt64),
+    // keyframe requests (UInt64).
+    private static let writtenOffset = 16
+    private static let releasedOffset = 24
+    private static let keyframeRequestsOffset = 32
+    // Slot header: sequence (UInt64), then the payload at a cache line boundary.
+    private static let slotHeaderSize = 64
+    
+    let slotCount: Int
+    let slotCapacity: Int
+    
+    private(set) var statistics = Statistics()
+    
+    private let fd: Int32
+    private let base: UnsafeMutableRawPointer
+    private let mappedSize: Int
+    private let slotsOffset: Int
+    private let slotStride: Int
+    private let lock = NSLock()
+    // Reader side: frames handed out and not released yet, and the next sequence not seen yet.
+    private var held = Set<UInt64>()
+    private var seen: UInt64 = 0
+    
+    /// Creates (or truncates) the ring file at `path`. Used by the app.
+    convenience init?(creatingAt path: String, slotCount: Int = 3, slotCapacity: Int) {
+        let fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0o600)
+        guard fd >= 0 else {
+            return nil
+        }
+        let stride = BroadcastFrameRing.stride(slotCapacity)
+        let size = BroadcastFrameRing.slotsOffset + slotCount * stride
+        guard ftruncate(fd, off_t(size)) == 0 else {
+            close(fd)
+            return nil
+        }
+        self.init(fd: fd, size: size)
+        self.base.storeBytes(of: UInt32(slotCount), toByteOffset: 8, as: UInt32.self)
+        self.base.storeBytes(of: UInt32(slotCapacity), toByteOffset: 12, as: UInt32.self)
+        self.base.storeBytes(of: BroadcastFrameRing.version, toByteOffset: 4, as: UInt32.self)
+        // Written last, so an extension opening the file early doesn't take a half made header.
+        self.base.storeBytes(of: BroadcastFrameRing.magic, as: UInt32.self)
+        msync(self.base, BroadcastFrameRing.slotsOffset, MS_SYNC)
+    }
+    
+    /// Opens the ring file the app created at `path`. Used by the extension.
+    convenience init?(openingAt path: String) {
+        let fd = open(path, O_RDWR)
+        guard fd >= 0 else {
+            return nil
+        }
+        var info = stat()
+        guard fstat(fd, &info) == 0, Int(info.st_size) >= BroadcastFrameRing.slotsOffset else {
+            close(fd)
+            return nil
+        }
+        self.init(fd: fd, size: Int(info.st_size))
+        guard self.base.load(as: UInt32.self) == BroadcastFrameRing.magic,
+            self.base.load(fromByteOffset: 4, as: UInt32.self) == BroadcastFrameRing.version,
+            BroadcastFrameRing.slotsOffset + self.slotCount * self.slotStride <= self.mappedSize else {
+            return nil
+        }
+    }
+    
+    private init?(fd: Int32, size: Int) {
+        guard let base = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0), base != MAP_FAILED else {
+            close(fd)
+            return nil
+        }
+        self.fd = fd
+        self.base = base
+        self.mappedSize = size
+        self.slotsOffset = BroadcastFrameRing.slotsOffset
+        self.slotCount = Int(base.load(fromByteOffset: 8, as: UInt32.self))
+        self.slotCapacity = Int(base.load(fromByteOffset: 12, as: UInt32.self))
+        self.slotStride = BroadcastFrameRing.stride(self.slotCapacity)
+    }
+    
+    deinit {
+        munmap(self.base, self.mappedSize)
+        close(self.fd)
+    }
+    
+    private static var slotsOffset: Int {
+        return Int(getpagesize())
+    }
+    
+    private static func stride(_ capacity: Int) -> Int {
+        return (slotHeaderSize + capacity + 63) & ~63
+    }
+    
+    static func now() -> UInt64 {
+        return DispatchTime.now().uptimeNanoseconds
+    }
+    
+    // MARK: Writer
+    
+    /// Copies a frame of `length` bytes into the next free slot with `fill`, and returns the
+    /// descriptor to send to the app. Returns nil, dropping the frame, when no slot is free.
+    func write(width: Int32, height: Int32, length: Int, captured: UInt64 = BroadcastFrameRing.now(), fill: (UnsafeMutableRawPointer) -> Void) -> Descriptor? {
+        let (written, released) = self.header()
+        guard length <= self.slotCapacity, written - released < UInt64(self.slotCount) else {
+            self.statistics.dropped += 1
+            return nil
+        }
+        // The slot is free until `written` moves past it, so it's filled without the lock.
+        let slot = Int(written % UInt64(self.slotCount))
+        let start = self.base + self.slotsOffset + slot * self.slotStride
+        fill(start + BroadcastFrameRing.slotHeaderSize)
+        start.storeBytes(of: written, as: UInt64.self)
+        self.update(BroadcastFrameRing.writtenOffset, to: written + 1)
+        self.statistics.written += 1
+        return Descriptor(sequence: written, slot: UInt32(slot), width: width, height: height, length: UInt32(length), captured: captured)
+    }
+    
+    // MARK: Reader
+    
+    /// Returns the bytes of the frame `descriptor` points at, or nil if the frame is gone. The slot
+    /// stays taken until `release` is called with the descriptor.
+    func read(_ descriptor: Descriptor) -> UnsafeRawBufferPointer? {
+        guard Int(descriptor.slot) < self.slotCount, Int(descriptor.length) <= self.slotCapacity else {
+            return nil
+        }
+        let start = self.base + self.slotsOffset + Int(descriptor.slot) * self.slotStride
+        self.lock.lock()
+        defer {
+            self.lock.unlock()
+        }
+        self.seen = max(self.seen, descriptor.sequence + 1)
+        guard start.load(as: UInt64.self) == descriptor.sequence else {
+            self.statistics.lost += 1
+            self.advance()
+            return nil
+        }
+        self.held.insert(descriptor.sequence)
+        self.statistics.read += 1
+        return UnsafeRawBufferPointer(start: start + BroadcastFrameRing.slotHeaderSize, count: Int(descriptor.length))
+    }
+    
+    /// Hands the slot of a frame returned by `read` back to the writer. Frames can be released in
+    /// any order; a slot frees up once all older frames were released too.
+    func release(_ descriptor: Descriptor) {
+        self.lock.lock()
+        defer {
+            self.lock.unlock()
+        }
+        self.held.remove(descriptor.sequence)
+        self.advance()
+    }
+    
+    /// Asks the writer for a frame that doesn't depend on earlier ones.
+    func requestKeyframe() {
+        self.update(BroadcastFrameRing.keyframeRequestsOffset, to: self.keyframeRequests + 1)
+    }
+    
+    /// How many times the reader asked for a keyframe so far.
+    var keyframeRequests: UInt64 {
+        flock(self.fd, LOCK_SH)
+        defer {
+            flock(self.fd, LOCK_UN)
+        }
+        return self.base.load(fromByteOffset: BroadcastFrameRing.keyframeRequestsOffset, as: UInt64.self)
+    }
+    
+    // Must hold the lock. Frames never seen, lost or skipped, are released along with newer ones.
+    private func advance() {
+        let header = self.header()
+        let released = min(self.held.min() ?? self.seen, header.written)
+        if released > header.released {
+            self.update(BroadcastFrameRing.releasedOffset, to: released)
+        }
+    }
+    
+    // MARK: Header
+    
+    private func header() -> (written: UInt64, released: UInt64) {
+        flock(self.fd, LOCK_SH)
+        defer {
+            flock(self.fd, LOCK_UN)
+        }
+        return (self.base.load(fromByteOffset: BroadcastFrameRing.writtenOffset, as: UInt64.self),
+                self.base.load(fromByteOffset: BroadcastFrameRing.releasedOffset, as: UInt64.self))
+    }
+    
+    private func update(_ offset: Int, to value: UInt64) {
+        flock(self.fd, LOCK_EX)
+        self.base.storeBytes(of: value, toByteOffset: offset, as: UInt64.self)
+        flock(self.fd, LOCK_UN)
+    }
+}
@@ -35,13 +35,6 @@ class MediaEngineWrapper {
         mediaEngineObserver.startObserving()
     }
 
-    func performReachabilityCheck(_ clusterInfo: [AnyHashable:Any], completionHandler: @escaping ReachabilityCheckHandler) {
-        mediaEngine?.performStunReachabilityCheck(clusterInfo) {
-            result in
-            completionHandler(result)
-        }
-    }
-    
     func clearReachabilityData() {
         mediaEngine?.clearReachabilityData()
     }
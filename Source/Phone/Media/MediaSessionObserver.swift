@@ -80,6 +80,7 @@ class MediaSessionObserver: NotificationObserver {
     @objc private func onMediaEngineDidChangeRemoteViewSize(_ notification: Notification) {
         DispatchQueue.main.async {
             if let retainCall = self.call {
+                retainCall.mediaSession.trackSetup(call: retainCall, firstPacket: true)
                 retainCall.onMediaChanged?(Call.MediaChangedEvent.remoteVideoViewSize)
             }
         }
@@ -0,0 +1,197 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import AVFoundation
+
+/// Keeps a media session warm for each `MediaOption` profile the phone is likely to call with:
+/// configured with the phone's bandwidths, its media connection created and its local SDP offer
+/// made, so dial and answer only attach their views and send the offer.
+///
+/// Sessions are warmed on the main queue one at a time, and only while there is no call, as the
+/// media engine runs one call at a time. For the same reason all of them are dropped once a call
+/// is dialed or answered, whether or not it took one, and warmed again after the call. Sessions warmed with
+/// bandwidths that have changed since are dropped and warmed again.
+///
+/// An offer carries the ICE candidates of the interfaces it was made on, so the phone invalidates
+/// the pool when the network changes and when the app becomes active. Changes missed in between
+/// are covered by `maxAge`: older sessions are not handed out, and are warmed again.
+///
+/// - note: for internal use only.
+class MediaSessionPool {
+    
+    enum Profile {
+        case audio
+        case audioVideo
+        case audioVideoShare
+        
+        init(option: MediaOption) {
+            if option.hasVideo && option.hasScreenShare {
+                self = .audioVideoShare
+            }
+            else if option.hasVideo {
+                self = .audioVideo
+            }
+            else {
+                self = .audio
+            }
+        }
+        
+        var hasVideo: Bool {
+            return self != .audio
+        }
+        
+        var hasScreenShare: Bool {
+            return self == .audioVideoShare
+        }
+    }
+    
+    /// What a session is configured with when warmed, as opposed to applied when handed out.
+    struct Settings: Equatable {
+        let audioMaxBandwidth: UInt32
+        let videoMaxBandwidth: UInt32
+        let screenShareMaxBandwidth: UInt32
+        
+        init(phone: Phone) {
+            self.audioMaxBandwidth = phone.audioMaxBandwidth
+            self.videoMaxBandwidth = phone.videoMaxBandwidth
+            self.screenShareMaxBandwidth = phone.screenShareMaxBandwidth
+        }
+        
+        static func ==(lhs: Settings, rhs: Settings) -> Bool {
+            return lhs.audioMaxBandwidth == rhs.audioMaxBandwidth && lhs.videoMaxBandwidth == rhs.videoMaxBandwidth && lhs.screenShareMaxBandwidth == rhs.screenShareMaxBandwidth
+        }
+    }
+    
+    /// How long a warm session's offer is trusted.
+    static let defaultMaxAge = TimeInterval(300)
+    
+    /// Whether sessions are warmed and handed out; when not, every call builds its own as before.
+    var enabled = true {
+        didSet {
+            self.invalidate()
+        }
+    }
+    
+    /// Whether the media access needed for a profile was granted; sessions are only warmed then.
+    var authorized: (Profile) -> Bool = { profile in
+        return AVCaptureDevice.authorizationStatus(for: AVMediaType.audio) == .authorized
+            && (!profile.hasVideo || AVCaptureDevice.authorizationStatus(for: AVMediaType.video) == .authorized)
+    }
+    
+    var maxAge = MediaSessionPool.defaultMaxAge
+    
+    // Screen share is only warmed once the app made a call with it.
+    private(set) var profiles: [Profile] = [.audioVideo, .audio]
+    private var sessions = [Profile: (session: MediaSessionWrapper, settings: Settings, date: Date)]()
+    private weak var phone: Phone?
+    private var active = false
+    private var scheduled = false
+    
+    init(phone: Phone) {
+        self.phone = phone
+    }
+    
+    /// The settings of the warm session for `profile`, if there is one.
+    func settings(of profile: Profile) -> Settings? {
+        return self.sessions[profile]?.settings
+    }
+    
+    /// Starts keeping sessions warm. Must be called on the main queue, as all of the following.
+    func start() {
+        self.active = true
+        self.refill()
+    }
+    
+    /// Drops the warm sessions and stops warming new ones.
+    func stop() {
+        self.active = false
+        self.drop()
+    }
+    
+    /// Drops the warm sessions, to be warmed again with the current settings and network.
+    func invalidate() {
+        self.drop()
+        self.refill()
+    }
+    
+    /// Drops the warm sessions as a call is dialed or answered. Call `refill` once the call is over.
+    func suspend() {
+        self.drop()
+    }
+    
+    /// Hands out the warm session for the profile of `option`, if there is one configured with the
+    /// current settings and younger than `maxAge`, and drops the others. Call `refill` once the call is over.
+    func take(option: MediaOption) -> MediaSessionWrapper? {
+        let profile = Profile(option: option)
+        if !self.profiles.contains(profile) {
+            self.profiles.append(profile)
+        }
+        let entry = self.sessions.removeValue(forKey: profile)
+        self.drop()
+        guard let taken = entry else {
+            return nil
+        }
+        guard self.enabled, let phone = self.phone, taken.settings == Settings(phone: phone), !self.expired(taken.date) else {
+            taken.session.stopMedia()
+            return nil
+        }
+        return taken.session
+    }
+    
+    /// Warms the sessions missing, one per main queue turn so as not to hold up the UI.
+    func refill() {
+        guard self.active && self.enabled && !self.scheduled else {
+            return
+        }
+        self.scheduled = true
+        DispatchQueue.main.async {
+            self.scheduled = false
+            guard self.active && self.enabled, let phone = self.phone, !phone.hasCalls else {
+                return
+            }
+            for (profile, entry) in self.sessions where self.expired(entry.date) {
+                entry.session.stopMedia()
+                self.sessions[profile] = nil
+            }
+            let settings = Settings(phone: phone)
+            guard let profile = self.profiles.first(where: { self.sessions[$0] == nil && self.authorized($0) }) else {
+                return
+            }
+            let session = MediaSessionWrapper()
+            session.warm(profile: profile, phone: phone)
+            self.sessions[profile] = (session, settings, Date())
+            SDKLogger.shared.debug("Warmed media session for \(profile)")
+            self.refill()
+        }
+    }
+    
+    private func expired(_ date: Date) -> Bool {
+        return Date().timeIntervalSince(date) > self.maxAge
+    }
+    
+    private func drop() {
+        for entry in self.sessions.values {
+            entry.session.stopMedia()
+        }
+        self.sessions.removeAll()
+    }
+}
@@ -40,10 +40,40 @@ class MediaSessionWrapper {
     fileprivate let mediaSession = MediaSession()
     private var mediaSessionObserver: MediaSessionObserver?
     private var broadcastServer: BroadcastConnectionServer?
+    private var frameRing: BroadcastFrameRing?
+    private var frameDecoder = BroadcastFrameDelta.Decoder()
+    // Frames older than this are dropped rather than shared late.
+    private static let maxFrameAge: TimeInterval = 0.2
+    
+    // Set while this session was warmed by the pool and not handed out yet.
+    private(set) var warmed: (profile: MediaSessionPool.Profile, offer: String)?
+    private(set) var setup: Setup?
+    
+    /// When each step from dial or answer to the first media of a call happened, for the
+    /// time-to-first-packet metric. The media engine tells nothing about packets, so the first
+    /// packet is taken to be the first remote video frame, or the start of media for audio only.
+    struct Setup {
+        let started = Date()
+        let pooled: Bool
+        var offered: Date?
+        var connected: Date?
+        var firstPacket: Date?
+        var reported = false
+        
+        init(pooled: Bool) {
+            self.pooled = pooled
+        }
+    }
     
     // MARK: - SDP
     func getLocalSdp() -> String {
+        if let warmed = self.warmed {
+            self.warmed = nil
+            self.setup?.offered = Date()
+            return warmed.offer
+        }
         mediaSession.createLocalSdpOffer()
+        self.setup?.offered = Date()
         return mediaSession.localSdpOffer
     }
     
@@ -211,44 +241,101 @@ class MediaSessionWrapper {
         if self.status == .preview {
             self.stopPreview()
         }
-        if self.status == .initial {
-            self.status = .prepare
-            
-            let mediaConfig :MediaCapabilityConfig = MediaCapabilityConfig()
-            mediaConfig.audioMaxBandwidth = phone.audioMaxBandwidth
-            
-            if option.hasVideo && option.hasScreenShare {
-                mediaConfig.videoMaxBandwidth = phone.videoMaxBandwidth
-                mediaConfig.screenShareMaxBandwidth = phone.screenShareMaxBandwidth
-                mediaSession.mediaConstraint = MediaConstraint(constraint: MediaConstraintFlag.audio.rawValue | MediaConstraintFlag.video.rawValue | MediaConstraintFlag.screenShare.rawValue, withCapability:mediaConfig)
-                mediaSession.localVideoView = option.localVideoView
-                mediaSession.remoteVideoView = option.remoteVideoView
-                mediaSession.screenShareView = option.screenShareView
-            }
-            else if option.hasVideo {
-                mediaConfig.videoMaxBandwidth = phone.videoMaxBandwidth
-                mediaSession.mediaConstraint = MediaConstraint(constraint: MediaConstraintFlag.audio.rawValue | MediaConstraintFlag.video.rawValue, withCapability:mediaConfig)
-                mediaSession.localVideoView = option.localVideoView
-                mediaSession.remoteVideoView = option.remoteVideoView
-            }
-            else {
-                mediaSession.mediaConstraint = MediaConstraint(constraint: MediaConstraintFlag.audio.rawValue, withCapability:mediaConfig)
-            }
-            mediaSession.createMediaConnection()
+        if self.status == .prepare, let warmed = self.warmed, warmed.profile == MediaSessionPool.Profile(option: option) {
+            self.setup = Setup(pooled: true)
+            // The camera and speaker may have changed since, and are cheap to apply.
             mediaSession.setDefaultCamera(phone.defaultFacingMode == Phone.FacingMode.user)
             mediaSession.setDefaultAudioOutput(phone.defaultLoudSpeaker)
-            
-            if let appGroupID = option.applicationGroupIdentifier, let _ = FileManager.default.containerURL(forSecurityApplicationGroupIdentifier: appGroupID) {
-                self.broadcastServer = BroadcastConnectionServer(applicationGroupIdentifier: appGroupID, delegate: self)
-            } else {
-                SDKLogger.shared.error("Fail to create broadcast server: Illegal Application Group Identifier.")
+            self.attach(option: option)
+        }
+        else if self.status == .initial {
+            self.setup = Setup(pooled: false)
+            self.attach(option: option)
+            self.configure(hasVideo: option.hasVideo, hasScreenShare: option.hasScreenShare, phone: phone)
+        }
+    }
+    
+    /// Configures the session for `profile` and creates its local SDP offer ahead of a call.
+    func warm(profile: MediaSessionPool.Profile, phone: Phone) {
+        guard self.status == .initial else {
+            return
+        }
+        self.configure(hasVideo: profile.hasVideo, hasScreenShare: profile.hasScreenShare, phone: phone)
+        mediaSession.createLocalSdpOffer()
+        self.warmed = (profile, mediaSession.localSdpOffer)
+    }
+    
+    private func configure(hasVideo: Bool, hasScreenShare: Bool, phone: Phone) {
+        self.status = .prepare
+        
+        let mediaConfig :MediaCapabilityConfig = MediaCapabilityConfig()
+        mediaConfig.audioMaxBandwidth = phone.audioMaxBandwidth
+        
+        if hasVideo && hasScreenShare {
+            mediaConfig.videoMaxBandwidth = phone.videoMaxBandwidth
+            mediaConfig.screenShareMaxBandwidth = phone.screenShareMaxBandwidth
+            mediaSession.mediaConstraint = MediaConstraint(constraint: MediaConstraintFlag.audio.rawValue | MediaConstraintFlag.video.rawValue | MediaConstraintFlag.screenShare.rawValue, withCapability:mediaConfig)
+        }
+        else if hasVideo {
+            mediaConfig.videoMaxBandwidth = phone.videoMaxBandwidth
+            mediaSession.mediaConstraint = MediaConstraint(constraint: MediaConstraintFlag.audio.rawValue | MediaConstraintFlag.video.rawValue, withCapability:mediaConfig)
+        }
+        else {
+            mediaSession.mediaConstraint = MediaConstraint(constraint: MediaConstraintFlag.audio.rawValue, withCapability:mediaConfig)
+        }
+        mediaSession.createMediaConnection()
+        mediaSession.setDefaultCamera(phone.defaultFacingMode == Phone.FacingMode.user)
+        mediaSession.setDefaultAudioOutput(phone.defaultLoudSpeaker)
+    }
+    
+    // The views are only known at dial or answer. A warmed session gets them after its connection
+    // was created, which is fine as nothing is rendered before the media starts.
+    private func attach(option: MediaOption) {
+        if option.hasVideo {
+            mediaSession.localVideoView = option.localVideoView
+            mediaSession.remoteVideoView = option.remoteVideoView
+        }
+        if option.hasVideo && option.hasScreenShare {
+            mediaSession.screenShareView = option.screenShareView
+        }
+        
+        if let appGroupID = option.applicationGroupIdentifier, let container = FileManager.default.containerURL(forSecurityApplicationGroupIdentifier: appGroupID) {
+            self.broadcastServer = BroadcastConnectionServer(applicationGroupIdentifier: appGroupID, delegate: self)
+            // Room for one full screen 4:2:0 keyframe per slot; larger frames still go over the socket.
+            let screen = UIScreen.main.nativeBounds.size
+            let capacity = BroadcastFrameDelta.capacity(forFrameLength: Int(screen.width * screen.height) * 3 / 2)
+            self.frameRing = BroadcastFrameRing(creatingAt: container.appendingPathComponent(BroadcastFrameRing.fileName).path, slotCapacity: capacity)
+            self.frameDecoder = BroadcastFrameDelta.Decoder()
+            if self.frameRing == nil {
+                SDKLogger.shared.warn("Fail to create broadcast frame ring, frames will be sent over the socket.")
             }
+        } else {
+            SDKLogger.shared.error("Fail to create broadcast server: Illegal Application Group Identifier.")
+        }
+    }
+    
+    /// Reports the setup of the media for `call`, once: on its first remote media, or when the media
+    /// stops before there was any.
+    func trackSetup(call: Call, firstPacket: Bool) {
+        guard var setup = self.setup, !setup.reported else {
+            return
+        }
+        if firstPacket {
+            setup.firstPacket = Date()
         }
+        setup.reported = true
+        self.setup = setup
+        call.device.phone.metrics.trackMediaSetupMetric(call: call, setup: setup)
     }
     
     func startMedia(call: Call) {
         if self.status == .prepare {
             self.status = .running
+            self.warmed = nil
+            self.setup?.connected = Date()
+            if !self.hasVideo {
+                self.trackSetup(call: call, firstPacket: true)
+            }
             mediaSessionObserver = MediaSessionObserver(call: call)
             mediaSessionObserver?.startObserving(mediaSession)
             mediaSession.connectToCloud()
@@ -262,11 +349,13 @@ class MediaSessionWrapper {
     }
     
     func stopMedia() {
+        self.warmed = nil
         mediaSessionObserver?.stopObserving()
         mediaSession.disconnectFromCloud()
         self.status = .initial
         self.stopBroadcasting()
         self.broadcastServer?.invalidate()
+        self.frameRing = nil
     }
     
     func updateMedia(mediaType:MediaType) {
@@ -348,7 +437,30 @@ extension MediaSessionWrapper : BroadcastConnectionServerDelegate {
 
     public func didReceivedFrame(_ frame: FrameInfo, frameData: Data!) {
         if self.isSharingScreen {
-            self.onReceiveScreenBroadcastMessage(frameInfo: frame, frameData: frameData)
+            if let ring = self.frameRing, let descriptor = BroadcastFrameRing.Descriptor(data: frameData) {
+                // Even a stale frame is patched in, later deltas build on it.
+                var rebuilt = false
+                if let payload = ring.read(descriptor) {
+                    rebuilt = self.frameDecoder.apply(payload, sequence: descriptor.sequence)
+                    ring.release(descriptor)
+                }
+                guard rebuilt else {
+                    ring.requestKeyframe()
+                    return
+                }
+                guard descriptor.age <= MediaSessionWrapper.maxFrameAge else {
+                    return
+                }
+                var info = frame
+                info.width = descriptor.width
+                info.height = descriptor.height
+                info.length = UInt32(self.frameDecoder.frame.count)
+                // Data is copied on write, so the decoder doesn't patch a frame still being encoded.
+                self.onReceiveScreenBroadcastMessage(frameInfo: info, frameData: self.frameDecoder.frame)
+            }
+            else {
+                self.onReceiveScreenBroadcastMessage(frameInfo: frame, frameData: frameData)
+            }
         }
     }
 
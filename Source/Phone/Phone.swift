@@ -72,21 +72,39 @@ public class Phone {
     /// if 0, default value of 64 * 1000 is used.
     ///
     /// - since: 1.3.0
-    public var audioMaxBandwidth: UInt32 = DefaultBandwidth.maxBandwidthAudio.rawValue
+    public var audioMaxBandwidth: UInt32 = DefaultBandwidth.maxBandwidthAudio.rawValue {
+        didSet {
+            DispatchQueue.main.async {
+                self.mediaPool.invalidate()
+            }
+        }
+    }
     
     /// The max bandwidth for video in unit bps for the call.
     /// Only effective if set before the start of call.
     /// if 0, default value of 2000*1000 is used.
     ///
     /// - since: 1.3.0
-    public var videoMaxBandwidth: UInt32 = DefaultBandwidth.maxBandwidth720p.rawValue
+    public var videoMaxBandwidth: UInt32 = DefaultBandwidth.maxBandwidth720p.rawValue {
+        didSet {
+            DispatchQueue.main.async {
+                self.mediaPool.invalidate()
+            }
+        }
+    }
     
     /// The max bandwidth for screen sharing in unit bps for the call.
     /// Only effective if set before the start of call.
     /// if 0, default value of 4000*1000 is used.
     ///
     /// - since: 1.3.0
-    public var screenShareMaxBandwidth: UInt32 = DefaultBandwidth.maxBandwidthSession.rawValue
+    public var screenShareMaxBandwidth: UInt32 = DefaultBandwidth.maxBandwidthSession.rawValue {
+        didSet {
+            DispatchQueue.main.async {
+                self.mediaPool.invalidate()
+            }
+        }
+    }
     
     /// Default camera facing mode of this phone, used as the default when dialing or answering a call.
     /// The default mode is the front camera.
@@ -119,24 +137,42 @@ public class Phone {
         return self.devices.device != nil
     }
     
+    var hasCalls: Bool {
+        return !self.calls.isEmpty
+    }
+    
     let authenticator: Authenticator
     let reachability: ReachabilityService
     let client: CallClient
     let conversations: ConversationClient
     let prompter: H264LicensePrompter
+    // Device-level lane: registration and the creation of incoming calls. Each call runs its
+    // locus operations on its own `Call.queue`, so a slow request for one call holds up nobody else.
     let queue = SerialQueue()
     let metrics: MetricsEngine
     private(set) var messages: MessageClientImpl?
     
     private let devices: DeviceService
     private let webSocket: WebSocketService
-    private var calls = [String: Call]()
+    // Calls are added and removed from their own queues and the device lane.
+    private let callsLock = NSLock()
+    private var _calls = [String: Call]()
     private var mediaContext: MediaSessionWrapper?
+    private var pendingRegistration: ((Error?) -> Void)?
+    private(set) lazy var mediaPool: MediaSessionPool = MediaSessionPool(phone: self)
     
     var debug = true;
     
+    private var calls: [String: Call] {
+        self.callsLock.lock()
+        defer {
+            self.callsLock.unlock()
+        }
+        return self._calls
+    }
+    
     enum LocusResult {
-        case call(Bool, Device, UUID?, MediaSessionWrapper, ServiceResponse<CallModel>, (Result<Call>) -> Void)
+        case call(Bool, Device, UUID?, MediaSessionWrapper, SerialQueue, ServiceResponse<CallModel>, (Result<Call>) -> Void)
         case join(Call, ServiceResponse<CallModel>, (Error?) -> Void)
         case leave(Call, ServiceResponse<CallModel>, (Error?) -> Void)
         case reject(Call, ServiceResponse<Any>, (Error?) -> Void)
@@ -167,6 +203,10 @@ public class Phone {
         self.webSocket = webSocket
         self.webSocket.onEvent = { [weak self] event in
             if let strong = self {
+                if case .recvCall(let model) = event {
+                    strong.route(model)
+                    return
+                }
                 strong.queue.underlying.async {
                     switch event {
                     case .recvCall(let model):
@@ -196,43 +236,53 @@ public class Phone {
     /// Registers this phone to Cisco Spark cloud on behalf of the authenticated user.
     /// It also creates the websocket and connects to Cisco Spark cloud.
     /// Subsequent invocations of this method refresh the registration.
+    /// If this phone was registered before, it connects with that registration right away and refreshes it in the background.
     ///
     /// - parameter completionHandler: A closure to be executed when completed, with error if the invocation is illegal or failed, otherwise nil.
     /// - returns: Void
     /// - since: 1.2.0
     public func register(_ completionHandler: @escaping ((Error?) -> Void)) {
         self.queue.sync {
-            self.devices.registerDevice(phone: self, queue: self.queue.underlying) { result in
-                switch result {
-                case .success(let device):
-                    if let messages = self.messages {
-                        messages.deviceUrl = device.deviceUrl
+            let cached = self.devices.cachedDevice(phone: self)
+            let timeline = StartupTimeline(cached: cached != nil) { [weak self] timeline in
+                self?.metrics.trackStartupMetric(timeline)
+            }
+            if let cached = cached {
+                // Come up on the device registered last time, and confirm it while the websocket connects.
+                SDKLogger.shared.info("Register with cached device: \(cached.deviceUrl)")
+                self.devices.device = cached
+                self.devices.registerDevice(phone: self, queue: self.queue.underlying, timeline: timeline) { result in
+                    self.queue.sync {
+                        self.reconcile(result, cached: cached, timeline: timeline)
+                    }
+                }
+                self.start(device: cached, timeline: timeline) { error in
+                    if error == nil {
+                        self.ready(error: nil, timeline: timeline, completionHandler: completionHandler)
                     }
                     else {
-                        self.messages = MessageClientImpl(authenticator: self.authenticator, deviceUrl: device.deviceUrl)
+                        // The cached device is likely gone, so the registration decides.
+                        self.pendingRegistration = completionHandler
                     }
-                    self.webSocket.connect(device.webSocketUrl) { [weak self] error in
-                        if let error = error {
-                            SDKLogger.shared.error("Failed to Register device", error: error)
+                    self.queue.yield()
+                }
+            }
+            else {
+                self.devices.registerDevice(phone: self, queue: self.queue.underlying, timeline: timeline) { result in
+                    switch result {
+                    case .success(let device):
+                        self.start(device: device, timeline: timeline) { error in
+                            self.ready(error: error, timeline: timeline, completionHandler: completionHandler)
+                            self.queue.yield()
                         }
-                        if let strong = self {
-                            strong.queue.underlying.async {
-                                strong.fetchActiveCalls()
-                                DispatchQueue.main.async {
-                                    strong.reachability.fetch()
-                                    strong.startObserving()
-                                    completionHandler(error)
-                                }
-                                strong.queue.yield()
-                            }
+                    case .failure(let error):
+                        SDKLogger.shared.error("Failed to Register device", error: error)
+                        timeline.finish()
+                        DispatchQueue.main.async {
+                            completionHandler(error)
                         }
+                        self.queue.yield()
                     }
-                case .failure(let error):
-                    SDKLogger.shared.error("Failed to Register device", error: error)
-                    DispatchQueue.main.async {
-                        completionHandler(error)
-                    }
-                    self.queue.yield()
                 }
             }
         }
@@ -252,6 +302,7 @@ public class Phone {
                 DispatchQueue.main.async {
                     self.reachability.clear()
                     self.stopObserving()
+                    self.mediaPool.stop()
                     completionHandler(error)
                 }
                 self.queue.yield()
@@ -288,27 +339,39 @@ public class Phone {
                     return
                 }
                 self.requestMediaAccess(option: option) {
-                    let mediaContext = self.mediaContext ?? MediaSessionWrapper()
+                    let mediaContext = self.mediaContext ?? self.mediaPool.take(option: option) ?? MediaSessionWrapper()
                     mediaContext.prepare(option: option, phone: self)
                     let localSDP = mediaContext.getLocalSdp()
                     let reachabilities = self.reachability.feedback?.reachabilities
                     
                     CallClient.DialTarget.lookup(address, by: Spark(authenticator: self.authenticator)) { target in
+                        // Pass through the device lane, so a dial waits for a registration in progress but never for other calls.
                         self.queue.sync {
-                            if let device = self.devices.device {
+                            let device = self.devices.device
+                            self.queue.yield()
+                            guard let registered = device else {
+                                SDKLogger.shared.error("Failure: unregistered device")
+                                DispatchQueue.main.async {
+                                    completionHandler(Result.failure(SparkError.unregistered))
+                                }
+                                return
+                            }
+                            // Becomes the queue of the new call.
+                            let queue = SerialQueue()
+                            queue.sync {
                                 let media = MediaModel(sdp: localSDP, audioMuted: false, videoMuted: false, reachabilities: reachabilities)
                                 if target.isEndpoint {
-                                    self.client.create(target.address, by: device, localMedia: media, queue: self.queue.underlying) { res in
-                                        self.doLocusResponse(LocusResult.call(target.isGroup, device, option.uuid, mediaContext, res, completionHandler))
-                                        self.queue.yield()
+                                    self.client.create(target.address, by: registered, localMedia: media, queue: queue.underlying) { res in
+                                        self.doLocusResponse(LocusResult.call(target.isGroup, registered, option.uuid, mediaContext, queue, res, completionHandler))
+                                        queue.yield()
                                     }
                                 }
                                 else {
-                                    self.conversations.getLocusUrl(conversation: target.address, by: device, queue: self.queue.underlying) { res in
+                                    self.conversations.getLocusUrl(conversation: target.address, by: registered, queue: queue.underlying) { res in
                                         if let url = res.result.data?.locusUrl {
-                                            self.client.join(url, by: device, localMedia: media, queue: self.queue.underlying) { resNew in
-                                                self.doLocusResponse(LocusResult.call(target.isGroup, device, option.uuid, mediaContext, resNew, completionHandler))
-                                                self.queue.yield()
+                                            self.client.join(url, by: registered, localMedia: media, queue: queue.underlying) { resNew in
+                                                self.doLocusResponse(LocusResult.call(target.isGroup, registered, option.uuid, mediaContext, queue, resNew, completionHandler))
+                                                queue.yield()
                                             }
                                         }
                                         else if let error = res.result.error {
@@ -316,18 +379,11 @@ public class Phone {
                                             DispatchQueue.main.async {
                                                 completionHandler(Result.failure(error))
                                             }
-                                            self.queue.yield()
+                                            queue.yield()
                                         }
                                     }
                                 }
                             }
-                            else {
-                                SDKLogger.shared.error("Failure: unregistered device")
-                                DispatchQueue.main.async {
-                                    completionHandler(Result.failure(SparkError.unregistered))
-                                }
-                                self.queue.yield()
-                            }
                         }
                     }
                 }
@@ -379,23 +435,36 @@ public class Phone {
     }
     
     private func add(call: Call) {
-        calls[call.url] = call;
+        self.callsLock.lock()
+        self._calls[call.url] = call
+        self.callsLock.unlock()
         SDKLogger.shared.info("Add call for call url:\(call.url)")
+        // A ringing call leaves the warm sessions to answer with; see `answer(call:option:completionHandler:)`.
+        if call.direction == Call.Direction.outgoing {
+            DispatchQueue.main.async {
+                self.mediaPool.suspend()
+            }
+        }
     }
     
     func remove(call: Call) {
-        calls[call.url] = nil
+        self.callsLock.lock()
+        self._calls[call.url] = nil
+        self.callsLock.unlock()
         SDKLogger.shared.info("Remove call for call url:\(call.url)")
+        DispatchQueue.main.async {
+            self.mediaPool.refill()
+        }
     }
     
     func acknowledge(call: Call, completionHandler: @escaping (Error?) -> Void) {
-        self.queue.sync {
+        call.queue.sync {
             if self.calls.filter({ $0.key != call.url }).count > 0 {
                 SDKLogger.shared.error("Failure: There are other active calls")
                 DispatchQueue.main.async {
                     completionHandler(SparkError.illegalOperation(reason: "There are other active calls"))
                 }
-                self.queue.yield()
+                call.queue.yield()
                 return
             }
             if call.direction == Call.Direction.outgoing {
@@ -403,7 +472,7 @@ public class Phone {
                 DispatchQueue.main.async {
                     completionHandler(SparkError.illegalOperation(reason: "Unsupport function for outgoing call"))
                 }
-                self.queue.yield()
+                call.queue.yield()
                 return
             }
             if call.direction == Call.Direction.incoming && call.status != CallStatus.initiated {
@@ -411,13 +480,13 @@ public class Phone {
                 DispatchQueue.main.async {
                     completionHandler(SparkError.illegalStatus(reason: "Not initialted call"))
                 }
-                self.queue.yield()
+                call.queue.yield()
                 return
             }
             if let url = call.model.locusUrl {
-                self.client.alert(url, by: call.device, queue: self.queue.underlying) { res in
+                self.client.alert(url, by: call.device, queue: call.queue.underlying) { res in
                     self.doLocusResponse(LocusResult.alert(call, res, completionHandler))
-                    self.queue.yield()
+                    call.queue.yield()
                 }
             }
             else {
@@ -425,7 +494,7 @@ public class Phone {
                 DispatchQueue.main.async {
                     completionHandler(SparkError.serviceFailed(code: -7000, reason: "Missing call URL"))
                 }
-                self.queue.yield()
+                call.queue.yield()
             }
         }
     }
@@ -459,13 +528,20 @@ public class Phone {
             }
             
             self.requestMediaAccess(option: option) {
-                let mediaContext = call.mediaSession
+                var mediaContext = call.mediaSession
+                if mediaContext.status == .initial, let media = self.mediaPool.take(option: option) {
+                    mediaContext = media
+                }
+                else {
+                    self.mediaPool.suspend()
+                }
                 mediaContext.prepare(option: option, phone: self)
+                call.use(media: mediaContext)
                 let media = MediaModel(sdp: mediaContext.getLocalSdp(), audioMuted: false, videoMuted: false, reachabilities: self.reachability.feedback?.reachabilities)
-                self.queue.sync {
-                    self.client.join(call.url, by: call.device, localMedia: media, queue: self.queue.underlying) { res in
+                call.queue.sync {
+                    self.client.join(call.url, by: call.device, localMedia: media, queue: call.queue.underlying) { res in
                         self.doLocusResponse(LocusResult.join(call, res, completionHandler))
-                        self.queue.yield()
+                        call.queue.yield()
                     }
                 }
             }
@@ -473,13 +549,13 @@ public class Phone {
     }
     
     func reject(call: Call, completionHandler: @escaping (Error?) -> Void) {
-        self.queue.sync {
+        call.queue.sync {
             if call.direction == Call.Direction.outgoing {
                 SDKLogger.shared.error("Failure: Unsupport function for outgoing call")
                 DispatchQueue.main.async {
                     completionHandler(SparkError.illegalOperation(reason: "Unsupport function for outgoing call"))
                 }
-                self.queue.yield()
+                call.queue.yield()
                 return
             }
             if call.direction == Call.Direction.incoming {
@@ -488,7 +564,7 @@ public class Phone {
                     DispatchQueue.main.async {
                         completionHandler(SparkError.illegalStatus(reason: "Already connected"))
                     }
-                    self.queue.yield()
+                    call.queue.yield()
                     return
                 }
                 else if call.status == CallStatus.disconnected {
@@ -496,14 +572,14 @@ public class Phone {
                     DispatchQueue.main.async {
                         completionHandler(SparkError.illegalStatus(reason: "Already disconnected"))
                     }
-                    self.queue.yield()
+                    call.queue.yield()
                     return
                 }
             }
             if let url = call.model.locusUrl {
-                self.client.decline(url, by: call.device, queue: self.queue.underlying) { res in
+                self.client.decline(url, by: call.device, queue: call.queue.underlying) { res in
                     self.doLocusResponse(LocusResult.reject(call, res, completionHandler))
-                    self.queue.yield()
+                    call.queue.yield()
                 }
             }
             else {
@@ -511,19 +587,19 @@ public class Phone {
                 DispatchQueue.main.async {
                     completionHandler(SparkError.serviceFailed(code: -7000, reason: "Missing call URL"))
                 }
-                self.queue.yield()
+                call.queue.yield()
             }
         }
     }
     
     func hangup(call: Call, completionHandler: @escaping (Error?) -> Void) {
-        self.queue.sync {
+        call.queue.sync {
             if call.status == CallStatus.disconnected {
                 SDKLogger.shared.warn("Warning: Already disconnected")
                 DispatchQueue.main.async {
                     completionHandler(SparkError.illegalStatus(reason: "Already disconnected"))
                 }
-                self.queue.yield()
+                call.queue.yield()
                 return
             }
             if let url = call.model.myself?.url {
@@ -536,9 +612,9 @@ public class Phone {
                 }
                 
                 
-                self.client.leave(url, by: call.device, queue: self.queue.underlying) { res in
+                self.client.leave(url, by: call.device, queue: call.queue.underlying) { res in
                     self.doLocusResponse(LocusResult.leave(call, res, completionHandler))
-                    self.queue.yield()
+                    call.queue.yield()
                 }
             }
             else {
@@ -546,33 +622,37 @@ public class Phone {
                 DispatchQueue.main.async {
                     completionHandler(SparkError.serviceFailed(code: -7000, reason: "Missing self participant URL"))
                 }
-                self.queue.yield()
+                call.queue.yield()
             }
         }
     }
     
-    func update(call: Call, sendingAudio: Bool, sendingVideo: Bool, localSDP:String? = nil) {
+    /// Sends the media state of the call. Use `Call.updateMedia` instead, which doesn't send states
+    /// already superseded by the time locus could take them.
+    func update(call: Call, sendingAudio: Bool, sendingVideo: Bool, localSDP:String? = nil, completionHandler: ((Error?) -> Void)? = nil) {
         DispatchQueue.main.async {
             let reachabilities = self.reachability.feedback?.reachabilities
-            self.queue.sync {
+            call.queue.sync {
                 guard let url = call.model.myself?.mediaBaseUrl, let sdp = call.model.mediaConnections?.first?.localSdp?.sdp, let mediaID = call.model.myself?[device: call.device.deviceUrl]?.mediaConnections?.first?.mediaId else {
-                    self.queue.yield()
+                    completionHandler?(SparkError.illegalStatus(reason: "No media connection"))
+                    call.queue.yield()
                     return
                 }
                 let media = MediaModel(sdp: localSDP == nil ? sdp:localSDP!, audioMuted: !sendingAudio, videoMuted: !sendingVideo, reachabilities: reachabilities)
-                self.client.update(url,by: mediaID,by: call.device, localMedia: media, queue: self.queue.underlying) { res in
+                self.client.update(url,by: mediaID,by: call.device, localMedia: media, queue: call.queue.underlying) { res in
                     self.doLocusResponse(LocusResult.update(call, res))
-                    self.queue.yield()
+                    completionHandler?(res.result.error)
+                    call.queue.yield()
                 }
             }
         }
     }
     
     func fetch(call: Call) {
-        self.queue.sync {
-            self.client.fetch(call.url, queue: self.queue.underlying) { res in
+        call.queue.sync {
+            self.client.fetch(call.url, queue: call.queue.underlying) { res in
                 self.doLocusResponse(LocusResult.update(call, res))
-                self.queue.yield()
+                call.queue.yield()
             }
         }
     }
@@ -631,12 +711,12 @@ public class Phone {
     
     private func doLocusResponse(_ ret: LocusResult) {
         switch ret {
-        case .call(let group, let device, let uuid, let media, let res, let completionHandler):
+        case .call(let group, let device, let uuid, let media, let queue, let res, let completionHandler):
             switch res.result {
             case .success(let model):
                 SDKLogger.shared.debug("Receive call locus response: \(model.toJSONString(prettyPrint: self.debug) ?? "Nil JSON")")
                 if model.isValid {
-                    let call = Call(model: model, device: device, media: media, direction: Call.Direction.outgoing, group: (group ? true : !model.isOneOnOne), uuid: uuid)
+                    let call = Call(model: model, device: device, media: media, direction: Call.Direction.outgoing, group: (group ? true : !model.isOneOnOne), uuid: uuid, queue: queue)
                     if call.isInIllegalStatus {
                         DispatchQueue.main.async {
                             let error = SparkError.illegalStatus(reason: "The previous session did not end")
@@ -751,7 +831,10 @@ public class Phone {
             return
         }
         if let call = self.calls[url] {
-            call.update(model: model)
+            // Added while this event waited on the device lane.
+            call.queue.underlying.async {
+                call.update(model: model)
+            }
         }
         else if let device = self.devices.device, model.isIncomingCall { // || callInfo.hasJoinedOnOtherDevice(deviceUrl: deviceUrl)
             // XXX: Is this conditional intended to add this call even when there is no real device registration information?
@@ -778,6 +861,21 @@ public class Phone {
         }
     }
     
+    /// Hands a locus event to the queue of its call, or to the device lane when the call is new.
+    private func route(_ model: CallModel) {
+        if let url = model.callUrl, let call = self.calls[url] {
+            call.queue.underlying.async {
+                SDKLogger.shared.debug("Receive locus event: \(model.toJSONString(prettyPrint: self.debug) ?? "Nil JSON")")
+                call.update(model: model)
+            }
+        }
+        else {
+            self.queue.underlying.async {
+                self.doLocusEvent(model)
+            }
+        }
+    }
+    
     private func doConversationEvent(_ model: ActivityModel){
         if let messages = self.messages {
             SDKLogger.shared.debug("Receive Conversation Acitivity: \(model.toJSONString(prettyPrint: self.debug) ?? "Nil JSON")")
@@ -810,14 +908,95 @@ public class Phone {
         }
     }
     
-    private func fetchActiveCalls() {
+    private func start(device: Device, timeline: StartupTimeline, completionHandler: @escaping (Error?) -> Void) {
+        if let messages = self.messages {
+            messages.deviceUrl = device.deviceUrl
+        }
+        else {
+            self.messages = MessageClientImpl(authenticator: self.authenticator, deviceUrl: device.deviceUrl)
+        }
+        self.webSocket.connect(device.webSocketUrl) { [weak self] error in
+            if let error = error {
+                SDKLogger.shared.error("Failed to Register device", error: error)
+            }
+            else {
+                timeline.mark(.webSocket)
+            }
+            if let strong = self {
+                strong.queue.underlying.async {
+                    strong.fetchActiveCalls(timeline: timeline)
+                    if error == nil {
+                        strong.messages?.prefetchKeyMaterials()
+                    }
+                    completionHandler(error)
+                }
+            }
+        }
+    }
+    
+    private func ready(error: Error?, timeline: StartupTimeline, completionHandler: @escaping (Error?) -> Void) {
+        if error == nil {
+            timeline.mark(.ready)
+        }
+        else {
+            timeline.finish()
+        }
+        DispatchQueue.main.async {
+            // Warm offers carry the ICE candidates of the network they were made on.
+            self.reachability.onNetworkChange = { [weak self] in
+                self?.mediaPool.invalidate()
+            }
+            self.reachability.fetch()
+            self.startObserving()
+            self.mediaPool.start()
+            completionHandler(error)
+        }
+    }
+    
+    /// Applies the registration done in the background of a start on the cached device.
+    /// Must run on the queue, which it yields.
+    private func reconcile(_ result: Result<Device>, cached: Device, timeline: StartupTimeline) {
+        let waiting = self.pendingRegistration
+        self.pendingRegistration = nil
+        switch result {
+        case .success(let device):
+            if device.webSocketUrl != cached.webSocketUrl || waiting != nil {
+                SDKLogger.shared.info("Registered device differs from the cached one, reconnect")
+                self.disconnectFromWebSocket()
+                self.start(device: device, timeline: timeline) { error in
+                    if let waiting = waiting {
+                        self.ready(error: error, timeline: timeline, completionHandler: waiting)
+                    }
+                    self.queue.yield()
+                }
+                return
+            }
+            self.messages?.deviceUrl = device.deviceUrl
+        case .failure(let error):
+            if let waiting = waiting {
+                SDKLogger.shared.error("Failed to Register device", error: error)
+                timeline.finish()
+                DispatchQueue.main.async {
+                    waiting(error)
+                }
+            }
+            else {
+                // Keep going on the cached device; the next registration tries again.
+                SDKLogger.shared.warn("Failed to revalidate cached device", error: error)
+            }
+        }
+        self.queue.yield()
+    }
+    
+    private func fetchActiveCalls(timeline: StartupTimeline? = nil) {
         SDKLogger.shared.info("Fetch call infos")
         if let device = self.devices.device {
             self.client.fetch(by: device, queue: self.queue.underlying) { res in
+                timeline?.mark(.activeCalls)
                 switch res.result {
                 case .success(let models):
                     for model in models {
-                        self.doLocusEvent(model)
+                        self.route(model)
                     }
                     SDKLogger.shared.info("Success: fetch call infos")
                 case .failure(let error):
@@ -851,6 +1030,8 @@ public class Phone {
     @objc func onApplicationDidBecomeActive() {
         SDKLogger.shared.info("Application did become active")
         self.connectToWebSocket()
+        self.reachability.fetch()
+        self.mediaPool.invalidate()
     }
     
     @objc func onApplicationDidEnterBackground() {
@@ -895,9 +1076,8 @@ public class Phone {
     
     func updateMeidaShare(call:Call, mediaShare: MediaShareModel,completionHandler: @escaping ((Error?) -> Void)) {
         if let mediaShareUrl = mediaShare.url {
-            self.client.updateMediaShare(mediaShare, by: call.device, mediaShareUrl: mediaShareUrl, queue: self.queue.underlying) { res in
+            self.client.updateMediaShare(mediaShare, by: call.device, mediaShareUrl: mediaShareUrl, queue: call.queue.underlying) { res in
                 self.doLocusResponse(LocusResult.updateMediaShare(call, res,completionHandler))
-                self.queue.yield()
             }
         } else {
             let error = SparkError.serviceFailed(code: -700, reason: "Unsupport media share.")
@@ -0,0 +1,294 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// Measures how well the media clusters can be reached from this network.
+///
+/// Every UDP, TCP and XTLS address the cluster discovery service returned is probed at once: UDP
+/// with a few STUN binding requests, TCP and XTLS by how long the connection takes. Whatever
+/// hasn't answered when the time budget runs out counts as unreachable.
+///
+/// Clusters are not ranked by round trip or loss: locus takes reachability as a dictionary keyed
+/// by cluster, with only `reachable` and `latencyInMilliseconds` per transport, so it has no order
+/// to honour and no field for a loss rate.
+///
+/// - note: for internal use only.
+class ReachabilityProber {
+    
+    struct Endpoint {
+        let cluster: String
+        let transport: String
+        let host: String
+        let port: String
+    }
+    
+    struct Measurement {
+        var sent = 0
+        var received = 0
+        /// The fastest answer.
+        var roundTrip: TimeInterval?
+        
+        mutating func merge(_ other: Measurement) {
+            self.sent += other.sent
+            self.received += other.received
+            if let roundTrip = other.roundTrip {
+                self.roundTrip = min(self.roundTrip ?? roundTrip, roundTrip)
+            }
+        }
+    }
+    
+    typealias Probe = (_ endpoint: Endpoint, _ deadline: DispatchTime, _ completionHandler: @escaping (Measurement) -> Void) -> Void
+    
+    static let transports = ["udp", "tcp", "xtls"]
+    
+    static let udpAttempts = 3
+    static let udpInterval: TimeInterval = 0.2
+    
+    let budget: TimeInterval
+    private let probe: Probe
+    private let queue = DispatchQueue(label: "com.ciscospark.sdk.ReachabilityProber")
+    
+    init(budget: TimeInterval = 3, probe: @escaping Probe = ReachabilityProber.defaultProbe) {
+        self.budget = budget
+        self.probe = probe
+    }
+    
+    /// Probes every address in `clusters` (cluster tag to transport to "host:port" addresses) and
+    /// calls `completionHandler` with the reachability of each cluster, in the form locus takes.
+    /// Always answers within the budget.
+    func run(_ clusters: [String: [String: [String]]], completionHandler: @escaping ([String: ReachabilityModel]) -> Void) {
+        let endpoints: [Endpoint] = clusters.flatMap { cluster, transports in
+            ReachabilityProber.transports.flatMap { transport in
+                (transports[transport] ?? []).compactMap { address -> Endpoint? in
+                    guard let (host, port) = ReachabilityProber.split(address) else {
+                        return nil
+                    }
+                    return Endpoint(cluster: cluster, transport: transport, host: host, port: port)
+                }
+            }
+        }
+        let deadline = DispatchTime.now() + self.budget
+        var measurements = [String: [String: Measurement]]()
+        var done = false
+        let finish = {
+            guard !done else {
+                return
+            }
+            done = true
+            var reachabilities = [String: ReachabilityModel]()
+            for cluster in clusters.keys {
+                let transports = measurements[cluster] ?? [:]
+                var model = ReachabilityModel()
+                model.udp = ReachabilityProber.status(transports["udp"], probed: clusters[cluster]?["udp"])
+                model.tcp = ReachabilityProber.status(transports["tcp"], probed: clusters[cluster]?["tcp"])
+                model.xtls = ReachabilityProber.status(transports["xtls"], probed: clusters[cluster]?["xtls"])
+                reachabilities[cluster] = model
+            }
+            let reachable = reachabilities.filter { $0.value.udp?.reachable == true || $0.value.tcp?.reachable == true || $0.value.xtls?.reachable == true }
+            SDKLogger.shared.info("Probed \(endpoints.count) media cluster addresses, \(reachable.count) of \(clusters.count) clusters reachable")
+            completionHandler(reachabilities)
+        }
+        let group = DispatchGroup()
+        for endpoint in endpoints {
+            group.enter()
+            self.probe(endpoint, deadline) { measurement in
+                self.queue.async {
+                    measurements[endpoint.cluster, default: [:]][endpoint.transport, default: Measurement()].merge(measurement)
+                    group.leave()
+                }
+            }
+        }
+        group.notify(queue: self.queue, execute: finish)
+        self.queue.asyncAfter(deadline: deadline + 0.05, execute: finish)
+    }
+    
+    private static func status(_ measurement: Measurement?, probed addresses: [String]?) -> ReachabilityTransportStatusModel? {
+        guard addresses?.isEmpty == false else {
+            return nil
+        }
+        var status = ReachabilityTransportStatusModel()
+        status.reachable = measurement?.roundTrip != nil
+        status.latencyInMilliseconds = measurement?.roundTrip.map { Int($0 * 1000) }
+        return status
+    }
+    
+    /// Splits "host:port" or "[v6 host]:port".
+    static func split(_ address: String) -> (String, String)? {
+        guard let colon = address.range(of: ":", options: .backwards) else {
+            return nil
+        }
+        var host = String(address[..<colon.lowerBound])
+        let port = String(address[colon.upperBound...])
+        if host.hasPrefix("[") && host.hasSuffix("]") {
+            host = String(host.dropFirst().dropLast())
+        }
+        guard !host.isEmpty, !port.isEmpty else {
+            return nil
+        }
+        return (host, port)
+    }
+    
+    // MARK: Probes
+    
+    /// The probe used unless one is injected: STUN over UDP, a connection for TCP and XTLS.
+    static func defaultProbe(_ endpoint: Endpoint, deadline: DispatchTime, completionHandler: @escaping (Measurement) -> Void) {
+        if endpoint.transport == "udp" {
+            self.stun(endpoint, deadline: deadline, completionHandler: completionHandler)
+        }
+        else {
+            self.connect(endpoint, deadline: deadline, completionHandler: completionHandler)
+        }
+    }
+    
+    private static let magicCookie: [UInt8] = [0x21, 0x12, 0xa4, 0x42]
+    
+    /// A STUN binding request (RFC 5389) without attributes.
+    static func bindingRequest(transactionId: [UInt8]) -> [UInt8] {
+        return [0x00, 0x01, 0x00, 0x00] + self.magicCookie + transactionId
+    }
+    
+    /// The transaction id of a STUN binding success response, nil for anything else.
+    static func transactionId(ofBindingResponse bytes: [UInt8]) -> [UInt8]? {
+        guard bytes.count >= 20, bytes[0] == 0x01, bytes[1] == 0x01, Array(bytes[4..<8]) == self.magicCookie else {
+            return nil
+        }
+        return Array(bytes[8..<20])
+    }
+    
+    /// Opens a non-blocking socket to the endpoint, resolving it off the caller's thread.
+    private static func open(_ endpoint: Endpoint, type: Int32, completionHandler: @escaping (Int32?) -> Void) {
+        DispatchQueue.global(qos: .utility).async {
+            var hints = addrinfo()
+            hints.ai_socktype = type
+            var info: UnsafeMutablePointer<addrinfo>?
+            guard getaddrinfo(endpoint.host, endpoint.port, &hints, &info) == 0, let first = info else {
+                completionHandler(nil)
+                return
+            }
+            defer {
+                freeaddrinfo(info)
+            }
+            let fd = socket(first.pointee.ai_family, first.pointee.ai_socktype, first.pointee.ai_protocol)
+            guard fd >= 0 else {
+                completionHandler(nil)
+                return
+            }
+            _ = fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK)
+            var on: Int32 = 1
+            setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, socklen_t(MemoryLayout<Int32>.size))
+            guard Foundation.connect(fd, first.pointee.ai_addr, first.pointee.ai_addrlen) == 0 || errno == EINPROGRESS else {
+                close(fd)
+                completionHandler(nil)
+                return
+            }
+            completionHandler(fd)
+        }
+    }
+    
+    private static func stun(_ endpoint: Endpoint, deadline: DispatchTime, completionHandler: @escaping (Measurement) -> Void) {
+        self.open(endpoint, type: SOCK_DGRAM) { fd in
+            guard let fd = fd else {
+                completionHandler(Measurement())
+                return
+            }
+            let queue = DispatchQueue(label: "com.ciscospark.sdk.ReachabilityProber.stun")
+            let source = DispatchSource.makeReadSource(fileDescriptor: fd, queue: queue)
+            var measurement = Measurement()
+            var pending = [Data: DispatchTime]()
+            var finished = false
+            let finish = {
+                guard !finished else {
+                    return
+                }
+                finished = true
+                source.cancel()
+                completionHandler(measurement)
+            }
+            source.setEventHandler {
+                var buffer = [UInt8](repeating: 0, count: 512)
+                while true {
+                    let count = recv(fd, &buffer, buffer.count, 0)
+                    guard count > 0 else {
+                        break
+                    }
+                    if let id = ReachabilityProber.transactionId(ofBindingResponse: Array(buffer[0..<count])), let sent = pending.removeValue(forKey: Data(id)) {
+                        measurement.merge(Measurement(sent: 0, received: 1, roundTrip: Double(DispatchTime.now().uptimeNanoseconds - sent.uptimeNanoseconds) / 1_000_000_000))
+                    }
+                }
+                if measurement.received == ReachabilityProber.udpAttempts {
+                    finish()
+                }
+            }
+            source.setCancelHandler {
+                close(fd)
+            }
+            source.resume()
+            for attempt in 0..<ReachabilityProber.udpAttempts {
+                queue.asyncAfter(deadline: .now() + Double(attempt) * ReachabilityProber.udpInterval) {
+                    guard !finished, DispatchTime.now() < deadline else {
+                        return
+                    }
+                    let id = (0..<12).map { _ in UInt8(truncatingIfNeeded: arc4random()) }
+                    let request = ReachabilityProber.bindingRequest(transactionId: id)
+                    pending[Data(id)] = DispatchTime.now()
+                    measurement.sent += 1
+                    _ = send(fd, request, request.count, 0)
+                }
+            }
+            queue.asyncAfter(deadline: deadline, execute: finish)
+        }
+    }
+    
+    private static func connect(_ endpoint: Endpoint, deadline: DispatchTime, completionHandler: @escaping (Measurement) -> Void) {
+        let start = DispatchTime.now()
+        self.open(endpoint, type: SOCK_STREAM) { fd in
+            guard let fd = fd else {
+                completionHandler(Measurement(sent: 1, received: 0, roundTrip: nil))
+                return
+            }
+            let queue = DispatchQueue(label: "com.ciscospark.sdk.ReachabilityProber.connect")
+            let source = DispatchSource.makeWriteSource(fileDescriptor: fd, queue: queue)
+            var finished = false
+            let finish = { (roundTrip: TimeInterval?) in
+                guard !finished else {
+                    return
+                }
+                finished = true
+                source.cancel()
+                completionHandler(Measurement(sent: 1, received: roundTrip == nil ? 0 : 1, roundTrip: roundTrip))
+            }
+            source.setEventHandler {
+                var error: Int32 = 0
+                var length = socklen_t(MemoryLayout<Int32>.size)
+                getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &length)
+                finish(error == 0 ? Double(DispatchTime.now().uptimeNanoseconds - start.uptimeNanoseconds) / 1_000_000_000 : nil)
+            }
+            source.setCancelHandler {
+                close(fd)
+            }
+            source.resume()
+            queue.asyncAfter(deadline: deadline) {
+                finish(nil)
+            }
+        }
+    }
+}
@@ -19,98 +19,190 @@
 // THE SOFTWARE.
 
 import Foundation
+import Alamofire
 import ObjectMapper
 
+/// Keeps the reachability of the media clusters that calls send to locus.
+///
+/// Results are kept per network, keyed by a fingerprint of the interfaces and their address
+/// prefixes, and persisted, so after a launch or a switch back to a known network the last result
+/// is used right away. A network without a result, or with one older than `MaxAge`, is probed in
+/// the background. Interface changes are picked up as they happen.
 class ReachabilityService {
     
-    typealias ReachabilityHandler = (String?) -> Void
-    var feedback: MediaEngineReachabilityFeedback?
+    struct Entry: Codable {
+        let date: Date
+        /// `MediaEngineReachabilityFeedback` as JSON.
+        let feedback: String
+    }
+    
+    typealias ClusterSource = (_ completionHandler: @escaping ([String: [String: [String]]]?) -> Void) -> Void
+    
+    static let capacity = 16
+    
+    /// Called on the main queue when the network changes while it's being watched.
+    var onNetworkChange: (() -> Void)?
+    
+    var feedback: MediaEngineReachabilityFeedback? {
+        return self.locked { self.current.flatMap { Mapper<MediaEngineReachabilityFeedback>().map(JSONString: $0.feedback) } }
+    }
     
-    private var hostAddresses: [InterfaceAddress.Item]?
-    private var lastFetchDate: Date?
     private let MaxAge = TimeInterval(7200) // 7200 sec = 2 hours
-    private let authenticator: Authenticator
-    private let deviceService: DeviceService
+    private let prober: ReachabilityProber
+    private let clusters: ClusterSource
+    private let fingerprint: () -> String
+    private let file: URL?
+    private let lock = NSLock()
+    private var results: [String: Entry]
+    private var current: Entry?
+    private var network: String?
+    private var probing = Set<String>()
+    private var monitor: NetworkReachabilityManager?
     
-    init(authenticator: Authenticator, deviceService: DeviceService) {
-        self.authenticator = authenticator
-        self.deviceService = deviceService
+    convenience init(authenticator: Authenticator, deviceService: DeviceService) {
+        self.init(prober: ReachabilityProber(), clusters: { completionHandler in
+            MediaClusterClient(authenticator: authenticator, deviceService: deviceService).get() { (response: ServiceResponse<MediaCluster>) in
+                if let error = response.result.error {
+                    SDKLogger.shared.error("Failure", error: error)
+                }
+                completionHandler(response.result.data?.group)
+            }
+        }, fingerprint: ReachabilityService.networkFingerprint, file: ReachabilityService.defaultFile)
     }
     
+    init(prober: ReachabilityProber, clusters: @escaping ClusterSource, fingerprint: @escaping () -> String, file: URL?) {
+        self.prober = prober
+        self.clusters = clusters
+        self.fingerprint = fingerprint
+        self.file = file
+        if let file = file, let data = try? Data(contentsOf: file), let results = try? JSONDecoder().decode([String: Entry].self, from: data) {
+            self.results = results
+        }
+        else {
+            self.results = [:]
+        }
+    }
+    
+    /// Switches to the result of the current network, probing it if there is none or it's too old,
+    /// and keeps watching for network changes.
     func fetch() {
-        let isAddressChanged = isHostAddressChanged()
-        let isMaxAgeReached = isDataOutOfDate()
-        
-        if isAddressChanged || isMaxAgeReached {
-            SDKLogger.shared.info("Fetch scheduled, isAddressChanged = \(isAddressChanged), isMaxAgeReached = \(isMaxAgeReached)")
-            performReachabilityCheck() {
-                if let value = $0 {
-                    self.feedback = Mapper<MediaEngineReachabilityFeedback>().map(JSONString: value)
-
-                    // update only when getting success feedback
-                    self.updateHostAddresses()
-                    self.updateFetchDate()
-                    
-                    SDKLogger.shared.info("Fetch done, result = \(value)")
-                } else {
-                    SDKLogger.shared.error("Fetch failed, get nil from Media Engine")
+        let network = self.fingerprint()
+        let (result, probe): (Entry?, Bool) = self.locked {
+            self.network = network
+            self.current = self.results[network]
+            let expired = self.current.map { Date().timeIntervalSince($0.date) > self.MaxAge } ?? true
+            return (self.current, expired && self.probing.insert(network).inserted)
+        }
+        SDKLogger.shared.info("Reachability of \(network): \(result == nil ? "unknown" : "from \(result!.date)"), probe = \(probe)")
+        if probe {
+            self.probe(network)
+        }
+        if self.monitor == nil {
+            self.monitor = NetworkReachabilityManager()
+            self.monitor?.listener = { [weak self] _ in
+                guard let strong = self else {
+                    return
+                }
+                // The listener is also called once as it starts, with the network fetched above.
+                let changed = strong.locked { strong.network } != strong.fingerprint()
+                strong.fetch()
+                if changed {
+                    strong.onNetworkChange?()
                 }
             }
-        } else {
-            SDKLogger.shared.info("Fetch skipped, isAddressChanged = \(isAddressChanged), isMaxAgeReached = \(isMaxAgeReached)")
+            self.monitor?.startListening()
         }
     }
     
     func clear() {
-        hostAddresses = nil
-        lastFetchDate = nil
-        clearReachabilityData()
+        self.monitor?.stopListening()
+        self.monitor = nil
+        self.locked {
+            self.network = nil
+            self.current = nil
+        }
+        MediaEngineWrapper.sharedInstance.clearReachabilityData()
+    }
+    
+    private func probe(_ network: String) {
+        self.clusters { group in
+            guard let group = group, !group.isEmpty else {
+                SDKLogger.shared.error("Reachability check skipped, no media clusters")
+                self.locked {
+                    _ = self.probing.remove(network)
+                }
+                return
+            }
+            self.prober.run(group) { reachabilities in
+                let feedback = MediaEngineReachabilityFeedback(reachabilities: reachabilities).toJSONString() ?? "{}"
+                let result = Entry(date: Date(), feedback: feedback)
+                let results: [String: Entry] = self.locked {
+                    self.probing.remove(network)
+                    self.results[network] = result
+                    if self.results.count > ReachabilityService.capacity, let oldest = self.results.min(by: { $0.value.date < $1.value.date }) {
+                        self.results.removeValue(forKey: oldest.key)
+                    }
+                    // The network may have changed while probing.
+                    if self.network == network {
+                        self.current = result
+                    }
+                    return self.results
+                }
+                self.save(results)
+            }
+        }
     }
     
-    private func isHostAddressChanged() -> Bool {
-        if let hostAddresses = hostAddresses {
-            let newHostAddresses = InterfaceAddress.getSortedAddresses()
-            return !InterfaceAddress.isSameSortedAddresses(oldAddrs: hostAddresses, newAddrs: newHostAddresses)
-        } else {
-            return true
+    private func save(_ results: [String: Entry]) {
+        guard let file = self.file else {
+            return
+        }
+        do {
+            try FileManager.default.createDirectory(at: file.deletingLastPathComponent(), withIntermediateDirectories: true, attributes: nil)
+            try JSONEncoder().encode(results).write(to: file, options: .atomic)
+        }
+        catch let error {
+            SDKLogger.shared.error("Failed to save reachability results", error: error)
         }
     }
     
-    private func isDataOutOfDate() -> Bool {
-        if let lastFetchDate = lastFetchDate {
-            return lastFetchDate.timeIntervalSinceNow > MaxAge
-        } else {
-            return true
+    private func locked<T>(_ block: () -> T) -> T {
+        self.lock.lock()
+        defer {
+            self.lock.unlock()
         }
+        return block()
     }
     
-    private func updateHostAddresses() {
-        hostAddresses = InterfaceAddress.getSortedAddresses()
+    static var defaultFile: URL? {
+        return FileManager.default.urls(for: .cachesDirectory, in: .userDomainMask).first?.appendingPathComponent("com.ciscospark.sdk/reachability.json")
     }
     
-    private func updateFetchDate() {
-        lastFetchDate = Date()
+    /// The interfaces with their address prefixes, /24 for IPv4 and /64 for IPv6, so a new lease
+    /// on the same network keeps the fingerprint.
+    static func networkFingerprint() -> String {
+        return self.fingerprint(of: InterfaceAddress.getSortedAddresses())
     }
     
-    private func performReachabilityCheck(_ completionHandler: @escaping ReachabilityCheckHandler) {
-        var clusterInfo: MediaCluster? = nil
-        MediaClusterClient(authenticator: authenticator, deviceService: deviceService).get() {
-            (response: ServiceResponse<MediaCluster>) in
-            switch response.result {
-            case .success(let value):
-                clusterInfo = value
-                if let group = clusterInfo?.group {
-                    MediaEngineWrapper.sharedInstance.performReachabilityCheck(group) {
-                        completionHandler($0)
-                    }
-                }
-            case .failure(let error):
-                SDKLogger.shared.error("Failure", error: error)
+    static func fingerprint(of addresses: [InterfaceAddress.Item]) -> String {
+        let prefixes = addresses.filter { !$0.ifaName.hasPrefix("lo") }.map { item -> String in
+            if item.ifaAddr.contains(":") {
+                return item.ifaName + "/" + self.prefix64(of: item.ifaAddr)
             }
+            return item.ifaName + "/" + item.ifaAddr.split(separator: ".").prefix(3).joined(separator: ".")
         }
+        return Array(Set(prefixes)).sorted().joined(separator: ",")
     }
     
-    private func clearReachabilityData() {
-        MediaEngineWrapper.sharedInstance.clearReachabilityData()
+    /// The first 64 bits of an IPv6 address, spelled out so "::" and leading zeros don't matter.
+    private static func prefix64(of address: String) -> String {
+        // Drop the zone of a link-local address, "fe80::1%en0".
+        let host = address.split(separator: "%", maxSplits: 1, omittingEmptySubsequences: false)[0]
+        var bytes = in6_addr()
+        guard inet_pton(AF_INET6, String(host), &bytes) == 1 else {
+            return address
+        }
+        let prefix = withUnsafeBytes(of: &bytes) { Array($0.prefix(8)) }
+        return stride(from: 0, to: 8, by: 2).map { String(format: "%x", UInt16(prefix[$0]) << 8 | UInt16(prefix[$0 + 1])) }.joined(separator: ":")
     }
 }
@@ -20,7 +20,6 @@
 
 import Foundation
 import Starscream
-import SwiftyJSON
 import ObjectMapper
 
 class WebSocketService: WebSocketAdvancedDelegate {
@@ -141,54 +140,84 @@ class WebSocketService: WebSocketAdvancedDelegate {
     }
     
     func websocketDidReceiveData(socket: WebSocket, data: Data, response: WebSocket.WSResponse) {
-        do {
-            let json = try JSON(data: data)
-            ackMessage(socket, messageId: json["id"].string ?? "")
-            let eventData = json["data"]
-            if let eventType = eventData["eventType"].string {
-                if eventType.hasPrefix("locus") {
-                    if let eventObj = eventData.object as? [String: Any],
-                        let event = Mapper<CallEventModel>().map(JSON: eventObj),
-                        let call = event.callModel,
-                        let type = event.type {
-                        SDKLogger.shared.info("Receive locus event: \(type)")
-                        self.onEvent?(MercuryEvent.recvCall(call))
-                    }
-                    else {
-                        SDKLogger.shared.error("Malformed call event could not be processed as a call event \(eventData.object)")
-                        return
-                    }
-                }
-                else if eventType == "conversation.activity" {
-                    if let activityObj = eventData["activity"].object as? [String: Any],
-                        let verb = activityObj["verb"] as? String,
-                        verb == "post" || verb == "share" || verb == "delete" {
-                        if let activity = try? Mapper<ActivityModel>().map(JSON: activityObj) {
-                            self.onEvent?(MercuryEvent.recvActivity(activity))
-                        }
-                    }
-                }
-                else if eventType == "encryption.kms_message" {
-                    if let kmsObj = eventData["encryption"].object as? [String: Any],
-                        let kms = Mapper<KmsMessageModel>().map(JSON: kmsObj) {
-                        self.onEvent?(MercuryEvent.recvKms(kms))
-                    }
-                }
-            }
-        }
-        catch let error {
-            SDKLogger.shared.error("Websocket data to Json error: \(error.localizedDescription)")
+        self.receive(data) { ack in
+            socket.write(data: ack)
         }
     }
     
     // MARK: - Websocket Event Handler
-    private func ackMessage(_ socket: WebSocket, messageId: String) {
-        let ack = JSON(["type": "ack", "messageId": messageId])
-        do {
-            let ackData: Data = try ack.rawData(options: .prettyPrinted)
-            socket.write(data: ackData)
-        } catch {
-            SDKLogger.shared.error("Failed to acknowledge message")
+    
+    private static let headerPaths = [["id"], ["data", "eventType"]]
+    
+    // Events of one room, or of one locus, are decoded on the same lane and so stay in order.
+    private static let routePaths = [["data", "activity", "target", "id"], ["data", "locusUrl"]]
+    
+    private static let ackPrefix = Data("{\"type\":\"ack\",\"messageId\":\"".utf8)
+    
+    private static let ackSuffix = Data("\"}".utf8)
+    
+    private static func isRelevant(_ eventType: String) -> Bool {
+        return eventType.hasPrefix("locus") || eventType == "conversation.activity" || eventType == "encryption.kms_message"
+    }
+    
+    private let lanes: [DispatchQueue] = (0..<max(2, min(4, ProcessInfo.processInfo.activeProcessorCount))).map {
+        DispatchQueue(label: "com.cisco.spark-ios-sdk.WSDecodeQueue-\($0)", qos: .userInitiated)
+    }
+    
+    /// Acknowledges a frame right away from a scan of its `id` and `eventType`, then fully
+    /// decodes only the events the SDK handles, off the socket queue.
+    func receive(_ data: Data, ack: (Data) -> Void) {
+        let header = JSONFieldScanner.scan(data, paths: WebSocketService.headerPaths)
+        var message = WebSocketService.ackPrefix
+        if let id = header[0] {
+            // Still JSON escaped, so it can go into the template as-is.
+            message.append(id)
+        }
+        message.append(WebSocketService.ackSuffix)
+        ack(message)
+        let eventType = header[1].flatMap { JSONFieldScanner.string($0) } ?? ""
+        guard WebSocketService.isRelevant(eventType) else {
+            SDKLogger.shared.verbose("Skipping websocket event \(eventType)")
+            return
+        }
+        let route = JSONFieldScanner.scan(data, paths: WebSocketService.routePaths).compactMap { $0 }.first.flatMap { JSONFieldScanner.string($0) } ?? eventType
+        let lane = self.lanes[Int(UInt(bitPattern: route.hashValue) % UInt(self.lanes.count))]
+        lane.async {
+            self.decode(data, eventType: eventType)
+        }
+    }
+    
+    private func decode(_ data: Data, eventType: String) {
+        guard let json = (try? JSONSerialization.jsonObject(with: data, options: [])) as? [String: Any],
+            let eventData = json["data"] as? [String: Any] else {
+            SDKLogger.shared.error("Websocket data to Json error")
+            return
+        }
+        if eventType.hasPrefix("locus") {
+            if let event = Mapper<CallEventModel>().map(JSON: eventData),
+                let call = event.callModel,
+                let type = event.type {
+                SDKLogger.shared.info("Receive locus event: \(type)")
+                self.onEvent?(MercuryEvent.recvCall(call))
+            }
+            else {
+                SDKLogger.shared.error("Malformed call event could not be processed as a call event \(eventData)")
+            }
+        }
+        else if eventType == "conversation.activity" {
+            if let activityObj = eventData["activity"] as? [String: Any],
+                let verb = activityObj["verb"] as? String,
+                verb == "post" || verb == "share" || verb == "delete" {
+                if let activity = try? Mapper<ActivityModel>().map(JSON: activityObj) {
+                    self.onEvent?(MercuryEvent.recvActivity(activity))
+                }
+            }
+        }
+        else if eventType == "encryption.kms_message" {
+            if let kmsObj = eventData["encryption"] as? [String: Any],
+                let kms = Mapper<KmsMessageModel>().map(JSON: kmsObj) {
+                self.onEvent?(MercuryEvent.recvKms(kms))
+            }
         }
     }
     
@@ -57,6 +57,22 @@ public class RoomClient {
         request.responseArray(completionHandler)
     }
     
+    /// Lists all rooms where the authenticated user belongs, page by page, through a cursor.
+    ///
+    /// - parameter teamId: If not nil, only list the rooms that are associated with the team by team id.
+    /// - parameter type: If not nil, only list the rooms of this type. Otherwise all rooms are listed.
+    /// - parameter sortBy: Sort results by roomId(id), most recent activity(lastactivity), or most recently created(created).
+    /// - parameter pageSize: The number of rooms fetched per request, or the service default if nil.
+    /// - parameter queue: If not nil, the queue on which the cursor hands out rooms. Otherwise, they're handed out on the application's main thread.
+    /// - returns: A cursor over the rooms.
+    /// - since: 1.4.2
+    public func listAll(teamId: String? = nil, type: RoomType? = nil, sortBy: RoomSortType? = nil, pageSize: Int? = nil, queue: DispatchQueue? = nil) -> ListCursor<Room> {
+        let request = requestBuilder()
+            .method(.get)
+            .query(RequestParameter(["teamId": teamId, "max": pageSize, "type": type?.rawValue, "sortBy": sortBy?.rawValue]))
+        return ListCursor(authenticator: self.authenticator, request: request, queue: queue)
+    }
+    
     /// Creates a room. The authenticated user is automatically added as a member of the room. See the Memberships API to learn how to add more people to the room.
     ///
     /// - parameter title: A user-friendly name for the room.
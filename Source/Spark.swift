@@ -86,6 +86,28 @@ public class Spark {
         }
     }
     
+    /// The maximum size in bytes of the rolling log file the SDK keeps in the Caches directory,
+    /// or 0 (the default) to keep no log file. Messages are logged to the file at the level of
+    /// the console logging.
+    ///
+    /// - since: 1.4.2
+    public var logFileSize: UInt64 {
+        get {
+            return SDKLogger.shared.fileSize
+        }
+        set {
+            SDKLogger.shared.fileSize = newValue
+        }
+    }
+    
+    /// Returns the SDK logs as text, from the log file if `logFileSize` is set, or else the
+    /// most recent logs kept in memory.
+    ///
+    /// - since: 1.4.2
+    public func exportLogs() -> String? {
+        return SDKLogger.shared.export()
+    }
+    
     /// This is the *Authenticator* object from the application when constructing this Spark object.
     /// It can be used to check and modify authentication state.
     ///
@@ -0,0 +1,66 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import Compression
+
+extension Data {
+    
+    /// The data as a gzip member (RFC 1952), or nil if it could not be compressed.
+    func gzipped() -> Data? {
+        let capacity = self.count + self.count / 8 + 1024
+        var deflated = Data(count: capacity)
+        let size = deflated.withUnsafeMutableBytes { (destination: UnsafeMutablePointer<UInt8>) -> Int in
+            self.withUnsafeBytes { (source: UnsafePointer<UInt8>) -> Int in
+                // COMPRESSION_ZLIB emits a raw DEFLATE stream, without zlib header or trailer.
+                compression_encode_buffer(destination, capacity, source, self.count, nil, COMPRESSION_ZLIB)
+            }
+        }
+        guard size > 0 || self.isEmpty else {
+            return nil
+        }
+        var output = Data([0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03])
+        output.append(deflated.prefix(size))
+        if self.isEmpty {
+            // An empty final block with fixed Huffman codes: BFINAL and BTYPE 01, then end-of-block.
+            output.append(contentsOf: [0x03, 0x00])
+        }
+        let trailer = [UInt32(littleEndian: self.crc32()), UInt32(littleEndian: UInt32(truncatingIfNeeded: self.count))]
+        trailer.withUnsafeBufferPointer { output.append($0) }
+        return output
+    }
+    
+    func crc32() -> UInt32 {
+        let table = Data.crc32Table
+        var crc: UInt32 = 0xffffffff
+        for byte in self {
+            crc = table[Int((crc ^ UInt32(byte)) & 0xff)] ^ (crc >> 8)
+        }
+        return crc ^ 0xffffffff
+    }
+    
+    private static let crc32Table: [UInt32] = (0..<256).map { index -> UInt32 in
+        var value = UInt32(index)
+        for _ in 0..<8 {
+            value = value & 1 == 1 ? 0xedb88320 ^ (value >> 1) : value >> 1
+        }
+        return value
+    }
+}
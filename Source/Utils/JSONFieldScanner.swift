@@ -0,0 +1,194 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+
+/// Pulls a few string fields out of a JSON document without parsing the rest of it.
+///
+/// Only objects on the way to a wanted field are walked; every other value is skipped by
+/// matching brackets and quotes, and the scan stops as soon as all fields were found. Values
+/// are returned as the raw, still escaped bytes between the quotes.
+///
+/// - note: for internal use only.
+struct JSONFieldScanner {
+    
+    private let bytes: UnsafeBufferPointer<UInt8>
+    private let paths: [[[UInt8]]]
+    private var index = 0
+    private var remaining: Int
+    private var failed = false
+    private(set) var found: [Range<Int>?]
+    
+    private init(bytes: UnsafeBufferPointer<UInt8>, paths: [[[UInt8]]]) {
+        self.bytes = bytes
+        self.paths = paths
+        self.remaining = paths.count
+        self.found = [Range<Int>?](repeating: nil, count: paths.count)
+    }
+    
+    /// The raw value of the string at each key path, or nil where there is none.
+    static func scan(_ data: Data, paths: [[String]]) -> [Data?] {
+        let wanted = paths.map { $0.map { Array($0.utf8) } }
+        return data.withUnsafeBytes { (pointer: UnsafePointer<UInt8>) -> [Data?] in
+            var scanner = JSONFieldScanner(bytes: UnsafeBufferPointer(start: pointer, count: data.count), paths: wanted)
+            scanner.skipWhitespace()
+            if scanner.peek == UInt8(ascii: "{") {
+                scanner.object(depth: 0, candidates: Array(wanted.indices))
+            }
+            return scanner.found.map { $0.map { data.subdata(in: data.startIndex + $0.lowerBound..<data.startIndex + $0.upperBound) } }
+        }
+    }
+    
+    /// Unescapes a raw value returned by `scan(_:paths:)`.
+    static func string(_ raw: Data) -> String? {
+        if !raw.contains(UInt8(ascii: "\\")) {
+            return String(data: raw, encoding: .utf8)
+        }
+        var quoted = Data("[\"".utf8)
+        quoted.append(raw)
+        quoted.append(contentsOf: Array("\"]".utf8))
+        return ((try? JSONSerialization.jsonObject(with: quoted, options: [])) as? [String])?.first
+    }
+    
+    private var peek: UInt8? {
+        return self.index < self.bytes.count ? self.bytes[self.index] : nil
+    }
+    
+    private mutating func skipWhitespace() {
+        while let byte = self.peek, byte == 0x20 || byte == 0x0a || byte == 0x0d || byte == 0x09 {
+            self.index += 1
+        }
+    }
+    
+    /// At an opening quote; returns the range between the quotes.
+    private mutating func string() -> Range<Int>? {
+        self.index += 1
+        let start = self.index
+        while self.index < self.bytes.count {
+            switch self.bytes[self.index] {
+            case UInt8(ascii: "\\"):
+                self.index += 2
+            case UInt8(ascii: "\""):
+                self.index += 1
+                return start..<self.index - 1
+            default:
+                self.index += 1
+            }
+        }
+        self.failed = true
+        return nil
+    }
+    
+    private mutating func skipValue() {
+        guard let first = self.peek else {
+            self.failed = true
+            return
+        }
+        switch first {
+        case UInt8(ascii: "\""):
+            _ = self.string()
+        case UInt8(ascii: "{"), UInt8(ascii: "["):
+            var depth = 0
+            while let byte = self.peek {
+                switch byte {
+                case UInt8(ascii: "\""):
+                    _ = self.string()
+                    continue
+                case UInt8(ascii: "{"), UInt8(ascii: "["):
+                    depth += 1
+                case UInt8(ascii: "}"), UInt8(ascii: "]"):
+                    depth -= 1
+                default:
+                    break
+                }
+                self.index += 1
+                if depth == 0 {
+                    return
+                }
+            }
+            self.failed = true
+        default:
+            while let byte = self.peek, byte != UInt8(ascii: ","), byte != UInt8(ascii: "}"), byte != UInt8(ascii: "]"), byte != 0x20, byte != 0x0a, byte != 0x0d, byte != 0x09 {
+                self.index += 1
+            }
+        }
+    }
+    
+    private func matches(_ range: Range<Int>, _ component: [UInt8]) -> Bool {
+        guard range.count == component.count else {
+            return false
+        }
+        for (offset, byte) in component.enumerated() where self.bytes[range.lowerBound + offset] != byte {
+            return false
+        }
+        return true
+    }
+    
+    /// At an opening brace. `candidates` are the paths that lead into this object.
+    private mutating func object(depth: Int, candidates: [Int]) {
+        self.index += 1
+        while !self.failed && self.remaining > 0 {
+            self.skipWhitespace()
+            guard let byte = self.peek else {
+                self.failed = true
+                return
+            }
+            if byte == UInt8(ascii: "}") {
+                self.index += 1
+                return
+            }
+            if byte == UInt8(ascii: ",") {
+                self.index += 1
+                continue
+            }
+            guard byte == UInt8(ascii: "\""), let key = self.string() else {
+                self.failed = true
+                return
+            }
+            self.skipWhitespace()
+            guard self.peek == UInt8(ascii: ":") else {
+                self.failed = true
+                return
+            }
+            self.index += 1
+            self.skipWhitespace()
+            let matching = candidates.filter { self.paths[$0].count > depth && self.matches(key, self.paths[$0][depth]) }
+            if matching.isEmpty {
+                self.skipValue()
+            }
+            else if self.peek == UInt8(ascii: "\"") {
+                guard let value = self.string() else {
+                    return
+                }
+                for candidate in matching where self.paths[candidate].count == depth + 1 && self.found[candidate] == nil {
+                    self.found[candidate] = value
+                    self.remaining -= 1
+                }
+            }
+            else if self.peek == UInt8(ascii: "{") && matching.contains(where: { self.paths[$0].count > depth + 1 }) {
+                self.object(depth: depth + 1, candidates: matching.filter { self.paths[$0].count > depth + 1 })
+            }
+            else {
+                self.skipValue()
+            }
+        }
+    }
+}
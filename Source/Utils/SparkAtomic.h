@@ -0,0 +1,46 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#pragma once
+
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// C11 atomics on plain 64-bit words, for the lock-free structures on the Swift side, which
+// cannot express them directly. A word must be 8-byte aligned, live at a stable address and
+// only ever be accessed through these functions.
+
+static inline int64_t spark_atomic_load(int64_t *target) {
+    return atomic_load_explicit((_Atomic int64_t *)target, memory_order_acquire);
+}
+
+static inline void spark_atomic_store(int64_t *target, int64_t value) {
+    atomic_store_explicit((_Atomic int64_t *)target, value, memory_order_release);
+}
+
+static inline int64_t spark_atomic_fetch_add(int64_t *target, int64_t value) {
+    return atomic_fetch_add_explicit((_Atomic int64_t *)target, value, memory_order_acq_rel);
+}
+
+/// On failure, `expected` is updated with the current value.
+static inline bool spark_atomic_compare_exchange(int64_t *target, int64_t *expected, int64_t desired) {
+    return atomic_compare_exchange_weak_explicit((_Atomic int64_t *)target, expected, desired, memory_order_acq_rel, memory_order_acquire);
+}
@@ -24,3 +24,5 @@
 #import "Seu/Seu.h"
 #import "Sbu/Sbu.h"
 
+#import <CommonCrypto/CommonCrypto.h>
+#import "SparkAtomic.h"
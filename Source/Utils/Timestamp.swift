@@ -25,10 +25,24 @@ class Timestamp {
         return Timestamp.ISO8601FullFormatterInUTC.string(from: Date())
     }
 
-    static var ISO8601FullFormatterInUTC: DateFormatter {
+    // DateFormatter is thread safe since iOS 7, and costly to create.
+    static let ISO8601FullFormatterInUTC: DateFormatter = {
         let formatter = DateFormatter()
         formatter.dateFormat = "yyyy-MM-dd'T'HH:mm:ss.SSSZ"
         formatter.timeZone = TimeZone(abbreviation: "UTC")
         return formatter
+    }()
+    
+    /// Nanoseconds on a clock that never goes backwards and keeps counting while the device sleeps.
+    /// Cheap enough for hot paths; convert with `date(monotonic:)` when the wall time is needed.
+    static var monotonicNow: UInt64 {
+        return clock_gettime_nsec_np(CLOCK_MONOTONIC)
     }
+    
+    /// The wall clock time of a `monotonicNow` reading taken in this process.
+    static func date(monotonic: UInt64) -> Date {
+        return Timestamp.reference.date.addingTimeInterval((Double(monotonic) - Double(Timestamp.reference.monotonic)) / 1_000_000_000)
+    }
+    
+    private static let reference = (date: Date(), monotonic: clock_gettime_nsec_np(CLOCK_MONOTONIC))
 }
@@ -26,6 +26,8 @@ class UserDefaults {
     private let storage = Foundation.UserDefaults.standard
     
     private let DeviceUrl = "deviceUrlKey"
+    private let CachedDeviceModel = "deviceModelKey"
+    private let CachedDeviceRegion = "deviceRegionKey"
     private let IsVideoLicenseActivationDisabled = "isVideoLicenseActivationDisabledKey"
     private let IsVideoLicenseActivated = "isVideoLicenseActivatedKey"
     
@@ -42,6 +44,33 @@ class UserDefaults {
         }
     }
     
+    /// The JSON of the device registered last, see `DeviceService.cachedDevice`.
+    var deviceModel: String? {
+        get {
+            return storage.string(forKey: CachedDeviceModel)
+        }
+        set {
+            if newValue == nil {
+                storage.removeObject(forKey: CachedDeviceModel)
+            } else {
+                storage.set(newValue, forKey: CachedDeviceModel)
+            }
+        }
+    }
+    
+    var deviceRegion: String? {
+        get {
+            return storage.string(forKey: CachedDeviceRegion)
+        }
+        set {
+            if newValue == nil {
+                storage.removeObject(forKey: CachedDeviceRegion)
+            } else {
+                storage.set(newValue, forKey: CachedDeviceRegion)
+            }
+        }
+    }
+    
     var isVideoLicenseActivationDisabled: Bool {
         get {
             return storage.bool(forKey: IsVideoLicenseActivationDisabled)
@@ -0,0 +1,97 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class ActivityDecryptionTests: XCTestCase {
+    
+    private let jwk: String = {
+        let key = Data((0..<32).map { _ in UInt8(truncatingIfNeeded: arc4random()) })
+        let k = key.base64EncodedString().replacingOccurrences(of: "+", with: "-").replacingOccurrences(of: "/", with: "_").replacingOccurrences(of: "=", with: "")
+        return "{\"kty\":\"oct\",\"k\":\"\(k)\"}"
+    }()
+    
+    private func activity(_ index: Int, key: String) throws -> ActivityModel {
+        return try ActivityModel(JSON: ["id": "activity-\(index)",
+                                        "verb": "post",
+                                        "object": ["displayName": "message \(index)".encrypt(key: key)]])
+    }
+    
+    func testMatchesCjoseWrapper() throws {
+        let key = JWEKey(jwk: self.jwk)
+        for text in ["hello", String(repeating: "x", count: 200), String(repeating: "y", count: 4099)] {
+            let jwe = try CjoseWrapper.ciphertext(fromContent: text.data(using: .utf8), key: self.jwk)
+            XCTAssertEqual(key.decrypt(jwe), text.data(using: .utf8))
+            XCTAssertEqual(key.decrypt(jwe), try CjoseWrapper.content(fromCiphertext: jwe, key: self.jwk))
+        }
+    }
+    
+    func testRejectsTamperedContent() throws {
+        let jwe = try CjoseWrapper.ciphertext(fromContent: "hello world".data(using: .utf8), key: self.jwk)
+        var segments = jwe.components(separatedBy: ".")
+        var content = Array(segments[3])
+        content[0] = content[0] == "A" ? "B" : "A"
+        segments[3] = String(content)
+        XCTAssertNil(JWEKey(jwk: self.jwk).decrypt(segments.joined(separator: ".")))
+        XCTAssertEqual("not a jwe".decrypt(key: self.jwk), "not a jwe")
+    }
+    
+    func testBatchDecryptKeepsOrder() throws {
+        let activities = try (0..<64).map { try self.activity($0, key: self.jwk) }
+        let decrypted = ActivityModel.decrypt(activities, key: self.jwk)
+        XCTAssertEqual(decrypted.map { $0.text ?? "" }, (0..<64).map { "message \($0)" })
+        XCTAssertEqual(decrypted.map { $0.id ?? "" }, activities.map { $0.id ?? "" })
+    }
+    
+    func testPipelineDecryptsPagesSubmittedBeforeAndAfterKey() throws {
+        let pipeline = ActivityDecryptionPipeline(limit: 25)
+        XCTAssertEqual(pipeline.submit(try (0..<10).map { try self.activity($0, key: self.jwk) }), 10)
+        pipeline.resolve(material: Result.success(self.jwk))
+        XCTAssertEqual(pipeline.submit(try (10..<20).map { try self.activity($0, key: self.jwk) }), 20)
+        XCTAssertEqual(pipeline.submit(try (20..<30).map { try self.activity($0, key: self.jwk) }), 25)
+        let done = expectation(description: "finished")
+        pipeline.finish { result in
+            XCTAssertEqual(result.data?.map { $0.text ?? "" } ?? [], (0..<25).map { "message \($0)" })
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 5)
+    }
+    
+    func testPipelineReportsKeyFailure() throws {
+        let pipeline = ActivityDecryptionPipeline(limit: 10)
+        _ = pipeline.submit(try (0..<3).map { try self.activity($0, key: self.jwk) })
+        pipeline.resolve(material: Result.failure(MessageClientImpl.MSGError.keyMaterialFetchFail))
+        let done = expectation(description: "finished")
+        pipeline.finish { result in
+            XCTAssertNotNil(result.error)
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 5)
+    }
+    
+    func testBenchmarkBatchDecrypt() throws {
+        let activities = try (0..<500).map { try self.activity($0, key: self.jwk) }
+        self.measure {
+            _ = ActivityModel.decrypt(activities, key: self.jwk)
+        }
+    }
+}
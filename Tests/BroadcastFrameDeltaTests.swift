@@ -0,0 +1,217 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class BroadcastFrameDeltaTests: XCTestCase {
+    
+    /// A 4:2:0 bi-planar frame with padded rows, as ReplayKit hands them out.
+    private class Frame {
+        let width: Int
+        let height: Int
+        let bytesPerRow: Int
+        let luma: UnsafeMutablePointer<UInt8>
+        let chroma: UnsafeMutablePointer<UInt8>
+        
+        init(width: Int, height: Int) {
+            self.width = width
+            self.height = height
+            self.bytesPerRow = (width + 63) & ~63
+            self.luma = UnsafeMutablePointer<UInt8>.allocate(capacity: self.bytesPerRow * height)
+            self.luma.initialize(repeating: 0x10, count: self.bytesPerRow * height)
+            self.chroma = UnsafeMutablePointer<UInt8>.allocate(capacity: self.bytesPerRow * height / 2)
+            self.chroma.initialize(repeating: 0x80, count: self.bytesPerRow * height / 2)
+        }
+        
+        deinit {
+            self.luma.deallocate()
+            self.chroma.deallocate()
+        }
+        
+        var planes: [BroadcastFrameDelta.Plane] {
+            return [BroadcastFrameDelta.Plane(base: self.luma, bytesPerRow: self.bytesPerRow, rowBytes: self.width, rows: self.height),
+                    BroadcastFrameDelta.Plane(base: self.chroma, bytesPerRow: self.bytesPerRow, rowBytes: self.width, rows: self.height / 2)]
+        }
+        
+        /// The planes one after another without row padding.
+        var compact: Data {
+            var data = Data()
+            for row in 0..<self.height {
+                data.append(self.luma + row * self.bytesPerRow, count: self.width)
+            }
+            for row in 0..<self.height / 2 {
+                data.append(self.chroma + row * self.bytesPerRow, count: self.width)
+            }
+            return data
+        }
+        
+        func fill(x: Int, y: Int, width: Int, height: Int, value: UInt8) {
+            for row in y..<min(y + height, self.height) {
+                memset(self.luma + row * self.bytesPerRow + x, Int32(value), min(width, self.width - x))
+            }
+        }
+    }
+    
+    private let encoder = BroadcastFrameDelta.Encoder(keyframeInterval: 1000)
+    private let decoder = BroadcastFrameDelta.Decoder()
+    private var sequence: UInt64 = 0
+    
+    /// Encodes `frame`, decodes the payload and returns the delta sent.
+    @discardableResult
+    private func send(_ frame: Frame, keyframe: Bool = false, deliver: Bool = true) -> BroadcastFrameDelta.Encoder.Delta {
+        let delta = self.encoder.prepare(frame.planes, keyframe: keyframe)
+        guard deliver else {
+            return delta
+        }
+        var payload = [UInt8](repeating: 0, count: delta.length)
+        payload.withUnsafeMutableBytes { self.encoder.write(delta, to: $0.baseAddress!) }
+        self.encoder.commit(delta)
+        XCTAssertTrue(payload.withUnsafeBytes { self.decoder.apply($0, sequence: self.sequence) })
+        self.sequence += 1
+        return delta
+    }
+    
+    func testRebuildsFrames() {
+        // Odd sizes leave partial tiles at the right and bottom edges.
+        let frame = Frame(width: 250, height: 130)
+        frame.fill(x: 3, y: 5, width: 70, height: 9, value: 0xee)
+        XCTAssertTrue(self.send(frame).keyframe)
+        XCTAssertEqual(self.decoder.frame, frame.compact)
+        
+        frame.fill(x: 200, y: 112, width: 50, height: 10, value: 0x42)
+        let delta = self.send(frame)
+        XCTAssertFalse(delta.keyframe)
+        XCTAssertEqual(delta.tiles, 1)
+        XCTAssertEqual(self.decoder.frame, frame.compact)
+    }
+    
+    func testUnchangedFrameSendsNoTiles() {
+        let frame = Frame(width: 640, height: 360)
+        self.send(frame)
+        let delta = self.send(frame)
+        XCTAssertEqual(delta.tiles, 0)
+        XCTAssertLessThan(delta.length, 64)
+        frame.luma[100 * frame.bytesPerRow + 300] ^= 1
+        XCTAssertEqual(self.send(frame).tiles, 1)
+        XCTAssertEqual(self.decoder.frame, frame.compact)
+    }
+    
+    func testDroppedFrameIsNotABase() {
+        let frame = Frame(width: 640, height: 360)
+        self.send(frame)
+        frame.fill(x: 0, y: 0, width: 64, height: 16, value: 0xff)
+        XCTAssertEqual(self.send(frame, deliver: false).tiles, 1)
+        // Not committed, so the same tile is sent again.
+        XCTAssertEqual(self.send(frame).tiles, 1)
+        XCTAssertEqual(self.decoder.frame, frame.compact)
+    }
+    
+    func testMissedFrameNeedsKeyframe() {
+        let frame = Frame(width: 320, height: 180)
+        self.send(frame)
+        frame.fill(x: 0, y: 0, width: 10, height: 10, value: 0xff)
+        let delta = self.encoder.prepare(frame.planes)
+        var payload = [UInt8](repeating: 0, count: delta.length)
+        payload.withUnsafeMutableBytes { self.encoder.write(delta, to: $0.baseAddress!) }
+        self.encoder.commit(delta)
+        // Sequence 1 never reaches the decoder.
+        self.sequence = 2
+        frame.fill(x: 100, y: 100, width: 10, height: 10, value: 0xff)
+        let next = self.encoder.prepare(frame.planes)
+        payload = [UInt8](repeating: 0, count: next.length)
+        payload.withUnsafeMutableBytes { self.encoder.write(next, to: $0.baseAddress!) }
+        self.encoder.commit(next)
+        XCTAssertFalse(payload.withUnsafeBytes { self.decoder.apply($0, sequence: 2) })
+        self.sequence = 3
+        XCTAssertTrue(self.send(frame, keyframe: true).keyframe)
+        XCTAssertEqual(self.decoder.frame, frame.compact)
+    }
+    
+    func testPeriodicKeyframes() {
+        let encoder = BroadcastFrameDelta.Encoder(keyframeInterval: 3)
+        let frame = Frame(width: 128, height: 64)
+        let keyframes = (0..<7).map { _ -> Bool in
+            let delta = encoder.prepare(frame.planes)
+            encoder.commit(delta)
+            return delta.keyframe
+        }
+        XCTAssertEqual(keyframes, [true, false, false, true, false, false, true])
+    }
+    
+    func testMalformedPayloadIsRejected() {
+        let frame = Frame(width: 128, height: 64)
+        let delta = self.encoder.prepare(frame.planes)
+        var payload = [UInt8](repeating: 0, count: delta.length)
+        payload.withUnsafeMutableBytes { self.encoder.write(delta, to: $0.baseAddress!) }
+        XCTAssertFalse(payload.dropLast(10).withUnsafeBytes { self.decoder.apply($0, sequence: 0) })
+        XCTAssertFalse([UInt8](repeating: 0, count: 64).withUnsafeBytes { self.decoder.apply($0, sequence: 0) })
+    }
+    
+    // MARK: Benchmarks
+    
+    private func report(_ name: String, frames: Int, _ change: (Frame, Int) -> Void) {
+        let frame = Frame(width: 1920, height: 1080)
+        let encoder = BroadcastFrameDelta.Encoder()
+        var bytes = 0
+        var elapsed: TimeInterval = 0
+        var payload = [UInt8](repeating: 0, count: BroadcastFrameDelta.capacity(forFrameLength: 1920 * 1080 * 3 / 2))
+        for index in 0..<frames {
+            change(frame, index)
+            let start = Date()
+            let delta = encoder.prepare(frame.planes)
+            payload.withUnsafeMutableBytes { encoder.write(delta, to: $0.baseAddress!) }
+            encoder.commit(delta)
+            elapsed += Date().timeIntervalSince(start)
+            bytes += delta.length
+        }
+        print("\(name): \(bytes / frames) bytes per frame (full frame \(1920 * 1080 * 3 / 2)), encode \(String(format: "%.2f", elapsed / Double(frames) * 1000)) ms")
+    }
+    
+    func testBenchmarkBytesPerFrame() {
+        // Slides: a new slide every 60 frames.
+        self.report("Slides", frames: 240) { frame, index in
+            if index % 60 == 0 {
+                frame.fill(x: 0, y: 0, width: 1920, height: 1080, value: UInt8(truncatingIfNeeded: index / 60 + 0x20))
+                frame.fill(x: 200, y: 200, width: 1200, height: 600, value: 0xf0)
+            }
+        }
+        // Typing: one character cell per frame, moving along a line.
+        self.report("Typing", frames: 240) { frame, index in
+            frame.fill(x: 100 + (index % 100) * 16, y: 300 + index / 100 * 24, width: 12, height: 20, value: 0x20)
+        }
+        // Scrolling: the whole document moves up a few rows per frame.
+        self.report("Scrolling", frames: 120) { frame, index in
+            memmove(frame.luma, frame.luma + 4 * frame.bytesPerRow, (frame.height - 4) * frame.bytesPerRow)
+            frame.fill(x: 0, y: frame.height - 4, width: frame.width, height: 4, value: UInt8(truncatingIfNeeded: index * 7))
+            for row in stride(from: 0, to: frame.height, by: 16) {
+                frame.fill(x: (row * 13 + index * 4) % 1800, y: row, width: 64, height: 2, value: UInt8(truncatingIfNeeded: row))
+            }
+        }
+        // Video: noise everywhere, the worst case.
+        self.report("Video", frames: 30) { frame, _ in
+            for i in stride(from: 0, to: frame.bytesPerRow * frame.height, by: 7) {
+                frame.luma[i] = UInt8(truncatingIfNeeded: arc4random())
+            }
+        }
+    }
+}
@@ -0,0 +1,162 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class BroadcastFrameRingTests: XCTestCase {
+    
+    private var path: String!
+    
+    override func setUp() {
+        self.path = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString).path
+    }
+    
+    override func tearDown() {
+        try? FileManager.default.removeItem(atPath: self.path)
+    }
+    
+    // Two mappings of one file stand in for the app and the extension.
+    private func rings(slotCount: Int = 3, slotCapacity: Int = 1024) -> (app: BroadcastFrameRing, extension: BroadcastFrameRing) {
+        let app = BroadcastFrameRing(creatingAt: self.path, slotCount: slotCount, slotCapacity: slotCapacity)!
+        let ext = BroadcastFrameRing(openingAt: self.path)!
+        return (app, ext)
+    }
+    
+    private func write(_ ring: BroadcastFrameRing, _ value: UInt8, length: Int = 100) -> BroadcastFrameRing.Descriptor? {
+        return ring.write(width: 10, height: 10, length: length) { memset($0, Int32(value), length) }
+    }
+    
+    func testFrameCrossesMappings() {
+        let (app, ext) = self.rings()
+        XCTAssertEqual(ext.slotCount, 3)
+        XCTAssertEqual(ext.slotCapacity, 1024)
+        let sent = self.write(ext, 7)!
+        let descriptor = BroadcastFrameRing.Descriptor(data: sent.data)!
+        XCTAssertEqual(descriptor.sequence, sent.sequence)
+        XCTAssertEqual(descriptor.length, 100)
+        let bytes = app.read(descriptor)!
+        XCTAssertEqual(Data(bytes), Data(repeating: 7, count: 100))
+        app.release(descriptor)
+        XCTAssertNil(BroadcastFrameRing.Descriptor(data: Data(count: BroadcastFrameRing.Descriptor.size)))
+    }
+    
+    func testOpeningWithoutAppFails() {
+        XCTAssertNil(BroadcastFrameRing(openingAt: self.path))
+        XCTAssertTrue(FileManager.default.createFile(atPath: self.path, contents: Data(count: 8192), attributes: nil))
+        XCTAssertNil(BroadcastFrameRing(openingAt: self.path))
+    }
+    
+    func testWriterDropsWithoutCredit() {
+        let (app, ext) = self.rings(slotCount: 2)
+        let first = self.write(ext, 1)!
+        let second = self.write(ext, 2)!
+        XCTAssertNil(self.write(ext, 3))
+        XCTAssertNil(self.write(ext, 4, length: 2048))
+        XCTAssertEqual(ext.statistics.dropped, 2)
+        
+        // Released out of order: the slot frees up only once the older frame is let go too.
+        XCTAssertNotNil(app.read(first))
+        XCTAssertNotNil(app.read(second))
+        app.release(second)
+        XCTAssertNil(self.write(ext, 5))
+        app.release(first)
+        XCTAssertNotNil(self.write(ext, 6))
+        XCTAssertNotNil(self.write(ext, 7))
+        XCTAssertNil(self.write(ext, 8))
+    }
+    
+    func testOverwrittenFrameIsLost() {
+        let (app, ext) = self.rings(slotCount: 2)
+        let late = ext.write(width: 1, height: 1, length: 1, captured: BroadcastFrameRing.now() - 2_000_000_000) { _ in }!
+        XCTAssertGreaterThanOrEqual(late.age, 2)
+        let second = self.write(ext, 2)!
+        XCTAssertNotNil(app.read(second))
+        app.release(second)
+        XCTAssertNotNil(self.write(ext, 3))
+        XCTAssertNil(app.read(late))
+        XCTAssertEqual(app.statistics.lost, 1)
+    }
+    
+    func testKeyframeRequests() {
+        let (app, ext) = self.rings()
+        XCTAssertEqual(ext.keyframeRequests, 0)
+        app.requestKeyframe()
+        app.requestKeyframe()
+        XCTAssertEqual(ext.keyframeRequests, 2)
+    }
+    
+    func testLostDescriptorsAreReleased() {
+        let (app, ext) = self.rings(slotCount: 3)
+        _ = self.write(ext, 1)
+        _ = self.write(ext, 2)
+        let third = self.write(ext, 3)!
+        XCTAssertNotNil(app.read(third))
+        app.release(third)
+        XCTAssertNotNil(self.write(ext, 4))
+        XCTAssertNotNil(self.write(ext, 5))
+        XCTAssertNotNil(self.write(ext, 6))
+    }
+    
+    // MARK: Benchmarks
+    
+    func testBenchmarkFrameThroughput() {
+        // One 1080p NV12 frame.
+        let length = 1920 * 1080 * 3 / 2
+        let frames = 300
+        let frame = [UInt8](repeating: 0x5a, count: length)
+        let (app, ext) = self.rings(slotCount: 3, slotCapacity: length)
+        let descriptors = DispatchQueue(label: "descriptors")
+        var pending = [BroadcastFrameRing.Descriptor]()
+        let done = self.expectation(description: "read")
+        var received = 0
+        let start = Date()
+        DispatchQueue.global().async {
+            while received < frames {
+                var next: BroadcastFrameRing.Descriptor?
+                descriptors.sync {
+                    if !pending.isEmpty {
+                        next = pending.removeFirst()
+                    }
+                }
+                if let descriptor = next, let bytes = app.read(descriptor) {
+                    XCTAssertEqual(bytes.count, length)
+                    app.release(descriptor)
+                    received += 1
+                }
+            }
+            done.fulfill()
+        }
+        var sent = 0
+        while sent < frames {
+            if let descriptor = ext.write(width: 1920, height: 1080, length: length, fill: { memcpy($0, frame, length) }) {
+                descriptors.sync {
+                    pending.append(descriptor)
+                }
+                sent += 1
+            }
+        }
+        self.wait(for: [done], timeout: 60)
+        let elapsed = Date().timeIntervalSince(start)
+        print("Frame ring: \(String(format: "%.0f", Double(frames) / elapsed)) fps at 1080p, \(ext.statistics.dropped) writes without credit")
+    }
+}
@@ -0,0 +1,182 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class CallCommandSchedulerTests: XCTestCase {
+    
+    /// Stands in for locus: holds requests until answered.
+    private class Locus<P> {
+        private let lock = NSLock()
+        private var _pending: [(payload: P, correlationId: Int, completionHandler: (Error?) -> Void)] = []
+        
+        var pending: [(payload: P, correlationId: Int, completionHandler: (Error?) -> Void)] {
+            lock.lock()
+            defer {
+                lock.unlock()
+            }
+            return _pending
+        }
+        
+        func send(_ payload: P, _ correlationId: Int, _ completionHandler: @escaping (Error?) -> Void) {
+            lock.lock()
+            _pending.append((payload, correlationId, completionHandler))
+            lock.unlock()
+        }
+        
+        func answer(_ error: Error? = nil) {
+            lock.lock()
+            let first = _pending.removeFirst()
+            lock.unlock()
+            first.completionHandler(error)
+        }
+    }
+    
+    private func wait(for count: Int, _ block: () -> Int) {
+        let deadline = Date(timeIntervalSinceNow: 5)
+        while block() < count && Date() < deadline {
+            RunLoop.current.run(until: Date(timeIntervalSinceNow: 0.001))
+        }
+        XCTAssertEqual(block(), count)
+    }
+    
+    func testLatestWins() {
+        let scheduler = CallCommandScheduler()
+        let locus = Locus<Int>()
+        let lane = scheduler.lane("test", combine: { $1 }, send: locus.send)
+        var answered = 0
+        for value in 1...5 {
+            lane.submit(value) { error in
+                XCTAssertNil(error)
+                answered += 1
+            }
+        }
+        wait(for: 1) { locus.pending.count }
+        XCTAssertEqual(locus.pending.first?.payload, 1)
+        locus.answer()
+        wait(for: 1) { locus.pending.count }
+        XCTAssertEqual(locus.pending.first?.payload, 5)
+        locus.answer()
+        wait(for: 5) { answered }
+        XCTAssertEqual(scheduler.statistics.sent, 2)
+        XCTAssertEqual(scheduler.statistics.combined, 3)
+    }
+    
+    func testJoinsWithinWindow() {
+        let scheduler = CallCommandScheduler()
+        let locus = Locus<String>()
+        let lane = scheduler.lane("test", window: 2, combine: { $0 + $1 }, send: locus.send)
+        for tone in ["1", "2", "3", "4", "#"] {
+            lane.submit(tone)
+        }
+        wait(for: 2) { locus.pending.count }
+        XCTAssertEqual(locus.pending.map { $0.payload }, ["1", "2"])
+        locus.answer()
+        wait(for: 2) { locus.pending.count }
+        XCTAssertEqual(locus.pending.map { $0.payload }, ["2", "34#"])
+        let ids = locus.pending.map { $0.correlationId }
+        XCTAssertLessThan(ids[0], ids[1])
+        locus.answer()
+        locus.answer()
+        wait(for: 3) { scheduler.statistics.sent }
+        XCTAssertEqual(locus.pending.count, 0)
+    }
+    
+    func testCorrelationIdsAreConsecutivePerLane() {
+        let scheduler = CallCommandScheduler()
+        let dtmf = Locus<String>()
+        let media = Locus<Int>()
+        let dtmfLane = scheduler.lane("DTMF", combine: { $0 + $1 }, send: dtmf.send)
+        let mediaLane = scheduler.lane("media", combine: { $1 }, send: media.send)
+        var ids = [Int]()
+        for i in 1...3 {
+            mediaLane.submit(i)
+            wait(for: 1) { media.pending.count }
+            media.answer()
+            dtmfLane.submit("\(i)")
+            wait(for: 1) { dtmf.pending.count }
+            ids.append(dtmf.pending[0].correlationId)
+            dtmf.answer()
+        }
+        XCTAssertEqual(ids, [1, 2, 3])
+    }
+    
+    func testFailureReachesCombinedCommands() {
+        let scheduler = CallCommandScheduler()
+        let locus = Locus<String>()
+        let lane = scheduler.lane("test", combine: { $0 + $1 }, send: locus.send)
+        var errors = [Error?]()
+        for tone in ["1", "2", "3"] {
+            lane.submit(tone) { errors.append($0) }
+        }
+        wait(for: 1) { locus.pending.count }
+        locus.answer()
+        wait(for: 1) { locus.pending.count }
+        locus.answer(SparkError.illegalStatus(reason: "test"))
+        wait(for: 3) { errors.count }
+        XCTAssertNil(errors[0])
+        XCTAssertNotNil(errors[1])
+        XCTAssertNotNil(errors[2])
+        XCTAssertEqual(scheduler.statistics.failures, 1)
+    }
+    
+    func testRoundTripStatistics() {
+        let scheduler = CallCommandScheduler()
+        let lane = scheduler.lane("test", combine: { $1 }) { (_: Int, _, completionHandler) in
+            DispatchQueue.global().asyncAfter(deadline: .now() + 0.05) {
+                completionHandler(nil)
+            }
+        }
+        var answered = 0
+        lane.submit(1) { _ in answered += 1 }
+        wait(for: 1) { answered }
+        let statistics = scheduler.statistics
+        XCTAssertGreaterThanOrEqual(statistics.lastRoundTrip, 0.05)
+        XCTAssertEqual(statistics.smoothedRoundTrip, statistics.lastRoundTrip)
+    }
+    
+    // MARK: Benchmarks
+    
+    func testBenchmarkMuteToggleBurst() {
+        let roundTrip = 0.02
+        let toggles = 200
+        for window in [1, 2] {
+            let scheduler = CallCommandScheduler()
+            let lane = scheduler.lane("test", window: window, combine: { $1 }) { (_: Bool, _, completionHandler) in
+                DispatchQueue.global().asyncAfter(deadline: .now() + roundTrip) {
+                    completionHandler(nil)
+                }
+            }
+            var answered = 0
+            let start = Date()
+            for i in 0..<toggles {
+                lane.submit(i % 2 == 0) { _ in answered += 1 }
+            }
+            wait(for: toggles) { answered }
+            let elapsed = Date().timeIntervalSince(start)
+            print("Window \(window): \(toggles) toggles in \(scheduler.statistics.sent) requests, \(String(format: "%.0f", Double(toggles) / elapsed)) ops/s "
+                + "(\(String(format: "%.0f", Double(toggles) * roundTrip / elapsed))x one request per toggle)")
+            XCTAssertLessThan(scheduler.statistics.sent, toggles / 10)
+        }
+    }
+}
@@ -215,6 +215,50 @@ class CallTests: XCTestCase {
         }
     }
     
+    func testBenchmarkLocusUpdates() {
+        guard let call = self.call else {
+            XCTFail("no call")
+            return
+        }
+        var events = 0
+        call.onCallMembershipChanged = { _ in
+            events += 1
+        }
+        var base = call.model
+        var sequence: UInt64 = 5_000_000_000
+        for size in [10, 100, 250, 500, 1000] {
+            var participants = (0..<size).map { self.participant(index: $0, sending: false) }
+            let updates = 50
+            var expected = 0
+            let start = Date()
+            for update in 0..<updates {
+                // Every update flips the audio of a few participants, as mute and unmute do.
+                for index in stride(from: update % 7, to: size, by: 7).prefix(5) {
+                    participants[index] = self.participant(index: index, sending: participants[index].status?.audioStatus != "SENDRECV")
+                    expected += update > 0 ? 1 : 0
+                }
+                sequence += 1
+                var model = SequenceModel()
+                model.entries = [sequence]
+                base.setParticipants(newParticipants: participants)
+                base.setSequence(newSequence: model)
+                call.update(model: base)
+            }
+            let elapsed = Date().timeIntervalSince(start)
+            XCTAssertEqual(call.memberships.count, size)
+            XCTAssertNotNil(call.membership(id: "participant-\(size - 1)"))
+            print("Locus update, \(size) participants: \(String(format: "%.3f", elapsed / Double(updates) * 1000)) ms")
+            events = 0
+            RunLoop.main.run(until: Date(timeIntervalSinceNow: 0.1))
+            XCTAssertGreaterThanOrEqual(events, expected)
+        }
+    }
+    
+    private func participant(index: Int, sending: Bool) -> ParticipantModel {
+        let status = ParticipantModel.StatusModel(audioStatus: sending ? "SENDRECV" : "RECVONLY", videoStatus: "SENDRECV", csis: nil)
+        return ParticipantModel(isCreator: false, id: "participant-\(index)", url: nil, state: CallMembership.State.joined, type: "USER", person: nil, status: status, deviceUrl: nil, mediaBaseUrl: nil, guest: false, alertHint: nil, alertType: nil, enableDTMF: false, devices: nil)
+    }
+    
     private func mockCall() -> Call? {
         if let user = self.fixture.createUser() {
             self.remoteUser = user
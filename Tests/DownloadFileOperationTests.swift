@@ -0,0 +1,203 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class DownloadFileOperationTests: XCTestCase {
+
+    /// Serves `body`, answering the first `rangeRequests` requests with the asked range and
+    /// every later one with the whole body, as a server or proxy ignoring `Range` would. Ranges
+    /// starting at `failFrom` or later are answered with 503, a little late.
+    private class FileServer: URLProtocol {
+        static let lock = NSLock()
+        static var body = Data()
+        static var rangeRequests = 0
+        static var requests = 0
+        static var failFrom: Int?
+        static var starts = [Int]()
+
+        override class func canInit(with request: URLRequest) -> Bool {
+            return request.url?.host == "files.example.com"
+        }
+
+        override class func canonicalRequest(for request: URLRequest) -> URLRequest {
+            return request
+        }
+
+        override func startLoading() {
+            FileServer.lock.lock()
+            FileServer.requests += 1
+            let partial = FileServer.requests <= FileServer.rangeRequests
+            let body = FileServer.body
+            let failFrom = FileServer.failFrom
+            let bounds = (self.request.value(forHTTPHeaderField: "Range") ?? "").dropFirst("bytes=".count).split(separator: "-").compactMap { Int($0) }
+            if bounds.count == 2 {
+                FileServer.starts.append(bounds[0])
+            }
+            FileServer.lock.unlock()
+            let response: HTTPURLResponse
+            let data: Data
+            if let failFrom = failFrom, bounds.count == 2, bounds[0] >= failFrom {
+                DispatchQueue.global().asyncAfter(deadline: .now() + 0.5) {
+                    self.client?.urlProtocol(self, didReceive: HTTPURLResponse(url: self.request.url!, statusCode: 503, httpVersion: "HTTP/1.1", headerFields: nil)!, cacheStoragePolicy: .notAllowed)
+                    self.client?.urlProtocolDidFinishLoading(self)
+                }
+                return
+            }
+            if partial && bounds.count == 2 && bounds[0] >= body.count {
+                data = Data()
+                response = HTTPURLResponse(url: self.request.url!, statusCode: 416, httpVersion: "HTTP/1.1", headerFields: ["Content-Range": "bytes */\(body.count)"])!
+            }
+            else if partial && bounds.count == 2 {
+                let upper = min(bounds[1], body.count - 1)
+                data = body.subdata(in: bounds[0]..<(upper + 1))
+                response = HTTPURLResponse(url: self.request.url!, statusCode: 206, httpVersion: "HTTP/1.1", headerFields: ["Content-Range": "bytes \(bounds[0])-\(upper)/\(body.count)", "Content-Length": String(data.count)])!
+            }
+            else {
+                data = body
+                response = HTTPURLResponse(url: self.request.url!, statusCode: 200, httpVersion: "HTTP/1.1", headerFields: ["Content-Length": String(data.count)])!
+            }
+            self.client?.urlProtocol(self, didReceive: response, cacheStoragePolicy: .notAllowed)
+            var offset = 0
+            while offset < data.count {
+                let count = min(256 * 1024, data.count - offset)
+                self.client?.urlProtocol(self, didLoad: data.subdata(in: offset..<(offset + count)))
+                offset += count
+            }
+            self.client?.urlProtocolDidFinishLoading(self)
+        }
+
+        override func stopLoading() {
+        }
+    }
+
+    private var installed: DownloadSessionPool!
+    private var maxRetries = 0
+    private var directory: URL!
+    private var plaintext = Data()
+    private var scr = ""
+
+    override func setUp() {
+        let configuration = URLSessionConfiguration.ephemeral
+        configuration.protocolClasses = [FileServer.self]
+        self.installed = DownloadSessionPool.shared
+        DownloadSessionPool.shared = DownloadSessionPool(configuration: configuration)
+        self.maxRetries = DownloadFileOperation.maxRetries
+        self.directory = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString, isDirectory: true)
+        XCTAssertNoThrow(try FileManager.default.createDirectory(at: self.directory, withIntermediateDirectories: true, attributes: nil))
+        self.serve(Data((0..<(2 * Int(DownloadFileOperation.segmentSize) + 123_457)).map { UInt8(truncatingIfNeeded: $0 &* 131) }))
+    }
+
+    override func tearDown() {
+        DownloadSessionPool.shared = self.installed
+        DownloadFileOperation.maxRetries = self.maxRetries
+        try? FileManager.default.removeItem(at: self.directory)
+    }
+
+    /// Encrypts `plaintext` with a new SCR and has the server send it.
+    private func serve(_ plaintext: Data) {
+        self.plaintext = plaintext
+        let reference = try! SecureContentReference(error: ())
+        let cipher = try! ParallelCipherA256GCM(scr: reference)
+        var ciphertext = plaintext
+        let count = ciphertext.count
+        if count > 0 {
+            _ = try! ciphertext.withUnsafeMutableBytes { (bytes: UnsafeMutablePointer<UInt8>) in
+                try cipher.encryptBytes(UnsafePointer(bytes), toBuffer: bytes, withLength: count)
+            }
+        }
+        try! cipher.finalize()
+        self.scr = try! reference.json()
+        FileServer.lock.lock()
+        FileServer.body = ciphertext
+        FileServer.requests = 0
+        FileServer.failFrom = nil
+        FileServer.starts = []
+        FileServer.lock.unlock()
+    }
+
+    private func download(source: String = "https://files.example.com/" + UUID().uuidString) -> Result<URL>? {
+        var result: Result<URL>?
+        let done = expectation(description: "downloaded")
+        let operation = DownloadFileOperation(authenticator: SimpleAuthenticator(accessToken: "token"), uuid: UUID().uuidString, source: source, displayName: "file", secureContentRef: self.scr, thnumnail: false, target: self.directory, queue: nil, progressHandler: nil) { value in
+            result = value
+            done.fulfill()
+        }
+        operation.run()
+        wait(for: [done], timeout: 10)
+        return result
+    }
+
+    func testDownloadsInRanges() {
+        FileServer.rangeRequests = Int.max
+        let url = self.download()?.data
+        XCTAssertNotNil(url)
+        XCTAssertEqual(url.flatMap { try? Data(contentsOf: $0) }, self.plaintext)
+        XCTAssertGreaterThan(FileServer.requests, 1)
+    }
+
+    func testServerIgnoringRange() {
+        FileServer.rangeRequests = 0
+        let url = self.download()?.data
+        XCTAssertNotNil(url)
+        XCTAssertEqual(url.flatMap { try? Data(contentsOf: $0) }, self.plaintext)
+    }
+
+    func testServerIgnoringRangeAfterFirstRange() {
+        // The later ranges ask for offsets past 0 and get the whole body from 0.
+        FileServer.rangeRequests = 1
+        let url = self.download()?.data
+        XCTAssertNotNil(url)
+        XCTAssertEqual(url.flatMap { try? Data(contentsOf: $0) }, self.plaintext)
+    }
+
+    func testEmptyFile() {
+        FileServer.rangeRequests = Int.max
+        self.serve(Data())
+        let url = self.download()?.data
+        XCTAssertNotNil(url)
+        XCTAssertEqual(url.flatMap { try? Data(contentsOf: $0) }, Data())
+    }
+
+    func testResumesFromCheckpoint() {
+        FileServer.rangeRequests = Int.max
+        DownloadFileOperation.maxRetries = 0
+        let source = "https://files.example.com/" + UUID().uuidString
+        // The first two ranges arrive, the last one fails.
+        FileServer.lock.lock()
+        FileServer.failFrom = 2 * Int(DownloadFileOperation.segmentSize)
+        FileServer.lock.unlock()
+        XCTAssertNil(self.download(source: source)?.data)
+
+        FileServer.lock.lock()
+        FileServer.failFrom = nil
+        FileServer.starts = []
+        FileServer.lock.unlock()
+        let url = self.download(source: source)?.data
+        XCTAssertNotNil(url)
+        XCTAssertEqual(url.flatMap { try? Data(contentsOf: $0) }, self.plaintext)
+        FileServer.lock.lock()
+        XCTAssertEqual(FileServer.starts, [2 * Int(DownloadFileOperation.segmentSize)])
+        FileServer.lock.unlock()
+    }
+}
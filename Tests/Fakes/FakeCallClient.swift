@@ -35,6 +35,14 @@ class FakeCallClient: CallClient {
     
     var illegalType:FakeCallModelHelper.CallIllegalStatusType? = nil
     
+    // Models answered by `fetch(_:queue:)`, and the call urls whose fetches wait for `releaseFetches()`.
+    var fetchModels = [String: CallModel]()
+    var heldFetches = Set<String>()
+    var onFetch: ((String) -> Void)?
+    private let fetchLock = NSLock()
+    private var fetchCounts = [String: Int]()
+    private var pendingFetches = [() -> Void]()
+    
     override init(authenticator: Authenticator) {
         super.init(authenticator: authenticator)
     }
@@ -73,6 +81,48 @@ class FakeCallClient: CallClient {
         
     }
     
+    override func fetch(_ callUrl: String, queue: DispatchQueue, completionHandler: @escaping (ServiceResponse<CallModel>) -> Void) {
+        let respond = {
+            let result: Result<CallModel>
+            if let model = self.fetchModels[callUrl] {
+                result = Result.success(model)
+            }
+            else {
+                result = Result.failure(SparkError.serviceFailed(code: -7000, reason: "fetch call error"))
+            }
+            completionHandler(ServiceResponse(HTTPURLResponse(url: URL(string: "www.aaa.com")!, statusCode: 200, httpVersion: "HTTP/1.1", headerFields: ["Content-Type":"application/json;charset=UTF-8"]), result))
+        }
+        self.fetchLock.lock()
+        self.fetchCounts[callUrl] = (self.fetchCounts[callUrl] ?? 0) + 1
+        let held = self.heldFetches.contains(callUrl)
+        if held {
+            self.pendingFetches.append(respond)
+        }
+        let onFetch = self.onFetch
+        self.fetchLock.unlock()
+        onFetch?(callUrl)
+        if !held {
+            respond()
+        }
+    }
+    
+    func fetchCount(_ callUrl: String) -> Int {
+        self.fetchLock.lock()
+        defer {
+            self.fetchLock.unlock()
+        }
+        return self.fetchCounts[callUrl] ?? 0
+    }
+    
+    func releaseFetches() {
+        self.fetchLock.lock()
+        let pending = self.pendingFetches
+        self.pendingFetches = []
+        self.heldFetches = []
+        self.fetchLock.unlock()
+        pending.forEach { $0() }
+    }
+    
     override func fetch(by device: Device, queue: DispatchQueue, completionHandler: @escaping (ServiceResponse<[CallModel]>) -> Void) {
         if enableServerReturnError {
             let error = SparkError.serviceFailed(code: -7000, reason: "create call error")
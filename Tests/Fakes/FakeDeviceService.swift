@@ -24,7 +24,29 @@ import Foundation
 class FakeDeviceService: DeviceService {
     var disableRegister: Bool = false
     var disableDeregister: Bool = false
-    override func registerDevice(phone: Phone, queue: DispatchQueue, completionHandler: @escaping (Result<Device>) -> Void) {
+    var enableCachedDevice: Bool = false
+    var registerDelay: TimeInterval = 0
+    private(set) var registerCount = 0
+    
+    override func cachedDevice(phone: Phone) -> Device? {
+        guard enableCachedDevice else {
+            return nil
+        }
+        return Device(phone: phone, deviceUrl: URL(string: Config.FakeSelfDeviceUrl)!, webSocketUrl: URL(string: Config.FakeWebSocketUrl)!, locusServiceUrl: URL(string: Config.FakeLocusServiceUrl)!, calliopeDiscoveryServiceUrl: URL(string: Config.FakeCalliopeDiscoveryServiceUrl)!, metricsServiceUrl: URL(string: Config.FakeMetricsServiceUrl)!, conversationServiceUrl: URL(string: Config.FakeConversationServiceUrl)!, deviceType: "IPHONE", regionCode: "US-WEST", countryCode: "US")
+    }
+    
+    override func registerDevice(phone: Phone, queue: DispatchQueue, timeline: StartupTimeline?, completionHandler: @escaping (Result<Device>) -> Void) {
+        if registerDelay > 0 {
+            let delay = registerDelay
+            registerDelay = 0
+            queue.asyncAfter(deadline: .now() + delay) {
+                self.registerDevice(phone: phone, queue: queue, timeline: timeline, completionHandler: completionHandler)
+            }
+            return
+        }
+        registerCount += 1
+        timeline?.mark(.device)
+        timeline?.mark(.region)
         if disableRegister == false {
         let deviceUrl = URL(string: Config.FakeSelfDeviceUrl)
         
@@ -0,0 +1,406 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+@testable import SparkSDK
+
+/// In-memory stand-in for the Hydra REST API, the conversation service, the file service and the
+/// Mercury websocket.
+///
+/// `install()` points `ServiceSession.shared` and `DownloadSessionPool.shared` at the server, so
+/// the SDK clients run unmodified, offline, without a cloud account. Resources are kept as plain
+/// JSON dictionaries; a list filters them by the query parameters it is given, and is paged with
+/// `Link` headers when given a `max`. Posted activities are pushed as Mercury frames to every
+/// attached `WebSocketService`. Files are served with `Range` support.
+///
+/// KMS is not emulated: its requests go through their own Alamofire session and a key exchange
+/// the server cannot answer. `shareKey(_:roomId:)` seeds room keys into `KeyMaterialCache.shared`
+/// instead, which the tests clear when done.
+class FakeSparkServer {
+
+    struct Statistics {
+        var requests = 0
+        var frames = 0
+        var acks = 0
+    }
+
+    /// Time every response is held back, roughly a round trip to the service.
+    var latency: TimeInterval = 0.002
+
+    let me: [String: Any]
+
+    var statistics: Statistics {
+        return self.locked { self._statistics }
+    }
+
+    private static let hydraPath = URL(string: ServiceRequest.HYDRA_SERVER_ADDRESS)!.path
+    private static let conversationPath = URL(string: ServiceRequest.CONVERSATION_SERVER_ADDRESS)!.path
+    private static let dateFormat = "yyyy-MM-dd'T'HH:mm:ss.SSSZZZZZ"
+    private static let fileAddress = "https://files.example.com/files/"
+
+    private let lock = NSLock()
+    private var _statistics = Statistics()
+    private var resources = [String: [String: [String: Any]]]()
+    private var activities = [String: [[String: Any]]]()
+    private var files = [String: Data]()
+    private var sockets = [WebSocketService]()
+    private var installed: ServiceSession?
+    private var installedDownloads: DownloadSessionPool?
+
+    init() {
+        let id = UUID().uuidString
+        self.me = ["id": id.hydraFormat(for: .people), "emails": ["me@example.com"], "displayName": "Me", "created": FakeSparkServer.now()]
+        self.resources["people"] = [self.me["id"] as! String: self.me]
+    }
+
+    func install() {
+        let configuration = URLSessionConfiguration.ephemeral
+        configuration.protocolClasses = [FakeSparkServer.URLProtocol.self]
+        FakeSparkServer.URLProtocol.server = self
+        self.installed = ServiceSession.shared
+        ServiceSession.shared = ServiceSession(configuration: configuration)
+        self.installedDownloads = DownloadSessionPool.shared
+        DownloadSessionPool.shared = DownloadSessionPool(configuration: configuration)
+    }
+
+    func uninstall() {
+        if let session = self.installed {
+            ServiceSession.shared = session
+        }
+        if let pool = self.installedDownloads {
+            DownloadSessionPool.shared = pool
+        }
+        FakeSparkServer.URLProtocol.server = nil
+    }
+
+    /// Delivers every activity posted from now on to `service`, as Mercury would.
+    func attach(_ service: WebSocketService) {
+        self.locked {
+            self.sockets.append(service)
+        }
+    }
+
+    /// Creates a room holding `messages` activities, encrypted with `key` if given. Returns its id.
+    @discardableResult
+    func seedRoom(title: String = "room", messages: Int = 0, key: String? = nil) -> String {
+        let id = UUID().uuidString.hydraFormat(for: .room)
+        self.locked {
+            self.resources["rooms", default: [:]][id] = ["id": id, "title": title, "type": "group", "created": FakeSparkServer.now()]
+        }
+        self.seedMessages(roomId: id, texts: (0..<messages).map { "message \($0)" }, key: key, start: Date().addingTimeInterval(-Double(messages)), interval: 1)
+        return id
+    }
+
+    /// Adds messages to a room, published `interval` apart from `start` on, encrypted with `key` if given.
+    func seedMessages(roomId: String, texts: [String], key: String? = nil, start: Date, interval: TimeInterval) {
+        for (index, text) in texts.enumerated() {
+            let text = text.encrypt(key: key)
+            _ = self.addActivity(["verb": "post", "object": ["objectType": "comment", "displayName": text, "content": text],
+                                  "target": ["id": roomId.locusFormat, "objectType": "conversation"]], published: start.addingTimeInterval(Double(index) * interval))
+        }
+    }
+
+    /// Adds `item` to the Hydra `collection` under a new id. Returns the id.
+    @discardableResult
+    func seed(_ collection: String, _ item: [String: Any]) -> String {
+        var item = item
+        let id = UUID().uuidString.hydraFormat(for: .message)
+        item["id"] = id
+        item["created"] = item["created"] ?? FakeSparkServer.now()
+        self.locked {
+            self.resources[collection, default: [:]][id] = item
+        }
+        return id
+    }
+
+    /// Encrypts `plaintext` as a file attachment and serves it. Returns its URL and secure content reference.
+    func seedFile(_ plaintext: Data) -> (url: String, scr: String) {
+        let reference = try! SecureContentReference(error: ())
+        let cipher = try! ParallelCipherA256GCM(scr: reference)
+        var ciphertext = plaintext
+        let count = ciphertext.count
+        if count > 0 {
+            _ = try! ciphertext.withUnsafeMutableBytes { (bytes: UnsafeMutablePointer<UInt8>) in
+                try cipher.encryptBytes(UnsafePointer(bytes), toBuffer: bytes, withLength: count)
+            }
+        }
+        try! cipher.finalize()
+        let id = UUID().uuidString
+        self.locked {
+            self.files[id] = ciphertext
+        }
+        return (FakeSparkServer.fileAddress + id, try! reference.json())
+    }
+
+    /// Makes the key of `roomId` known to the SDK, as if it had been fetched from KMS.
+    func shareKey(_ key: String, roomId: String) {
+        let uri = "kms://kms.example.com/keys/" + UUID().uuidString
+        KeyMaterialCache.shared.store(uri: uri, material: key)
+        KeyMaterialCache.shared.bind(roomId: roomId, uri: uri)
+    }
+
+    static func randomKey() -> String {
+        let key = Data((0..<32).map { _ in UInt8(truncatingIfNeeded: arc4random()) })
+        let k = key.base64EncodedString().replacingOccurrences(of: "+", with: "-").replacingOccurrences(of: "/", with: "_").replacingOccurrences(of: "=", with: "")
+        return "{\"kty\":\"oct\",\"k\":\"\(k)\"}"
+    }
+
+    static func now(_ date: Date = Date()) -> String {
+        let formatter = DateFormatter()
+        formatter.locale = Locale(identifier: "en_US_POSIX")
+        formatter.timeZone = TimeZone(identifier: "UTC")
+        formatter.dateFormat = FakeSparkServer.dateFormat
+        return formatter.string(from: date)
+    }
+
+    private func locked<T>(_ block: () -> T) -> T {
+        self.lock.lock()
+        defer {
+            self.lock.unlock()
+        }
+        return block()
+    }
+
+    // MARK: Routing
+
+    /// Answers a request for a seeded file, or returns nil if it is not one.
+    fileprivate func file(for request: URLRequest) -> (Int, Data, [String: String])? {
+        guard let url = request.url?.absoluteString, url.hasPrefix(FakeSparkServer.fileAddress) else {
+            return nil
+        }
+        let file = self.locked { () -> Data? in
+            self._statistics.requests += 1
+            return self.files[String(url.dropFirst(FakeSparkServer.fileAddress.count))]
+        }
+        guard let data = file else {
+            return (404, Data(), [:])
+        }
+        let bounds = (request.value(forHTTPHeaderField: "Range") ?? "").dropFirst("bytes=".count).split(separator: "-").compactMap { Int($0) }
+        guard bounds.count == 2 else {
+            return (200, data, ["Content-Length": String(data.count)])
+        }
+        guard bounds[0] < data.count else {
+            return (416, Data(), ["Content-Range": "bytes */\(data.count)"])
+        }
+        let upper = min(bounds[1], data.count - 1)
+        return (206, data.subdata(in: bounds[0]..<(upper + 1)), ["Content-Range": "bytes \(bounds[0])-\(upper)/\(data.count)", "Content-Length": String(upper + 1 - bounds[0])])
+    }
+
+    fileprivate func respond(to request: URLRequest, body: Data?) -> (Int, Any?, [String: String]) {
+        self.locked {
+            self._statistics.requests += 1
+        }
+        guard let url = request.url, let components = URLComponents(url: url, resolvingAgainstBaseURL: false) else {
+            return (400, nil, [:])
+        }
+        var query = [String: String]()
+        components.queryItems?.forEach { query[$0.name] = $0.value }
+        let json = body.flatMap { try? JSONSerialization.jsonObject(with: $0, options: []) } as? [String: Any]
+        let method = request.httpMethod ?? "GET"
+        if url.path.hasPrefix(FakeSparkServer.conversationPath) {
+            let path = url.path.dropFirst(FakeSparkServer.conversationPath.count).split(separator: "/").map(String.init)
+            let (status, response) = self.conversation(method: method, path: path, query: query, body: json)
+            return (status, response, [:])
+        }
+        let path = url.path.dropFirst(FakeSparkServer.hydraPath.count).split(separator: "/").map(String.init)
+        var headers = [String: String]()
+        let (status, response) = self.hydra(method: method, path: path, query: query, body: json) { cursor in
+            var next = components
+            next.queryItems = (components.queryItems ?? []).filter { $0.name != "cursor" } + [URLQueryItem(name: "cursor", value: String(cursor))]
+            headers["Link"] = "<\(next.url!.absoluteString)>; rel=\"next\""
+        }
+        return (status, response, headers)
+    }
+
+    /// Lists are paged by `max`; `link` is called with the offset of the next page, if there is one.
+    private func hydra(method: String, path: [String], query: [String: String], body: [String: Any]?, link: (Int) -> Void) -> (Int, Any?) {
+        guard let collection = path.first else {
+            return (404, nil)
+        }
+        return self.locked { () -> (Int, Any?) in
+            var items = self.resources[collection] ?? [:]
+            defer {
+                self.resources[collection] = items
+            }
+            switch (method, path.count > 1 ? path[1] : nil) {
+            case ("GET", "me"?) where collection == "people":
+                return (200, self.me)
+            case ("GET", let id?):
+                return items[id].map { (200, $0) } ?? (404, nil)
+            case ("GET", nil):
+                let filters = query.filter { $0.key != "max" && $0.key != "cursor" }
+                var matches = items.values.filter { item in
+                    !filters.contains { filter in
+                        let value = item[filter.key == "email" ? "emails" : filter.key]
+                        return (value as? String) != filter.value && (value as? [String])?.contains(filter.value) != true
+                    }
+                }
+                matches.sort { ($0["created"] as? String ?? "", $0["id"] as? String ?? "") < ($1["created"] as? String ?? "", $1["id"] as? String ?? "") }
+                if let max = query["max"].flatMap({ Int($0) }) {
+                    let offset = min(query["cursor"].flatMap { Int($0) } ?? 0, matches.count)
+                    if offset + max < matches.count {
+                        link(offset + max)
+                    }
+                    matches = Array(matches[offset..<min(offset + max, matches.count)])
+                }
+                return (200, ["items": matches])
+            case ("POST", nil):
+                var item = body ?? [:]
+                let type: IdentityType = collection == "people" ? .people : collection == "rooms" ? .room : .message
+                item["id"] = UUID().uuidString.hydraFormat(for: type)
+                item["created"] = FakeSparkServer.now()
+                if collection == "rooms" {
+                    item["type"] = "group"
+                }
+                items[item["id"] as! String] = item
+                return (200, item)
+            case ("PUT", let id?):
+                guard var item = items[id] else {
+                    return (404, nil)
+                }
+                body?.forEach { item[$0.key] = $0.value }
+                items[id] = item
+                return (200, item)
+            case ("DELETE", let id?):
+                return items.removeValue(forKey: id) == nil ? (404, nil) : (204, nil)
+            default:
+                return (405, nil)
+            }
+        }
+    }
+
+    private func conversation(method: String, path: [String], query: [String: String], body: [String: Any]?) -> (Int, Any?) {
+        switch (method, path.first, path.count > 1 ? path[1] : nil) {
+        case ("GET", "activities"?, let id?):
+            let activity = self.locked {
+                self.activities.values.lazy.compactMap { $0.first { ($0["id"] as? String) == id } }.first
+            }
+            return activity.map { (200, $0) } ?? (404, nil)
+        case ("GET", "activities"?, nil):
+            guard let conversation = query["conversationId"] else {
+                return (400, nil)
+            }
+            let before = query["maxDate"].flatMap { Date.fromISO860($0) }.map { FakeSparkServer.now($0) } ?? "~"
+            let limit = query["limit"].flatMap { Int($0) } ?? 50
+            let items = self.locked {
+                Array((self.activities[conversation] ?? []).reversed().lazy.filter { ($0["published"] as? String ?? "") < before }.prefix(limit))
+            }
+            return (200, ["items": items])
+        case ("POST", "activities"?, nil):
+            guard let body = body else {
+                return (400, nil)
+            }
+            return (200, self.addActivity(body, published: Date()))
+        case ("GET", "conversations"?, let id?):
+            return (200, ["id": id, "kmsResourceObjectUrl": "kms://kms.example.com/resources/" + id])
+        case ("PUT", "conversations"?, "user"?):
+            return (200, ["id": UUID().uuidString])
+        case ("PUT", "conversations"?, let id?) where path.last == "space":
+            return (200, ["spaceUrl": "https://files.example.com/spaces/" + id])
+        default:
+            return (404, nil)
+        }
+    }
+
+    private func addActivity(_ body: [String: Any], published: Date) -> [String: Any] {
+        var activity = body
+        activity["id"] = UUID().uuidString
+        activity["published"] = FakeSparkServer.now(published)
+        activity["actor"] = ["entryUUID": (self.me["id"] as! String).locusFormat, "emailAddress": "me@example.com"]
+        let conversation = (body["target"] as? [String: Any])?["id"] as? String ?? ""
+        let sockets = self.locked { () -> [WebSocketService] in
+            self.activities[conversation, default: []].append(activity)
+            return self.sockets
+        }
+        if !sockets.isEmpty {
+            let frame = try! JSONSerialization.data(withJSONObject: ["id": UUID().uuidString, "data": ["eventType": "conversation.activity", "activity": activity]], options: [])
+            for socket in sockets {
+                self.locked {
+                    self._statistics.frames += 1
+                }
+                socket.receive(frame) { _ in
+                    self.locked {
+                        self._statistics.acks += 1
+                    }
+                }
+            }
+        }
+        return activity
+    }
+
+    // MARK: URLProtocol
+
+    class URLProtocol: Foundation.URLProtocol {
+
+        static var server: FakeSparkServer?
+
+        override class func canInit(with request: URLRequest) -> Bool {
+            return true
+        }
+
+        override class func canonicalRequest(for request: URLRequest) -> URLRequest {
+            return request
+        }
+
+        override func startLoading() {
+            guard let server = URLProtocol.server, let url = self.request.url else {
+                self.client?.urlProtocol(self, didFailWithError: URLError(.cannotConnectToHost))
+                return
+            }
+            let body = self.request.httpBody ?? self.request.httpBodyStream.map { URLProtocol.read($0) }
+            DispatchQueue.global().asyncAfter(deadline: .now() + server.latency) {
+                if let (status, data, headers) = server.file(for: self.request) {
+                    self.client?.urlProtocol(self, didReceive: HTTPURLResponse(url: url, statusCode: status, httpVersion: "HTTP/1.1", headerFields: headers)!, cacheStoragePolicy: .notAllowed)
+                    self.client?.urlProtocol(self, didLoad: data)
+                    self.client?.urlProtocolDidFinishLoading(self)
+                    return
+                }
+                let (status, json, headers) = server.respond(to: self.request, body: body)
+                let response = HTTPURLResponse(url: url, statusCode: status, httpVersion: "HTTP/1.1", headerFields: headers.merging(["Content-Type": "application/json;charset=UTF-8"]) { $1 })!
+                self.client?.urlProtocol(self, didReceive: response, cacheStoragePolicy: .notAllowed)
+                if let json = json, let data = try? JSONSerialization.data(withJSONObject: json, options: []) {
+                    self.client?.urlProtocol(self, didLoad: data)
+                }
+                self.client?.urlProtocolDidFinishLoading(self)
+            }
+        }
+
+        override func stopLoading() {
+        }
+
+        private static func read(_ stream: InputStream) -> Data {
+            var data = Data()
+            var buffer = [UInt8](repeating: 0, count: 16 * 1024)
+            stream.open()
+            defer {
+                stream.close()
+            }
+            while true {
+                let count = stream.read(&buffer, maxLength: buffer.count)
+                if count <= 0 {
+                    break
+                }
+                data.append(buffer, count: count)
+            }
+            return data
+        }
+    }
+}
@@ -26,8 +26,10 @@ import ObjectMapper
 
 class FakeWebSocketService:WebSocketService {
     private var callModel:CallModel?
+    private(set) var connectedUrls = [URL]()
     
     override func connect(_ webSocketUrl: URL, _ block: @escaping (Error?) -> Void) {
+        connectedUrls.append(webSocketUrl)
         block(nil)
     }
     
@@ -0,0 +1,122 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class JWEKeyTests: XCTestCase {
+    
+    private let jwk: String = {
+        let key = Data((0..<32).map { _ in UInt8(truncatingIfNeeded: arc4random()) })
+        return "{\"kty\":\"oct\",\"k\":\"\(JWEKey.base64URLEncode(key))\"}"
+    }()
+    
+    // A typical message body.
+    private let body = Data(String(repeating: "Lorem ipsum dolor sit amet. ", count: 8).prefix(200).utf8)
+    
+    private let iterations = 2000
+    
+    func testBase64URLMatchesFoundation() {
+        for count in 0..<70 {
+            let data = Data((0..<count).map { UInt8(truncatingIfNeeded: $0 &* 37 &+ 11) })
+            let expected = data.base64EncodedString().replacingOccurrences(of: "+", with: "-").replacingOccurrences(of: "/", with: "_").replacingOccurrences(of: "=", with: "")
+            XCTAssertEqual(JWEKey.base64URLEncode(data), expected)
+            XCTAssertEqual(JWEKey.base64URLDecode(expected), data)
+        }
+        XCTAssertNil(JWEKey.base64URLDecode("ab+c"))
+        XCTAssertNil(JWEKey.base64URLDecode("abcde"))
+    }
+    
+    func testEncryptInteroperatesWithCjoseWrapper() throws {
+        let key = JWEKey(jwk: self.jwk)
+        XCTAssertTrue(key.isPrepared)
+        guard let jwe = key.encrypt(self.body) else {
+            XCTFail("Encryption failed")
+            return
+        }
+        XCTAssertEqual(try CjoseWrapper.content(fromCiphertext: jwe, key: self.jwk), self.body)
+        XCTAssertEqual(key.decrypt(try CjoseWrapper.ciphertext(fromContent: self.body, key: self.jwk)), self.body)
+        XCTAssertNotEqual(key.encrypt(self.body), jwe)
+    }
+    
+    func testBatchKeepsOrder() {
+        let key = JWEKey(jwk: self.jwk)
+        let payloads = (0..<100).map { Data("payload \($0)".utf8) }
+        let ciphertexts = key.encrypt(payloads)
+        XCTAssertEqual(ciphertexts.count, payloads.count)
+        let plaintexts = key.decrypt(ciphertexts.map { $0 ?? "" })
+        XCTAssertEqual(plaintexts.map { $0 ?? Data() }, payloads)
+    }
+    
+    func testUnparsableKeyFallsBackToCjoseWrapper() {
+        let key = JWEKey(jwk: "not a jwk")
+        XCTAssertFalse(key.isPrepared)
+        XCTAssertNil(key.decrypt("a.b.c.d.e"))
+    }
+    
+    // MARK: Benchmarks
+    
+    private func report(_ name: String, _ block: () -> Void) {
+        let start = Date()
+        block()
+        let elapsed = Date().timeIntervalSince(start)
+        print("\(name): \(Int(Double(self.iterations) / elapsed)) ops/s")
+    }
+    
+    func testBenchmarkEncrypt() {
+        let key = JWEKey.prepared(jwk: self.jwk)
+        self.measure {
+            self.report("CjoseWrapper encrypt") {
+                for _ in 0..<self.iterations {
+                    _ = try? CjoseWrapper.ciphertext(fromContent: self.body, key: self.jwk)
+                }
+            }
+            self.report("JWEKey encrypt") {
+                for _ in 0..<self.iterations {
+                    _ = key.encrypt(self.body)
+                }
+            }
+            self.report("JWEKey batch encrypt") {
+                _ = key.encrypt([Data](repeating: self.body, count: self.iterations))
+            }
+        }
+    }
+    
+    func testBenchmarkDecrypt() throws {
+        let key = JWEKey.prepared(jwk: self.jwk)
+        let jwe = try CjoseWrapper.ciphertext(fromContent: self.body, key: self.jwk)
+        self.measure {
+            self.report("CjoseWrapper decrypt") {
+                for _ in 0..<self.iterations {
+                    _ = try? CjoseWrapper.content(fromCiphertext: jwe, key: self.jwk)
+                }
+            }
+            self.report("JWEKey decrypt") {
+                for _ in 0..<self.iterations {
+                    _ = key.decrypt(jwe)
+                }
+            }
+            self.report("JWEKey batch decrypt") {
+                _ = key.decrypt([String](repeating: jwe, count: self.iterations))
+            }
+        }
+    }
+}
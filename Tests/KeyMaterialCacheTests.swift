@@ -0,0 +1,145 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class KeyMaterialCacheTests: XCTestCase {
+    
+    private var url: URL!
+    private var keychain: MockKeychain!
+    private var clock: MockClock!
+    
+    override func setUp() {
+        self.url = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString).appendingPathComponent("kms.cache")
+        self.keychain = MockKeychain()
+        self.clock = MockClock()
+    }
+    
+    override func tearDown() {
+        try? FileManager.default.removeItem(at: self.url.deletingLastPathComponent())
+    }
+    
+    private func cache(capacity: Int = KeyMaterialCache.defaultCapacity, timeToLive: TimeInterval = KeyMaterialCache.defaultTimeToLive) -> KeyMaterialCache {
+        return KeyMaterialCache(keychain: self.keychain, url: self.url, capacity: capacity, timeToLive: timeToLive, clock: self.clock)
+    }
+    
+    func testLookupByUriAndRoom() {
+        let cache = self.cache()
+        XCTAssertNil(cache.material(uri: "kms://key/1"))
+        cache.store(uri: "kms://key/1", material: "material-1")
+        cache.bind(roomId: "room-1", uri: "kms://key/1")
+        XCTAssertEqual(cache.material(uri: "kms://key/1"), "material-1")
+        XCTAssertEqual(cache.uri(roomId: "room-1"), "kms://key/1")
+        XCTAssertEqual(cache.material(roomId: "room-1")?.1, "material-1")
+        XCTAssertNil(cache.material(roomId: "room-2"))
+        XCTAssertEqual(cache.statistics.hits, 2)
+        XCTAssertEqual(cache.statistics.misses, 2)
+    }
+    
+    func testHonorsExpirationDateAndTimeToLive() {
+        let cache = self.cache(timeToLive: 3600)
+        cache.store(uri: "kms://key/short", material: "short", expiration: self.clock.currentTime.addingTimeInterval(60))
+        cache.store(uri: "kms://key/long", material: "long", expiration: self.clock.currentTime.addingTimeInterval(86400))
+        cache.store(uri: "kms://key/expired", material: "expired", expiration: self.clock.currentTime.addingTimeInterval(-1))
+        XCTAssertNil(cache.material(uri: "kms://key/expired"))
+        self.clock.advance(by: 120)
+        XCTAssertNil(cache.material(uri: "kms://key/short"))
+        XCTAssertEqual(cache.material(uri: "kms://key/long"), "long")
+        self.clock.advance(by: 3600)
+        XCTAssertNil(cache.material(uri: "kms://key/long"))
+    }
+    
+    func testEvictsLeastRecentlyUsed() {
+        let cache = self.cache(capacity: 2)
+        cache.store(uri: "kms://key/1", material: "1")
+        self.clock.advance(by: 1)
+        cache.store(uri: "kms://key/2", material: "2")
+        self.clock.advance(by: 1)
+        XCTAssertEqual(cache.material(uri: "kms://key/1"), "1")
+        self.clock.advance(by: 1)
+        cache.store(uri: "kms://key/3", material: "3")
+        XCTAssertEqual(cache.count, 2)
+        XCTAssertEqual(cache.statistics.evictions, 1)
+        XCTAssertNil(cache.material(uri: "kms://key/2"))
+        XCTAssertEqual(cache.material(uri: "kms://key/1"), "1")
+        XCTAssertEqual(cache.material(uri: "kms://key/3"), "3")
+    }
+    
+    func testPersistsSealed() throws {
+        let cache = self.cache()
+        cache.store(uri: "kms://key/1", material: "secret-material")
+        cache.bind(roomId: "room-1", uri: "kms://key/1")
+        cache.flush()
+        let sealed = try Data(contentsOf: self.url)
+        XCTAssertNil(String(data: sealed, encoding: .utf8)?.range(of: "secret-material"))
+        
+        // Only the material is persisted; which key a room uses is asked again after a restart.
+        let reloaded = self.cache()
+        XCTAssertEqual(reloaded.material(uri: "kms://key/1"), "secret-material")
+        XCTAssertNil(reloaded.uri(roomId: "room-1"))
+        
+        // Without the keychain key the file cannot be opened and is discarded.
+        self.keychain.data.removeAll()
+        XCTAssertEqual(self.cache().count, 0)
+        XCTAssertFalse(FileManager.default.fileExists(atPath: self.url.path))
+    }
+    
+    func testTamperedFileFailsToOpen() throws {
+        let key = Data(repeating: 7, count: 32)
+        var sealed = try KeyMaterialCache.seal(Data("payload".utf8), key: key)
+        XCTAssertEqual(try KeyMaterialCache.open(sealed, key: key), Data("payload".utf8))
+        sealed[sealed.count - 1] ^= 0x01
+        XCTAssertThrowsError(try KeyMaterialCache.open(sealed, key: key))
+    }
+    
+    func testPrefetchCandidatesFavorRecentStaleRooms() {
+        let cache = self.cache()
+        cache.bind(roomId: "room-1", uri: "kms://key/1")
+        self.clock.advance(by: 1)
+        cache.bind(roomId: "room-2", uri: "kms://key/2")
+        self.clock.advance(by: 1)
+        cache.bind(roomId: "room-3", uri: "kms://key/3")
+        cache.store(uri: "kms://key/3", material: "3")
+        cache.store(uri: "kms://key/2", material: "2", expiration: self.clock.currentTime.addingTimeInterval(60))
+        XCTAssertEqual(cache.prefetchCandidates(limit: 10), ["kms://key/2", "kms://key/1"])
+        XCTAssertEqual(cache.prefetchCandidates(limit: 1), ["kms://key/2"])
+    }
+    
+    func testPrefetchCandidatesAfterRestartAreKeysAboutToExpire() {
+        let cache = self.cache()
+        cache.store(uri: "kms://key/1", material: "1", expiration: self.clock.currentTime.addingTimeInterval(60))
+        cache.store(uri: "kms://key/2", material: "2")
+        cache.bind(roomId: "room-2", uri: "kms://key/2")
+        cache.flush()
+        XCTAssertEqual(self.cache().prefetchCandidates(limit: 10), ["kms://key/1"])
+    }
+    
+    func testClaimByAnotherUserClears() {
+        let cache = self.cache()
+        cache.claim(owner: "user-1")
+        cache.store(uri: "kms://key/1", material: "1")
+        cache.claim(owner: "user-1")
+        XCTAssertEqual(cache.count, 1)
+        cache.claim(owner: "user-2")
+        XCTAssertEqual(cache.count, 0)
+    }
+}
@@ -0,0 +1,111 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class KmsKeyFetcherTests: XCTestCase {
+    
+    private var batches = [[String]]()
+    private var failures = [([String], (Error) -> Void)]()
+    
+    private func fetcher(maxBatchSize: Int = KmsKeyFetcher.defaultMaxBatchSize, timeout: TimeInterval = KmsKeyFetcher.defaultTimeout) -> KmsKeyFetcher {
+        return KmsKeyFetcher(window: 0.05, maxBatchSize: maxBatchSize, timeout: timeout) { uris, failed in
+            DispatchQueue.main.async {
+                self.batches.append(uris)
+                self.failures.append((uris, failed))
+            }
+        }
+    }
+    
+    func testCoalescesRoomsIntoOneBatch() {
+        let fetcher = self.fetcher()
+        let done = expectation(description: "all keys")
+        done.expectedFulfillmentCount = 60
+        var materials = [String: String]()
+        for room in 0..<50 {
+            fetcher.fetch(uri: "kms://key/\(room)") { result in
+                XCTAssertNil(result.error)
+                materials[result.data!.0] = result.data!.1
+                done.fulfill()
+            }
+        }
+        // Repeated callers for a key already pending only wait for it.
+        for room in 0..<10 {
+            fetcher.fetch(uri: "kms://key/\(room)") { result in
+                XCTAssertEqual(result.data?.1, "material-\(room)")
+                done.fulfill()
+            }
+        }
+        let sent = expectation(description: "sent")
+        DispatchQueue.main.asyncAfter(deadline: .now() + 0.3) {
+            XCTAssertEqual(self.batches.count, 1)
+            XCTAssertEqual(Set(self.batches.first ?? []).count, 50)
+            (0..<50).forEach { fetcher.resolve(uri: "kms://key/\($0)", material: "material-\($0)") }
+            sent.fulfill()
+        }
+        wait(for: [sent, done], timeout: 5)
+        XCTAssertEqual(materials.count, 50)
+        XCTAssertEqual(fetcher.statistics.batches, 1)
+        XCTAssertEqual(fetcher.statistics.keys, 50)
+        XCTAssertEqual(fetcher.statistics.requests, 60)
+        XCTAssertEqual(fetcher.statistics.savedRequests, 59)
+    }
+    
+    func testSplitsAtMaxBatchSize() {
+        let fetcher = self.fetcher(maxBatchSize: 4)
+        (0..<10).forEach { fetcher.fetch(uri: "kms://key/\($0)") { _ in } }
+        let sent = expectation(description: "sent")
+        DispatchQueue.main.asyncAfter(deadline: .now() + 0.3) {
+            XCTAssertEqual(self.batches.map { $0.count }, [4, 4, 2])
+            sent.fulfill()
+        }
+        wait(for: [sent], timeout: 5)
+    }
+    
+    func testFailedBatchFailsEveryWaiter() {
+        let fetcher = self.fetcher()
+        let done = expectation(description: "failed")
+        done.expectedFulfillmentCount = 3
+        for uri in ["kms://key/1", "kms://key/1", "kms://key/2"] {
+            fetcher.fetch(uri: uri) { result in
+                XCTAssertNotNil(result.error)
+                done.fulfill()
+            }
+        }
+        DispatchQueue.main.asyncAfter(deadline: .now() + 0.3) {
+            self.failures.first?.1(MessageClientImpl.MSGError.keyMaterialFetchFail)
+        }
+        wait(for: [done], timeout: 5)
+    }
+    
+    func testUnansweredBatchTimesOut() {
+        let fetcher = self.fetcher(timeout: 0.2)
+        let done = expectation(description: "timed out")
+        fetcher.fetch(uri: "kms://key/1") { result in
+            XCTAssertNotNil(result.error)
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 5)
+        // A late answer has no one left to complete.
+        fetcher.resolve(uri: "kms://key/1", material: "late")
+    }
+}
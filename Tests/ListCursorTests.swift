@@ -0,0 +1,111 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class ListCursorTests: XCTestCase {
+
+    private let server = FakeSparkServer()
+    private var client: MembershipClient!
+    private var roomId: String!
+
+    override func setUp() {
+        self.server.install()
+        self.client = MembershipClient(authenticator: SimpleAuthenticator(accessToken: "token"))
+        self.roomId = self.server.seedRoom()
+    }
+
+    override func tearDown() {
+        self.server.uninstall()
+    }
+
+    private func seed(_ count: Int) {
+        let start = Date().addingTimeInterval(-Double(count))
+        for index in 0..<count {
+            self.server.seed("memberships", ["roomId": self.roomId, "personEmail": "user\(index)@example.com", "created": FakeSparkServer.now(start.addingTimeInterval(Double(index)))])
+        }
+    }
+
+    private func collect(_ cursor: ListCursor<Membership>, limit: Int = Int.max) -> [String] {
+        var emails = [String]()
+        let done = expectation(description: "done")
+        cursor.forEach({ membership in
+            emails.append(membership.personEmail?.toString() ?? "")
+            return emails.count < limit
+        }, completionHandler: { error in
+            XCTAssertNil(error)
+            done.fulfill()
+        })
+        wait(for: [done], timeout: 30)
+        return emails
+    }
+
+    func testFollowsLinksAcrossPages() {
+        self.seed(250)
+        let emails = self.collect(self.client.listAll(roomId: self.roomId, pageSize: 100))
+        XCTAssertEqual(emails, (0..<250).map { "user\($0)@example.com" })
+        XCTAssertEqual(self.server.statistics.requests, 3)
+    }
+
+    func testStopsEarly() {
+        self.seed(1000)
+        let emails = self.collect(self.client.listAll(roomId: self.roomId, pageSize: 100), limit: 5)
+        XCTAssertEqual(emails.count, 5)
+        // The first page and the one prefetched behind it.
+        XCTAssertLessThanOrEqual(self.server.statistics.requests, 2)
+    }
+
+    func testEmptyList() {
+        XCTAssertEqual(self.collect(self.client.listAll(roomId: self.roomId, pageSize: 100)), [])
+    }
+
+    func testReportsFailedPage() {
+        self.seed(10)
+        // Requests now fail as if the host were unreachable.
+        FakeSparkServer.URLProtocol.server = nil
+        let cursor = self.client.listAll(roomId: self.roomId, pageSize: 5)
+        let done = expectation(description: "done")
+        cursor.next { result in
+            XCTAssertNotNil(result.error)
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 10)
+    }
+
+    func testParsesLinkHeader() {
+        let response = HTTPURLResponse(url: URL(string: "https://api.ciscospark.com/v1/people")!, statusCode: 200, httpVersion: "HTTP/1.1",
+                                       headerFields: ["Link": "<https://api.ciscospark.com/v1/people?cursor=a>; rel=\"prev\", <https://api.ciscospark.com/v1/people?max=2&cursor=b>; rel=\"next\""])
+        XCTAssertEqual(response?.nextPageUrl?.absoluteString, "https://api.ciscospark.com/v1/people?max=2&cursor=b")
+        XCTAssertNil(HTTPURLResponse(url: URL(string: "https://api.ciscospark.com/v1/people")!, statusCode: 200, httpVersion: "HTTP/1.1", headerFields: [:])?.nextPageUrl)
+    }
+
+    // MARK: Benchmarks
+
+    func testBenchmarkListAll() {
+        self.seed(20000)
+        let start = Date()
+        let count = self.collect(self.client.listAll(roomId: self.roomId, pageSize: 500, queue: DispatchQueue.global())).count
+        XCTAssertEqual(count, 20000)
+        print("ListCursor: \(Int(Double(count) / Date().timeIntervalSince(start))) items/s")
+    }
+}
@@ -0,0 +1,158 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class MediaSessionPoolTests: XCTestCase {
+    
+    private var phone: Phone!
+    private var pool: MediaSessionPool!
+    
+    override func setUp() {
+        phone = Phone(authenticator: SimpleAuthenticator(accessToken: "token"))
+        pool = MediaSessionPool(phone: phone)
+        pool.authorized = { _ in true }
+    }
+    
+    override func tearDown() {
+        pool.stop()
+    }
+    
+    // Warming takes a main queue turn per session.
+    private func settle() {
+        let settled = expectation(description: "settled")
+        DispatchQueue.main.asyncAfter(deadline: .now() + 0.5) {
+            settled.fulfill()
+        }
+        waitForExpectations(timeout: 5)
+    }
+    
+    func testProfileOfOption() {
+        XCTAssertEqual(MediaSessionPool.Profile(option: MediaOption.audioOnly()), .audio)
+        XCTAssertEqual(MediaSessionPool.Profile(option: MediaOption.audioVideo()), .audioVideo)
+        XCTAssertEqual(MediaSessionPool.Profile(option: MediaOption.audioVideoScreenShare()), .audioVideoShare)
+    }
+    
+    func testWarmsLikelyProfilesAndHandsEachOutOnce() {
+        pool.start()
+        settle()
+        XCTAssertNotNil(pool.settings(of: .audio))
+        XCTAssertNotNil(pool.settings(of: .audioVideo))
+        XCTAssertNil(pool.settings(of: .audioVideoShare))
+        
+        let session = pool.take(option: MediaOption.audioOnly())
+        XCTAssertEqual(session?.status, MediaSessionWrapper.Status.prepare)
+        XCTAssertEqual(session?.warmed?.profile, .audio)
+        XCTAssertNil(pool.take(option: MediaOption.audioOnly()))
+        session?.stopMedia()
+    }
+    
+    func testTakingOneSessionDropsTheOthers() {
+        pool.start()
+        settle()
+        let session = pool.take(option: MediaOption.audioVideo())
+        XCTAssertNotNil(session)
+        XCTAssertNil(pool.settings(of: .audio))
+        XCTAssertNil(pool.take(option: MediaOption.audioOnly()))
+        session?.stopMedia()
+        pool.refill()
+        settle()
+        XCTAssertNotNil(pool.settings(of: .audio))
+        XCTAssertNotNil(pool.settings(of: .audioVideo))
+    }
+    
+    func testSuspendDropsEverySession() {
+        pool.start()
+        settle()
+        pool.suspend()
+        XCTAssertNil(pool.settings(of: .audio))
+        XCTAssertNil(pool.settings(of: .audioVideo))
+        pool.refill()
+        settle()
+        XCTAssertNotNil(pool.settings(of: .audio))
+    }
+    
+    func testScreenShareIsWarmedOnceUsed() {
+        pool.start()
+        settle()
+        XCTAssertNil(pool.take(option: MediaOption.audioVideoScreenShare()))
+        pool.refill()
+        settle()
+        XCTAssertNotNil(pool.settings(of: .audioVideoShare))
+    }
+    
+    func testSessionWithOldBandwidthIsNotHandedOut() {
+        pool.start()
+        settle()
+        phone.videoMaxBandwidth = Phone.DefaultBandwidth.maxBandwidth1080p.rawValue
+        XCTAssertNil(pool.take(option: MediaOption.audioVideo()))
+        pool.refill()
+        settle()
+        XCTAssertEqual(pool.settings(of: .audioVideo)?.videoMaxBandwidth, Phone.DefaultBandwidth.maxBandwidth1080p.rawValue)
+    }
+    
+    func testExpiredSessionIsNotHandedOut() {
+        pool.start()
+        settle()
+        pool.maxAge = 0
+        XCTAssertNil(pool.take(option: MediaOption.audioOnly()))
+        pool.maxAge = MediaSessionPool.defaultMaxAge
+        pool.refill()
+        settle()
+        let session = pool.take(option: MediaOption.audioOnly())
+        XCTAssertNotNil(session)
+        session?.stopMedia()
+    }
+    
+    func testProfilesWithoutMediaAccessAreNotWarmed() {
+        pool.authorized = { !$0.hasVideo }
+        pool.start()
+        settle()
+        XCTAssertNotNil(pool.settings(of: .audio))
+        XCTAssertNil(pool.settings(of: .audioVideo))
+    }
+    
+    func testPreparedWarmSessionSendsItsOffer() {
+        pool.start()
+        settle()
+        guard let session = pool.take(option: MediaOption.audioOnly()) else {
+            XCTFail("No warm session")
+            return
+        }
+        let offer = session.warmed?.offer
+        session.prepare(option: MediaOption.audioOnly(), phone: phone)
+        XCTAssertEqual(session.setup?.pooled, true)
+        XCTAssertEqual(session.getLocalSdp(), offer)
+        XCTAssertNil(session.warmed)
+        XCTAssertNotNil(session.setup?.offered)
+        session.stopMedia()
+    }
+    
+    func testDisabledPoolHandsOutNothing() {
+        pool.start()
+        settle()
+        pool.enabled = false
+        XCTAssertNil(pool.take(option: MediaOption.audioOnly()))
+        XCTAssertNil(pool.settings(of: .audioVideo))
+    }
+}
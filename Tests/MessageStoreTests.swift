@@ -0,0 +1,165 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class MessageStoreTests: XCTestCase {
+    
+    private let roomId = UUID().uuidString.hydraFormat(for: .room)
+    private var directory: URL!
+    private var keychain: MockKeychain!
+    
+    override func setUp() {
+        self.directory = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        self.keychain = MockKeychain()
+    }
+    
+    override func tearDown() {
+        try? FileManager.default.removeItem(at: self.directory)
+    }
+    
+    private func store(capacity: Int = MessageStore.defaultCapacity) -> MessageStore {
+        return MessageStore(keychain: self.keychain, directory: self.directory, capacity: capacity)
+    }
+    
+    private let base = Date(timeIntervalSince1970: 1525000000)
+    
+    private func activity(_ index: Int, verb: String = "post", object: String? = nil) -> ActivityModel {
+        var json: [String: Any] = ["id": "activity-\(index)", "verb": verb, "published": FakeSparkServer.now(self.base.addingTimeInterval(Double(index))),
+                                   "object": ["objectType": "comment", "displayName": "message \(index)"],
+                                   "target": ["id": self.roomId.locusFormat, "objectType": "conversation"],
+                                   "actor": ["entryUUID": "person-1", "emailAddress": "someone@example.com"]]
+        if let object = object {
+            json["object"] = ["id": object, "objectType": "activity"]
+        }
+        return try! ActivityModel(JSON: json)
+    }
+    
+    private func texts(_ activities: [ActivityModel]) -> [String] {
+        return activities.map { $0.text ?? "" }
+    }
+    
+    func testServesNewestFirstBeforeDate() {
+        let store = self.store()
+        store.merge(roomId: self.roomId, activities: (0..<10).reversed().map { self.activity($0) }, from: self.base, until: self.base.addingTimeInterval(20), complete: true)
+        XCTAssertEqual(self.texts(store.activities(roomId: self.roomId, before: nil, max: 3)), ["message 9", "message 8", "message 7"])
+        XCTAssertEqual(self.texts(store.activities(roomId: self.roomId, before: self.base.addingTimeInterval(2), max: 5)), ["message 1", "message 0"])
+        XCTAssertEqual(store.created(roomId: self.roomId, messageId: self.activity(4).id!), self.base.addingTimeInterval(4))
+        XCTAssertTrue(store.room(self.roomId)?.covers(self.base.addingTimeInterval(-100)) ?? false)
+    }
+    
+    func testDeletesAndDeduplicates() {
+        let store = self.store()
+        store.merge(roomId: self.roomId, activities: (0..<5).map { self.activity($0) }, from: self.base, until: self.base.addingTimeInterval(5), complete: false)
+        store.merge(roomId: self.roomId, activities: [self.activity(4), self.activity(6, verb: "delete", object: "activity-2")],
+                    from: self.base.addingTimeInterval(4), until: self.base.addingTimeInterval(7), complete: false)
+        XCTAssertEqual(self.texts(store.activities(roomId: self.roomId, before: nil, max: 10)), ["message 4", "message 3", "message 1", "message 0"])
+        XCTAssertEqual(store.room(self.roomId)?.syncedUntil, self.base.addingTimeInterval(7))
+        XCTAssertEqual(store.room(self.roomId)?.coveredFrom, self.base)
+    }
+    
+    func testDropsRangeLeftBehindByGap() {
+        let store = self.store()
+        store.merge(roomId: self.roomId, activities: (0..<5).map { self.activity($0) }, from: self.base, until: self.base.addingTimeInterval(5), complete: false)
+        store.merge(roomId: self.roomId, activities: (100..<103).map { self.activity($0) }, from: self.base.addingTimeInterval(100), until: self.base.addingTimeInterval(110), complete: false)
+        XCTAssertEqual(self.texts(store.activities(roomId: self.roomId, before: nil, max: 10)), ["message 102", "message 101", "message 100"])
+        XCTAssertEqual(store.room(self.roomId)?.coveredFrom, self.base.addingTimeInterval(100))
+    }
+    
+    func testAppendsLiveActivitiesWithinRange() {
+        let store = self.store()
+        store.append(roomId: self.roomId, activity: self.activity(1))
+        XCTAssertNil(store.room(self.roomId))
+        store.merge(roomId: self.roomId, activities: [self.activity(5)], from: self.base.addingTimeInterval(5), until: self.base.addingTimeInterval(6), complete: false)
+        store.append(roomId: self.roomId, activity: self.activity(7))
+        store.append(roomId: self.roomId, activity: self.activity(1))
+        XCTAssertEqual(self.texts(store.activities(roomId: self.roomId, before: nil, max: 10)), ["message 7", "message 5"])
+        XCTAssertEqual(store.room(self.roomId)?.syncedUntil, self.base.addingTimeInterval(6))
+    }
+    
+    func testTrimsToCapacity() {
+        let store = self.store(capacity: 4)
+        store.merge(roomId: self.roomId, activities: (0..<10).map { self.activity($0) }, from: self.base, until: self.base.addingTimeInterval(10), complete: true)
+        XCTAssertEqual(self.texts(store.activities(roomId: self.roomId, before: nil, max: 10)), ["message 9", "message 8", "message 7", "message 6"])
+        XCTAssertEqual(store.room(self.roomId)?.complete, false)
+        XCTAssertEqual(store.room(self.roomId)?.coveredFrom, self.base.addingTimeInterval(6))
+    }
+    
+    func testPersistsSealed() throws {
+        let store = self.store()
+        store.claim(owner: "user-1")
+        store.merge(roomId: self.roomId, activities: (0..<3).map { self.activity($0) }, from: self.base, until: self.base.addingTimeInterval(3), complete: true)
+        store.flush()
+        let file = try Data(contentsOf: self.directory.appendingPathComponent(self.roomId.locusFormat + ".store"))
+        XCTAssertNil(file.range(of: Data("message 1".utf8)))
+        
+        let reopened = self.store()
+        XCTAssertEqual(self.texts(reopened.activities(roomId: self.roomId, before: nil, max: 10)), ["message 2", "message 1", "message 0"])
+        XCTAssertEqual(reopened.room(self.roomId)?.complete, true)
+        XCTAssertEqual(reopened.room(self.roomId)?.activities.first?.personEmail, "someone@example.com")
+        
+        reopened.claim(owner: "user-2")
+        XCTAssertNil(reopened.room(self.roomId))
+        reopened.flush()
+        XCTAssertNil(self.store().room(self.roomId))
+    }
+    
+    func testListFetchesOnlyWhatIsNew() {
+        let server = FakeSparkServer()
+        server.install()
+        defer {
+            server.uninstall()
+        }
+        let key = FakeSparkServer.randomKey()
+        let roomId = server.seedRoom(messages: 500, key: key)
+        server.shareKey(key, roomId: roomId)
+        let client = MessageClientImpl(authenticator: SimpleAuthenticator(accessToken: "token"), deviceUrl: URL(string: "https://device.example.com/devices/1")!, store: self.store())
+        
+        func list(_ max: Int, before: Before? = nil) -> [Message] {
+            var messages = [Message]()
+            let done = expectation(description: "listed")
+            client.list(roomId: roomId, before: before, max: max) { response in
+                messages = response.result.data ?? []
+                done.fulfill()
+            }
+            wait(for: [done], timeout: 10)
+            return messages
+        }
+        
+        XCTAssertEqual(list(50).map { $0.text ?? "" }, (450..<500).reversed().map { "message \($0)" })
+        var requests = server.statistics.requests
+        server.seedMessages(roomId: roomId, texts: ["new 0", "new 1"], key: key, start: Date().addingTimeInterval(-0.5), interval: 0.01)
+        let latest = list(50)
+        XCTAssertEqual(latest.map { $0.text ?? "" }, ["new 1", "new 0"] + (452..<500).reversed().map { "message \($0)" })
+        XCTAssertEqual(server.statistics.requests - requests, 1)
+        
+        // Older than what is stored: the sync, then one older page. After that it's all local.
+        requests = server.statistics.requests
+        let older = list(30, before: .message(latest.last!.id!))
+        XCTAssertEqual(older.map { $0.text ?? "" }, (422..<452).reversed().map { "message \($0)" })
+        XCTAssertEqual(server.statistics.requests - requests, 2)
+        requests = server.statistics.requests
+        XCTAssertEqual(list(30, before: .message(latest.last!.id!)).count, 30)
+        XCTAssertEqual(server.statistics.requests - requests, 1)
+    }
+}
@@ -0,0 +1,108 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class MetricsBufferTests: XCTestCase {
+
+    private func metric(_ index: Int) -> Metric {
+        return Metric(name: "metric", data: ["index": String(index)])
+    }
+
+    func testKeepsOrder() {
+        let buffer = MetricsBuffer(capacity: 16)
+        (0..<10).forEach { XCTAssertTrue(buffer.add(metric: self.metric($0))) }
+        XCTAssertEqual(buffer.count, 10)
+        XCTAssertEqual(buffer.pop(4).map { $0.data["index"]! }, ["0", "1", "2", "3"])
+        XCTAssertEqual(buffer.popAll().map { $0.data["index"]! }, ["4", "5", "6", "7", "8", "9"])
+        XCTAssertNil(buffer.pop())
+        XCTAssertEqual(buffer.count, 0)
+    }
+
+    func testRejectsWhenFull() {
+        let buffer = MetricsBuffer(capacity: 5)
+        XCTAssertEqual(buffer.capacity, 8)
+        (0..<8).forEach { XCTAssertTrue(buffer.add(metric: self.metric($0))) }
+        XCTAssertFalse(buffer.add(metric: self.metric(8)))
+        XCTAssertNotNil(buffer.pop())
+        XCTAssertTrue(buffer.add(metric: self.metric(9)))
+    }
+
+    func testConcurrentProducers() {
+        let producers = 8
+        let perProducer = 10_000
+        let buffer = MetricsBuffer(capacity: 256)
+        var seen = [Int](repeating: 0, count: producers * perProducer)
+        let done = DispatchSemaphore(value: 0)
+        DispatchQueue.global().async {
+            var received = 0
+            while received < seen.count {
+                if let metric = buffer.pop() {
+                    seen[Int(metric.data["index"]!)!] += 1
+                    received += 1
+                }
+            }
+            done.signal()
+        }
+        let start = Date()
+        DispatchQueue.concurrentPerform(iterations: producers) { producer in
+            for index in 0..<perProducer {
+                let metric = self.metric(producer * perProducer + index)
+                while !buffer.add(metric: metric) {
+                }
+            }
+        }
+        XCTAssertEqual(done.wait(timeout: .now() + 30), .success)
+        print("MetricsBuffer: \(Int(Double(seen.count) / Date().timeIntervalSince(start))) metrics/s")
+        XCTAssertEqual(seen.filter { $0 != 1 }.count, 0)
+    }
+
+    func testSpillLogRoundTrip() {
+        let url = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+        let log = MetricsSpillLog(url: url, maxSize: 256)
+        log.append([["key": "a", "value": "1"], ["key": "b"]])
+        log.append([["key": "c"]])
+        XCTAssertGreaterThan(log.size, 0)
+        // Over the limit, so dropped as a whole.
+        log.append([["key": String(repeating: "x", count: 512)]])
+        XCTAssertEqual(log.takeAll().compactMap { $0["key"] }, ["a", "b", "c"])
+        XCTAssertEqual(log.takeAll().count, 0)
+        XCTAssertEqual(log.size, 0)
+    }
+
+    func testGzip() {
+        let json = try! JSONSerialization.data(withJSONObject: ["metrics": (0..<100).map { ["key": "metric", "time": String($0)] }], options: [])
+        guard let gzipped = json.gzipped() else {
+            XCTFail("gzip failed")
+            return
+        }
+        XCTAssertEqual(Array(gzipped.prefix(3)), [0x1f, 0x8b, 0x08])
+        XCTAssertLessThan(gzipped.count, json.count)
+        let trailer = Array(gzipped.suffix(8))
+        let crc = trailer[0..<4].reversed().reduce(UInt32(0)) { $0 << 8 | UInt32($1) }
+        let size = trailer[4..<8].reversed().reduce(UInt32(0)) { $0 << 8 | UInt32($1) }
+        XCTAssertEqual(crc, json.crc32())
+        XCTAssertEqual(Int(size), json.count)
+        XCTAssertEqual(Data("123456789".utf8).crc32(), 0xcbf43926)
+    }
+}
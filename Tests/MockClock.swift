@@ -25,19 +25,29 @@ import Foundation
 
 class MockClock: Clock {
     
+    // Read from the threads of the code under test while the test advances it.
+    private let lock = NSLock()
     private var time: Date = Date()
     
     override var currentTime: Date {
         get {
+            lock.lock()
+            defer {
+                lock.unlock()
+            }
             return time
         }
         set {
+            lock.lock()
             time = newValue
+            lock.unlock()
         }
     }
     
     func advance(by timeInterval: TimeInterval) {
+        lock.lock()
         time = time.addingTimeInterval(timeInterval)
+        lock.unlock()
     }
     
 }
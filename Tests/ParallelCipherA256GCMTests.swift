@@ -0,0 +1,197 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class ParallelCipherA256GCMTests: XCTestCase {
+
+    private let benchmarkSize = 64 * 1024 * 1024
+
+    private func hex(_ data: Data?) -> String {
+        return data?.map { String(format: "%02x", $0) }.joined() ?? ""
+    }
+
+    private func random(_ count: Int) -> [UInt8] {
+        return (0..<count).map { _ in UInt8(truncatingIfNeeded: arc4random()) }
+    }
+
+    // NIST GCM spec, test case 13 and 14 (AES-256, zero key and iv).
+    func testEmptyPlaintextVector() throws {
+        let cipher = try ParallelCipherA256GCM(key: Data(count: 32), iv: Data(count: 12), aad: Data())
+        try cipher.finalize()
+        XCTAssertEqual(hex(cipher.tag), "530f8afbc74536b9a963b4f1c4cb738b")
+    }
+
+    func testSingleBlockVector() throws {
+        let cipher = try ParallelCipherA256GCM(key: Data(count: 32), iv: Data(count: 12), aad: Data())
+        let input = [UInt8](repeating: 0, count: 16)
+        var output = [UInt8](repeating: 0, count: 16)
+        XCTAssertEqual(try cipher.encryptBytes(input, toBuffer: &output, withLength: 16), 16)
+        try cipher.finalize()
+        XCTAssertEqual(hex(Data(output)), "cea7403d4d606b6e074ec5d3baf39d18")
+        XCTAssertEqual(hex(cipher.tag), "d0d1c8a799996bf0265b98b5d48ab919")
+    }
+
+    func testMatchesCipherA256GCM() throws {
+        let scr = try SecureContentReference(error: ())
+        let input = random(3 * ParallelCipherA256GCM.chunkSize + 1234)
+        var expected = [UInt8](repeating: 0, count: input.count)
+        var actual = [UInt8](repeating: 0, count: input.count)
+        let reference = try CipherA256GCM(secureContentReference: scr)
+        XCTAssertEqual(reference.encryptBytes(input, toBuffer: &expected, withLength: input.count, error: nil), input.count)
+        try reference.finalize()
+        let tag = scr.tag
+        XCTAssertEqual(tag?.count, 16)
+        // A SCR carrying a tag would put the cipher in decrypt mode.
+        scr.tag = nil
+        let cipher = try ParallelCipherA256GCM(scr: scr)
+        XCTAssertEqual(try cipher.encryptBytes(input, toBuffer: &actual, withLength: input.count), input.count)
+        try cipher.finalize()
+        XCTAssertEqual(expected, actual)
+        XCTAssertEqual(tag, scr.tag)
+    }
+
+    func testRoundTripWithUnalignedWrites() throws {
+        let scr = try SecureContentReference(error: ())
+        let input = random(2 * ParallelCipherA256GCM.chunkSize + 777)
+        var ciphertext = [UInt8](repeating: 0, count: input.count)
+        let encryptor = try ParallelCipherA256GCM(scr: scr)
+        var offset = 0
+        for size in [5, 11, 16, 33, 4096, ParallelCipherA256GCM.chunkSize + 3, Int.max] where offset < input.count {
+            let length = min(size, input.count - offset)
+            _ = try input.withUnsafeBufferPointer { rbuf in
+                try ciphertext.withUnsafeMutableBufferPointer { wbuf in
+                    try encryptor.encryptBytes(rbuf.baseAddress! + offset, toBuffer: wbuf.baseAddress! + offset, withLength: length)
+                }
+            }
+            offset += length
+        }
+        try encryptor.finalize()
+        XCTAssertNotNil(scr.tag)
+
+        let decryptor = try ParallelCipherA256GCM(scr: scr)
+        XCTAssertEqual(decryptor.mode, ParallelCipherA256GCM.Mode.decrypt)
+        var plaintext = ciphertext
+        let decrypted = try plaintext.withUnsafeMutableBufferPointer { buffer in
+            try decryptor.decryptBytes(UnsafePointer(buffer.baseAddress!), toBuffer: buffer.baseAddress!, withLength: buffer.count)
+        }
+        XCTAssertEqual(decrypted, plaintext.count)
+        XCTAssertNoThrow(try decryptor.finalize())
+        XCTAssertEqual(plaintext, input)
+    }
+
+    func testTamperedContentFailsFinalize() throws {
+        let scr = try SecureContentReference(error: ())
+        let input = random(4096)
+        var ciphertext = [UInt8](repeating: 0, count: input.count)
+        let encryptor = try ParallelCipherA256GCM(scr: scr)
+        _ = try encryptor.encryptBytes(input, toBuffer: &ciphertext, withLength: input.count)
+        try encryptor.finalize()
+
+        ciphertext[100] ^= 0x01
+        var plaintext = [UInt8](repeating: 0, count: input.count)
+        let decryptor = try ParallelCipherA256GCM(scr: scr)
+        _ = try decryptor.decryptBytes(ciphertext, toBuffer: &plaintext, withLength: ciphertext.count)
+        XCTAssertThrowsError(try decryptor.finalize())
+    }
+
+    func testTruncatedTagFailsFinalize() throws {
+        let scr = try SecureContentReference(error: ())
+        let input = random(4096)
+        var ciphertext = [UInt8](repeating: 0, count: input.count)
+        let encryptor = try ParallelCipherA256GCM(scr: scr)
+        _ = try encryptor.encryptBytes(input, toBuffer: &ciphertext, withLength: input.count)
+        try encryptor.finalize()
+        let tag = scr.tag!
+
+        for length in [1, 8, 15] {
+            var plaintext = [UInt8](repeating: 0, count: input.count)
+            let decryptor = try ParallelCipherA256GCM(key: scr.key, iv: scr.iv, aad: scr.aad?.data(using: .utf8) ?? Data(), tag: tag.prefix(length))
+            _ = try decryptor.decryptBytes(ciphertext, toBuffer: &plaintext, withLength: ciphertext.count)
+            XCTAssertThrowsError(try decryptor.finalize())
+        }
+    }
+
+    func testResumeFromState() throws {
+        let scr = try SecureContentReference(error: ())
+        let input = random(ParallelCipherA256GCM.chunkSize + 4099)
+        var ciphertext = [UInt8](repeating: 0, count: input.count)
+        let encryptor = try ParallelCipherA256GCM(scr: scr)
+        _ = try encryptor.encryptBytes(input, toBuffer: &ciphertext, withLength: input.count)
+        try encryptor.finalize()
+
+        let split = 1001
+        let first = try ParallelCipherA256GCM(scr: scr)
+        var plaintext = [UInt8](repeating: 0, count: input.count)
+        _ = try first.decryptBytes(ciphertext, toBuffer: &plaintext, withLength: split)
+        let state = try JSONDecoder().decode(ParallelCipherA256GCM.State.self, from: JSONEncoder().encode(first.state))
+
+        let second = try ParallelCipherA256GCM(scr: scr)
+        try second.resume(from: state)
+        _ = try ciphertext.withUnsafeBufferPointer { rbuf in
+            try plaintext.withUnsafeMutableBufferPointer { wbuf in
+                try second.decryptBytes(rbuf.baseAddress! + split, toBuffer: wbuf.baseAddress! + split, withLength: input.count - split)
+            }
+        }
+        XCTAssertNoThrow(try second.finalize())
+        XCTAssertEqual(plaintext, input)
+    }
+
+    // MARK: Benchmarks
+
+    private func throughput(_ name: String, _ block: (UnsafePointer<UInt8>, UnsafeMutablePointer<UInt8>, Int) throws -> Void) rethrows {
+        let input = [UInt8](repeating: 0x5a, count: self.benchmarkSize)
+        var output = [UInt8](repeating: 0, count: self.benchmarkSize)
+        let start = Date()
+        try output.withUnsafeMutableBufferPointer { wbuf in
+            try block(input, wbuf.baseAddress!, input.count)
+        }
+        let elapsed = Date().timeIntervalSince(start)
+        print("\(name): \(String(format: "%.1f", Double(self.benchmarkSize) / 1048576 / elapsed)) MB/s")
+    }
+
+    func testBenchmarkCipherA256GCM() throws {
+        let scr = try SecureContentReference(error: ())
+        self.measure {
+            let cipher = try! CipherA256GCM(secureContentReference: scr)
+            // SecureInputStream drives the cipher with stream-sized buffers.
+            self.throughput("CipherA256GCM") { rbuf, wbuf, length in
+                var offset = 0
+                while offset < length {
+                    let size = min(64 * 1024, length - offset)
+                    _ = cipher.encryptBytes(rbuf + offset, toBuffer: wbuf + offset, withLength: size, error: nil)
+                    offset += size
+                }
+            }
+        }
+    }
+
+    func testBenchmarkParallelCipherA256GCM() throws {
+        let scr = try SecureContentReference(error: ())
+        self.measure {
+            let cipher = try! ParallelCipherA256GCM(scr: scr)
+            try! self.throughput("ParallelCipherA256GCM") { rbuf, wbuf, length in
+                _ = try cipher.encryptBytes(rbuf, toBuffer: wbuf, withLength: length)
+            }
+        }
+    }
+}
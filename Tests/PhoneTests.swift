@@ -78,6 +78,32 @@ class PhoneTests: XCTestCase {
         XCTAssertTrue(registerPhone())
     }
     
+    func testWhenRegisterWithCachedDeviceThenCompletesBeforeRevalidation() {
+        XCTAssertTrue(deregisterPhone())
+        let connects = self.fakeWebSocketService!.connectedUrls.count
+        self.fakeDeviceService!.enableCachedDevice = true
+        self.fakeDeviceService!.registerDelay = 2
+        let registers = self.fakeDeviceService!.registerCount
+        
+        let start = Date()
+        XCTAssertTrue(registerPhone())
+        XCTAssertLessThan(Date().timeIntervalSince(start), 2)
+        XCTAssertTrue(self.phone.registered)
+        XCTAssertEqual(self.fakeDeviceService!.registerCount, registers)
+        
+        // The registration confirms the cached device, so the websocket stays as it is.
+        let revalidated = expectation(description: "revalidated")
+        DispatchQueue.global().asyncAfter(deadline: .now() + 3) {
+            revalidated.fulfill()
+        }
+        waitForExpectations(timeout: 5) { error in
+            XCTAssertNil(error, "Revalidation timed out")
+        }
+        XCTAssertEqual(self.fakeDeviceService!.registerCount, registers + 1)
+        XCTAssertEqual(self.fakeWebSocketService!.connectedUrls.count, connects + 1)
+        self.fakeDeviceService!.enableCachedDevice = false
+    }
+    
     func testWhenDeregisterPhoneTwiceThenBothSuceed() {
         XCTAssertTrue(deregisterPhone())
         Thread.sleep(forTimeInterval: Config.TestcaseInterval)
@@ -880,6 +906,67 @@ class PhoneTests: XCTestCase {
     }
     
     
+    func testOverlappingCallOperationsDoNotBlockEachOther() {
+        guard let caller = fixture.createUser() else {
+            XCTFail("Unable to create user")
+            return
+        }
+        let count = 8
+        let rounds = 20
+        var calls = [Call]()
+        let incoming = expectation(description: "Calls incoming")
+        incoming.expectedFulfillmentCount = count
+        self.phone.onIncoming = { call in
+            calls.append(call)
+            incoming.fulfill()
+        }
+        for _ in 0..<count {
+            let model = FakeCallModelHelper.initCallModel(caller: caller, allParticipantUsers: [caller, fixture.selfUser], selfUser: fixture.selfUser)
+            self.fakeCallClient?.fetchModels[model.callUrl!] = model
+            self.fakeWebSocketService?.onEvent?(MercuryEvent.recvCall(model))
+        }
+        wait(for: [incoming], timeout: 5)
+
+        // The first call stalls on its fetch, the others keep fetching and receiving events.
+        let stalled = calls[0]
+        let others = Array(calls.dropFirst())
+        let fetched = expectation(description: "Other calls fetched")
+        fetched.expectedFulfillmentCount = others.count * rounds
+        let drained = expectation(description: "Stalled call fetched")
+        drained.expectedFulfillmentCount = 2
+        self.fakeCallClient?.heldFetches = [stalled.url]
+        self.fakeCallClient?.onFetch = { url in
+            if url == stalled.url {
+                drained.fulfill()
+            }
+            else {
+                fetched.fulfill()
+            }
+        }
+        self.phone.fetch(call: stalled)
+        self.phone.fetch(call: stalled)
+        DispatchQueue.concurrentPerform(iterations: others.count * rounds) { i in
+            let call = others[i % others.count]
+            self.phone.fetch(call: call)
+            self.fakeWebSocketService?.onEvent?(MercuryEvent.recvCall(call.model))
+        }
+        let registered = expectation(description: "Registered while a call is stalled")
+        self.phone.register { error in
+            XCTAssertNil(error)
+            registered.fulfill()
+        }
+        wait(for: [fetched, registered], timeout: 5)
+        // The second fetch of the stalled call still waits behind the first.
+        XCTAssertEqual(self.fakeCallClient?.fetchCount(stalled.url), 1)
+
+        self.fakeCallClient?.releaseFetches()
+        wait(for: [drained], timeout: 5)
+        XCTAssertEqual(self.fakeCallClient?.fetchCount(stalled.url), 2)
+        for call in others {
+            XCTAssertGreaterThanOrEqual(self.fakeCallClient?.fetchCount(call.url) ?? 0, rounds)
+        }
+    }
+
     func testApplicationLifeCycle() {
         if let user = fixture.createUser() {
             self.fakeCallClient?.otherParticipants = [user]
@@ -0,0 +1,183 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class ReachabilityServiceTests: XCTestCase {
+    
+    private typealias Measurement = ReachabilityProber.Measurement
+    
+    private let clusters = ["near": ["udp": ["10.0.0.1:5004"], "tcp": ["10.0.0.1:5004"], "xtls": ["10.0.0.1:443"]],
+                            "far": ["udp": ["10.0.1.1:5004"], "tcp": ["10.0.1.1:5004"]],
+                            "blocked": ["udp": ["10.0.2.1:5004"]]]
+    private var file: URL!
+    
+    override func setUp() {
+        self.file = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString).appendingPathComponent("reachability.json")
+    }
+    
+    override func tearDown() {
+        try? FileManager.default.removeItem(at: self.file.deletingLastPathComponent())
+    }
+    
+    /// Answers after `delay` with the measurement `results` has for the endpoint; never answers for
+    /// endpoints it has none for.
+    private func probe(delay: TimeInterval = 0, _ results: [String: Measurement]) -> ReachabilityProber.Probe {
+        return { endpoint, _, completionHandler in
+            guard let measurement = results[endpoint.cluster + "/" + endpoint.transport] else {
+                return
+            }
+            DispatchQueue.global().asyncAfter(deadline: .now() + delay) {
+                completionHandler(measurement)
+            }
+        }
+    }
+    
+    private let measured: [String: Measurement] = ["near/udp": Measurement(sent: 3, received: 3, roundTrip: 0.02),
+                                                   "near/tcp": Measurement(sent: 1, received: 1, roundTrip: 0.03),
+                                                   "near/xtls": Measurement(sent: 1, received: 0, roundTrip: nil),
+                                                   "far/udp": Measurement(sent: 3, received: 3, roundTrip: 0.12),
+                                                   "far/tcp": Measurement(sent: 1, received: 1, roundTrip: 0.13)]
+    
+    private func run(_ prober: ReachabilityProber) -> [String: ReachabilityModel] {
+        let done = self.expectation(description: "probed")
+        var output = [String: ReachabilityModel]()
+        prober.run(self.clusters) { reachabilities in
+            output = reachabilities
+            done.fulfill()
+        }
+        self.wait(for: [done], timeout: 5)
+        return output
+    }
+    
+    func testProbesInParallelWithinBudget() {
+        let start = Date()
+        let reachabilities = self.run(ReachabilityProber(budget: 0.5, probe: self.probe(delay: 0.2, self.measured)))
+        // The blocked cluster never answers, so the budget ends the run.
+        XCTAssertLessThan(Date().timeIntervalSince(start), 1)
+        XCTAssertEqual(reachabilities["near"]?.udp?.reachable, true)
+        XCTAssertEqual(reachabilities["near"]?.udp?.latencyInMilliseconds, 20)
+        XCTAssertEqual(reachabilities["near"]?.xtls?.reachable, false)
+        XCTAssertEqual(reachabilities["blocked"]?.udp?.reachable, false)
+        XCTAssertNil(reachabilities["blocked"]?.tcp)
+    }
+    
+    func testSplitsAddresses() {
+        XCTAssertTrue(ReachabilityProber.split("10.0.0.1:5004")! == ("10.0.0.1", "5004"))
+        XCTAssertTrue(ReachabilityProber.split("[2001:db8::1]:443")! == ("2001:db8::1", "443"))
+        XCTAssertNil(ReachabilityProber.split("10.0.0.1"))
+    }
+    
+    func testStunMessages() {
+        let id: [UInt8] = Array(1...12)
+        let request = ReachabilityProber.bindingRequest(transactionId: id)
+        XCTAssertEqual(request.count, 20)
+        XCTAssertNil(ReachabilityProber.transactionId(ofBindingResponse: request))
+        var response = request
+        response[0] = 0x01
+        response[1] = 0x01
+        XCTAssertEqual(ReachabilityProber.transactionId(ofBindingResponse: response)!, id)
+    }
+    
+    func testConnectProbe() {
+        // A listening socket on the loopback interface.
+        let fd = socket(AF_INET, SOCK_STREAM, 0)
+        var address = sockaddr_in()
+        address.sin_family = sa_family_t(AF_INET)
+        address.sin_addr.s_addr = inet_addr("127.0.0.1")
+        var length = socklen_t(MemoryLayout<sockaddr_in>.size)
+        withUnsafeMutablePointer(to: &address) {
+            $0.withMemoryRebound(to: sockaddr.self, capacity: 1) {
+                XCTAssertEqual(bind(fd, $0, length), 0)
+                XCTAssertEqual(listen(fd, 1), 0)
+                XCTAssertEqual(getsockname(fd, $0, &length), 0)
+            }
+        }
+        let port = String(UInt16(bigEndian: address.sin_port))
+        defer {
+            close(fd)
+        }
+        let done = self.expectation(description: "connected")
+        let endpoint = ReachabilityProber.Endpoint(cluster: "local", transport: "tcp", host: "127.0.0.1", port: port)
+        ReachabilityProber.defaultProbe(endpoint, deadline: .now() + 2) { measurement in
+            XCTAssertEqual(measurement.received, 1)
+            XCTAssertNotNil(measurement.roundTrip)
+            done.fulfill()
+        }
+        self.wait(for: [done], timeout: 5)
+    }
+    
+    func testFingerprintIgnoresHostPart() {
+        let first = ReachabilityService.fingerprint(of: [("lo0", "127.0.0.1"), ("en0", "192.168.1.23"), ("en0", "fe80:0:0:0:1c2b:aaaa:bbbb:cccc")])
+        let second = ReachabilityService.fingerprint(of: [("en0", "192.168.1.77"), ("en0", "fe80:0:0:0:99:aaaa:bbbb:cccc")])
+        let other = ReachabilityService.fingerprint(of: [("pdp_ip0", "10.20.30.40")])
+        XCTAssertEqual(first, second)
+        XCTAssertNotEqual(first, other)
+    }
+    
+    func testFingerprintExpandsCompressedIPv6() {
+        let compressed = ReachabilityService.fingerprint(of: [("en0", "2001:db8::1")])
+        let expanded = ReachabilityService.fingerprint(of: [("en0", "2001:0db8:0000:0000:aaaa:bbbb:cccc:dddd")])
+        let linkLocal = ReachabilityService.fingerprint(of: [("en0", "fe80::1c2b:aaaa:bbbb:cccc%en0")])
+        XCTAssertEqual(compressed, "en0/2001:db8:0:0")
+        XCTAssertEqual(compressed, expanded)
+        XCTAssertEqual(linkLocal, "en0/fe80:0:0:0")
+        XCTAssertNotEqual(compressed, ReachabilityService.fingerprint(of: [("en0", "2001:db8:0:1::1")]))
+    }
+    
+    func testResultsPersistPerNetwork() {
+        var network = "wifi"
+        var probes = 0
+        let prober = ReachabilityProber(budget: 0.3, probe: self.probe(self.measured))
+        let clusters: ReachabilityService.ClusterSource = { completionHandler in
+            probes += 1
+            completionHandler(self.clusters)
+        }
+        let service = ReachabilityService(prober: prober, clusters: clusters, fingerprint: { network }, file: self.file)
+        service.fetch()
+        XCTAssertNil(service.feedback)
+        self.waitForFeedback(service)
+        XCTAssertEqual(service.feedback?.reachabilities?["near"]?.udp?.latencyInMilliseconds, 20)
+        service.fetch()
+        XCTAssertEqual(probes, 1)
+        
+        // After a relaunch the result is there before anything is probed.
+        let relaunched = ReachabilityService(prober: prober, clusters: clusters, fingerprint: { network }, file: self.file)
+        relaunched.fetch()
+        XCTAssertEqual(relaunched.feedback?.reachabilities?["near"]?.udp?.latencyInMilliseconds, 20)
+        XCTAssertEqual(probes, 1)
+        
+        network = "cellular"
+        relaunched.fetch()
+        XCTAssertNil(relaunched.feedback)
+        XCTAssertEqual(probes, 2)
+        self.waitForFeedback(relaunched)
+    }
+    
+    private func waitForFeedback(_ service: ReachabilityService) {
+        let deadline = Date(timeIntervalSinceNow: 5)
+        while service.feedback == nil && Date() < deadline {
+            RunLoop.current.run(until: Date(timeIntervalSinceNow: 0.01))
+        }
+    }
+}
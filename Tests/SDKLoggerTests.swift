@@ -0,0 +1,173 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class SDKLoggerTests: XCTestCase {
+
+    private var evaluations = 0
+    private var directory: URL!
+
+    override func setUp() {
+        self.evaluations = 0
+        self.directory = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString)
+    }
+
+    override func tearDown() {
+        try? FileManager.default.removeItem(at: self.directory)
+    }
+
+    private func message(_ text: String = "message") -> String {
+        self.evaluations += 1
+        return text
+    }
+
+    private func record(_ message: String, level: LogLevel = LogLevel.info) -> LogRecord {
+        return LogRecord(level: level, timestamp: Date(), thread: "thread", file: #file, function: #function, line: #line, message: message)
+    }
+
+    func testLevelGateSkipsMessage() {
+        let logger = SDKLogger()
+        logger.console = LogLevel.info
+        logger.debug(self.message())
+        logger.verbose(self.message())
+        XCTAssertEqual(self.evaluations, 0)
+        logger.info(self.message("kept"))
+        XCTAssertEqual(self.evaluations, 1)
+        XCTAssertTrue(logger.logs?.contains("kept") ?? false)
+    }
+
+    func testKeepsOrderAcrossThreads() {
+        let logger = SDKLogger()
+        logger.console = LogLevel.all
+        let threads = 4
+        let count = 100
+        DispatchQueue.concurrentPerform(iterations: threads) { thread in
+            for index in 0..<count {
+                logger.info("\(thread):\(index)")
+            }
+        }
+        var last = [Int](repeating: -1, count: threads)
+        for line in logger.logs?.components(separatedBy: "\n") ?? [] {
+            guard let message = line.components(separatedBy: ": ").last else {
+                continue
+            }
+            let parts = message.components(separatedBy: ":").compactMap { Int($0) }
+            if parts.count == 2 {
+                XCTAssertEqual(parts[1], last[parts[0]] + 1)
+                last[parts[0]] = parts[1]
+            }
+        }
+        XCTAssertEqual(last, [Int](repeating: count - 1, count: threads))
+    }
+
+    func testRingDropsWhenFull() {
+        let ring = LogRing(capacity: 4)
+        (0..<4).forEach { XCTAssertTrue(ring.push(self.record(String($0)))) }
+        XCTAssertTrue(ring.isFull)
+        XCTAssertFalse(ring.push(self.record("4")))
+        var records = [LogRecord]()
+        ring.drain(into: &records)
+        XCTAssertEqual(records.map { $0.message }, ["0", "1", "2", "3"])
+        XCTAssertEqual(ring.takeDropped(), 1)
+        XCTAssertEqual(ring.takeDropped(), 0)
+        XCTAssertEqual(ring.count, 0)
+    }
+
+    func testMemoryStorageKeepsNewest() {
+        let storage = MemoryLoggerStorage(capacity: 1024)
+        storage.write((0..<100).map { self.record("message \($0)") })
+        let text = storage.read()
+        XCTAssertTrue(text.contains("message 99"))
+        XCTAssertFalse(text.contains("message 0\n"))
+        XCTAssertLessThanOrEqual(text.utf8.count, 2048)
+    }
+
+    func testFileSinkRoundTrip() {
+        let sink = LogFileSink(directory: self.directory, maxSize: 1024 * 1024)
+        sink.write([self.record("first", level: LogLevel.warning), self.record("second ✓")])
+        let records = sink.read()
+        XCTAssertEqual(records.map { $0.message }, ["first", "second ✓"])
+        XCTAssertEqual(records.first?.level, LogLevel.warning)
+        XCTAssertEqual(records.first?.thread, "thread")
+        XCTAssertEqual(records.first?.function, #function)
+
+        // A new sink carries on with the same file.
+        let reopened = LogFileSink(directory: self.directory, maxSize: 1024 * 1024)
+        reopened.write([self.record("third")])
+        XCTAssertEqual(reopened.read().map { $0.message }, ["first", "second ✓", "third"])
+    }
+
+    func testFileSinkRolls() {
+        let sink = LogFileSink(directory: self.directory, maxSize: 4096)
+        for index in 0..<200 {
+            sink.write([self.record("message \(index)")])
+        }
+        let records = sink.read()
+        XCTAssertEqual(records.last?.message, "message 199")
+        XCTAssertLessThan(records.count, 200)
+        let size = ["log.0", "log.1"].compactMap { name in
+            (try? FileManager.default.attributesOfItem(atPath: self.directory.appendingPathComponent(name).path))?[.size] as? NSNumber
+        }.reduce(0) { $0 + $1.intValue }
+        XCTAssertLessThanOrEqual(size, 4096)
+    }
+
+    func testFileSinkIgnoresTruncatedRecord() {
+        var data = Data()
+        LogFileSink.encode(self.record("whole"), into: &data)
+        LogFileSink.encode(self.record("cut"), into: &data)
+        var records = [LogRecord]()
+        LogFileSink.decode(data.prefix(data.count - 3), into: &records)
+        XCTAssertEqual(records.map { $0.message }, ["whole"])
+    }
+
+    // MARK: Benchmarks
+
+    func testBenchmarkLogging() {
+        let logger = SDKLogger()
+        logger.console = LogLevel.no
+        logger.memory = false
+        logger.logger = NullLogger()
+        let count = 100_000
+        let start = Date()
+        DispatchQueue.concurrentPerform(iterations: 4) { thread in
+            for index in 0..<count / 4 {
+                logger.debug("thread \(thread) message \(index)")
+            }
+        }
+        let elapsed = Date().timeIntervalSince(start)
+        print("SDKLogger: \(Int(Double(count) / elapsed)) messages/s")
+        logger.logger = nil
+        logger.console = LogLevel.debug
+        let gated = Date()
+        for index in 0..<count {
+            logger.verbose("skipped \(index)")
+        }
+        print("SDKLogger (below level): \(Int(Double(count) / Date().timeIntervalSince(gated))) messages/s")
+    }
+}
+
+private class NullLogger: Logger {
+    func log(message: LogMessage) {
+    }
+}
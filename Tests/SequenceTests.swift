@@ -24,99 +24,167 @@ import XCTest
 
 class SequenceTests: XCTestCase {
     
-//    func testHundredsToTwoHundredsIsLess() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [201, 202, 203, 204])
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.lessThan)
-//    }
-//    
-//    func testHundredsToTwoHundredsWithHighRangesIsLess() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [201, 202, 203, 204], currentStart: 90, currentEnd: 95, incomingStart: 190, incomingEnd: 195)
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.lessThan)
-//    }
-//    
-//    func testHundredsToHundredsWithSixIncomingIsLess() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104, 105, 106])
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.lessThan)
-//    }
-//    
-//    func testHundredsToHundredsWithSixIncomingAndHighRangesIsLess() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104, 105, 106], currentStart: 80, currentEnd: 95, incomingStart: 80, incomingEnd: 95)
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.lessThan)
-//    }
-//    
-//    func testHundredsToHundredsWithFiveCurrentAndSixLaterIncomingIsLess() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104, 105], incomingEntries: [102, 103, 104, 105, 106, 107])
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.lessThan)
-//    }
-//    
-//    func testHundredsToHundredsWithFiveEarlierCurrentAndSixEarlierIncomingAndHighRangesIsLess() {
-//        let result = compareSequences(currentEntries: [100, 101, 102, 103], incomingEntries: [100, 101, 102, 103, 104, 105], currentStart: 75, currentEnd: 90, incomingStart: 80, incomingEnd: 90)
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.lessThan)
-//    }
-//    
-//    func testHundredsToHundredsWithFiveCurrentAndLaterIncomingIsGreater() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104, 105], incomingEntries: [102, 103, 104, 105])
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.greaterThan)
-//    }
-//    
-//    func testHundredsToHundredsWithHighRangesIsGreater() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104], currentStart: 80, currentEnd: 95, incomingStart: 85, incomingEnd: 95)
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.greaterThan)
-//    }
-//    
-//    func testHundredsToNoIncomingWithThreeCurrentIsGreater() {
-//        let result = compareSequences(currentEntries: [101, 102, 103], incomingEntries: [])
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.greaterThan)
-//    }
-//    
-//    func testHundredsToNoIncomingWithHighCurrentRangeAndThreeCurrentIsGreater() {
-//        let result = compareSequences(currentEntries: [101, 102, 103], incomingEntries: [], currentStart: 80, currentEnd: 95)
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.greaterThan)
-//    }
-//    
-//    func testEmptyAllIsEqual() {
-//        let result = compareSequences(currentEntries: [], incomingEntries: [])
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.equal)
-//    }
-//    
-//    func testHundredsToHundredsIsEqual() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104])
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.equal)
-//    }
-//    
-//    func testHundredsToTwoHundredsWithSameHighRangesIsEqual() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104], currentStart: 50, currentEnd: 75, incomingStart: 50, incomingEnd: 75)
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.equal)
-//    }
-//    
-//    func testHundredsToHundredsWithFiveGapCurrentAndSevenGapIncomingIsDesync() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 106, 107], incomingEntries: [101,102,103,104,105,107,108])
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.deSync)
-//    }
-//    
-//    func testHundredsToHundredsWithHighRangesAndFiveGapCurrentAndSevenGapIncomingIsDesync() {
-//        let result = compareSequences(currentEntries: [101, 102, 103, 106, 107], incomingEntries: [101,102,103,104,105,107,108], currentStart: 80, currentEnd: 90, incomingStart: 80, incomingEnd: 90)
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.deSync)
-//    }
-//    
-//    func testHundredsToHundredsWithHighRangesAndGapIncomingIsDesync() {
-//        let result = compareSequences(currentEntries: [101,102,103,104], incomingEntries: [101,102,103,105], currentStart: 80, currentEnd: 90, incomingStart: 80, incomingEnd: 90)
-//        XCTAssertEqual(result, CallInfoSequence.CompareResult.deSync)
-//    }
-//    
-//    private func compareSequences(currentEntries: [UInt64], incomingEntries: [UInt64], currentStart: UInt64 = 0, currentEnd: UInt64 = 0, incomingStart: UInt64 = 0, incomingEnd: UInt64 = 0) -> CallInfoSequence.CompareResult {
-//        var current = Sequence()
-//        var incoming = Sequence()
-//        
-//        current.entries = currentEntries
-//        current.rangeStart = currentStart
-//        current.rangeEnd = currentEnd
-//        
-//        incoming.entries = incomingEntries
-//        incoming.rangeStart = incomingStart
-//        incoming.rangeEnd = incomingEnd
-//        
-//        return CallInfoSequence.compare(current, incoming)
-//    }
-//    
+    func testHundredsToTwoHundredsIsLess() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [201, 202, 203, 204])
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.lessThan)
+    }
+    
+    func testHundredsToTwoHundredsWithHighRangesIsLess() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [201, 202, 203, 204], currentStart: 90, currentEnd: 95, incomingStart: 190, incomingEnd: 195)
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.lessThan)
+    }
+    
+    func testHundredsToHundredsWithSixIncomingIsLess() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104, 105, 106])
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.lessThan)
+    }
+    
+    func testHundredsToHundredsWithSixIncomingAndHighRangesIsLess() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104, 105, 106], currentStart: 80, currentEnd: 95, incomingStart: 80, incomingEnd: 95)
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.lessThan)
+    }
+    
+    func testHundredsToHundredsWithFiveCurrentAndSixLaterIncomingIsLess() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104, 105], incomingEntries: [102, 103, 104, 105, 106, 107])
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.lessThan)
+    }
+    
+    func testHundredsToHundredsWithFiveEarlierCurrentAndSixEarlierIncomingAndHighRangesIsLess() {
+        let result = compareSequences(currentEntries: [100, 101, 102, 103], incomingEntries: [100, 101, 102, 103, 104, 105], currentStart: 75, currentEnd: 90, incomingStart: 80, incomingEnd: 90)
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.lessThan)
+    }
+    
+    func testHundredsToHundredsWithFiveCurrentAndLaterIncomingIsGreater() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104, 105], incomingEntries: [102, 103, 104, 105])
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.greaterThan)
+    }
+    
+    func testHundredsToHundredsWithHighRangesIsGreater() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104], currentStart: 80, currentEnd: 95, incomingStart: 85, incomingEnd: 95)
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.greaterThan)
+    }
+    
+    func testHundredsToNoIncomingWithThreeCurrentIsGreater() {
+        let result = compareSequences(currentEntries: [101, 102, 103], incomingEntries: [])
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.greaterThan)
+    }
+    
+    func testHundredsToNoIncomingWithHighCurrentRangeAndThreeCurrentIsGreater() {
+        let result = compareSequences(currentEntries: [101, 102, 103], incomingEntries: [], currentStart: 80, currentEnd: 95)
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.greaterThan)
+    }
+    
+    func testEmptyAllIsEqual() {
+        let result = compareSequences(currentEntries: [], incomingEntries: [])
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.equal)
+    }
+    
+    func testHundredsToHundredsIsEqual() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104])
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.equal)
+    }
+    
+    func testHundredsToTwoHundredsWithSameHighRangesIsEqual() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 104], incomingEntries: [101, 102, 103, 104], currentStart: 50, currentEnd: 75, incomingStart: 50, incomingEnd: 75)
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.equal)
+    }
+    
+    func testHundredsToHundredsWithFiveGapCurrentAndSevenGapIncomingIsDesync() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 106, 107], incomingEntries: [101,102,103,104,105,107,108])
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.deSync)
+    }
+    
+    func testHundredsToHundredsWithHighRangesAndFiveGapCurrentAndSevenGapIncomingIsDesync() {
+        let result = compareSequences(currentEntries: [101, 102, 103, 106, 107], incomingEntries: [101,102,103,104,105,107,108], currentStart: 80, currentEnd: 90, incomingStart: 80, incomingEnd: 90)
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.deSync)
+    }
+    
+    func testHundredsToHundredsWithHighRangesAndGapIncomingIsDesync() {
+        let result = compareSequences(currentEntries: [101,102,103,104], incomingEntries: [101,102,103,105], currentStart: 80, currentEnd: 90, incomingStart: 80, incomingEnd: 90)
+        XCTAssertEqual(result, CallEventSequencer.CompareResult.deSync)
+    }
+    
+    func testIntervals() {
+        let intervals = SequenceIntervals([1, 2, 3, 5, 7, 8, 9, 9, 12])
+        XCTAssertEqual(intervals.ranges, [1...3, 5...5, 7...9, 12...12])
+        XCTAssertEqual(SequenceIntervals([9, 3, 1, 2]).ranges, [1...3, 9...9])
+        XCTAssertTrue(intervals.contains(8))
+        XCTAssertFalse(intervals.contains(10))
+        XCTAssertTrue(intervals.containsAny(between: 9, and: 13))
+        XCTAssertFalse(intervals.containsAny(between: 9, and: 12))
+        XCTAssertEqual(intervals.subtracting(SequenceIntervals([2, 6, 7, 8, 9, 10, 11, 12])).ranges, [1...1, 3...3, 5...5])
+        XCTAssertEqual(intervals.subtracting(4...8).ranges, [1...3, 9...9, 12...12])
+    }
+    
+    func testStateMatchesComparatorOnRandomSequences() {
+        for _ in 0..<2000 {
+            let a = self.randomSequence()
+            let b = self.randomSequence()
+            XCTAssertEqual(CallSequenceState().compare(a, b), CallEventSequencer.compare(a, b), "\(a) vs \(b)")
+        }
+    }
+    
+    func testStateFollowsAcceptedSequence() {
+        let state = CallSequenceState()
+        var current = self.sequence(Array(1...100))
+        for step in 1...10 {
+            let next = self.sequence(Array(UInt64(step * 10)...UInt64(100 + step * 10)))
+            XCTAssertEqual(state.compare(current, next), CallEventSequencer.CompareResult.lessThan)
+            XCTAssertEqual(state.compare(next, current), CallEventSequencer.CompareResult.greaterThan)
+            current = next
+        }
+    }
+    
+    // MARK: Benchmarks
+    
+    func testBenchmarkCompare() {
+        for size in [10, 100, 1000, 10000] {
+            // A long-running meeting: mostly consecutive entries with a few gaps, and a delta on top.
+            let entries = (1...UInt64(size)).filter { $0 % 97 != 0 }
+            let current = self.sequence(entries, start: 1, end: 0)
+            let incoming = self.sequence(entries.dropFirst(3) + [UInt64(size + 1), UInt64(size + 2)], start: 4, end: 0)
+            XCTAssertEqual(CallEventSequencer.compare(current, incoming), CallEventSequencer.CompareResult.lessThan)
+            let iterations = max(10, 100_000 / size)
+            var start = Date()
+            for _ in 0..<iterations {
+                _ = CallEventSequencer.compare(current, incoming)
+            }
+            let merge = Date().timeIntervalSince(start) / Double(iterations)
+            // The current side changes on every call here, so this is the state's worst case:
+            // it collapses both sequences each time.
+            let state = CallSequenceState()
+            start = Date()
+            for _ in 0..<iterations {
+                XCTAssertEqual(state.compare(current, incoming), CallEventSequencer.CompareResult.lessThan)
+            }
+            let intervals = Date().timeIntervalSince(start) / Double(iterations)
+            print("Sequence compare, \(size) entries: merge \(String(format: "%.2f", merge * 1_000_000)) us, intervals \(String(format: "%.2f", intervals * 1_000_000)) us")
+        }
+    }
+    
+    private func sequence<S: Swift.Sequence>(_ entries: S, start: UInt64 = 0, end: UInt64 = 0) -> SequenceModel where S.Element == UInt64 {
+        var sequence = SequenceModel()
+        sequence.entries = Array(entries)
+        sequence.rangeStart = start
+        sequence.rangeEnd = end
+        return sequence
+    }
+    
+    private func randomSequence() -> SequenceModel {
+        let base = UInt64(arc4random_uniform(20) + 1)
+        let span = arc4random_uniform(16)
+        let entries = Set((0..<arc4random_uniform(9)).map { _ in base + UInt64(arc4random_uniform(span + 1)) }).sorted()
+        let start = arc4random_uniform(2) == 0 ? 0 : UInt64(arc4random_uniform(25) + 1)
+        let end = start > 0 ? start + UInt64(arc4random_uniform(9)) : UInt64(arc4random_uniform(3) == 0 ? arc4random_uniform(26) : 0)
+        return self.sequence(entries, start: start, end: end)
+    }
+    
+    private func compareSequences(currentEntries: [UInt64], incomingEntries: [UInt64], currentStart: UInt64 = 0, currentEnd: UInt64 = 0, incomingStart: UInt64 = 0, incomingEnd: UInt64 = 0) -> CallEventSequencer.CompareResult {
+        let current = self.sequence(currentEntries, start: currentStart, end: currentEnd)
+        let incoming = self.sequence(incomingEntries, start: incomingStart, end: incomingEnd)
+        let result = CallEventSequencer.compare(current, incoming)
+        XCTAssertEqual(CallSequenceState().compare(current, incoming), result)
+        return result
+    }
+    
 }
@@ -0,0 +1,220 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+/// Drives the SDK clients against `FakeSparkServer` and reports throughput and latency percentiles,
+/// so regressions in the request, decryption, download and event paths show up without a cloud
+/// account. KMS is not part of it: room keys are seeded into `KeyMaterialCache.shared`.
+class ServiceBenchmarkTests: XCTestCase {
+
+    private let server = FakeSparkServer()
+    private let authenticator = SimpleAuthenticator(accessToken: "token")
+    private let queue = DispatchQueue(label: "com.ciscospark.sdk.ServiceBenchmarkTests", attributes: .concurrent)
+
+    override func setUp() {
+        self.server.install()
+    }
+
+    override func tearDown() {
+        self.server.uninstall()
+        KeyMaterialCache.shared.removeAll()
+    }
+
+    func testMessageRoundTrip() {
+        let key = FakeSparkServer.randomKey()
+        let roomId = self.server.seedRoom(messages: 3, key: key)
+        self.server.shareKey(key, roomId: roomId)
+        let client = MessageClientImpl(authenticator: self.authenticator, deviceUrl: URL(string: "https://device.example.com/devices/1")!, store: MessageStore(keychain: MockKeychain(), directory: nil))
+        let listed = expectation(description: "listed")
+        client.list(roomId: roomId, max: 10, queue: self.queue) { response in
+            XCTAssertEqual(response.result.data?.map { $0.text ?? "" } ?? [], ["message 2", "message 1", "message 0"])
+            listed.fulfill()
+        }
+        wait(for: [listed], timeout: 10)
+        let posted = expectation(description: "posted")
+        client.post(roomId: roomId, text: "hello", queue: self.queue) { response in
+            XCTAssertEqual(response.result.data?.text, "hello")
+            posted.fulfill()
+        }
+        wait(for: [posted], timeout: 10)
+    }
+
+    func testRoomLifecycle() {
+        let client = RoomClient(authenticator: self.authenticator)
+        let done = expectation(description: "done")
+        client.create(title: "benchmark", queue: self.queue) { response in
+            guard let id = response.result.data?.id else {
+                XCTFail("room not created")
+                done.fulfill()
+                return
+            }
+            client.update(roomId: id, title: "renamed", queue: self.queue) { response in
+                XCTAssertEqual(response.result.data?.title, "renamed")
+                client.delete(roomId: id, queue: self.queue) { _ in
+                    client.get(roomId: id, queue: self.queue) { response in
+                        XCTAssertNotNil(response.result.error)
+                        done.fulfill()
+                    }
+                }
+            }
+        }
+        wait(for: [done], timeout: 10)
+    }
+
+    // MARK: Benchmarks
+
+    /// Runs `operations` calls of `operation`, at most `concurrency` at a time, and prints
+    /// operations per second and the 50th, 90th and 99th latency percentiles. Returns the time taken.
+    @discardableResult
+    private func run(_ name: String, operations: Int, concurrency: Int, _ operation: @escaping (Int, @escaping () -> Void) -> Void) -> TimeInterval {
+        let slots = DispatchSemaphore(value: concurrency)
+        let group = DispatchGroup()
+        let lock = NSLock()
+        var latencies = [TimeInterval]()
+        let start = Date()
+        for index in 0..<operations {
+            slots.wait()
+            group.enter()
+            let began = Date()
+            operation(index) {
+                let latency = Date().timeIntervalSince(began)
+                lock.lock()
+                latencies.append(latency)
+                lock.unlock()
+                slots.signal()
+                group.leave()
+            }
+        }
+        XCTAssertEqual(group.wait(timeout: .now() + 60), .success)
+        let elapsed = Date().timeIntervalSince(start)
+        latencies.sort()
+        func percentile(_ p: Double) -> String {
+            let latency = latencies.isEmpty ? 0 : latencies[min(latencies.count - 1, Int(Double(latencies.count) * p))]
+            return String(format: "%.2f", latency * 1000)
+        }
+        print("\(name): \(Int(Double(operations) / elapsed)) ops/s, p50 \(percentile(0.5)) ms, p90 \(percentile(0.9)) ms, p99 \(percentile(0.99)) ms "
+            + "(\(self.server.statistics.requests) requests, session hit rate \(String(format: "%.2f", ServiceSession.shared.statistics.hitRate)))")
+        return elapsed
+    }
+
+    func testBenchmarkRoomList() {
+        (0..<200).forEach { self.server.seedRoom(title: "room \($0)") }
+        let client = RoomClient(authenticator: self.authenticator)
+        self.run("RoomClient.list", operations: 500, concurrency: 8) { _, done in
+            client.list(max: 100, queue: self.queue) { response in
+                XCTAssertEqual(response.result.data?.count, 100)
+                done()
+            }
+        }
+    }
+
+    func testBenchmarkPersonGet() {
+        let client = PersonClient(authenticator: self.authenticator)
+        let id = self.server.me["id"] as! String
+        self.run("PersonClient.get", operations: 2000, concurrency: 16) { _, done in
+            client.get(personId: id, queue: self.queue) { response in
+                XCTAssertNotNil(response.result.data)
+                done()
+            }
+        }
+    }
+
+    func testBenchmarkMembershipCreate() {
+        let roomId = self.server.seedRoom()
+        let client = MembershipClient(authenticator: self.authenticator)
+        self.run("MembershipClient.create", operations: 500, concurrency: 8) { index, done in
+            client.create(roomId: roomId, personEmail: EmailAddress.fromString("user\(index)@example.com")!, queue: self.queue) { response in
+                XCTAssertNotNil(response.result.data)
+                done()
+            }
+        }
+    }
+
+    func testBenchmarkMessagePost() {
+        let key = FakeSparkServer.randomKey()
+        let roomId = self.server.seedRoom()
+        self.server.shareKey(key, roomId: roomId)
+        let client = MessageClientImpl(authenticator: self.authenticator, deviceUrl: URL(string: "https://device.example.com/devices/1")!, store: MessageStore(keychain: MockKeychain(), directory: nil))
+        let socket = WebSocketService(authenticator: self.authenticator)
+        let received = expectation(description: "events")
+        received.expectedFulfillmentCount = 500
+        socket.onEvent = { event in
+            if case .recvActivity = event {
+                received.fulfill()
+            }
+        }
+        self.server.attach(socket)
+        self.run("MessageClient.post", operations: 500, concurrency: 8) { index, done in
+            client.post(roomId: roomId, text: "message \(index)", queue: self.queue) { response in
+                XCTAssertEqual(response.result.data?.text, "message \(index)")
+                done()
+            }
+        }
+        wait(for: [received], timeout: 10)
+        XCTAssertEqual(self.server.statistics.acks, 500)
+    }
+
+    func testBenchmarkMessageList() {
+        let key = FakeSparkServer.randomKey()
+        let roomId = self.server.seedRoom(messages: 1000, key: key)
+        self.server.shareKey(key, roomId: roomId)
+        let client = MessageClientImpl(authenticator: self.authenticator, deviceUrl: URL(string: "https://device.example.com/devices/1")!, store: MessageStore(keychain: MockKeychain(), directory: nil))
+        self.run("MessageClient.list", operations: 100, concurrency: 4) { _, done in
+            client.list(roomId: roomId, max: 200, queue: self.queue) { response in
+                XCTAssertEqual(response.result.data?.first?.text, "message 999")
+                XCTAssertEqual(response.result.data?.count, 200)
+                done()
+            }
+        }
+    }
+
+    func testBenchmarkFileDownload() {
+        let size = 8 * 1024 * 1024
+        let (url, scr) = self.server.seedFile(Data((0..<size).map { UInt8(truncatingIfNeeded: $0 &* 131) }))
+        let directory = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString, isDirectory: true)
+        XCTAssertNoThrow(try FileManager.default.createDirectory(at: directory, withIntermediateDirectories: true, attributes: nil))
+        defer {
+            try? FileManager.default.removeItem(at: directory)
+        }
+        let operations = 20
+        let elapsed = self.run("DownloadFileOperation", operations: operations, concurrency: 2) { index, done in
+            // A directory of its own, as a download resumes from the checkpoint of its source and directory.
+            let target = directory.appendingPathComponent(String(index), isDirectory: true)
+            XCTAssertNoThrow(try FileManager.default.createDirectory(at: target, withIntermediateDirectories: true, attributes: nil))
+            let operation = DownloadFileOperation(authenticator: self.authenticator, uuid: UUID().uuidString, source: url, displayName: "file", secureContentRef: scr, thnumnail: false, target: target, queue: self.queue, progressHandler: nil) { result in
+                if let file = result.data {
+                    let attributes = try? FileManager.default.attributesOfItem(atPath: file.path)
+                    XCTAssertEqual((attributes?[.size] as? NSNumber)?.intValue, size)
+                    try? FileManager.default.removeItem(at: file)
+                }
+                else {
+                    XCTFail("download failed")
+                }
+                done()
+            }
+            operation.run()
+        }
+        print("DownloadFileOperation: \(String(format: "%.1f", Double(operations * size) / elapsed / 1024 / 1024)) MB/s")
+    }
+}
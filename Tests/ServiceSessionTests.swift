@@ -0,0 +1,242 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+import ObjectMapper
+@testable import SparkSDK
+
+class ServiceSessionTests: XCTestCase {
+
+    private var session: ServiceSession!
+    private let authenticator = StubAuthenticator()
+
+    override func setUp() {
+        StubURLProtocol.reset()
+        let configuration = URLSessionConfiguration.ephemeral
+        configuration.protocolClasses = [StubURLProtocol.self]
+        self.session = ServiceSession(configuration: configuration)
+    }
+
+    private func get(_ path: String, ttl: TimeInterval? = nil, method: HTTPMethod = .get, completionHandler: @escaping (ServiceResponse<Any>) -> Void) {
+        var builder = ServiceRequest.Builder(self.authenticator).baseUrl("https://stub.test").path(path).method(method).session(self.session).queue(DispatchQueue.global())
+        if let ttl = ttl {
+            builder = builder.cache(ttl: ttl)
+        }
+        builder.build().responseJSON(completionHandler)
+    }
+
+    private func wait(_ count: Int, _ send: (@escaping (ServiceResponse<Any>) -> Void) -> Void) -> [ServiceResponse<Any>] {
+        let done = expectation(description: "responses")
+        done.expectedFulfillmentCount = count
+        let lock = NSLock()
+        var responses = [ServiceResponse<Any>]()
+        for _ in 0..<count {
+            send { response in
+                lock.lock()
+                responses.append(response)
+                lock.unlock()
+                done.fulfill()
+            }
+        }
+        wait(for: [done], timeout: 10)
+        return responses
+    }
+
+    func testCoalescesIdenticalGets() {
+        StubURLProtocol.delay = 0.2
+        let responses = self.wait(20) { self.get("people/1", completionHandler: $0) }
+        XCTAssertEqual(responses.filter { ($0.result.data as? [String: Any])?["path"] as? String == "/people/1" }.count, 20)
+        XCTAssertEqual(StubURLProtocol.requests.count, 1)
+        XCTAssertEqual(self.session.statistics.coalesced, 19)
+        XCTAssertEqual(self.session.statistics.network, 1)
+    }
+
+    func testDoesNotCoalesceWrites() {
+        StubURLProtocol.delay = 0.1
+        _ = self.wait(3) { self.get("rooms/1", method: .put, completionHandler: $0) }
+        XCTAssertEqual(StubURLProtocol.requests.count, 3)
+    }
+
+    func testCachesAndRevalidates() {
+        _ = self.wait(1) { self.get("people/me", ttl: 60, completionHandler: $0) }
+        let cached = self.wait(5) { self.get("people/me", ttl: 60, completionHandler: $0) }
+        XCTAssertEqual(cached.filter { $0.result.data != nil }.count, 5)
+        XCTAssertEqual(StubURLProtocol.requests.count, 1)
+        XCTAssertEqual(self.session.statistics.cacheHits, 5)
+
+        // Expired: sent again with the ETag, answered with 304 and served from the cache.
+        _ = self.wait(1) { self.get("people/2", ttl: 0, completionHandler: $0) }
+        let revalidated = self.wait(1) { self.get("people/2", ttl: 0, completionHandler: $0) }
+        XCTAssertEqual((revalidated.first?.result.data as? [String: Any])?["path"] as? String, "/people/2")
+        XCTAssertEqual(StubURLProtocol.requests.last?.value(forHTTPHeaderField: "If-None-Match"), "\"/people/2\"")
+        XCTAssertEqual(self.session.statistics.revalidated, 1)
+        XCTAssertGreaterThan(self.session.statistics.hitRate, 0.5)
+    }
+
+    func testWriteInvalidatesCache() {
+        _ = self.wait(1) { self.get("people/3", ttl: 60, completionHandler: $0) }
+        _ = self.wait(1) { self.get("people/3", method: .put, completionHandler: $0) }
+        _ = self.wait(1) { self.get("people/3", ttl: 60, completionHandler: $0) }
+        XCTAssertEqual(StubURLProtocol.requests.count, 3)
+        XCTAssertNil(StubURLProtocol.requests.last?.value(forHTTPHeaderField: "If-None-Match"))
+    }
+
+    func testWriteInvalidatesNamedPaths() {
+        _ = self.wait(1) { self.get("people/me", ttl: 60, completionHandler: $0) }
+        _ = self.wait(1) { ServiceRequest.Builder(self.authenticator).baseUrl("https://stub.test").path("people/5").method(.put).invalidates("people/me")
+            .session(self.session).queue(DispatchQueue.global()).build().responseJSON($0) }
+        _ = self.wait(1) { self.get("people/me", ttl: 60, completionHandler: $0) }
+        XCTAssertEqual(StubURLProtocol.requests.count, 3)
+        XCTAssertEqual(StubURLProtocol.requests.last?.url?.path, "/people/me")
+        XCTAssertNil(StubURLProtocol.requests.last?.value(forHTTPHeaderField: "If-None-Match"))
+    }
+
+    func testRefreshesTokenOn401() {
+        StubURLProtocol.unauthorized = ["Bearer token-0"]
+        let responses = self.wait(1) { self.get("people/4", completionHandler: $0) }
+        XCTAssertNotNil(responses.first?.result.data)
+        XCTAssertEqual(StubURLProtocol.requests.map { $0.value(forHTTPHeaderField: "Authorization") ?? "" }, ["Bearer token-0", "Bearer token-1"])
+    }
+
+    func testRefreshesTokenOnImmediate401() {
+        // Answered before `send` returns, so the retrier must already know the authenticator.
+        StubURLProtocol.immediate = true
+        StubURLProtocol.unauthorized = ["Bearer token-0"]
+        let responses = self.wait(1) { self.get("people/5", completionHandler: $0) }
+        XCTAssertNotNil(responses.first?.result.data)
+        XCTAssertEqual(StubURLProtocol.requests.map { $0.value(forHTTPHeaderField: "Authorization") ?? "" }, ["Bearer token-0", "Bearer token-1"])
+    }
+
+    private func send(token: String) -> String? {
+        var request = URLRequest(url: URL(string: "https://stub.test/people/6")!)
+        request.setValue("Bearer " + token, forHTTPHeaderField: "Authorization")
+        let done = expectation(description: "response")
+        self.session.send(request, authenticator: self.authenticator, coalesce: false, ttl: nil) { _ in
+            done.fulfill()
+        }
+        wait(for: [done], timeout: 10)
+        return StubURLProtocol.requests.last?.value(forHTTPHeaderField: "Authorization")
+    }
+
+    func testRemembersOnlyRecentTokenRefreshes() {
+        let refreshes = ServiceSession.refreshedTokenCapacity + 2
+        for i in 0..<refreshes {
+            StubURLProtocol.unauthorized = ["Bearer token-\(i)"]
+            _ = self.wait(1) { self.get("people/\(i)", completionHandler: $0) }
+        }
+        StubURLProtocol.unauthorized = []
+        // Recent refreshes still upgrade a stale token, the oldest ones were forgotten.
+        XCTAssertEqual(self.send(token: "token-\(refreshes - 3)"), "Bearer token-\(refreshes)")
+        XCTAssertEqual(self.send(token: "token-0"), "Bearer token-0")
+
+        self.session.removeAllCachedResponses()
+        XCTAssertEqual(self.send(token: "token-\(refreshes - 1)"), "Bearer token-\(refreshes - 1)")
+    }
+}
+
+private class StubAuthenticator: Authenticator {
+    private var token = 0
+
+    var authorized: Bool {
+        return true
+    }
+
+    func deauthorize() {
+    }
+
+    func accessToken(completionHandler: @escaping (_ accessToken: String?) -> Void) {
+        completionHandler("token-\(self.token)")
+    }
+
+    func refreshToken(completionHandler: @escaping (_ accessToken: String?) -> Void) {
+        self.token += 1
+        completionHandler("token-\(self.token)")
+    }
+}
+
+/// Answers every request with `{"path": <path>}`, an ETag of the path, and 304 to a matching If-None-Match.
+private class StubURLProtocol: URLProtocol {
+    private static let lock = NSLock()
+    private static var _requests = [URLRequest]()
+    static var delay: TimeInterval = 0
+    static var immediate = false
+    static var unauthorized = Set<String>()
+
+    static var requests: [URLRequest] {
+        lock.lock()
+        defer {
+            lock.unlock()
+        }
+        return _requests
+    }
+
+    static func reset() {
+        lock.lock()
+        _requests.removeAll()
+        lock.unlock()
+        delay = 0
+        immediate = false
+        unauthorized = []
+    }
+
+    override class func canInit(with request: URLRequest) -> Bool {
+        return true
+    }
+
+    override class func canonicalRequest(for request: URLRequest) -> URLRequest {
+        return request
+    }
+
+    override func startLoading() {
+        StubURLProtocol.lock.lock()
+        StubURLProtocol._requests.append(self.request)
+        StubURLProtocol.lock.unlock()
+        let path = self.request.url?.path ?? ""
+        let etag = "\"\(path)\""
+        var status = 200
+        if StubURLProtocol.unauthorized.contains(self.request.value(forHTTPHeaderField: "Authorization") ?? "") {
+            status = 401
+        }
+        else if self.request.value(forHTTPHeaderField: "If-None-Match") == etag {
+            status = 304
+        }
+        let respond = {
+            let response = HTTPURLResponse(url: self.request.url!, statusCode: status, httpVersion: "HTTP/1.1", headerFields: ["Content-Type": "application/json", "ETag": etag])!
+            self.client?.urlProtocol(self, didReceive: response, cacheStoragePolicy: .notAllowed)
+            if status == 200 {
+                self.client?.urlProtocol(self, didLoad: try! JSONSerialization.data(withJSONObject: ["path": path], options: []))
+            }
+            self.client?.urlProtocolDidFinishLoading(self)
+        }
+        if StubURLProtocol.immediate {
+            respond()
+        }
+        else {
+            DispatchQueue.global().asyncAfter(deadline: .now() + StubURLProtocol.delay) {
+                respond()
+            }
+        }
+    }
+
+    override func stopLoading() {
+    }
+}
@@ -0,0 +1,99 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class StreamingSecureInputStreamTests: XCTestCase {
+
+    // Roughly what URLSession asks for per read when streaming a request body.
+    private let readSize = 32 * 1024
+    private var path: String!
+
+    override func setUp() {
+        let size = 16 * 1024 * 1024 + 123
+        let bytes = (0..<size).map { UInt8(truncatingIfNeeded: $0 &* 31) }
+        self.path = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString).path
+        XCTAssertTrue(FileManager.default.createFile(atPath: self.path, contents: Data(bytes), attributes: nil))
+    }
+
+    override func tearDown() {
+        try? FileManager.default.removeItem(atPath: self.path)
+    }
+
+    private func cpuTime() -> TimeInterval {
+        var usage = rusage()
+        getrusage(RUSAGE_SELF, &usage)
+        return TimeInterval(usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) + TimeInterval(usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1_000_000
+    }
+
+    private func drain(_ name: String, _ stream: InputStream) -> Data {
+        var output = Data()
+        var buffer = [UInt8](repeating: 0, count: self.readSize)
+        var reads = 0
+        var maxLatency: TimeInterval = 0
+        let cpu = self.cpuTime()
+        let start = Date()
+        stream.open()
+        while true {
+            let readStart = Date()
+            let count = stream.read(&buffer, maxLength: buffer.count)
+            maxLatency = max(maxLatency, Date().timeIntervalSince(readStart))
+            if count <= 0 {
+                XCTAssertEqual(count, 0)
+                break
+            }
+            reads += 1
+            output.append(buffer, count: count)
+        }
+        stream.close()
+        let elapsed = Date().timeIntervalSince(start)
+        print("\(name): \(String(format: "%.1f", Double(output.count) / 1048576 / elapsed)) MB/s, "
+            + "avg read \(String(format: "%.3f", elapsed / Double(max(reads, 1)) * 1000)) ms, max read \(String(format: "%.3f", maxLatency * 1000)) ms, "
+            + "CPU \(String(format: "%.3f", self.cpuTime() - cpu)) s")
+        return output
+    }
+
+    func testMatchesSecureInputStream() throws {
+        let scr = try SecureContentReference(error: ())
+        let expected = self.drain("SecureInputStream", try SecureInputStream(stream: InputStream(fileAtPath: self.path), scr: scr))
+        let tag = scr.tag
+        // A SCR carrying a tag would put the cipher in decrypt mode.
+        scr.tag = nil
+        let stream = try StreamingSecureInputStream(path: self.path, scr: scr)
+        let actual = self.drain("StreamingSecureInputStream", stream)
+        XCTAssertEqual(expected, actual)
+        XCTAssertEqual(tag, scr.tag)
+        XCTAssertEqual(stream.streamStatus, Stream.Status.closed)
+        XCTAssertGreaterThan(stream.statistics.chunks, 1)
+    }
+
+    func testCloseStopsProducer() throws {
+        let scr = try SecureContentReference(error: ())
+        let stream = try StreamingSecureInputStream(path: self.path, scr: scr)
+        var buffer = [UInt8](repeating: 0, count: self.readSize)
+        stream.open()
+        XCTAssertEqual(stream.read(&buffer, maxLength: buffer.count), buffer.count)
+        stream.close()
+        XCTAssertEqual(stream.read(&buffer, maxLength: buffer.count), 0)
+        XCTAssertLessThanOrEqual(stream.statistics.chunks, StreamingSecureInputStream.ringCapacity + 1)
+    }
+}
@@ -0,0 +1,188 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class TokenBrokerTests: XCTestCase {
+    
+    private let lock = NSLock()
+    private var clock: MockClock!
+    private var stored: TokenBroker.Token?
+    private var fetches = 0
+    // Fetches hold their answer until this is signalled, so all requests are in before any completes.
+    private var release: DispatchSemaphore!
+    private var broker: TokenBroker!
+    
+    override func setUp() {
+        clock = MockClock()
+        stored = nil
+        fetches = 0
+        release = DispatchSemaphore(value: 0)
+        broker = TokenBroker(clock: clock, current: { [unowned self] in
+            return self.locked { self.stored }
+        }, fetch: { [unowned self] completionHandler in
+            let fetch = self.locked { () -> Int in
+                self.fetches += 1
+                return self.fetches
+            }
+            DispatchQueue.global().async {
+                self.release.wait()
+                let token = TokenBroker.Token(value: "token\(fetch)", expiration: self.clock.currentTime.addingTimeInterval(3600))
+                self.locked {
+                    self.stored = token
+                }
+                completionHandler(token)
+            }
+        })
+    }
+    
+    private func locked<T>(_ block: () -> T) -> T {
+        lock.lock()
+        defer {
+            lock.unlock()
+        }
+        return block()
+    }
+    
+    private func store(_ value: String, expiresIn interval: TimeInterval) {
+        stored = TokenBroker.Token(value: value, expiration: clock.currentTime.addingTimeInterval(interval))
+    }
+    
+    private func token() -> String? {
+        var result: String?
+        let done = DispatchSemaphore(value: 0)
+        broker.token { token in
+            result = token
+            done.signal()
+        }
+        XCTAssertEqual(done.wait(timeout: .now() + 5), .success)
+        return result
+    }
+    
+    func testFreshTokenIsReturnedWithoutFetching() {
+        store("token0", expiresIn: 3600)
+        XCTAssertEqual(token(), "token0")
+        XCTAssertEqual(token(), "token0")
+        XCTAssertEqual(fetches, 0)
+    }
+    
+    func testTokenInRefreshWindowIsReturnedAndRefreshedOnce() {
+        store("token0", expiresIn: 10 * 60)
+        for _ in 0..<100 {
+            XCTAssertEqual(token(), "token0")
+        }
+        XCTAssertEqual(fetches, 1)
+        release.signal()
+        
+        let refreshed = expectation(description: "refreshed")
+        DispatchQueue.global().async {
+            while self.broker.refreshing {
+                usleep(1000)
+            }
+            refreshed.fulfill()
+        }
+        waitForExpectations(timeout: 5)
+        XCTAssertEqual(token(), "token1")
+        XCTAssertEqual(fetches, 1)
+    }
+    
+    func testExpiredTokenWaitsForRefresh() {
+        store("token0", expiresIn: 30)
+        release.signal()
+        XCTAssertEqual(token(), "token1")
+        XCTAssertEqual(fetches, 1)
+    }
+    
+    func testConcurrentRequestsAcrossExpiryShareOneRefresh() {
+        store("token0", expiresIn: 20 * 60)
+        let requests = 2000
+        let group = DispatchGroup()
+        var tokens = [String?]()
+        DispatchQueue.concurrentPerform(iterations: requests) { index in
+            if index == requests / 2 {
+                clock.advance(by: 30 * 60)
+            }
+            group.enter()
+            broker.token { token in
+                self.locked {
+                    tokens.append(token)
+                }
+                group.leave()
+            }
+        }
+        release.signal()
+        XCTAssertEqual(group.wait(timeout: .now() + 10), .success)
+        
+        XCTAssertEqual(tokens.count, requests)
+        XCTAssertTrue(tokens.filter { $0 != "token0" && $0 != "token1" }.isEmpty)
+        XCTAssertEqual(fetches, 1)
+        XCTAssertEqual(token(), "token1")
+    }
+    
+    func testConcurrentForcedRefreshesShareOneFetch() {
+        store("token0", expiresIn: 3600)
+        let requests = 500
+        let group = DispatchGroup()
+        var tokens = [String?]()
+        DispatchQueue.concurrentPerform(iterations: requests) { _ in
+            group.enter()
+            broker.refresh { token in
+                self.locked {
+                    tokens.append(token)
+                }
+                group.leave()
+            }
+        }
+        release.signal()
+        XCTAssertEqual(group.wait(timeout: .now() + 10), .success)
+        XCTAssertEqual(tokens.count, requests)
+        XCTAssertTrue(tokens.filter { $0 != "token1" }.isEmpty)
+        XCTAssertEqual(fetches, 1)
+    }
+    
+    func testRefreshUsingReplacesTheFetchInFlight() {
+        var result: String?
+        broker.token { token in
+            result = token
+        }
+        XCTAssertEqual(fetches, 1)
+        broker.refresh(using: { completionHandler in
+            completionHandler(TokenBroker.Token(value: "authorized", expiration: self.clock.currentTime.addingTimeInterval(3600)))
+        })
+        XCTAssertEqual(result, "authorized")
+        
+        // The first fetch still completes, but nobody waits for it any more.
+        release.signal()
+        XCTAssertEqual(token(), "authorized")
+    }
+    
+    func testInvalidateForgetsTheToken() {
+        store("token0", expiresIn: 3600)
+        XCTAssertEqual(token(), "token0")
+        stored = nil
+        broker.invalidate()
+        release.signal()
+        XCTAssertEqual(token(), "token1")
+        XCTAssertEqual(fetches, 1)
+    }
+}
@@ -0,0 +1,102 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class UploadFileOperationTests: XCTestCase {
+
+    /// Reports progress and finishes from a background thread, as Alamofire's upload callbacks do.
+    private class FakeUploadFileOperation: UploadFileOperation {
+        override func doUpload(client: MessageClientImpl, path: String, size: UInt64, progressHandler: ((Double) -> Void)?, completionHandler: @escaping (String?, SecureContentReference?, Error?) -> Void) {
+            DispatchQueue.global().async {
+                progressHandler?(0.5)
+                progressHandler?(1)
+                completionHandler("https://files.example.com/" + UUID().uuidString, try? SecureContentReference(error: ()), nil)
+            }
+        }
+    }
+
+    private let server = FakeSparkServer()
+    private let roomId = UUID().uuidString
+    private var client: MessageClientImpl!
+    private var paths = [String]()
+
+    override func setUp() {
+        self.server.install()
+        self.server.shareKey(FakeSparkServer.randomKey(), roomId: self.roomId)
+        self.client = MessageClientImpl(authenticator: SimpleAuthenticator(accessToken: "token"), deviceUrl: URL(string: "https://device.example.com/devices/1")!, store: MessageStore(keychain: MockKeychain(), directory: nil))
+    }
+
+    override func tearDown() {
+        self.server.uninstall()
+        self.paths.forEach { try? FileManager.default.removeItem(atPath: $0) }
+    }
+
+    private func file(progressHandler: ((Double) -> Void)? = nil) -> LocalFile {
+        let path = FileManager.default.temporaryDirectory.appendingPathComponent(UUID().uuidString).path
+        XCTAssertTrue(FileManager.default.createFile(atPath: path, contents: Data(count: 1024), attributes: nil))
+        self.paths.append(path)
+        return LocalFile(path: path, progressHandler: progressHandler)!
+    }
+
+    private func run(files: [LocalFile], queue: DispatchQueue?, progressHandler: @escaping (Double) -> Void) {
+        let key = EncryptionKey(roomId: self.roomId)
+        let operations = UploadFileOperations(key: key, operations: files.map { FakeUploadFileOperation(key: key, local: $0) })
+        let uploaded = expectation(description: "uploaded")
+        operations.run(client: self.client, progressHandler: progressHandler, queue: queue) { result in
+            XCTAssertEqual(result.data?.count, files.count)
+            uploaded.fulfill()
+        }
+        wait(for: [uploaded], timeout: 5)
+    }
+
+    func testFileProgressIsReportedOnMainQueue() {
+        var reports = 0
+        let files = (0..<3).map { _ in
+            self.file { _ in
+                XCTAssertTrue(Thread.isMainThread)
+                reports += 1
+            }
+        }
+        self.run(files: files, queue: nil) { _ in
+            XCTAssertTrue(Thread.isMainThread)
+        }
+        // Handlers posted to the main queue before the completion have run by now.
+        XCTAssertEqual(reports, 6)
+    }
+
+    func testOverallProgressIsReportedOnGivenQueue() {
+        let key = DispatchSpecificKey<Bool>()
+        let queue = DispatchQueue(label: "com.ciscospark.sdk.UploadFileOperationTests")
+        queue.setSpecific(key: key, value: true)
+        var values = [Double]()
+        self.run(files: [self.file(), self.file()], queue: queue) { value in
+            XCTAssertEqual(DispatchQueue.getSpecific(key: key), true)
+            values.append(value)
+        }
+        queue.sync {
+            XCTAssertEqual(values.count, 4)
+            XCTAssertEqual(values.last, 1)
+        }
+    }
+}
@@ -0,0 +1,128 @@
+// Copyright 2016-2018 Cisco Systems Inc
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+
+import Foundation
+import XCTest
+@testable import SparkSDK
+
+class WebSocketServiceTests: XCTestCase {
+
+    private func frame(id: String, room: String, index: Int, verb: String = "post") -> Data {
+        let json: [String: Any] = [
+            "id": id,
+            "data": [
+                "eventType": "conversation.activity",
+                "activity": [
+                    "id": UUID().uuidString,
+                    "verb": verb,
+                    "object": ["objectType": "comment", "displayName": String(index), "files": ["items": [["a": [1, 2, ["b": "}"]]]]]],
+                    "target": ["id": room, "objectType": "conversation"],
+                    "actor": ["entryUUID": UUID().uuidString, "emailAddress": "someone@example.com"]
+                ]
+            ],
+            "timestamp": 1525000000000,
+            "trackingId": "tracking"
+        ]
+        return try! JSONSerialization.data(withJSONObject: json, options: [])
+    }
+
+    func testScannerFindsNestedFields() {
+        let data = Data("""
+            {"skip": {"id": "wrong", "list": ["{", "\\"", {"id": 1}]}, "flag": true, "n": -1.5e3,
+             "data" : { "eventType" : "locus.difference", "locusUrl": "https:\\/\\/locus\\/1" }, "id": "a\\"b"}
+            """.utf8)
+        let fields = JSONFieldScanner.scan(data, paths: [["id"], ["data", "eventType"], ["data", "locusUrl"], ["data", "missing"]])
+        XCTAssertEqual(fields[0].flatMap { JSONFieldScanner.string($0) }, "a\"b")
+        XCTAssertEqual(fields[0].flatMap { String(data: $0, encoding: .utf8) }, "a\\\"b")
+        XCTAssertEqual(fields[1].flatMap { JSONFieldScanner.string($0) }, "locus.difference")
+        XCTAssertEqual(fields[2].flatMap { JSONFieldScanner.string($0) }, "https://locus/1")
+        XCTAssertNil(fields[3])
+    }
+
+    func testScannerStopsOnMalformedInput() {
+        let fields = JSONFieldScanner.scan(Data("{\"data\": {\"eventType\": \"loc".utf8), paths: [["data", "eventType"]])
+        XCTAssertNil(fields[0])
+        XCTAssertNil(JSONFieldScanner.scan(Data("[1, 2]".utf8), paths: [["id"]])[0])
+    }
+
+    func testAcksAndDropsIrrelevantEvents() {
+        let service = WebSocketService(authenticator: NoAuthenticator())
+        var events = 0
+        service.onEvent = { _ in
+            events += 1
+        }
+        var acks = [Data]()
+        service.receive(Data("{\"id\":\"1234\",\"data\":{\"eventType\":\"conversation.typing\"}}".utf8)) { acks.append($0) }
+        XCTAssertEqual(acks.count, 1)
+        let ack = (try? JSONSerialization.jsonObject(with: acks[0], options: [])) as? [String: String]
+        XCTAssertEqual(ack ?? [:], ["type": "ack", "messageId": "1234"])
+        Thread.sleep(forTimeInterval: 0.2)
+        XCTAssertEqual(events, 0)
+    }
+
+    func testKeepsOrderPerRoom() {
+        let service = WebSocketService(authenticator: NoAuthenticator())
+        let rooms = (0..<8).map { _ in UUID().uuidString }
+        let count = 50
+        let lock = NSLock()
+        var received = [String: [String]]()
+        let done = expectation(description: "events")
+        done.expectedFulfillmentCount = rooms.count * count
+        service.onEvent = { event in
+            if case .recvActivity(let activity) = event, let room = activity.roomId, let text = activity.text {
+                lock.lock()
+                received[room, default: []].append(text)
+                lock.unlock()
+                done.fulfill()
+            }
+        }
+        let start = Date()
+        for index in 0..<count {
+            for room in rooms {
+                service.receive(self.frame(id: UUID().uuidString, room: room, index: index)) { _ in }
+            }
+        }
+        wait(for: [done], timeout: 10)
+        print("WebSocketService: \(Int(Double(rooms.count * count) / Date().timeIntervalSince(start))) events/s")
+        let expected = (0..<count).map { String($0) }
+        XCTAssertEqual(received.count, rooms.count)
+        for texts in received.values {
+            XCTAssertEqual(texts, expected)
+        }
+    }
+}
+
+private class NoAuthenticator: Authenticator {
+    var authorized: Bool {
+        return false
+    }
+
+    func deauthorize() {
+    }
+
+    func accessToken(completionHandler: @escaping (_ accessToken: String?) -> Void) {
+        completionHandler(nil)
+    }
+
+    func refreshToken(completionHandler: @escaping (_ accessToken: String?) -> Void) {
+        completionHandler(nil)
+    }
+}